@@ -1,11 +1,21 @@
 #pragma once
 #include "NanoVectorDB.hpp"
+#include "fan_out.hpp"
+#include "numa.hpp"
 #include "metric/base.hpp"
 #include "metric/factory.hpp"
 #include "storage/base.hpp"
 #include "storage/factory.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <random>
 #include <vector>
 #include <memory>
@@ -13,8 +23,56 @@
 
 namespace nano_vectordb
 {
+/**
+ * @brief Tenant cache counters; see MultiTenantNanoVDB::cache_stats().
+ */
+struct TenantCacheStats
+{
+  std::size_t tenants = 0;        // tenants in memory
+  std::size_t evicting = 0;       // evicted tenants still in memory until their save finishes
+  std::size_t bytes = 0;          // memory_usage().total() summed over cached tenants, as last measured
+  std::size_t memory_budget = 0;  // 0 when only max_capacity limits the cache
+  std::uint64_t hits = 0;         // get_tenant calls served from memory
+  std::uint64_t misses = 0;       // get_tenant calls that loaded the tenant from disk
+  std::uint64_t evictions = 0;
+};
+
+/**
+ * @brief NUMA placement of tenants; see MultiTenantNanoVDB::set_numa_options().
+ */
+struct NumaOptions
+{
+  std::vector<numa::Node> nodes;     // empty: numa::detect_nodes()
+  std::size_t threads_per_node = 0;  // workers in each node's pool; 0 = one per CPU of the node
+  bool pin_threads = true;           // restrict the workers of a pool to the CPUs of its node
+  bool bind_memory = true;           // keep the rows of each tenant on its home node
+};
+
+/**
+ * @brief Tenants placed on one NUMA node; see MultiTenantNanoVDB::numa_stats().
+ */
+struct NumaNodeStats
+{
+  int node = 0;             // operating system node id
+  std::size_t tenants = 0;  // tenants homed on the node, cached or not
+  std::size_t bytes = 0;    // memory_usage().total() of its cached tenants, plus file sizes of those loading
+};
+
+/**
+ * @brief One hit of MultiTenantNanoVDB::query_many(); an owned copy, valid after the tenant changes.
+ */
+struct TenantQueryResult
+{
+  std::string tenant_id;
+  std::string id;  // record id within the tenant
+  float score;
+};
+
 /**
  * @brief Multi-tenant NanoVectorDB manager
+ *
+ * Cached tenants live in lock-striped shards, each with its own LRU list, so calls for tenants in
+ * different shards do not contend. All methods may be called from several threads at once.
  */
 class MultiTenantNanoVDB
 {
@@ -24,11 +82,13 @@ public:
    *
    * @param embedding_dim Dimension of the embedding vectors.
    * @param metric Similarity metric to use ("cosine" supported).
-   * @param max_capacity Maximum number of tenants to cache in memory.
+   * @param max_capacity Maximum number of tenants to cache in memory; least recently used are evicted.
    * @param storage_dir Directory for persistent storage of tenant databases.
+   * @param io_threads Background threads that save evicted tenants and run prefetches; 0 saves evicted
+   *        tenants on the calling thread.
    */
   MultiTenantNanoVDB(int embedding_dim, const std::string& metric = "cosine", int max_capacity = 1000,
-                     const std::string& storage_dir = "./nano_multi_tenant_storage")
+                     const std::string& storage_dir = "./nano_multi_tenant_storage", int io_threads = 1)
     : embedding_dim_(embedding_dim), metric_(metric), max_capacity_(max_capacity), storage_dir_(storage_dir)
   {
     if (embedding_dim_ <= 0)
@@ -43,8 +103,33 @@ public:
     {
       throw std::runtime_error("Storage directory must not be empty");
     }
+    if (io_threads < 0)
+    {
+      throw std::runtime_error("I/O thread count must not be negative");
+    }
     // Default storage backend for new tenants: SQLite (row-wise)
     default_storage_ = ::nano_vectordb::make(::nano_vectordb::storage::SQLite);
+    // Split the capacity over the shards so the total never exceeds max_capacity
+    const int shards = std::max(1, std::min(kMaxShards, max_capacity_ / kMinShardCapacity));
+    for (int i = 0; i < shards; ++i)
+    {
+      shards_.push_back(std::make_unique<Shard>());
+      shards_.back()->capacity = static_cast<std::size_t>(max_capacity_ / shards) +
+                                 (i < max_capacity_ % shards ? 1 : 0);
+    }
+    if (io_threads > 0)
+      io_pool_ = std::make_unique<ThreadPool>(static_cast<std::size_t>(io_threads));
+  }
+
+  MultiTenantNanoVDB(const MultiTenantNanoVDB&) = delete;
+  MultiTenantNanoVDB& operator=(const MultiTenantNanoVDB&) = delete;
+
+  /**
+   * @brief Finish background saves and prefetches before the cache goes away.
+   */
+  ~MultiTenantNanoVDB()
+  {
+    wait_for_io();
   }
 
   /**
@@ -53,6 +138,7 @@ public:
    */
   void set_default_metric(::nano_vectordb::metric type)
   {
+    std::lock_guard<std::mutex> lock(config_mutex_);
     default_metric_ = ::nano_vectordb::make(type);
   }
 
@@ -62,9 +148,110 @@ public:
    */
   void set_default_storage(::nano_vectordb::storage type)
   {
+    std::lock_guard<std::mutex> lock(config_mutex_);
     default_storage_ = ::nano_vectordb::make(type);
   }
 
+  /**
+   * @brief Configure parallel scans for all tenants
+   *
+   * Creates one worker pool shared by every cached and future tenant, so concurrent tenants do not
+   * oversubscribe the node with a pool each. With NUMA placement (set_numa_options()) tenants scan on
+   * the pool of their home node instead and only take min_chunk_rows from here.
+   *
+   * @param options Thread count and minimum chunk size. threads <= 1 disables the shared pool.
+   */
+  void set_scan_options(const ScanOptions& options)
+  {
+    std::shared_ptr<ThreadPool> pool = options.threads > 1 ? std::make_shared<ThreadPool>(options.threads - 1)
+                                                           : nullptr;
+    {
+      std::lock_guard<std::mutex> lock(config_mutex_);
+      scan_options_ = options;
+      thread_pool_ = pool;
+    }
+    const auto placement = numa_placement();
+    for (const auto& [tenant_id, db] : cached_tenants())
+      db->set_thread_pool(placement ? placement->pools[home_of(*placement, tenant_id)] : pool,
+                          options.min_chunk_rows);
+  }
+
+  /**
+   * @brief Place tenants on NUMA nodes and search each tenant on its home node
+   *
+   * Every node gets its own worker pool, pinned to the CPUs of the node. A tenant is homed on the node
+   * with the fewest bytes placed so far (its file size counts until it is loaded and measured) when it
+   * is first opened, and keeps that node for the lifetime of the manager. It is loaded on its node's
+   * pool, so its rows are first touched there, and the rows are then bound to the node. query() and
+   * query_many() search every tenant on its home pool, and the tenant's parallel scans split across
+   * that pool instead of the set_scan_options() one.
+   *
+   * Must be called before any tenant is opened.
+   *
+   * @param options Nodes, pool sizes, and whether to pin threads and bind memory.
+   */
+  void set_numa_options(const NumaOptions& options)
+  {
+    for (const auto& shard : shards_)
+    {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      if (!shard->lru.empty() || !shard->evicting.empty() || !shard->loading.empty())
+      {
+        throw std::runtime_error("NUMA placement must be set before any tenant is opened");
+      }
+    }
+    auto placement = std::make_shared<NumaPlacement>();
+    placement->nodes = options.nodes.empty() ? numa::detect_nodes() : options.nodes;
+    placement->bind = options.bind_memory;
+    placement->bytes.assign(placement->nodes.size(), 0);
+    placement->tenants.assign(placement->nodes.size(), 0);
+    for (std::size_t i = 0; i < placement->nodes.size(); ++i)
+    {
+      const numa::Node& node = placement->nodes[i];
+      if (node.cpus.empty())
+      {
+        throw std::runtime_error("NUMA node " + std::to_string(node.id) + " has no CPUs");
+      }
+      const std::size_t threads = options.threads_per_node > 0 ? options.threads_per_node : node.cpus.size();
+      const bool pin = options.pin_threads;
+      placement->pools.push_back(std::make_shared<ThreadPool>(threads, [node, i, pin](std::size_t) {
+        if (pin)
+          numa::pin_this_thread(node.cpus);
+        numa::this_thread_node() = static_cast<int>(i);
+      }));
+    }
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    numa_ = std::move(placement);
+  }
+
+  /**
+   * @brief Operating system id of a tenant's home node, -1 without NUMA placement or before the tenant
+   *        was first opened.
+   */
+  int tenant_node(const std::string& tenant_id) const
+  {
+    const auto placement = numa_placement();
+    if (!placement)
+      return -1;
+    const int node = placement->find(tenant_id);
+    return node < 0 ? -1 : placement->nodes[static_cast<std::size_t>(node)].id;
+  }
+
+  /**
+   * @brief Tenants and bytes placed on each NUMA node, in node order; empty without NUMA placement.
+   */
+  std::vector<NumaNodeStats> numa_stats() const
+  {
+    std::vector<NumaNodeStats> out;
+    const auto placement = numa_placement();
+    if (!placement)
+      return out;
+    std::lock_guard<std::mutex> lock(placement->mutex);
+    for (std::size_t i = 0; i < placement->nodes.size(); ++i)
+      out.push_back({ placement->nodes[i].id, placement->tenants[i], placement->bytes[i] });
+    return out;
+  }
+
   /**
    * @brief Generate the JSON file name from tenant ID
    *
@@ -85,8 +272,13 @@ public:
    */
   bool contain_tenant(const std::string& tenant_id) const
   {
-    return storage_.count(tenant_id) ||
-           std::filesystem::exists(storage_dir_ + "/" + jsonfile_from_id(tenant_id));
+    const Shard& shard = shard_for(tenant_id);
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (shard.index.count(tenant_id) || shard.evicting.count(tenant_id))
+        return true;
+    }
+    return std::filesystem::exists(path_for(tenant_id));
   }
 
   /**
@@ -97,36 +289,63 @@ public:
   std::string create_tenant()
   {
     std::string tenant_id = generate_uuid();
-    auto db = std::make_shared<NanoVectorDB>(embedding_dim_, metric_,
-                                             storage_dir_ + "/" + jsonfile_from_id(tenant_id));
-    // Apply default strategies if provided
-    if (default_metric_)
-      db->initialize_metric(default_metric_);
-    if (default_storage_)
-      db->initialize_storage(default_storage_);
-    if (!db)
+    const auto placement = numa_placement();
+    const int node = placement ? static_cast<int>(home_of(*placement, tenant_id)) : -1;
+    auto db = on_node(placement.get(), node, [&] { return make_tenant(tenant_id, placement.get(), node); });
+    const std::size_t bytes = db->memory_usage().total();
+    Shard& shard = shard_for(tenant_id);
+    std::vector<Entry> evicted;
     {
-      throw std::runtime_error("Failed to create NanoVectorDB for tenant");
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      evicted = insert(shard, tenant_id, db, bytes);
     }
-    load_tenant_in_cache(tenant_id, db);
+    flush_evicted(shard, evicted);
+    enforce_budget(tenant_id);
     return tenant_id;
   }
 
   /**
    * @brief Delete a tenant object
    *
+   * Waits for a load or save of the tenant that is in progress on another thread.
+   *
    * @param tenant_id Tenant identifier
    */
   void delete_tenant(const std::string& tenant_id)
   {
-    if (!contain_tenant(tenant_id))
+    Shard& shard = shard_for(tenant_id);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    shard.settled.wait(lock,
+                       [&] { return !shard.loading.count(tenant_id) && !shard.flushing.count(tenant_id); });
+    const std::string path = path_for(tenant_id);
+    bool cached = shard.evicting.erase(tenant_id) > 0;
+    auto it = shard.index.find(tenant_id);
+    if (it != shard.index.end())
+    {
+      bytes_ -= it->second->bytes;
+      if (const auto placement = numa_placement())
+        placement->sub(tenant_id, it->second->bytes);
+      shard.lru.erase(it->second);
+      shard.index.erase(it);
+      cached = true;
+    }
+    if (!cached && !std::filesystem::exists(path))
     {
       throw std::runtime_error("Tenant does not exist: " + tenant_id);
     }
-    storage_.erase(tenant_id);
-    cache_queue_.erase(std::remove(cache_queue_.begin(), cache_queue_.end(), tenant_id), cache_queue_.end());
+    if (const auto placement = numa_placement())
+      placement->forget(tenant_id);
+    // The shard stays locked until the files are gone, so the tenant cannot be reloaded from them
+    // A cached SQLite connection folds its journal back in when closed; leftovers go with the file
+    if (auto sqlite = std::dynamic_pointer_cast<SQLiteStorage>(default_storage()))
+      sqlite->close(path);
     std::error_code ec;
-    std::filesystem::remove(storage_dir_ + "/" + jsonfile_from_id(tenant_id), ec);
+    for (const std::string& file : { path, WriteAheadLog::path_for(path), path + "-wal", path + "-shm" })
+    {
+      std::filesystem::remove(file, ec);
+      if (ec)
+        break;
+    }
     if (ec)
     {
       throw std::runtime_error("Failed to remove tenant file: " + ec.message());
@@ -134,107 +353,895 @@ public:
   }
 
   /**
-   * @brief Get a tenant object
+   * @brief Get a tenant object and mark it most recently used
+   *
+   * A tenant that is not cached is loaded from disk outside the shard lock; concurrent calls for the
+   * same tenant wait for that one load instead of starting their own. The tenant's memory usage is
+   * measured again on every call, so growth since the last call counts against the memory budget. With
+   * NUMA placement the load runs on the pool of the tenant's home node.
    *
    * @param tenant_id Tenant identifier
    * @return std::shared_ptr<NanoVectorDB>
    */
   std::shared_ptr<NanoVectorDB> get_tenant(const std::string& tenant_id)
   {
-    // If present in cache, return it
-    if (storage_.count(tenant_id))
+    Shard& shard = shard_for(tenant_id);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    for (;;)
     {
-      if (!storage_[tenant_id])
+      auto it = shard.index.find(tenant_id);
+      if (it != shard.index.end())
+      {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        ++it->second->hits;
+        metrics_->add(counter::TenantHits);
+        auto db = it->second->db;
+        lock.unlock();
+        remeasure(shard, tenant_id, db);
+        return db;
+      }
+      // Evicted but not written yet, or its save failed: take it back instead of reading the file
+      auto ev = shard.evicting.find(tenant_id);
+      if (ev != shard.evicting.end())
+      {
+        auto db = ev->second;
+        shard.evicting.erase(ev);
+        metrics_->add(counter::TenantHits);
+        std::vector<Entry> evicted = insert(shard, tenant_id, db, 0);
+        lock.unlock();
+        flush_evicted(shard, evicted);
+        remeasure(shard, tenant_id, db);
+        return db;
+      }
+      auto pending = shard.loading.find(tenant_id);
+      if (pending != shard.loading.end())
       {
-        throw std::runtime_error("Tenant DB pointer is null: " + tenant_id);
+        auto result = pending->second;
+        metrics_->add(counter::TenantMisses);
+        lock.unlock();
+        return result.get();
       }
-      return storage_[tenant_id];
+      // The file is being rewritten by a save; wait for it rather than load a partial file
+      if (!shard.flushing.count(tenant_id))
+        break;
+      shard.settled.wait(lock);
     }
-    // Lazy-load from disk if file exists
-    const std::string path = storage_dir_ + "/" + jsonfile_from_id(tenant_id);
-    if (std::filesystem::exists(path))
+
+    std::promise<std::shared_ptr<NanoVectorDB>> promise;
+    shard.loading.emplace(tenant_id, promise.get_future().share());
+    metrics_->add(counter::TenantMisses);
+    lock.unlock();
+    std::shared_ptr<NanoVectorDB> db;
+    std::size_t bytes = 0;
+    const auto placement = numa_placement();
+    try
     {
-      auto db = std::make_shared<NanoVectorDB>(embedding_dim_, metric_, path);
-      load_tenant_in_cache(tenant_id, db);
-      return db;
+      if (!std::filesystem::exists(path_for(tenant_id)))
+      {
+        throw std::runtime_error("Tenant not found: " + tenant_id);
+      }
+      const int node = placement ? static_cast<int>(home_of(*placement, tenant_id)) : -1;
+      db = on_node(placement.get(), node, [&] { return make_tenant(tenant_id, placement.get(), node); });
+      bytes = db->memory_usage().total();
     }
-    throw std::runtime_error("Tenant not found: " + tenant_id);
+    catch (...)
+    {
+      if (placement)
+        placement->forget(tenant_id);
+      lock.lock();
+      shard.loading.erase(tenant_id);
+      shard.settled.notify_all();
+      lock.unlock();
+      promise.set_exception(std::current_exception());
+      throw;
+    }
+    lock.lock();
+    shard.loading.erase(tenant_id);
+    std::vector<Entry> evicted = insert(shard, tenant_id, db, bytes);
+    shard.settled.notify_all();
+    lock.unlock();
+    promise.set_value(db);
+    flush_evicted(shard, evicted);
+    enforce_budget(tenant_id);
+    return db;
   }
 
   /**
-   * @brief Save all cached tenant databases to disk.
+   * @brief Get a tenant without blocking on disk I/O.
+   *
+   * A cached tenant is returned in a ready future; otherwise it is loaded on the I/O pool (or on the
+   * calling thread without one). Errors such as an unknown tenant are reported through the future.
+   *
+   * @param tenant_id Tenant identifier
+   * @return std::future<std::shared_ptr<NanoVectorDB>>
    */
-  void save()
+  std::future<std::shared_ptr<NanoVectorDB>> get_tenant_async(const std::string& tenant_id)
   {
-    std::error_code ec;
-    if (!std::filesystem::exists(storage_dir_))
+    if (!io_pool_ || is_cached(tenant_id))
     {
-      std::filesystem::create_directories(storage_dir_, ec);
-      if (ec)
+      std::promise<std::shared_ptr<NanoVectorDB>> ready;
+      try
       {
-        throw std::runtime_error("Failed to create storage directory: " + ec.message());
+        ready.set_value(get_tenant(tenant_id));
       }
-    }
-    for (const auto& [tenant_id, db] : storage_)
-    {
-      if (!db)
+      catch (...)
       {
-        throw std::runtime_error("Tenant DB pointer is null during save: " + tenant_id);
+        ready.set_exception(std::current_exception());
       }
+      return ready.get_future();
+    }
+    return submit_io([this, tenant_id] { return get_tenant(tenant_id); });
+  }
+
+  /**
+   * @brief Load a tenant into the cache ahead of demand, on the I/O pool when there is one.
+   *
+   * Does nothing if the tenant is cached; a tenant that cannot be loaded is skipped, and get_tenant()
+   * reports the error when it is actually requested.
+   *
+   * @param tenant_id Tenant identifier
+   */
+  void prefetch_tenant(const std::string& tenant_id)
+  {
+    if (is_cached(tenant_id))
+      return;
+    auto load = [this, tenant_id] {
       try
       {
-        db->save();
+        get_tenant(tenant_id);
       }
       catch (const std::exception& e)
       {
-        throw std::runtime_error("Failed to save tenant '" + tenant_id + "': " + e.what());
+        NVDB_LOG("[MultiTenantNanoVDB::prefetch_tenant] " << tenant_id << ": " << e.what());
       }
+    };
+    if (io_pool_)
+      submit_io(load);
+    else
+      load();
+  }
+
+  /**
+   * @brief Search one tenant, on the pool of its home node when NUMA placement is set.
+   *
+   * @param tenant_id Tenant to search; loaded if it is not cached.
+   * @param query Input query vector.
+   * @param top_k Number of results to return.
+   * @param better_than_threshold Optional threshold to filter results.
+   * @return std::vector<TenantQueryResult> Best first.
+   */
+  std::vector<TenantQueryResult> query(const std::string& tenant_id, const Eigen::VectorXf& query,
+                                       int top_k = 10,
+                                       std::optional<float> better_than_threshold = std::nullopt)
+  {
+    return search_on_home(tenant_id, better_than_threshold,
+                          [&](const NanoVectorDB& db, std::optional<float> threshold) {
+                            return db.query(query, top_k, threshold);
+                          });
+  }
+
+  /**
+   * @brief query() restricted to the records matching a metadata predicate.
+   */
+  std::vector<TenantQueryResult> query(const std::string& tenant_id, const Eigen::VectorXf& query, int top_k,
+                                       std::optional<float> better_than_threshold, const Predicate& where)
+  {
+    return search_on_home(tenant_id, better_than_threshold,
+                          [&](const NanoVectorDB& db, std::optional<float> threshold) {
+                            return db.query(query, top_k, threshold, where);
+                          });
+  }
+
+  /**
+   * @brief Search several tenants for one query and return the global top-k.
+   *
+   * Each tenant is loaded (if it is not cached) and searched as its own task on the scan pool set by
+   * set_scan_options(), so cold tenants load concurrently and the call takes about as long as the
+   * slowest tenant instead of the sum of all of them. Tasks are claimed by whichever thread is free,
+   * cold tenants first. The k-th best score found so far is shared between tasks and passed on as the
+   * threshold of every tenant searched after it. Without a scan pool the tenants are searched in turn
+   * on the calling thread. With NUMA placement each tenant is searched on the pool of its home node,
+   * all nodes at once, and the threshold is shared across them.
+   *
+   * @param tenant_ids Tenants to search; duplicates are searched once.
+   * @param query Input query vector.
+   * @param top_k Number of results to return over all tenants.
+   * @param better_than_threshold Optional threshold to filter results.
+   * @return std::vector<TenantQueryResult> Best first.
+   */
+  std::vector<TenantQueryResult> query_many(const std::vector<std::string>& tenant_ids,
+                                            const Eigen::VectorXf& query, int top_k = 10,
+                                            std::optional<float> better_than_threshold = std::nullopt)
+  {
+    return fan_out(tenant_ids, top_k, better_than_threshold,
+                   [&](const NanoVectorDB& db, std::optional<float> threshold) {
+                     return db.query(query, top_k, threshold);
+                   });
+  }
+
+  /**
+   * @brief query_many() restricted to the records matching a metadata predicate in every tenant.
+   */
+  std::vector<TenantQueryResult> query_many(const std::vector<std::string>& tenant_ids,
+                                            const Eigen::VectorXf& query, int top_k,
+                                            std::optional<float> better_than_threshold,
+                                            const Predicate& where)
+  {
+    return fan_out(tenant_ids, top_k, better_than_threshold,
+                   [&](const NanoVectorDB& db, std::optional<float> threshold) {
+                     return db.query(query, top_k, threshold, where);
+                   });
+  }
+
+  /**
+   * @brief Block until every queued background save and prefetch has finished.
+   *
+   * Tenants whose background save failed stay cached; save() retries them and reports the error.
+   */
+  void wait_for_io()
+  {
+    std::unique_lock<std::mutex> lock(io_mutex_);
+    io_idle_.wait(lock, [this] { return io_pending_ == 0; });
+  }
+
+  /**
+   * @brief Save all cached tenant databases that changed since they were loaded or last saved.
+   *
+   * Tenants whose save failed during eviction are retried and released once written.
+   */
+  void save()
+  {
+    ensure_storage_dir();
+    for (auto& shard : shards_)
+    {
+      std::vector<Entry> entries;
+      {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        for (const auto& cached : shard->lru)
+          entries.emplace_back(cached.id, cached.db);
+        entries.insert(entries.end(), shard->evicting.begin(), shard->evicting.end());
+        for (const auto& entry : entries)
+          ++shard->flushing[entry.first];
+      }
+      std::string error;
+      for (const auto& entry : entries)
+      {
+        std::string failed = write_tenant(*shard, entry, "Failed to save tenant '");
+        if (error.empty())
+          error = std::move(failed);
+      }
+      settle(*shard, entries);
+      if (!error.empty())
+      {
+        throw std::runtime_error(error);
+      }
+    }
+  }
+
+  /**
+   * @brief Limit the memory held by cached tenants, in bytes of NanoVectorDB::memory_usage().total().
+   *
+   * When the cached tenants outgrow the budget, tenants near the least recently used end are evicted,
+   * preferring large tenants with few hits. max_capacity still limits the tenant count.
+   *
+   * @param bytes Memory budget; 0 removes it.
+   */
+  void set_memory_budget(std::size_t bytes)
+  {
+    memory_budget_ = bytes;
+    enforce_budget(std::string());
+  }
+
+  std::size_t memory_budget() const
+  {
+    return memory_budget_;
+  }
+
+  /**
+   * @brief Current memory usage and hit, miss and eviction counts of the tenant cache.
+   */
+  TenantCacheStats cache_stats() const
+  {
+    TenantCacheStats stats;
+    for (const auto& shard : shards_)
+    {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      stats.tenants += shard->lru.size();
+      stats.evicting += shard->evicting.size();
     }
+    const MetricsSnapshot counts = metrics_->snapshot();
+    stats.hits = counts[counter::TenantHits];
+    stats.misses = counts[counter::TenantMisses];
+    stats.evictions = counts[counter::TenantEvictions];
+    stats.bytes = bytes_;
+    stats.memory_budget = memory_budget_;
+    return stats;
+  }
+
+  /**
+   * @brief Operation latencies and counters of all tenants, plus the tenant cache hits, misses and
+   *        evictions. Tenant loads (including creation) are recorded as op load.
+   */
+  MetricsSnapshot stats() const
+  {
+    return metrics_->snapshot();
+  }
+
+  /**
+   * @brief stats() in the Prometheus text exposition format, for a /metrics endpoint.
+   *
+   * @param prefix Metric name prefix.
+   */
+  std::string prometheus_metrics(const std::string& prefix = "nanovdb") const
+  {
+    return stats().to_prometheus(prefix);
   }
 
 private:
+  using Entry = std::pair<std::string, std::shared_ptr<NanoVectorDB>>;
+
   /**
-   * @brief Load a tenant into cache
+   * @brief One lock stripe of the tenant cache with its own LRU list.
+   */
+  struct Cached
+  {
+    std::string id;
+    std::shared_ptr<NanoVectorDB> db;
+    std::size_t bytes = 0;   // memory_usage().total() when last measured
+    std::uint64_t hits = 0;  // get_tenant calls since the tenant was cached
+  };
+
+  struct Shard
+  {
+    mutable std::mutex mutex;
+    std::condition_variable settled;  // signalled when a load or save of a tenant finishes
+    std::list<Cached> lru;            // most recently used first
+    std::unordered_map<std::string, std::list<Cached>::iterator> index;
+    std::unordered_map<std::string, std::shared_future<std::shared_ptr<NanoVectorDB>>> loading;
+    std::unordered_map<std::string, std::shared_ptr<NanoVectorDB>> evicting;  // evicted, not yet saved
+    std::unordered_map<std::string, int> flushing;                             // saves in progress per tenant
+    std::size_t capacity = 0;
+  };
+
+  /**
+   * @brief Node pools and tenant homes set by set_numa_options().
+   */
+  struct NumaPlacement
+  {
+    struct Home
+    {
+      std::size_t node = 0;
+      std::size_t reserved = 0;  // file size counted in bytes until the tenant is measured
+    };
+
+    std::vector<numa::Node> nodes;
+    std::vector<std::shared_ptr<ThreadPool>> pools;  // one per node, in node order
+    bool bind = true;
+
+    mutable std::mutex mutex;  // guards the members below
+    std::unordered_map<std::string, Home> homes;
+    std::vector<std::size_t> bytes;    // per node
+    std::vector<std::size_t> tenants;  // homes per node
+
+    /**
+     * @brief Node index of a tenant's home, -1 if it has none.
+     */
+    int find(const std::string& tenant_id) const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = homes.find(tenant_id);
+      return it == homes.end() ? -1 : static_cast<int>(it->second.node);
+    }
+
+    /**
+     * @brief Home a tenant on the node with the fewest bytes, then fewest tenants; keeps an existing home.
+     *
+     * @param estimate Bytes counted for the tenant until add() reports it measured.
+     */
+    std::size_t place(const std::string& tenant_id, std::size_t estimate)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = homes.find(tenant_id);
+      if (it != homes.end())
+        return it->second.node;
+      std::size_t best = 0;
+      for (std::size_t i = 1; i < nodes.size(); ++i)
+      {
+        if (bytes[i] < bytes[best] || (bytes[i] == bytes[best] && tenants[i] < tenants[best]))
+          best = i;
+      }
+      homes.emplace(tenant_id, Home{ best, estimate });
+      bytes[best] += estimate;
+      ++tenants[best];
+      return best;
+    }
+
+    /**
+     * @brief Count measured bytes of a cached tenant on its node, replacing its estimate.
+     */
+    void add(const std::string& tenant_id, std::size_t n)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = homes.find(tenant_id);
+      if (it == homes.end())
+        return;
+      std::size_t& node_bytes = bytes[it->second.node];
+      node_bytes = node_bytes - it->second.reserved + n;
+      it->second.reserved = 0;
+    }
+
+    void sub(const std::string& tenant_id, std::size_t n)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = homes.find(tenant_id);
+      if (it == homes.end())
+        return;
+      std::size_t& node_bytes = bytes[it->second.node];
+      node_bytes -= std::min(node_bytes, n);
+    }
+
+    /**
+     * @brief Drop the home of a deleted tenant, or of one that failed to load.
+     */
+    void forget(const std::string& tenant_id)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = homes.find(tenant_id);
+      if (it == homes.end())
+        return;
+      bytes[it->second.node] -= std::min(bytes[it->second.node], it->second.reserved);
+      --tenants[it->second.node];
+      homes.erase(it);
+    }
+  };
+
+  // Lock stripes; fewer when the capacity is small so eviction stays close to global LRU order
+  static constexpr int kMaxShards = 16;
+  static constexpr int kMinShardCapacity = 64;
+  // Least recently used tenants compared by hits per byte when a memory budget is set
+  static constexpr int kEvictionSample = 8;
+
+  Shard& shard_for(const std::string& tenant_id)
+  {
+    return *shards_[std::hash<std::string>{}(tenant_id) % shards_.size()];
+  }
+
+  const Shard& shard_for(const std::string& tenant_id) const
+  {
+    return *shards_[std::hash<std::string>{}(tenant_id) % shards_.size()];
+  }
+
+  std::string path_for(const std::string& tenant_id) const
+  {
+    return storage_dir_ + "/" + jsonfile_from_id(tenant_id);
+  }
+
+  std::shared_ptr<IStorage> default_storage() const
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    return default_storage_;
+  }
+
+  std::shared_ptr<NumaPlacement> numa_placement() const
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    return numa_;
+  }
+
+  /**
+   * @brief Node index of a tenant's home, placing a tenant opened for the first time.
+   */
+  std::size_t home_of(NumaPlacement& placement, const std::string& tenant_id) const
+  {
+    const int node = placement.find(tenant_id);
+    if (node >= 0)
+      return static_cast<std::size_t>(node);
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(path_for(tenant_id), ec);
+    return placement.place(tenant_id, ec ? 0 : static_cast<std::size_t>(size));
+  }
+
+  /**
+   * @brief Run f on the pool of a node and wait for it; on the calling thread without placement or when
+   *        it already works for that pool.
+   */
+  template <typename F>
+  static auto on_node(NumaPlacement* placement, int node, F&& f) -> std::invoke_result_t<F&>
+  {
+    if (!placement || node < 0 || numa::this_thread_node() == node)
+      return f();
+    return placement->pools[static_cast<std::size_t>(node)]->submit([&f] { return f(); }).get();
+  }
+
+  /**
+   * @brief Open a tenant database with the default strategies, loading it if the file exists.
    *
-   * @param tenant_id Tenant identifier
-   * @param db Pointer to NanoVectorDB instance
+   * @param placement NUMA placement, or nullptr.
+   * @param node Home node index of the tenant in placement; its pool scans the tenant and its rows are
+   *        bound to the node.
    */
-  void load_tenant_in_cache(const std::string& tenant_id, std::shared_ptr<NanoVectorDB> db)
+  std::shared_ptr<NanoVectorDB> make_tenant(const std::string& tenant_id, const NumaPlacement* placement,
+                                            int node) const
+  {
+    std::shared_ptr<IMetric> metric;
+    std::shared_ptr<IStorage> storage;
+    std::shared_ptr<ThreadPool> pool;
+    std::size_t min_chunk_rows = 0;
+    {
+      std::lock_guard<std::mutex> lock(config_mutex_);
+      metric = default_metric_;
+      storage = default_storage_;
+      pool = thread_pool_;
+      min_chunk_rows = scan_options_.min_chunk_rows;
+    }
+    const auto start = Metrics::clock::now();
+    // The tenant records into metrics_ once set up; the load is timed here so it covers the setup too
+    auto db =
+      std::make_shared<NanoVectorDB>(embedding_dim_, metric_, path_for(tenant_id), nullptr, storage, nullptr);
+    if (!db)
+    {
+      throw std::runtime_error("Failed to create NanoVectorDB for tenant");
+    }
+    // Through initialize_metric so the legacy metric string and normalization follow the strategy
+    if (metric)
+      db->initialize_metric(metric);
+    if (placement && node >= 0)
+    {
+      pool = placement->pools[static_cast<std::size_t>(node)];
+      if (placement->bind)
+        db->set_numa_node(placement->nodes[static_cast<std::size_t>(node)].id);
+    }
+    if (pool)
+      db->set_thread_pool(pool, min_chunk_rows);
+    db->set_metrics(metrics_);
+    metrics_->record(operation::Load, start);
+    return db;
+  }
+
+  /**
+   * @brief Insert a tenant as most recently used; the caller holds the shard lock.
+   *
+   * @param bytes Measured memory usage of the tenant.
+   * @return std::vector<Entry> Tenants pushed out of the shard, to be saved by flush_evicted().
+   */
+  std::vector<Entry> insert(Shard& shard, const std::string& tenant_id, std::shared_ptr<NanoVectorDB> db,
+                            std::size_t bytes)
   {
     if (!db)
     {
       throw std::runtime_error("Cannot cache null NanoVectorDB for tenant: " + tenant_id);
     }
-    if (storage_.size() >= (size_t)max_capacity_)
+    shard.lru.push_front(Cached{ tenant_id, std::move(db), bytes, 1 });
+    shard.index[tenant_id] = shard.lru.begin();
+    bytes_ += bytes;
+    if (const auto placement = numa_placement())
+      placement->add(tenant_id, bytes);
+    std::vector<Entry> evicted;
+    while (shard.lru.size() > shard.capacity)
+      evict(shard, pick_victim(shard, tenant_id), evicted);
+    return evicted;
+  }
+
+  /**
+   * @brief Tenant to evict from a shard, never `keep`; lru.end() if there is none.
+   *
+   * Without a memory budget this is the least recently used tenant. With one, the few least recently
+   * used tenants are compared and the one with the fewest hits per byte goes, so a large, rarely used
+   * tenant makes room before several small busy ones.
+   */
+  std::list<Cached>::iterator pick_victim(Shard& shard, const std::string& keep) const
+  {
+    const bool weighted = memory_budget_ > 0;
+    auto victim = shard.lru.end();
+    double victim_score = 0.0;
+    int sampled = 0;
+    for (auto it = shard.lru.end(); it != shard.lru.begin() && sampled < kEvictionSample;)
+    {
+      --it;
+      if (it->id == keep)
+        continue;
+      const double score =
+        static_cast<double>(it->hits) / static_cast<double>(std::max<std::size_t>(1, it->bytes));
+      if (victim == shard.lru.end() || score < victim_score)
+      {
+        victim = it;
+        victim_score = score;
+      }
+      if (!weighted)
+        break;
+      ++sampled;
+    }
+    return victim;
+  }
+
+  /**
+   * @brief Move a cached tenant to the evicting set; the caller holds the shard lock.
+   */
+  void evict(Shard& shard, std::list<Cached>::iterator victim, std::vector<Entry>& evicted)
+  {
+    bytes_ -= victim->bytes;
+    if (const auto placement = numa_placement())
+      placement->sub(victim->id, victim->bytes);
+    shard.index.erase(victim->id);
+    shard.evicting[victim->id] = victim->db;
+    ++shard.flushing[victim->id];
+    metrics_->add(counter::TenantEvictions);
+    evicted.emplace_back(std::move(victim->id), std::move(victim->db));
+    shard.lru.erase(victim);
+  }
+
+  /**
+   * @brief Measure a tenant again after it was handed out, and evict others if it outgrew the budget.
+   */
+  void remeasure(Shard& shard, const std::string& tenant_id, const std::shared_ptr<NanoVectorDB>& db)
+  {
+    // Measured without the shard lock: memory_usage() takes the tenant's own lock
+    const std::size_t bytes = db->memory_usage().total();
     {
-      // Evict least-recently-added tenant and persist it to disk
-      const std::string evict_id = cache_queue_.front();
-      auto it = storage_.find(evict_id);
-      if (it != storage_.end() && it->second)
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto it = shard.index.find(tenant_id);
+      if (it == shard.index.end() || it->second->db != db)
+        return;
+      bytes_ += bytes;
+      bytes_ -= it->second->bytes;
+      if (const auto placement = numa_placement())
       {
-        std::error_code ec;
-        if (!std::filesystem::exists(storage_dir_))
-        {
-          std::filesystem::create_directories(storage_dir_, ec);
-          if (ec)
-          {
-            throw std::runtime_error("Failed to create storage directory during eviction: " + ec.message());
-          }
-        }
-        try
+        placement->sub(tenant_id, it->second->bytes);
+        placement->add(tenant_id, bytes);
+      }
+      it->second->bytes = bytes;
+    }
+    enforce_budget(tenant_id);
+  }
+
+  /**
+   * @brief Evict tenants until the cache fits the memory budget, starting with the shard of `keep`.
+   *
+   * Shards are locked one at a time. `keep` (the tenant just requested) is never evicted, so a single
+   * tenant larger than the budget stays cached on its own.
+   */
+  void enforce_budget(const std::string& keep)
+  {
+    const std::size_t budget = memory_budget_;
+    if (budget == 0 || bytes_ <= budget)
+      return;
+    const std::size_t first = std::hash<std::string>{}(keep) % shards_.size();
+    for (std::size_t k = 0; k < shards_.size() && bytes_ > budget; ++k)
+    {
+      Shard& shard = *shards_[(first + k) % shards_.size()];
+      std::vector<Entry> evicted;
+      {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        while (bytes_ > budget)
         {
-          it->second->save();
+          auto victim = pick_victim(shard, keep);
+          if (victim == shard.lru.end())
+            break;
+          evict(shard, victim, evicted);
         }
-        catch (const std::exception& e)
+      }
+      flush_evicted(shard, evicted);
+    }
+  }
+
+  /**
+   * @brief Save tenants evicted by insert() without holding the shard lock.
+   *
+   * With an I/O pool the saves run in the background and this returns at once. A tenant whose save fails
+   * stays reachable (and is retried by save()) instead of losing its changes.
+   */
+  void flush_evicted(Shard& shard, const std::vector<Entry>& evicted)
+  {
+    if (evicted.empty())
+      return;
+    if (io_pool_)
+    {
+      for (const auto& entry : evicted)
+        submit_io([this, &shard, entry] {
+          const std::string error = write_tenant(shard, entry, "Failed to save evicted tenant '");
+          if (!error.empty())
+            NVDB_LOG("[MultiTenantNanoVDB::flush_evicted] " << error);
+          settle(shard, { entry });
+        });
+      return;
+    }
+    std::string error;
+    for (const auto& entry : evicted)
+    {
+      std::string failed = write_tenant(shard, entry, "Failed to save evicted tenant '");
+      if (error.empty())
+        error = std::move(failed);
+    }
+    settle(shard, evicted);
+    if (!error.empty())
+    {
+      throw std::runtime_error(error);
+    }
+  }
+
+  /**
+   * @brief Save a tenant if it changed since it was loaded or last saved, then release it if evicted.
+   *
+   * @return std::string Error message prefixed with `context`, empty on success.
+   */
+  std::string write_tenant(Shard& shard, const Entry& entry, const char* context) const
+  {
+    const auto& [tenant_id, db] = entry;
+    try
+    {
+      if (db->dirty())
+      {
+        ensure_storage_dir();
+        db->save();
+      }
+    }
+    catch (const std::exception& e)
+    {
+      return context + tenant_id + "': " + e.what();
+    }
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto ev = shard.evicting.find(tenant_id);
+    if (ev != shard.evicting.end() && ev->second == db)
+      shard.evicting.erase(ev);
+    return std::string();
+  }
+
+  /**
+   * @brief Queue a task on the I/O pool; wait_for_io() waits for it.
+   */
+  template <typename F>
+  auto submit_io(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+  {
+    {
+      std::lock_guard<std::mutex> lock(io_mutex_);
+      ++io_pending_;
+    }
+    return io_pool_->submit([this, f = std::forward<F>(f)]() mutable {
+      // Counted down even when f throws; the exception goes to the future
+      struct Done
+      {
+        MultiTenantNanoVDB* self;
+        ~Done()
         {
-          throw std::runtime_error("Failed to save evicted tenant '" + evict_id + "': " + e.what());
+          std::lock_guard<std::mutex> lock(self->io_mutex_);
+          if (--self->io_pending_ == 0)
+            self->io_idle_.notify_all();
         }
+      } done{ this };
+      return f();
+    });
+  }
+
+  /**
+   * @brief Run search(tenant, threshold) on one tenant and copy out the hits.
+   *
+   * The hits are copied under the tenant's read lock, before a writer can invalidate the views.
+   */
+  template <typename Search>
+  std::vector<TenantQueryResult> search_tenant(const std::string& tenant_id, std::optional<float> threshold,
+                                               const Search& search)
+  {
+    auto db = get_tenant(tenant_id);
+    NanoVectorDB::ReadGuard read(*db);
+    const auto results = search(*db, threshold);
+    std::vector<TenantQueryResult> hits;
+    hits.reserve(results.size());
+    for (const auto& r : results)
+      hits.push_back({ tenant_id, std::string(r.data.id), r.score });
+    return hits;
+  }
+
+  /**
+   * @brief search_tenant() on the pool of the tenant's home node.
+   */
+  template <typename Search>
+  std::vector<TenantQueryResult> search_on_home(const std::string& tenant_id, std::optional<float> threshold,
+                                                const Search& search)
+  {
+    const auto placement = numa_placement();
+    const int node = placement ? static_cast<int>(home_of(*placement, tenant_id)) : -1;
+    return on_node(placement.get(), node, [&] { return search_tenant(tenant_id, threshold, search); });
+  }
+
+  /**
+   * @brief Run search(tenant, threshold) for every tenant and merge the hits with fan_out_top_k().
+   */
+  template <typename Search>
+  std::vector<TenantQueryResult> fan_out(const std::vector<std::string>& tenant_ids, int top_k,
+                                         std::optional<float> threshold, const Search& search)
+  {
+    const auto start = Metrics::clock::now();
+    std::shared_ptr<ThreadPool> pool;
+    std::shared_ptr<NumaPlacement> placement;
+    {
+      std::lock_guard<std::mutex> lock(config_mutex_);
+      pool = thread_pool_;
+      placement = numa_;
+    }
+    std::vector<std::size_t> order;
+    std::unordered_set<std::string> seen;
+    for (std::size_t i = 0; i < tenant_ids.size(); ++i)
+    {
+      if (seen.insert(tenant_ids[i]).second)
+        order.push_back(i);
+    }
+    // Loads are the longest tasks, so they start before the scans of cached tenants
+    std::stable_partition(order.begin(), order.end(),
+                          [&](std::size_t i) { return !is_cached(tenant_ids[i]); });
+    // One group per home node, each scanned by its node's pool; the thread of a node pool drives its own
+    std::vector<FanOutGroup> groups;
+    if (placement)
+    {
+      groups.resize(placement->pools.size());
+      for (std::size_t g = 0; g < groups.size(); ++g)
+      {
+        groups[g].pool = placement->pools[g].get();
+        groups[g].run_here = numa::this_thread_node() == static_cast<int>(g);
+      }
+      for (std::size_t i : order)
+        groups[home_of(*placement, tenant_ids[i])].schedule.push_back(i);
+    }
+    else
+      groups.push_back({ pool.get(), order, true });
+    auto out = fan_out_top_k<TenantQueryResult>(
+      groups, tenant_ids.size(), top_k, threshold,
+      [&](std::size_t i, std::optional<float> bound) { return search_tenant(tenant_ids[i], bound, search); });
+    metrics_->record(operation::QueryMany, start);
+    return out;
+  }
+
+  /**
+   * @brief Whether a tenant is in memory (and not being evicted).
+   */
+  bool is_cached(const std::string& tenant_id) const
+  {
+    const Shard& shard = shard_for(tenant_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.index.count(tenant_id) > 0;
+  }
+
+  /**
+   * @brief Mark the saves of the given tenants finished and wake threads waiting on them.
+   */
+  static void settle(Shard& shard, const std::vector<Entry>& entries)
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (const auto& entry : entries)
+    {
+      auto it = shard.flushing.find(entry.first);
+      if (it != shard.flushing.end() && --it->second == 0)
+        shard.flushing.erase(it);
+    }
+    shard.settled.notify_all();
+  }
+
+  /**
+   * @brief Every cached tenant, including evicted ones not yet written.
+   */
+  std::vector<Entry> cached_tenants() const
+  {
+    std::vector<Entry> entries;
+    for (const auto& shard : shards_)
+    {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      for (const auto& cached : shard->lru)
+        entries.emplace_back(cached.id, cached.db);
+      entries.insert(entries.end(), shard->evicting.begin(), shard->evicting.end());
+    }
+    return entries;
+  }
+
+  void ensure_storage_dir() const
+  {
+    std::error_code ec;
+    if (!std::filesystem::exists(storage_dir_))
+    {
+      std::filesystem::create_directories(storage_dir_, ec);
+      if (ec)
+      {
+        throw std::runtime_error("Failed to create storage directory: " + ec.message());
       }
-      storage_.erase(evict_id);
-      cache_queue_.erase(cache_queue_.begin());
     }
-    storage_[tenant_id] = db;
-    cache_queue_.push_back(tenant_id);
   }
 
   /**
@@ -244,9 +1251,8 @@ private:
    */
   static std::string generate_uuid()
   {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<uint64_t> dis;
+    thread_local std::mt19937_64 gen(std::random_device{}());
+    std::uniform_int_distribution<uint64_t> dis;
     std::ostringstream oss;
     oss << std::hex << dis(gen);
     return oss.str();
@@ -256,13 +1262,29 @@ private:
   std::string metric_;
   int max_capacity_;
   std::string storage_dir_;
-  std::unordered_map<std::string, std::shared_ptr<NanoVectorDB>> storage_;
-  std::vector<std::string> cache_queue_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<std::size_t> bytes_{ 0 };          // measured bytes of the tenants in the LRU lists
+  std::atomic<std::size_t> memory_budget_{ 0 };  // 0 = no budget
+  // Shared by every tenant, so stats() covers them all
+  const std::shared_ptr<Metrics> metrics_ = std::make_shared<Metrics>();
 
-  // Default strategies
+  // Default strategies and scan pool, guarded by config_mutex_
+  mutable std::mutex config_mutex_;
   std::shared_ptr<IMetric> default_metric_{};
   // Serializer support removed; JSON persistence handled internally.
   std::shared_ptr<IStorage> default_storage_{};
+
+  // Scan pool shared by all tenants
+  ScanOptions scan_options_{};
+  std::shared_ptr<ThreadPool> thread_pool_{};
+  // Node pools and tenant homes, or nullptr without NUMA placement
+  std::shared_ptr<NumaPlacement> numa_{};
+
+  // Background saves and prefetches; declared last so its workers stop before the state they use goes
+  std::mutex io_mutex_;
+  std::condition_variable io_idle_;
+  std::size_t io_pending_ = 0;
+  std::unique_ptr<ThreadPool> io_pool_;
 };
 
 }  // namespace nano_vectordb
@@ -1,10 +1,26 @@
 #pragma once
 #include "helper.hpp"
 #include "structs.hpp"
+#include "topk.hpp"
+#include "thread_pool.hpp"
+#include "id_index.hpp"
+#include "row_store.hpp"
+#include "rw_mutex.hpp"
+#include "precision.hpp"
+#include "bitmap.hpp"
+#include "metadata.hpp"
+#include "memory_usage.hpp"
+#include "metrics.hpp"
+#include "query_cache.hpp"
 #include "metric/base.hpp"
 #include "metric/factory.hpp"
+#include "metric/fixed_kernels.hpp"
+#include "metric/kernels.hpp"
 #include "storage/base.hpp"
 #include "storage/factory.hpp"
+#include "storage/wal.hpp"
+#include "index/base.hpp"
+#include "index/factory.hpp"
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -15,6 +31,12 @@
 #include <optional>
 #include <algorithm>
 #include <numeric>
+#include <cmath>
+#include <future>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <cstring>
 
 namespace nano_vectordb
 {
@@ -22,126 +44,64 @@ namespace nano_vectordb
 /**
  * @brief A simple in-memory vector database supporting upsert, get, remove, and query operations.
  *
+ * Safe to share between threads: readers (query, get, size, ...) run concurrently under a shared lock
+ * and writers (upsert, remove, set_* and initialize_*) take it exclusively. save() copies the changes
+ * out under the shared lock and writes them without it.
  */
 class NanoVectorDB
 {
 public:
   /**
-   * @brief Construct a new Nano Eigen::VectorXf DB object
+   * @brief Shared lock on a database: other readers proceed, writers wait until it is released.
    *
-   * @param embedding_dim Embedding dimension
-   * @param metric Similarity metric to use ("cosine" supported)
-   * @param storage_file Storage file path
+   * Every public method locks internally, so a guard is only needed to keep the DataViews returned by
+   * query(), query_batch() or get_views() valid while other threads write. Methods called by the
+   * thread holding the guard do not lock again, except writers, which throw. Release the guard on the
+   * thread that took it. Query filters may run on pool threads and must not call back into the database.
    */
-  NanoVectorDB(int embedding_dim, const std::string& metric = "cosine",
-               const std::string& storage_file = "nano-vectordb.json")
-    : embedding_dim_(embedding_dim), metric_(metric), storage_file_(storage_file)
+  class ReadGuard
   {
-    NVDB_LOG("[NanoVectorDB::NanoVectorDB] embedding_dim=" << embedding_dim_ << ", metric=" << metric_
-                                                           << ", storage_file=" << storage_file_);
-    // Use storage + serializer strategies if provided, fallback to default file loading
-    std::optional<nlohmann::json> loaded;
-    std::vector<Data> loaded_records;
-    if (storage_strategy_)
-    {
-      try
-      {
-        // Prefer row-wise storage if available
-        if (auto rs = std::dynamic_pointer_cast<IStorageRecords>(storage_strategy_))
-        {
-          auto lr = rs->read_records(storage_file_);
-          if (!lr.records.empty() || lr.embedding_dim > 0)
-          {
-            loaded_records = std::move(lr.records);
-            loaded = nlohmann::json{ {"embedding_dim", lr.embedding_dim}, {"matrix", ""}, {"data", nlohmann::json::array()} };
-            additional_data_ = lr.additional;
-          }
-        }
-        else
-        {
-          auto bytes = storage_strategy_->read(storage_file_);
-          if (!bytes.empty())
-          {
-            nlohmann::json j = nlohmann::json::parse(bytes.begin(), bytes.end());
-            loaded = j;
-          }
-        }
-      }
-      catch (...)
-      {
-        loaded = load_storage(storage_file_, embedding_dim_);
-      }
-    }
-    else
+  public:
+    explicit ReadGuard(const NanoVectorDB& db)
     {
-      loaded = load_storage(storage_file_, embedding_dim_);
+      if (db.held_lock())
+        return;  // the thread already holds a lock on db
+      db.mutex_.lock_shared();
+      held_locks().push_back({ &db, false });
+      db_ = &db;
     }
-    if (loaded)
+
+    ReadGuard(ReadGuard&& other) noexcept : db_(std::exchange(other.db_, nullptr))
     {
-      const auto& val = loaded.value();
-      if (!val.contains("matrix"))
-      {
-        throw std::runtime_error("Storage file missing 'matrix' field");
-      }
-      if (!loaded_records.empty())
-      {
-        // Rebuild from serializer-decoded records
-        data_ = loaded_records;
-        matrix_.resize((int)data_.size(), embedding_dim_);
-        for (size_t i = 0; i < data_.size(); ++i)
-        {
-          if (data_[i].vector.size() != embedding_dim_)
-          {
-            throw std::runtime_error("Loaded record dim mismatch");
-          }
-          matrix_.row((int)i) =
-              Eigen::Map<const Eigen::RowVectorXf>(data_[i].vector.data(), data_[i].vector.size());
-        }
-      }
-      else
-      {
-        std::string matrix_b64 = val["matrix"];
-        matrix_ = buffer_string_to_array(matrix_b64, embedding_dim_);
-        if (!val.contains("data"))
-        {
-          throw std::runtime_error("Storage file missing 'data' field");
-        }
-        for (const auto& d : val["data"])
-        {
-          if (!d.contains("id"))
-          {
-            throw std::runtime_error("Data entry missing 'id' field");
-          }
-          Data entry;
-          entry.id = d["id"];
-          // Vector will align with matrix rows by index
-          entry.vector = matrix_.row((int)data_.size());
-          data_.push_back(entry);
-        }
-      }
-      if (val.contains("additional_data"))
-      {
-        additional_data_ = val["additional_data"];
-      }
-      if (val.contains("embedding_dim"))
-      {
-        int loaded_dim = val["embedding_dim"];
-        if (loaded_dim != embedding_dim_)
-        {
-          throw std::runtime_error("Embedding dim mismatch: expected " + std::to_string(embedding_dim_) +
-                                   ", got " + std::to_string(loaded_dim));
-        }
-      }
-      if (matrix_.rows() != static_cast<int>(data_.size()))
-      {
-        throw std::runtime_error("Eigen::MatrixXf row count does not match data size");
-      }
-      pre_process();
     }
-    else
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+    ReadGuard& operator=(ReadGuard&&) = delete;
+
+    ~ReadGuard()
     {
-      matrix_ = Eigen::MatrixXf(0, embedding_dim_);
+      if (!db_)
+        return;
+      db_->release_held_lock();
+      db_->mutex_.unlock_shared();
     }
+
+  private:
+    const NanoVectorDB* db_ = nullptr;  // null when nested or moved from
+  };
+
+  /**
+   * @brief Construct a new Nano Eigen::VectorXf DB object
+   *
+   * @param embedding_dim Embedding dimension
+   * @param metric Similarity metric to use ("cosine" supported)
+   * @param storage_file Storage file path
+   */
+  NanoVectorDB(int embedding_dim, const std::string& metric = "cosine",
+               const std::string& storage_file = "nano-vectordb.json")
+    : NanoVectorDB(embedding_dim, metric, storage_file, nullptr, nullptr)
+  {
   }
 
   /**
@@ -152,499 +112,2580 @@ public:
    * @param storage_file Storage file path
    * @param metric_strategy Metric strategy
    * @param storage_strategy Storage strategy
+   * @param metrics Collector that records the load and later operations; nullptr records nothing (see
+   *        set_metrics())
    */
   NanoVectorDB(int embedding_dim, const std::string& metric, const std::string& storage_file,
                std::shared_ptr<IMetric> metric_strategy,
-               std::shared_ptr<IStorage> storage_strategy)
+               std::shared_ptr<IStorage> storage_strategy,
+               std::shared_ptr<Metrics> metrics = std::make_shared<Metrics>())
     : embedding_dim_(embedding_dim)
     , metric_(metric)
     , storage_file_(storage_file)
+    , matrix_(embedding_dim)
     , metric_strategy_(std::move(metric_strategy))
     , storage_strategy_(std::move(storage_strategy))
   {
     NVDB_LOG("[NanoVectorDB::NanoVectorDB] embedding_dim=" << embedding_dim_ << ", metric=" << metric_
                                                            << ", storage_file=" << storage_file_);
-    // Use storage + serializer strategies if provided, fallback to default file loading
-    std::optional<nlohmann::json> loaded;
-    std::vector<Data> loaded_records;
-    if (storage_strategy_)
+    const auto start = Metrics::clock::now();
+    load();
+    metrics_ = std::move(metrics);
+    if (metrics_)
+      metrics_->record(operation::Load, start);
+  }
+
+  /**
+   * @brief Pre-process the matrix (e.g., normalize for cosine)
+   *
+   * Rows known to be unit length (stored by a cosine database, or normalized before) are left as they
+   * are; otherwise they are normalized and their norms recomputed in parallel row ranges.
+   */
+  void pre_process()
+  {
+    WriteGuard write(*this);
+    NVDB_LOG("[NanoVectorDB::pre_process] matrix shape: (" << matrix_.rows() << ", " << matrix_.dim()
+                                                           << ")");
+    if (metric_ == "cosine" && !rows_normalized_)
     {
-      try
+      normalize_stored_rows();
+      refresh_row_norms();
+      rows_normalized_ = true;
+    }
+    else if (row_sq_norms_.size() != matrix_.rows())
+    {
+      refresh_row_norms();
+    }
+    rebuild_index();
+  }
+
+  /**
+   * @brief Upsert data entries into the database.
+   *
+   * @param datas Eigen::VectorXf of Data entries to upsert.
+   */
+  void upsert(const std::vector<Data>& datas)
+  {
+    const Timed<WriteGuard> write(*this, operation::Upsert);
+    NVDB_LOG("[NanoVectorDB::upsert] datas.size()=" << datas.size());
+    // Last occurrence of an id in the batch wins; vectors are referenced, not copied
+    std::unordered_map<std::string, const Data*> index_datas;
+    for (const auto& data : datas)
+    {
+      if (data.vector.size() != embedding_dim_)
       {
-        if (auto rs = std::dynamic_pointer_cast<IStorageRecords>(storage_strategy_))
-        {
-          auto lr = rs->read_records(storage_file_);
-          if (!lr.records.empty() || lr.embedding_dim > 0)
-          {
-            loaded_records = std::move(lr.records);
-            loaded = nlohmann::json{ {"embedding_dim", lr.embedding_dim}, {"matrix", ""}, {"data", nlohmann::json::array()} };
-            additional_data_ = lr.additional;
-          }
-        }
-        else
-        {
-          auto bytes = storage_strategy_->read(storage_file_);
-          if (!bytes.empty())
-          {
-            nlohmann::json j = nlohmann::json::parse(bytes.begin(), bytes.end());
-            loaded = j;
-          }
-        }
+        throw std::runtime_error("Eigen::VectorXf dimension mismatch in upsert: expected " +
+                                 std::to_string(embedding_dim_) + ", got " +
+                                 std::to_string(data.vector.size()));
       }
-      catch (...)
+      if (metric_ == "cosine" && data.vector.norm() == 0)
       {
-        loaded = load_storage(storage_file_, embedding_dim_);
+        throw std::runtime_error("Cannot normalize zero-norm vector");
       }
+      // Always use hash of vector as ID if id is empty, to match Python behavior
+      std::string id = data.id.empty() ? hash_vector(data.vector) : data.id;
+      index_datas[id] = &data;
     }
-    else
-    {
-      loaded = load_storage(storage_file_, embedding_dim_);
-    }
-    if (loaded)
+    NVDB_LOG("[NanoVectorDB::upsert] ids_.size() before update=" << ids_.size());
+    if (metric_ != "cosine")
+      rows_normalized_ = false;
+    int updated_count = 0;
+    int inserted_count = 0;
+    for (const auto& [id, d] : index_datas)
     {
-      const auto& val = loaded.value();
-      if (!val.contains("matrix"))
+      int i = id_index_.find(id, id_at());
+      if (i >= 0)
       {
-        throw std::runtime_error("Storage file missing 'matrix' field");
+        if (index_enabled())
+          index_->remove(i, index_space());
+        ++updated_count;
       }
-      if (!loaded_records.empty())
+      else if (!free_rows_.empty())
       {
-        // Rebuild from serializer-decoded records
-        data_ = loaded_records;
-        matrix_.resize((int)data_.size(), embedding_dim_);
-        for (size_t i = 0; i < data_.size(); ++i)
-        {
-          if (data_[i].vector.size() != embedding_dim_)
-          {
-            throw std::runtime_error("Loaded record dim mismatch");
-          }
-          matrix_.row((int)i) =
-              Eigen::Map<const Eigen::RowVectorXf>(data_[i].vector.data(), data_[i].vector.size());
-        }
+        // Reuse a tombstoned row before growing storage
+        i = free_rows_.back();
+        free_rows_.pop_back();
+        deleted_.reset(i);
+        ids_[i] = id;
+        id_index_.insert(id, i, id_at());
+        ++inserted_count;
       }
       else
       {
-        std::string matrix_b64 = val["matrix"];
-        matrix_ = buffer_string_to_array(matrix_b64, embedding_dim_);
-        if (!val.contains("data"))
-        {
-          throw std::runtime_error("Storage file missing 'data' field");
-        }
-        for (const auto& d : val["data"])
-        {
-          if (!d.contains("id"))
-          {
-            throw std::runtime_error("Data entry missing 'id' field");
-          }
-          Data entry;
-          entry.id = d["id"];
-          entry.vector = matrix_.row((int)data_.size());
-          data_.push_back(entry);
-        }
+        i = static_cast<int>(ids_.size());
+        ids_.push_back(id);
+        matrix_.resize(ids_.size());
+        row_sq_norms_.push_back(0.0f);
+        deleted_.resize(ids_.size());
+        id_index_.insert(id, i, id_at());
+        ++inserted_count;
       }
-      if (val.contains("additional_data"))
+      write_row(i, d->vector.data());
+      if (index_enabled())
+        index_->add(i, index_space());
+      track_upsert(id);
+    }
+    NVDB_LOG("[NanoVectorDB::upsert] summary: updated=" << updated_count << ", inserted=" << inserted_count);
+    count(counter::RowsUpserted, index_datas.size());
+  }
+
+  /**
+   * @brief Upsert n vectors stored contiguously, without building Data records.
+   *
+   * Rows are copied straight into the row store (normalized there for cosine) and written in
+   * parallel when a thread pool is set. A batch at least as large as the live database rebuilds the
+   * index in one pass instead of adding rows one at a time. As in upsert(), the last occurrence of an
+   * id wins and empty ids are replaced by a hash of the vector.
+   *
+   * @param rows n * embedding_dim floats, row-major: row i starts at rows + i * embedding_dim.
+   * @param n Number of rows.
+   * @param ids n ids, or nullptr to hash every vector.
+   */
+  void upsert(const float* rows, size_t n, const std::string* ids = nullptr)
+  {
+    const Timed<WriteGuard> write(*this, operation::Upsert);
+    const size_t live_before = size();
+    std::vector<int> written;
+    upsert_rows(rows, n, ids, written);
+    index_rows(written, live_before);
+    count(counter::RowsUpserted, n);
+  }
+
+  /**
+   * @brief Source of rows for ingest(): writes up to capacity rows (row-major, embedding_dim floats
+   *        each) and their ids into the buffers and returns how many it wrote; 0 ends the ingest.
+   *
+   * The buffers are reused between calls; ids left empty are hashed from the vector.
+   */
+  using RowReader = std::function<size_t(float* rows, std::string* ids, size_t capacity)>;
+
+  /**
+   * @brief Bulk-load rows pulled in chunks from a reader, e.g. a file parser.
+   *
+   * Every chunk goes through upsert(rows, n, ids) using one reusable pair of buffers, so the load
+   * allocates nothing per row beyond the stored id. The index is updated once at the end. The whole
+   * ingest is a single write: queries wait until it finishes.
+   *
+   * @param read Row source.
+   * @param chunk_rows Rows per chunk.
+   * @param expected_rows Total rows expected, to reserve storage up front (0 if unknown).
+   * @return size_t Number of rows read.
+   */
+  size_t ingest(const RowReader& read, size_t chunk_rows = 4096, size_t expected_rows = 0)
+  {
+    if (chunk_rows == 0)
+      throw std::runtime_error("ingest: chunk_rows must be positive");
+    const Timed<WriteGuard> write(*this, operation::Ingest);
+    if (expected_rows > 0)
+      reserve(ids_.size() + expected_rows);
+    const size_t live_before = size();
+    std::vector<float> rows(chunk_rows * static_cast<size_t>(embedding_dim_));
+    std::vector<std::string> ids(chunk_rows);
+    std::vector<int> written;
+    size_t total = 0;
+    for (;;)
+    {
+      const size_t n = std::min(read(rows.data(), ids.data(), chunk_rows), chunk_rows);
+      if (n == 0)
+        break;
+      try
       {
-        additional_data_ = val["additional_data"];
+        upsert_rows(rows.data(), n, ids.data(), written);
       }
-      if (val.contains("embedding_dim"))
+      catch (...)
       {
-        int loaded_dim = val["embedding_dim"];
-        if (loaded_dim != embedding_dim_)
-        {
-          throw std::runtime_error("Embedding dim mismatch: expected " + std::to_string(embedding_dim_) +
-                                   ", got " + std::to_string(loaded_dim));
-        }
+        // Earlier chunks stay loaded; index them before reporting the error
+        index_rows(written, live_before);
+        throw;
+      }
+      for (size_t i = 0; i < n; ++i)
+        ids[i].clear();
+      total += n;
+    }
+    index_rows(written, live_before);
+    count(counter::RowsUpserted, total);
+    return total;
+  }
+
+  /**
+   * @brief Retrieve data entries by their IDs, copying their vectors.
+   *
+   * @param ids Eigen::VectorXf of IDs to retrieve.
+   * @return std::vector<Data> Retrieved data entries, in the order of `ids`; unknown ids are skipped.
+   */
+  std::vector<Data> get(const std::vector<std::string>& ids) const
+  {
+    ReadGuard read(*this);
+    std::vector<Data> result;
+    result.reserve(ids.size());
+    for (const auto& id : ids)
+    {
+      const int row = id_index_.find(id, id_at());
+      if (row >= 0)
+      {
+        result.push_back(view_at(row).to_data());
       }
-      if (matrix_.rows() != static_cast<int>(data_.size()))
+    }
+    return result;
+  }
+
+  /**
+   * @brief Retrieve zero-copy views of data entries by their IDs.
+   *
+   * Views point into the database and stay valid until its next mutation; hold a ReadGuard while using
+   * them if other threads write.
+   *
+   * @param ids IDs to retrieve.
+   * @return std::vector<DataView> Views in the order of `ids`; unknown ids are skipped.
+   */
+  std::vector<DataView> get_views(const std::vector<std::string>& ids) const
+  {
+    ReadGuard read(*this);
+    std::vector<DataView> result;
+    result.reserve(ids.size());
+    for (const auto& id : ids)
+    {
+      const int row = id_index_.find(id, id_at());
+      if (row >= 0)
       {
-        throw std::runtime_error("Eigen::MatrixXf row count does not match data size");
+        result.push_back(view_at(row));
       }
-      pre_process();
     }
-    else
+    return result;
+  }
+
+  /**
+   * @brief Ids of every live record, in row order.
+   */
+  std::vector<std::string> ids() const
+  {
+    ReadGuard read(*this);
+    std::vector<std::string> out;
+    out.reserve(ids_.size() - free_rows_.size());
+    for (size_t i = 0; i < ids_.size(); ++i)
+    {
+      if (!deleted_.test(i))
+        out.push_back(ids_[i]);
+    }
+    return out;
+  }
+
+  /**
+   * @brief Remove data entries by their IDs.
+   */
+  void remove(const std::vector<std::string>& ids)
+  {
+    const Timed<WriteGuard> write(*this, operation::Remove);
+    size_t removed = 0;
+    for (const auto& id : ids)
+    {
+      const int row = id_index_.find(id, id_at());
+      if (row < 0)
+        continue;
+      ++removed;
+      // Tombstone the row: scans skip it and the next insert reuses it
+      if (index_enabled())
+        index_->remove(row, index_space());
+      id_index_.erase(id, id_at());
+      track_remove(id);
+      if (!metadata_.empty())
+      {
+        metadata_.clear_row(row);
+        metadata_dirty_ = true;
+      }
+      deleted_.set(row);
+      std::string().swap(ids_[row]);
+      free_rows_.push_back(row);
+    }
+    count(counter::RowsRemoved, removed);
+    if (needs_compaction())
+    {
+      compact();
+    }
+  }
+
+  /**
+   * @brief Drop tombstoned rows and pack the live rows densely.
+   *
+   * Runs automatically when the live fraction falls below the compaction threshold; can also be called
+   * explicitly (e.g. from a maintenance job) or scheduled with compact_async(). The live rows are copied
+   * under a shared lock, so queries keep running; only swapping in the packed rows excludes them.
+   */
+  void compact()
+  {
+    if (const HeldLock* held = held_lock(); held && held->exclusive)
+    {
+      // Called by a writer (remove()), which already excludes everyone else
+      apply_compaction(plan_compaction());
+      return;
+    }
+    // Holding the writer mutex keeps the rows unchanged between the copy and the swap
+    std::unique_lock<std::mutex> writers(write_mutex_);
+    Compaction next;
+    {
+      ReadGuard read(*this);
+      if (free_rows_.empty())
+        return;
+      next = plan_compaction();
+    }
+    WriteGuard write(*this, std::move(writers));
+    apply_compaction(std::move(next));
+  }
+
+  /**
+   * @brief Run compact() on a background thread.
+   *
+   * Queries keep running while the live rows are copied; writers wait until compaction has finished.
+   *
+   * @return std::future<void> Completes when compaction has finished.
+   */
+  std::future<void> compact_async()
+  {
+    if (thread_pool_)
+      return thread_pool_->submit([this] { compact(); });
+    return std::async(std::launch::async, [this] { compact(); });
+  }
+
+  /**
+   * @brief Set the live fraction below which remove() compacts automatically.
+   *
+   * @param min_live_fraction Value in [0, 1]; 0 disables automatic compaction.
+   */
+  void set_compaction_threshold(float min_live_fraction)
+  {
+    WriteGuard write(*this);
+    compaction_threshold_ = min_live_fraction;
+  }
+
+  /**
+   * @brief Number of tombstoned rows waiting for reuse or compaction.
+   */
+  size_t tombstones() const
+  {
+    ReadGuard read(*this);
+    return free_rows_.size();
+  }
+
+  /**
+   * @brief Declare a typed metadata column that predicates can filter on.
+   *
+   * @param name Column name.
+   * @param type Column type. See enum in metadata.hpp
+   */
+  void add_column(const std::string& name, column_type type)
+  {
+    WriteGuard write(*this);
+    metadata_.add_column(name, type);
+    metadata_dirty_ = true;
+  }
+
+  /**
+   * @brief Set an Int column of a record.
+   */
+  void set_metadata(const std::string& id, const std::string& column, std::int64_t value)
+  {
+    WriteGuard write(*this);
+    metadata_.set_int(row_of(id), column, value);
+    metadata_dirty_ = true;
+    track_upsert(id);
+  }
+
+  /**
+   * @brief Set an Enum column of a record.
+   */
+  void set_metadata(const std::string& id, const std::string& column, const std::string& label)
+  {
+    WriteGuard write(*this);
+    metadata_.set_enum(row_of(id), column, label);
+    metadata_dirty_ = true;
+    track_upsert(id);
+  }
+
+  /**
+   * @brief Replace the labels of a Tags column of a record.
+   */
+  void set_tags(const std::string& id, const std::string& column, const std::vector<std::string>& tags)
+  {
+    WriteGuard write(*this);
+    metadata_.set_tags(row_of(id), column, tags);
+    metadata_dirty_ = true;
+    track_upsert(id);
+  }
+
+  /**
+   * @brief Metadata of a record as {column: value}; tags are arrays of labels.
+   */
+  nlohmann::json get_metadata(const std::string& id) const
+  {
+    ReadGuard read(*this);
+    return metadata_.row_json(row_of(id));
+  }
+
+  /**
+   * @brief Perform a similarity query.
+   *
+   * @param query Input query vector.
+   * @param top_k Number of top results to return.
+   * @param better_than_threshold Optional threshold to filter results.
+   * @param filter Optional filter function to apply on data entries.
+   * @return std::vector<QueryResult>
+   */
+  std::vector<QueryResult> query(const Eigen::VectorXf& query, int top_k = 10,
+                                 std::optional<float> better_than_threshold = std::nullopt,
+                                 std::function<bool(const DataView&)> filter = nullptr) const
+  {
+    const Timed<ReadGuard> read(*this, operation::Query);
+    // A filter function has no identity to key on, so those queries bypass the result cache
+    if (filter || !query_cache_)
+      return run_query(query, top_k, better_than_threshold, filter, nullptr);
+    return cached_query(query, top_k, better_than_threshold, nullptr,
+                        [&] { return run_query(query, top_k, better_than_threshold, nullptr, nullptr); });
+  }
+
+  /**
+   * @brief Perform a similarity query restricted to the rows matching a metadata predicate.
+   *
+   * The predicate is compiled once into a row bitmap that the scan applies block by block; indexes
+   * receive it as a pre-filter. Predicates matching few rows are answered by an exact scan of the
+   * matches instead of the index.
+   *
+   * @param query Input query vector.
+   * @param top_k Number of top results to return.
+   * @param better_than_threshold Optional threshold to filter results.
+   * @param where Predicate over metadata columns, e.g. `where::eq("lang", "en")`.
+   * @return std::vector<QueryResult>
+   */
+  std::vector<QueryResult> query(const Eigen::VectorXf& query, int top_k,
+                                 std::optional<float> better_than_threshold, const Predicate& where) const
+  {
+    const Timed<ReadGuard> read(*this, operation::Query);
+    auto run = [&] {
+      const Bitmap mask = compile(where);
+      return run_query(query, top_k, better_than_threshold, nullptr, &mask);
+    };
+    if (!query_cache_)
+      return run();
+    return cached_query(query, top_k, better_than_threshold, &where, run);
+  }
+
+  /**
+   * @brief Perform similarity queries for a batch of query vectors.
+   *
+   * The stored matrix is scored in row tiles with one matrix-matrix product per tile, so the whole
+   * batch shares a single pass over the stored vectors instead of one pass per query.
+   *
+   * @param queries Query vectors, one per row (n_queries x embedding_dim).
+   * @param top_k Number of top results to return per query.
+   * @param better_than_threshold Optional threshold to filter results.
+   * @param filter Optional filter function to apply on data entries.
+   * @return std::vector<std::vector<QueryResult>> Results for each query, in input order.
+   */
+  std::vector<std::vector<QueryResult>> query_batch(const Eigen::MatrixXf& queries, int top_k = 10,
+                                                    std::optional<float> better_than_threshold = std::nullopt,
+                                                    std::function<bool(const DataView&)> filter = nullptr) const
+  {
+    const Timed<ReadGuard> read(*this, operation::QueryBatch);
+    return run_query_batch(queries, top_k, better_than_threshold, filter, nullptr);
+  }
+
+  /**
+   * @brief Perform similarity queries for a batch of query vectors, restricted to a metadata predicate.
+   *
+   * The predicate is compiled once for the whole batch.
+   *
+   * @param queries Query vectors, one per row (n_queries x embedding_dim).
+   * @param top_k Number of top results to return per query.
+   * @param better_than_threshold Optional threshold to filter results.
+   * @param where Predicate over metadata columns.
+   * @return std::vector<std::vector<QueryResult>> Results for each query, in input order.
+   */
+  std::vector<std::vector<QueryResult>> query_batch(const Eigen::MatrixXf& queries, int top_k,
+                                                    std::optional<float> better_than_threshold,
+                                                    const Predicate& where) const
+  {
+    const Timed<ReadGuard> read(*this, operation::QueryBatch);
+    const Bitmap mask = compile(where);
+    return run_query_batch(queries, top_k, better_than_threshold, nullptr, &mask);
+  }
+
+  /**
+   * @brief Get the number of data entries in the database.
+   *
+   * @return int Number of data entries.
+   */
+  int size() const
+  {
+    ReadGuard read(*this);
+    return ids_.size() - free_rows_.size();
+  }
+
+
+  /**
+   * @brief Pre-allocate room for n records so bulk upserts do not reallocate.
+   *
+   * @param n Total number of records expected.
+   */
+  void reserve(size_t n)
+  {
+    WriteGuard write(*this);
+    ids_.reserve(n);
+    matrix_.reserve(n);
+    row_sq_norms_.reserve(n);
+    id_index_.reserve(n);
+  }
+
+  /**
+   * @brief Change the element type of the stored vectors.
+   *
+   * F16 and BF16 halve the memory of the row store and the bandwidth of every scan. Queries stay fp32
+   * and are scored against the 2-byte rows with fp32 accumulation. Converting to a narrow type rounds
+   * the stored vectors, so converting back to F32 does not restore the original values. The index, if
+   * any, is rebuilt over the converted rows.
+   *
+   * @param type Element type. See enum in precision.hpp
+   */
+  void set_precision(::nano_vectordb::precision type)
+  {
+    WriteGuard write(*this);
+    if (type == matrix_.type())
+      return;
+    RowStore converted(embedding_dim_, type);
+    converted.reserve(matrix_.rows());
+    Eigen::VectorXf v(embedding_dim_);
+    for (size_t i = 0; i < matrix_.rows(); ++i)
+    {
+      matrix_.decode_row(i, v.data());
+      converted.push_back(v.data());
+    }
+    matrix_ = std::move(converted);
+    refresh_row_norms();
+    rebuild_index();
+    full_save_ = true;
+  }
+
+  /**
+   * @brief Element type of the stored vectors.
+   */
+  ::nano_vectordb::precision get_precision() const
+  {
+    ReadGuard read(*this);
+    return matrix_.type();
+  }
+
+  /**
+   * @brief Persist the changes made since the last save.
+   *
+   * SQLite storage updates only the changed rows. Other backends rewrite the storage file, unless the
+   * write-ahead log is enabled (set_wal_options(); off by default): then the changes are appended to
+   * `<storage_file>.wal` and the file itself is only rewritten (checkpoint()) when the log outgrows the
+   * WalOptions limits or the changes are not tracked, e.g. on the first save or after the precision or
+   * storage changed. The storage file alone is stale until that checkpoint; opening the database
+   * replays the log, older binaries and other readers of the file do not.
+   */
+  void save() const
+  {
+    // Changes are copied out under a shared lock and written without it, so writers continue
+    const auto start = Metrics::clock::now();
+    std::lock_guard<std::mutex> saving(save_mutex_);
+    const SaveTimer timer{ *this, start };
+    std::shared_ptr<IStorage> storage;
+    bool incremental = false;
+    {
+      ReadGuard read(*this);
+      storage = storage_strategy_;
+      incremental = wal_options_.enabled && !full_save_ && !checkpoint_due();
+    }
+    if (auto rs = std::dynamic_pointer_cast<IStorageRecords>(storage))
+    {
+      save_records(*rs);
+      return;
+    }
+    if (incremental && append_wal())
+      return;
+    write_checkpoint();
+  }
+
+  /**
+   * @brief Rewrite the storage file with every live record and drop the write-ahead log.
+   *
+   * Other threads can query while the file is written; writers wait, except with SQLite storage, where
+   * the records are copied out first.
+   */
+  void checkpoint() const
+  {
+    const auto start = Metrics::clock::now();
+    std::lock_guard<std::mutex> saving(save_mutex_);
+    const SaveTimer timer{ *this, start };
+    write_checkpoint();
+  }
+
+  /**
+   * @brief Whether anything changed since the last save or load, i.e. whether save() has work to do.
+   */
+  bool dirty() const
+  {
+    ReadGuard read(*this);
+    std::lock_guard<std::mutex> tracking(tracking_mutex_);
+    return full_save_ || !dirty_ids_.empty() || !removed_ids_.empty() || metadata_dirty_ || additional_dirty_;
+  }
+
+  /**
+   * @brief Heap memory held by the database, by component.
+   *
+   * Counts allocated capacity (row store, id strings and index, metadata columns, index structures),
+   * not just the live records. The result is cached until the next write, so repeated calls are cheap.
+   */
+  MemoryUsage memory_usage() const
+  {
+    ReadGuard read(*this);
+    std::lock_guard<std::mutex> lock(usage_mutex_);
+    if (usage_version_ == version_)
+      return usage_;
+    MemoryUsage usage;
+    (matrix_.borrowed() ? usage.mapped : usage.vectors) += matrix_.memory_bytes();
+    usage.vectors += capacity_bytes(row_sq_norms_);
+    usage.ids = heap_bytes(ids_) + id_index_.memory_bytes();
+    // Additional data is opaque JSON; its serialized size stands in for the node tree
+    usage.metadata = metadata_.memory_bytes() + additional_data_.dump().size();
+    usage.index = index_ ? index_->memory_bytes() : 0;
+    {
+      std::lock_guard<std::mutex> tracking(tracking_mutex_);
+      usage.other = deleted_.memory_bytes() + capacity_bytes(free_rows_) + heap_bytes(dirty_ids_) +
+                    heap_bytes(removed_ids_);
+    }
+    usage_ = usage;
+    usage_version_ = version_;
+    return usage;
+  }
+
+  /**
+   * @brief Configure the write-ahead log used by save() with non-SQLite storage; see save().
+   *
+   * A log left by an earlier run is replayed on open whether or not it is enabled, and the next full
+   * save folds it in.
+   */
+  void set_wal_options(const WalOptions& options)
+  {
+    WriteGuard write(*this);
+    wal_options_ = options;
+  }
+
+  WalOptions wal_options() const
+  {
+    ReadGuard read(*this);
+    return wal_options_;
+  }
+
+  /**
+   * @brief Get additional stored data.
+   *
+   * @return nlohmann::json Additional data.
+   */
+  nlohmann::json get_additional_data() const
+  {
+    ReadGuard read(*this);
+    return additional_data_;
+  }
+
+  /**
+   * @brief Store additional data.
+   *
+   * @param data Additional data to store.
+   */
+  void store_additional_data(const nlohmann::json& data)
+  {
+    WriteGuard write(*this);
+    additional_data_ = data;
+    additional_dirty_ = true;
+  }
+
+  /**
+   * @brief Initialize metric strategy
+   * @param metric_strategy Metric strategy See enum in metric/base.hpp
+   */
+  void initialize_metric(::nano_vectordb::metric type)
+  {
+    WriteGuard write(*this);
+    metric_strategy_ = ::nano_vectordb::make(type);
+
+    // Keep legacy string in sync for preprocessing
+    switch (type)
+    {
+      case ::nano_vectordb::metric::Cosine:
+        metric_ = "cosine";
+        break;
+      case ::nano_vectordb::metric::L2:
+        metric_ = "l2";
+        break;
+    }
+    pre_process();
+  }
+
+  // Overload: initialize metric with a strategy instance
+  void initialize_metric(const std::shared_ptr<IMetric>& strategy)
+  {
+    WriteGuard write(*this);
+    metric_strategy_ = strategy;
+    if (std::dynamic_pointer_cast<CosineMetric>(strategy))
+      metric_ = "cosine";
+    else
+      metric_ = "l2";
+    pre_process();
+  }
+
+  /**
+   * @brief Initialize serializer strategy
+   * @param serializer_strategy Serializer strategy. See enum in serializer/base.hpp
+   */
+  // Serializer support removed; JSON persistence handled internally.
+  /**
+   * @brief Initialize storage strategy
+   * @param storage_strategy Storage strategy. See enum in storage/base.hpp
+   */
+  void initialize_storage(::nano_vectordb::storage type, const std::string& path)
+  {
+    WriteGuard write(*this);
+    storage_strategy_ = ::nano_vectordb::make(type);
+    storage_file_ = path;
+    full_save_ = true;
+  }
+
+  // Overload: initialize storage with a strategy instance, keep current storage_file_
+  void initialize_storage(const std::shared_ptr<IStorage>& strategy)
+  {
+    WriteGuard write(*this);
+    storage_strategy_ = strategy;
+    full_save_ = true;
+  }
+
+  /**
+   * @brief Initialize index strategy and build it over the stored rows
+   * @param type Index strategy. See enum in index/factory.hpp; Flat restores the exact scan.
+   */
+  void initialize_index(::nano_vectordb::index type)
+  {
+    WriteGuard write(*this);
+    initialize_index(::nano_vectordb::make(type));
+  }
+
+  // Overload: initialize index with a strategy instance (e.g. an HNSWIndex with custom HNSWParams)
+  void initialize_index(const std::shared_ptr<IIndex>& strategy)
+  {
+    WriteGuard write(*this);
+    index_ = strategy;
+    rebuild_index();
+  }
+
+  /**
+   * @brief Re-index every live row.
+   *
+   * Runs automatically when the index or the metric changes; call it to retrain an index (e.g. IVF
+   * centroids) after the data distribution drifted. While the rows are still those mapped from a column
+   * storage file, an index saved with that file (see save_index()) is loaded instead.
+   */
+  void rebuild_index()
+  {
+    WriteGuard write(*this);
+    if (!index_enabled())
+      return;
+    const std::vector<int> rows = live_rows();
+    auto persistent = std::dynamic_pointer_cast<IPersistentIndex>(index_);
+    if (persistent && matrix_.borrowed())
+    {
+      const std::vector<int> stored = all_rows();
+      if (persistent->load(IPersistentIndex::path_for(storage_file_), index_space(), rows,
+                           rows_fingerprint(stored)))
+        return;
+    }
+    index_->build(index_space(), rows);
+  }
+
+  /**
+   * @brief Write the index next to the storage file (`<storage_file>.index`), so the next open loads it
+   *        instead of reading every row to rebuild it.
+   *
+   * Only indexes with a file format (SQ8, PQ) are written, and only while the rows are still those mapped
+   * from a column storage file (MMap); checkpoint() writes it as well. Removals logged since then leave
+   * the file valid.
+   *
+   * @return bool Whether the index was written.
+   */
+  bool save_index() const
+  {
+    std::lock_guard<std::mutex> saving(save_mutex_);
+    ReadGuard read(*this);
+    if (!matrix_.borrowed())
+      return false;
+    return write_index(all_rows());
+  }
+
+  /**
+   * @brief Current index strategy, or nullptr when queries scan every row.
+   */
+  std::shared_ptr<IIndex> index_strategy() const
+  {
+    ReadGuard read(*this);
+    return index_;
+  }
+
+  /**
+   * @brief Configure the parallel scan used by query() and query_batch()
+   * @param options Thread count and minimum chunk size. threads <= 1 scans on the calling thread.
+   */
+  void set_scan_options(const ScanOptions& options)
+  {
+    WriteGuard write(*this);
+    scan_options_ = options;
+    // The calling thread takes part in every scan, so the pool needs one thread fewer
+    thread_pool_ = options.threads > 1 ? std::make_shared<ThreadPool>(options.threads - 1) : nullptr;
+  }
+
+  /**
+   * @brief Scan with a pool shared with other databases (e.g. all tenants of a MultiTenantNanoVDB)
+   * @param pool Worker pool, or nullptr to scan on the calling thread.
+   * @param min_chunk_rows Minimum number of rows per parallel chunk.
+   */
+  void set_thread_pool(std::shared_ptr<ThreadPool> pool, size_t min_chunk_rows = ScanOptions{}.min_chunk_rows)
+  {
+    WriteGuard write(*this);
+    thread_pool_ = std::move(pool);
+    scan_options_.threads = thread_pool_ ? static_cast<int>(thread_pool_->size()) + 1 : 1;
+    scan_options_.min_chunk_rows = min_chunk_rows;
+  }
+
+  /**
+   * @brief Keep the row store on a NUMA node
+   *
+   * Rows already in memory are moved to the node and later growth is allocated there. Rows borrowed
+   * from a mapped file stay in the page cache until the first write copies them.
+   *
+   * @param node Operating system node id, or -1 to stop binding new allocations.
+   */
+  void set_numa_node(int node)
+  {
+    WriteGuard write(*this);
+    matrix_.set_node(node);
+  }
+
+  /**
+   * @brief NUMA node set by set_numa_node(), -1 if none.
+   */
+  int numa_node() const
+  {
+    ReadGuard read(*this);
+    return matrix_.node();
+  }
+
+  /**
+   * @brief Current scan configuration
+   */
+  ScanOptions scan_options() const
+  {
+    ReadGuard read(*this);
+    return scan_options_;
+  }
+
+  /**
+   * @brief Operation counts, latency histograms and row counters collected since the database opened.
+   *
+   * query(), query_batch(), upsert(), remove() and save() / checkpoint() are timed including the wait
+   * for the lock; opening the database is recorded as one load. Recording adds two clock reads and a
+   * few thread-local stores per call.
+   */
+  MetricsSnapshot stats() const
+  {
+    std::shared_ptr<Metrics> metrics;
+    {
+      ReadGuard read(*this);
+      metrics = metrics_;
+    }
+    return metrics ? metrics->snapshot() : MetricsSnapshot{};
+  }
+
+  /**
+   * @brief Record into a collector shared with other databases, or stop recording (nullptr).
+   */
+  void set_metrics(std::shared_ptr<Metrics> metrics)
+  {
+    // save() reads metrics_ under save_mutex_ only
+    std::lock_guard<std::mutex> saving(save_mutex_);
+    WriteGuard write(*this);
+    metrics_ = std::move(metrics);
+  }
+
+  /**
+   * @brief The collector in use, or nullptr when recording is off.
+   */
+  std::shared_ptr<Metrics> metrics() const
+  {
+    ReadGuard read(*this);
+    return metrics_;
+  }
+
+  /**
+   * @brief Cache the results of up to `entries` distinct query() calls; 0 turns the cache off.
+   *
+   * Queries are keyed on the exact query vector, top_k, threshold and metadata predicate; queries with a
+   * filter function are never cached. Every write to the database invalidates the cache, so a cached
+   * answer is always the one a scan would return. The cache starts empty.
+   */
+  void set_query_cache(size_t entries)
+  {
+    WriteGuard write(*this);
+    query_cache_ = entries > 0 ? std::make_unique<QueryCache>(entries) : nullptr;
+  }
+
+  /**
+   * @brief Entries, bytes and hit and miss counts of the query result cache.
+   */
+  QueryCacheStats query_cache_stats() const
+  {
+    ReadGuard read(*this);
+    return query_cache_ ? query_cache_->stats() : QueryCacheStats{};
+  }
+
+private:
+  struct HeldLock
+  {
+    const NanoVectorDB* db;
+    bool exclusive;
+  };
+
+  /**
+   * @brief Locks held by the calling thread, so methods called under a lock do not take it again.
+   */
+  static std::vector<HeldLock>& held_locks()
+  {
+    thread_local std::vector<HeldLock> held;
+    return held;
+  }
+
+  const HeldLock* held_lock() const
+  {
+    for (const auto& h : held_locks())
+    {
+      if (h.db == this)
+        return &h;
+    }
+    return nullptr;
+  }
+
+  void release_held_lock() const
+  {
+    auto& held = held_locks();
+    held.erase(std::find_if(held.begin(), held.end(), [this](const HeldLock& h) { return h.db == this; }));
+  }
+
+  /**
+   * @brief Exclusive lock taken by every method that changes the database.
+   *
+   * Writers first serialize on write_mutex_, so a writer can prepare work under a shared lock (see
+   * compact()) knowing that nothing changes before it takes the exclusive lock.
+   */
+  class WriteGuard
+  {
+  public:
+    explicit WriteGuard(const NanoVectorDB& db) : WriteGuard(db, std::unique_lock<std::mutex>())
+    {
+    }
+
+    /**
+     * @param writers write_mutex_ already locked by the caller, or empty to lock it here.
+     */
+    WriteGuard(const NanoVectorDB& db, std::unique_lock<std::mutex> writers)
+    {
+      if (const HeldLock* held = db.held_lock())
+      {
+        if (!held->exclusive)
+          throw std::runtime_error("NanoVectorDB: cannot write while this thread holds a ReadGuard");
+        return;  // nested in another writer
+      }
+      writers_ = writers.owns_lock() ? std::move(writers) : std::unique_lock<std::mutex>(db.write_mutex_);
+      db.mutex_.lock();
+      held_locks().push_back({ &db, true });
+      db_ = &db;
+    }
+
+    WriteGuard(const WriteGuard&) = delete;
+    WriteGuard& operator=(const WriteGuard&) = delete;
+
+    ~WriteGuard()
+    {
+      if (!db_)
+        return;
+      ++db_->version_;
+      db_->release_held_lock();
+      db_->mutex_.unlock();
+    }
+
+  private:
+    const NanoVectorDB* db_ = nullptr;  // null when nested
+    std::unique_lock<std::mutex> writers_;
+  };
+
+  /**
+   * @brief A ReadGuard or WriteGuard that records the operation it protects when released.
+   *
+   * The clock starts before locking, so time spent waiting for the lock counts; the sample is recorded
+   * before the lock that protects metrics_ is released.
+   */
+  template <typename Guard>
+  class Timed
+  {
+  public:
+    Timed(const NanoVectorDB& db, operation op) : db_(db), op_(op), start_(Metrics::clock::now()), guard_(db)
+    {
+    }
+
+    ~Timed()
+    {
+      db_.record(op_, start_);
+    }
+
+  private:
+    const NanoVectorDB& db_;
+    operation op_;
+    Metrics::clock::time_point start_;
+    Guard guard_;
+  };
+
+  /**
+   * @brief Records a save when destroyed; declared while save_mutex_ is held, which protects metrics_.
+   */
+  struct SaveTimer
+  {
+    const NanoVectorDB& db;
+    Metrics::clock::time_point start;
+
+    ~SaveTimer()
+    {
+      db.record(operation::Save, start);
+    }
+  };
+
+  void record(operation op, Metrics::clock::time_point start) const
+  {
+    if (metrics_)
+      metrics_->record(op, start);
+  }
+
+  void count(counter c, size_t n) const
+  {
+    if (metrics_ && n > 0)
+      metrics_->add(c, n);
+  }
+
+  /**
+   * @brief Answer a query from query_cache_ at the current version, or run it and cache the results.
+   */
+  template <typename Run>
+  std::vector<QueryResult> cached_query(const Eigen::VectorXf& query, int top_k,
+                                        std::optional<float> threshold, const Predicate* where,
+                                        const Run& run) const
+  {
+    std::string key = QueryCache::key(query, top_k, threshold, where);
+    if (auto hit = query_cache_->find(key, version_))
+    {
+      count(counter::QueryCacheHits, 1);
+      return std::move(*hit);
+    }
+    count(counter::QueryCacheMisses, 1);
+    std::vector<QueryResult> results = run();
+    query_cache_->insert(std::move(key), version_, results);
+    return results;
+  }
+
+  /**
+   * @brief Packed live rows prepared by compact() before they replace the current ones.
+   */
+  struct Compaction
+  {
+    std::vector<std::string> ids;
+    RowStore matrix;
+    std::vector<float> sq_norms;
+    std::vector<int> new_row_of;  // new row of each current row, -1 for dropped rows
+  };
+
+  Compaction plan_compaction() const
+  {
+    Compaction next;
+    const size_t live = size();
+    next.ids.reserve(live);
+    next.matrix = RowStore(embedding_dim_, matrix_.type());
+    next.matrix.reserve(live);
+    next.sq_norms.reserve(live);
+    next.new_row_of.assign(ids_.size(), -1);
+    for (size_t i = 0; i < ids_.size(); ++i)
+    {
+      if (deleted_.test(i))
+        continue;
+      next.new_row_of[i] = static_cast<int>(next.ids.size());
+      next.ids.push_back(ids_[i]);
+      next.matrix.append_row(matrix_, i);
+      next.sq_norms.push_back(row_sq_norms_[i]);
+    }
+    return next;
+  }
+
+  void apply_compaction(Compaction next)
+  {
+    if (next.matrix.rows() != next.ids.size())
+    {
+      throw std::runtime_error("Eigen::MatrixXf row count does not match data size after compaction");
+    }
+    ids_ = std::move(next.ids);
+    matrix_ = std::move(next.matrix);
+    row_sq_norms_ = std::move(next.sq_norms);
+    deleted_ = Bitmap(ids_.size());
+    free_rows_.clear();
+    id_index_.rebuild(ids_.size(), id_at());
+    metadata_.remap(next.new_row_of, ids_.size());
+    if (index_)
+      index_->remap(next.new_row_of);
+  }
+
+  /**
+   * @brief Load records from the configured storage file, if it exists.
+   */
+  void load()
+  {
+    bool loaded = false;
+    if (auto cs = std::dynamic_pointer_cast<IStorageColumns>(storage_strategy_))
+      loaded = load_columns(cs->read_columns(storage_file_));
+    else
+      loaded = load_file();
+    // The log only holds changes relative to a storage file, so it is ignored without one
+    if (loaded && !std::dynamic_pointer_cast<IStorageRecords>(storage_strategy_))
+      replay_wal();
+    reset_tracking();
+    full_save_ = !loaded;
+  }
+
+  /**
+   * @brief Load records through a byte or row-wise backend, or from the JSON storage file.
+   *
+   * @return bool Whether anything was stored at the path.
+   */
+  bool load_file()
+  {
+    // Use storage + serializer strategies if provided, fallback to default file loading
+    std::optional<nlohmann::json> loaded;
+    std::optional<ColumnLoad> loaded_rows;
+    std::vector<Data> loaded_records;
+    precision stored_type = precision::F32;
+    if (storage_strategy_)
+    {
+      try
+      {
+        // Prefer rows read straight into a row store over records decoded one by one
+        auto rs = std::dynamic_pointer_cast<IStorageRecords>(storage_strategy_);
+        if (rs)
+          loaded_rows = rs->read_rows(storage_file_);
+        if (rs && !loaded_rows)
+        {
+          auto lr = rs->read_records(storage_file_);
+          if (!lr.records.empty() || lr.embedding_dim > 0)
+          {
+            loaded_records = std::move(lr.records);
+            stored_type = lr.type;
+            loaded = nlohmann::json{ {"embedding_dim", lr.embedding_dim}, {"matrix", ""}, {"data", nlohmann::json::array()} };
+            if (!lr.metadata.is_null())
+              (*loaded)["metadata"] = std::move(lr.metadata);
+            additional_data_ = lr.additional;
+          }
+        }
+        else if (!rs)
+        {
+          auto bytes = storage_strategy_->read(storage_file_);
+          if (!bytes.empty())
+          {
+            nlohmann::json j = nlohmann::json::parse(bytes.begin(), bytes.end());
+            loaded = j;
+          }
+        }
+      }
+      catch (...)
+      {
+        loaded = load_storage(storage_file_, embedding_dim_);
+      }
+    }
+    else
+    {
+      loaded = load_storage(storage_file_, embedding_dim_);
+    }
+    if (loaded_rows)
+    {
+      return load_columns(std::move(*loaded_rows));
+    }
+    if (loaded)
+    {
+      const auto& val = loaded.value();
+      if (!val.contains("matrix"))
+      {
+        throw std::runtime_error("Storage file missing 'matrix' field");
+      }
+      if (!loaded_records.empty())
+      {
+        // Rebuild from serializer-decoded records, in the element type they were saved with
+        matrix_ = RowStore(embedding_dim_, stored_type);
+        ids_.reserve(loaded_records.size());
+        matrix_.reserve(loaded_records.size());
+        for (auto& record : loaded_records)
+        {
+          if (record.vector.size() != embedding_dim_)
+          {
+            throw std::runtime_error("Loaded record dim mismatch");
+          }
+          ids_.push_back(std::move(record.id));
+          matrix_.push_back(record.vector.data());
+        }
+      }
+      else
+      {
+        std::string matrix_b64 = val["matrix"];
+        if (val.contains("precision"))
+          stored_type = precision_from_name(val["precision"].get<std::string>());
+        matrix_ = RowStore(embedding_dim_, stored_type);
+        matrix_.assign(buffer_string_to_array(matrix_b64, embedding_dim_, stored_type));
+        if (!val.contains("data"))
+        {
+          throw std::runtime_error("Storage file missing 'data' field");
+        }
+        for (const auto& d : val["data"])
+        {
+          if (!d.contains("id"))
+          {
+            throw std::runtime_error("Data entry missing 'id' field");
+          }
+          // Ids align with matrix rows by index
+          ids_.push_back(d["id"].get<std::string>());
+        }
+      }
+      if (val.contains("additional_data"))
+      {
+        additional_data_ = val["additional_data"];
+      }
+      checkpoint_generation_ = val.value("checkpoint_generation", std::uint64_t(0));
+      if (val.contains("embedding_dim"))
+      {
+        int loaded_dim = val["embedding_dim"];
+        if (loaded_dim != embedding_dim_)
+        {
+          throw std::runtime_error("Embedding dim mismatch: expected " + std::to_string(embedding_dim_) +
+                                   ", got " + std::to_string(loaded_dim));
+        }
+      }
+      if (matrix_.rows() != ids_.size())
+      {
+        throw std::runtime_error("Eigen::MatrixXf row count does not match data size");
+      }
+      std::vector<float> sq_norms;
+      if (loaded_records.empty() && val.contains("sq_norms"))
+      {
+        const std::vector<char> bytes = base64_to_bytes(val["sq_norms"].get<std::string>());
+        if (bytes.size() == ids_.size() * sizeof(float))
+        {
+          sq_norms.resize(ids_.size());
+          std::memcpy(sq_norms.data(), bytes.data(), bytes.size());
+        }
+      }
+      adopt_rows(loaded_records.empty() && val.value("normalized", false), std::move(sq_norms));
+      deleted_ = Bitmap(ids_.size());
+      id_index_.rebuild(ids_.size(), id_at());
+      if (val.contains("metadata"))
+      {
+        restore_metadata(val["metadata"]);
+      }
+    }
+    return loaded.has_value();
+  }
+
+  /**
+   * @brief Rewrite the storage file; the caller holds save_mutex_.
+   */
+  void write_checkpoint() const
+  {
+    std::shared_ptr<IStorageRecords> rs;
+    {
+      ReadGuard read(*this);
+      rs = std::dynamic_pointer_cast<IStorageRecords>(storage_strategy_);
+      if (!rs)
+      {
+        // Batches already in the log are at or below the new generation, so replay skips them even
+        // if the log outlives this checkpoint
+        write_storage_file(checkpoint_generation_ + 1);
+        ++checkpoint_generation_;
+        if (std::dynamic_pointer_cast<IStorageColumns>(storage_strategy_))
+          write_index(live_rows());
+        const std::string wal = WriteAheadLog::path_for(storage_file_);
+        std::error_code ec;
+        std::filesystem::remove(wal, ec);
+        if (ec)
+          throw std::runtime_error("Failed to remove write-ahead log " + wal + ": " + ec.message());
+        wal_bytes_ = 0;
+        reset_tracking();
+        return;
+      }
+    }
+    write_all_records(*rs);
+  }
+
+  /**
+   * @brief Write every live record through a row-wise backend; the caller holds save_mutex_.
+   */
+  void write_all_records(const IStorageRecords& rs) const
+  {
+    std::vector<Data> records;
+    std::string path;
+    nlohmann::json additional;
+    nlohmann::json metadata;
+    precision type;
+    {
+      ReadGuard read(*this);
+      records.reserve(size());
+      for (size_t i = 0; i < ids_.size(); ++i)
+      {
+        if (!deleted_.test(i))
+          records.push_back(view_at(i).to_data());
+      }
+      path = storage_file_;
+      additional = additional_data_;
+      metadata = metadata_json();
+      type = matrix_.type();
+      reset_tracking();
+    }
+    try
+    {
+      rs.write_records(path, records, embedding_dim_, additional, type, metadata);
+    }
+    catch (...)
+    {
+      restore_full_save();
+      throw;
+    }
+  }
+
+  /**
+   * @brief save() for row-wise backends: upsert and delete only the changed rows when possible.
+   */
+  void save_records(const IStorageRecords& rs) const
+  {
+    std::vector<Data> upserts;
+    std::vector<std::string> removed;
+    std::optional<nlohmann::json> metadata;
+    std::string path;
+    nlohmann::json additional;
+    precision type;
+    bool full = false;
+    {
+      ReadGuard read(*this);
+      full = full_save_;
+      if (!full)
+      {
+        upserts = changed_records();
+        removed.assign(removed_ids_.begin(), removed_ids_.end());
+        if (metadata_dirty_)
+          metadata = metadata_json();
+        path = storage_file_;
+        additional = additional_data_;
+        type = matrix_.type();
+        reset_tracking();
+      }
+    }
+    if (full)
+    {
+      write_all_records(rs);
+      return;
+    }
+    bool written = false;
+    try
+    {
+      written = rs.write_changes(path, upserts, removed, embedding_dim_, additional, type, metadata);
+    }
+    catch (...)
+    {
+      restore_full_save();
+      throw;
+    }
+    if (!written)
+      write_all_records(rs);
+  }
+
+  /**
+   * @brief Append the changes since the last save to the write-ahead log; the caller holds save_mutex_.
+   *
+   * @return bool false if the changes are no longer tracked and the caller must checkpoint instead.
+   */
+  bool append_wal() const
+  {
+    WalBatch batch;
+    std::string path;
+    {
+      ReadGuard read(*this);
+      if (full_save_)
+        return false;
+      batch.upserts = changed_records();
+      batch.removes.assign(removed_ids_.begin(), removed_ids_.end());
+      if (metadata_dirty_)
+      {
+        // Whole rows of the changed ids; an empty object clears a row on replay
+        nlohmann::json rows = nlohmann::json::object();
+        for (const auto& id : dirty_ids_)
+          rows[id] = metadata_.row_json(row_of(id));
+        batch.metadata = { { "columns", metadata_.schema_json() }, { "rows", std::move(rows) } };
+      }
+      if (additional_dirty_)
+        batch.additional = additional_data_;
+      batch.generation = checkpoint_generation_ + 1;
+      path = WriteAheadLog::path_for(storage_file_);
+      reset_tracking();
+    }
+    if (batch.upserts.empty() && batch.removes.empty() && batch.metadata.is_null() && batch.additional.is_null())
+      return true;
+    try
+    {
+      wal_bytes_ = WriteAheadLog::append(path, embedding_dim_, batch);
+    }
+    catch (...)
+    {
+      restore_full_save();
+      throw;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Re-apply the batches of the write-ahead log on top of the loaded storage file.
+   *
+   * Batches at or below the storage file's generation were folded in by a checkpoint and are skipped.
+   */
+  void replay_wal()
+  {
+    const std::string path = WriteAheadLog::path_for(storage_file_);
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec))
+      return;
+    std::uint64_t valid = 0;
+    const std::vector<WalBatch> batches = WriteAheadLog::read(path, embedding_dim_, valid);
+    if (std::filesystem::file_size(path, ec) > valid)
+      std::filesystem::resize_file(path, valid, ec);  // drop a batch torn by a crash
+    for (const auto& batch : batches)
+    {
+      if (batch.generation <= checkpoint_generation_)
+        continue;
+      remove(batch.removes);
+      upsert(batch.upserts);
+      if (!batch.metadata.is_null())
+        restore_metadata(batch.metadata);
+      if (!batch.additional.is_null())
+        additional_data_ = batch.additional;
+    }
+    wal_bytes_ = valid;
+  }
+
+  /**
+   * @brief Whether the next save() should rewrite the storage file rather than grow the log.
+   */
+  bool checkpoint_due() const
+  {
+    const size_t changed = dirty_ids_.size() + removed_ids_.size();
+    const size_t logged_bytes = changed * (sizeof(float) * static_cast<size_t>(embedding_dim_) + 32);
+    return wal_bytes_ + logged_bytes > wal_options_.checkpoint_bytes ||
+           static_cast<float>(changed) > wal_options_.checkpoint_fraction * static_cast<float>(size());
+  }
+
+  /**
+   * @brief Live records upserted since the last save.
+   */
+  std::vector<Data> changed_records() const
+  {
+    std::vector<Data> records;
+    records.reserve(dirty_ids_.size());
+    for (const auto& id : dirty_ids_)
+      records.push_back(view_at(row_of(id)).to_data());
+    return records;
+  }
+
+  /**
+   * @brief Record an upsert (or a metadata change) for the next save().
+   */
+  void track_upsert(const std::string& id)
+  {
+    std::lock_guard<std::mutex> tracking(tracking_mutex_);
+    if (full_save_)
+      return;
+    removed_ids_.erase(id);
+    dirty_ids_.insert(id);
+    limit_tracking();
+  }
+
+  void track_remove(const std::string& id)
+  {
+    std::lock_guard<std::mutex> tracking(tracking_mutex_);
+    if (full_save_)
+      return;
+    dirty_ids_.erase(id);
+    removed_ids_.insert(id);
+    limit_tracking();
+  }
+
+  /**
+   * @brief Stop tracking once a full rewrite is as cheap as writing the changes (e.g. bulk loads); the
+   *        caller holds tracking_mutex_.
+   */
+  void limit_tracking()
+  {
+    if (dirty_ids_.size() + removed_ids_.size() > std::max<size_t>(kMinTrackedChanges, ids_.size()))
+    {
+      full_save_ = true;
+      dirty_ids_.clear();
+      removed_ids_.clear();
+    }
+  }
+
+  /**
+   * @brief After a failed write, make the next save rewrite everything; the caller holds save_mutex_.
+   */
+  void restore_full_save() const
+  {
+    // Writers are excluded by the shared lock, other saves by save_mutex_ and readers by tracking_mutex_
+    ReadGuard read(*this);
+    std::lock_guard<std::mutex> tracking(tracking_mutex_);
+    full_save_ = true;
+    dirty_ids_.clear();
+    removed_ids_.clear();
+  }
+
+  /**
+   * @brief Mark the storage file (plus log) as matching the in-memory state.
+   *
+   * Called by load() and, under a shared lock plus save_mutex_, by the save paths: writers only touch the
+   * tracked changes while holding the exclusive lock, and tracking_mutex_ keeps dirty() and
+   * memory_usage() from reading them while they are cleared.
+   */
+  void reset_tracking() const
+  {
+    std::lock_guard<std::mutex> tracking(tracking_mutex_);
+    dirty_ids_.clear();
+    removed_ids_.clear();
+    full_save_ = false;
+    metadata_dirty_ = false;
+    additional_dirty_ = false;
+  }
+
+  /**
+   * @brief Write every live record to the storage file through a column or byte backend, or as JSON.
+   *
+   * @param generation Checkpoint generation recorded in the file (see WriteAheadLog).
+   */
+  void write_storage_file(std::uint64_t generation) const
+  {
+    if (auto cs = std::dynamic_pointer_cast<IStorageColumns>(storage_strategy_))
+    {
+      ColumnSnapshot snapshot;
+      snapshot.rows = &matrix_;
+      snapshot.ids = &ids_;
+      snapshot.sq_norms = &row_sq_norms_;
+      snapshot.deleted = free_rows_.empty() ? nullptr : &deleted_;
+      snapshot.normalized = rows_normalized_;
+      snapshot.additional = additional_data_;
+      snapshot.metadata = metadata_json();
+      snapshot.generation = generation;
+      cs->write_columns(storage_file_, snapshot);
+      return;
+    }
+    nlohmann::json storage;
+    std::string dumped;
+    storage["embedding_dim"] = embedding_dim_;
+    storage["precision"] = precision_name(matrix_.type());
+    // Serialized through a column-major copy of the live rows so the on-disk layout is unchanged
+    Eigen::MatrixXf live(size(), embedding_dim_);
+    Eigen::RowVectorXf row(embedding_dim_);
+    std::vector<nlohmann::json> data_json;
+    std::vector<float> sq_norms;
+    sq_norms.reserve(live.rows());
+    for (size_t i = 0; i < ids_.size(); ++i)
+    {
+      if (deleted_.test(i))
+        continue;
+      matrix_.decode_row(i, row.data());
+      live.row(data_json.size()) = row;
+      sq_norms.push_back(row_sq_norms_[i]);
+      nlohmann::json entry;
+      entry["id"] = ids_[i];
+      data_json.push_back(entry);
+    }
+    storage["matrix"] = array_to_buffer_string(live, matrix_.type());
+    storage["data"] = data_json;
+    // Loading skips normalizing unit rows and recomputing norms
+    storage["normalized"] = rows_normalized_;
+    storage["sq_norms"] = bytes_to_base64(sq_norms.data(), sq_norms.size() * sizeof(float));
+    storage["checkpoint_generation"] = generation;
+    if (!additional_data_.is_null())
+    {
+      storage["additional_data"] = additional_data_;
+    }
+    if (!metadata_.empty())
+    {
+      storage["metadata"] = metadata_json();
+    }
+    dumped = storage.dump();
+    if (storage_strategy_)
+    {
+      std::vector<uint8_t> bytes(dumped.begin(), dumped.end());
+      storage_strategy_->write(storage_file_, bytes);
+    }
+    else
+    {
+      std::ofstream f(storage_file_);
+      if (!f.is_open())
+      {
+        throw std::runtime_error("Failed to open storage file for saving: " + storage_file_);
+      }
+      f << dumped;
+    }
+  }
+
+  /**
+   * @brief Adopt columns read by a backend without copying the rows.
+   *
+   * The row store keeps borrowing the backend's memory (e.g. a file mapping) until a write copies it.
+   * Stored norms are reused, so nothing touches the vectors unless cosine rows still need normalizing
+   * or the backend stores no norms.
+   */
+  bool load_columns(ColumnLoad loaded)
+  {
+    if (loaded.embedding_dim == 0)
+      return false;
+    if (loaded.embedding_dim != embedding_dim_)
+    {
+      throw std::runtime_error("Embedding dim mismatch: expected " + std::to_string(embedding_dim_) +
+                               ", got " + std::to_string(loaded.embedding_dim));
+    }
+    matrix_ = std::move(loaded.rows);
+    ids_ = std::move(loaded.ids);
+    additional_data_ = std::move(loaded.additional);
+    checkpoint_generation_ = loaded.generation;
+    adopt_rows(loaded.normalized, std::move(loaded.sq_norms));
+    deleted_ = Bitmap(ids_.size());
+    id_index_.rebuild(ids_.size(), id_at());
+    if (!loaded.metadata.is_null())
+    {
+      restore_metadata(loaded.metadata);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Metadata of the live rows, as {columns: schema, rows: {id: values}}; null when no column exists.
+   */
+  nlohmann::json metadata_json() const
+  {
+    if (metadata_.empty())
+      return nullptr;
+    nlohmann::json rows = nlohmann::json::object();
+    for (size_t i = 0; i < ids_.size(); ++i)
+    {
+      if (deleted_.test(i))
+        continue;
+      nlohmann::json values = metadata_.row_json(i);
+      if (!values.empty())
+        rows[ids_[i]] = std::move(values);
+    }
+    return nlohmann::json{ { "columns", metadata_.schema_json() }, { "rows", std::move(rows) } };
+  }
+
+  /**
+   * @brief Re-create the columns and row values written by metadata_json().
+   */
+  void restore_metadata(const nlohmann::json& stored)
+  {
+    for (const auto& column : stored.at("columns"))
+    {
+      metadata_.add_column(column.at("name").get<std::string>(),
+                           column_type_from_name(column.at("type").get<std::string>()));
+    }
+    for (const auto& [id, values] : stored.at("rows").items())
+    {
+      const int row = id_index_.find(id, id_at());
+      if (row < 0)
+        continue;
+      metadata_.clear_row(static_cast<size_t>(row));
+      metadata_.set_row_json(static_cast<size_t>(row), values);
+    }
+  }
+
+  /**
+   * @brief query() with either a filter function or a compiled predicate mask (rows to keep).
+   */
+  std::vector<QueryResult> run_query(const Eigen::VectorXf& query, int top_k,
+                                     std::optional<float> better_than_threshold,
+                                     const std::function<bool(const DataView&)>& filter,
+                                     const Bitmap* mask) const
+  {
+    if (query.size() != embedding_dim_)
+    {
+      throw std::runtime_error("Query vector dimension mismatch: expected " + std::to_string(embedding_dim_) +
+                               ", got " + std::to_string(query.size()));
+    }
+    // No query returns more than the live rows, so selectors and index searches are sized by those
+    top_k = std::max(0, std::min(top_k, size()));
+    if (use_index(mask))
+    {
+      return index_query(query, top_k, better_than_threshold, filter, mask);
+    }
+    // If a strategy is provided, use it for general distance-based querying
+    if (metric_strategy_)
+    {
+      const bool is_cosine = (std::dynamic_pointer_cast<CosineMetric>(metric_strategy_) != nullptr);
+      // One virtual call per block; the metric runs its kernel over contiguous rows of matrix_
+      auto score_block = [&](size_t start, size_t len, float* out) {
+        block_distances(query, start, len, out);
+        for (size_t r = 0; r < len; ++r)
+          out[r] = is_cosine ? (1.0f - out[r]) : (-out[r]);  // score: higher is better
+      };
+      TopK selector = scan(top_k, better_than_threshold, filter, mask, score_block);
+      return rank_results(selector);
+    }
+    if (metric_ == "cosine")
+    {
+      return cosine_query(query, top_k, better_than_threshold, filter, mask);
+    }
+    return {};
+  }
+
+  /**
+   * @brief query_batch() with either a filter function or a compiled predicate mask (rows to keep).
+   */
+  std::vector<std::vector<QueryResult>> run_query_batch(const Eigen::MatrixXf& queries, int top_k,
+                                                        std::optional<float> better_than_threshold,
+                                                        const std::function<bool(const DataView&)>& filter,
+                                                        const Bitmap* mask) const
+  {
+    if (queries.cols() != embedding_dim_)
+    {
+      throw std::runtime_error("Query batch dimension mismatch: expected " + std::to_string(embedding_dim_) +
+                               ", got " + std::to_string(queries.cols()));
+    }
+    const int n_queries = static_cast<int>(queries.rows());
+    std::vector<std::vector<QueryResult>> results(n_queries);
+    if (n_queries == 0)
+    {
+      return results;
+    }
+    top_k = std::max(0, std::min(top_k, size()));
+    if (use_index(mask))
+    {
+      // Graph searches are independent; spread the queries over the scan pool
+      auto one = [&](size_t i) {
+        results[i] = index_query(queries.row(i).transpose(), top_k, better_than_threshold, filter, mask);
+      };
+      if (thread_pool_)
+        thread_pool_->parallel_for(static_cast<size_t>(n_queries), one);
+      else
+        for (int i = 0; i < n_queries; ++i)
+          one(i);
+      return results;
+    }
+    const bool strategy_cosine = (std::dynamic_pointer_cast<CosineMetric>(metric_strategy_) != nullptr);
+    const bool strategy_l2 = (std::dynamic_pointer_cast<L2Metric>(metric_strategy_) != nullptr);
+    if (metric_strategy_ && !strategy_cosine && !strategy_l2)
+    {
+      // Custom metrics cannot be expressed as a matrix product; score them one query at a time.
+      for (int i = 0; i < n_queries; ++i)
+      {
+        results[i] = run_query(queries.row(i).transpose(), top_k, better_than_threshold, filter, mask);
+      }
+      return results;
+    }
+    if (!metric_strategy_ && metric_ != "cosine")
+    {
+      return results;
+    }
+
+    // Query vectors become the columns of the right-hand side of every tile product.
+    Eigen::MatrixXf rhs = queries.transpose();
+    Eigen::VectorXf query_sq_norms = rhs.colwise().squaredNorm().transpose();
+    if (!strategy_l2)
+    {
+      for (int i = 0; i < n_queries; ++i)
+      {
+        // CosineMetric scores a zero query as 0 instead of rejecting it; keep that behaviour here
+        if (metric_strategy_ && rhs.col(i).norm() == 0.0f)
+          continue;
+        rhs.col(i) = normalize(rhs.col(i));
+      }
+    }
+    // Cosine rows are normalized on upsert only when the legacy metric string agrees with the strategy.
+    const bool need_row_norms = strategy_l2 || metric_ != "cosine";
+
+    std::vector<char> allowed;
+    const bool masked = filter || mask || !free_rows_.empty();
+    if (masked)
+    {
+      allowed.resize(ids_.size());
+      for (size_t i = 0; i < ids_.size(); ++i)
+      {
+        if (mask)
+          allowed[i] = mask->test(i) ? 1 : 0;
+        else
+          allowed[i] = !deleted_.test(i) && (!filter || filter(view_at(i))) ? 1 : 0;
+      }
+    }
+
+    const int n_rows = static_cast<int>(matrix_.rows());
+    const int tile_rows =
+        std::max(64, static_cast<int>(kBatchTileBytes / (sizeof(float) * static_cast<size_t>(embedding_dim_))));
+    // Each chunk of rows is tiled independently and keeps its own per-query selectors
+    auto scan_range = [&](int begin, int end, std::vector<TopK>& selectors) {
+      Eigen::MatrixXf tile_scores;
+      RowMatrixXf decoded;
+      for (int start = begin; start < end; start += tile_rows)
+      {
+        const int len = std::min(tile_rows, end - start);
+        if (mask && !mask->any(static_cast<size_t>(start), static_cast<size_t>(start + len)))
+          continue;  // no row of this tile matches the predicate
+        if (matrix_.type() == precision::F32)
+        {
+          tile_scores.noalias() = matrix_.block(start, len) * rhs;
+        }
+        else
+        {
+          // Narrow rows are widened one tile at a time so the product runs in fp32
+          decode_block(start, len, decoded);
+          tile_scores.noalias() = decoded * rhs;
+        }
+        const float* tile_sq_norms = row_sq_norms_.data() + start;
+        for (int qi = 0; qi < n_queries; ++qi)
+        {
+          for (int r = 0; r < len; ++r)
+          {
+            const int idx = start + r;
+            if (masked && !allowed[idx])
+              continue;
+            float score = tile_scores(r, qi);
+            if (strategy_l2)
+            {
+              // Clamped like L2Metric::distances, so rounding cannot push a duplicate above 0
+              score = -std::max(0.0f, tile_sq_norms[r] + query_sq_norms[qi] - 2.0f * score);
+            }
+            else if (need_row_norms)
+            {
+              score = tile_sq_norms[r] == 0.0f ? 0.0f : score / std::sqrt(tile_sq_norms[r]);
+            }
+            selectors[qi].push(idx, score);
+          }
+        }
+      }
+    };
+    // A chunk keeps at most its own row count per query
+    auto make_selectors = [&](size_t rows) {
+      std::vector<TopK> selectors;
+      selectors.reserve(n_queries);
+      for (int qi = 0; qi < n_queries; ++qi)
+        selectors.emplace_back(static_cast<int>(std::min<size_t>(top_k, rows)), better_than_threshold);
+      return selectors;
+    };
+    const auto chunks = scan_chunks(static_cast<size_t>(n_rows));
+    std::vector<TopK> selectors = make_selectors(static_cast<size_t>(n_rows));
+    if (chunks.size() <= 1)
+    {
+      scan_range(0, n_rows, selectors);
+    }
+    else
+    {
+      std::vector<std::vector<TopK>> partial(chunks.size());
+      thread_pool_->parallel_for(chunks.size(), [&](size_t c) {
+        partial[c] = make_selectors(chunks[c].second - chunks[c].first);
+        scan_range(static_cast<int>(chunks[c].first), static_cast<int>(chunks[c].second), partial[c]);
+      });
+      for (const auto& p : partial)
+      {
+        for (int qi = 0; qi < n_queries; ++qi)
+          selectors[qi].merge(p[qi]);
+      }
+    }
+    for (int qi = 0; qi < n_queries; ++qi)
+    {
+      results[qi] = rank_results(selectors[qi]);
+    }
+    return results;
+  }
+
+  /**
+   * @brief Perform a cosine similarity query.
+   *
+   * @param query Input query vector.
+   * @param top_k Number of top results to return.
+   * @param better_than_threshold Optional threshold to filter results.
+   * @param filter Optional filter function to apply on data entries.
+   * @param mask Optional compiled predicate (rows to keep).
+   * @return std::vector<QueryResult> Query results.
+   */
+  std::vector<QueryResult> cosine_query(const Eigen::VectorXf& query, int top_k,
+                                        std::optional<float> better_than_threshold,
+                                        const std::function<bool(const DataView&)>& filter,
+                                        const Bitmap* mask) const
+  {
+    Eigen::VectorXf q = normalize(query);
+    auto score_block = [&](size_t start, size_t len, float* out) {
+      if (matrix_.type() == precision::F32)
+      {
+        kernels::dot_rows(q.data(), matrix_.row(start), matrix_.stride(), len, embedding_dim_, out);
+        return;
+      }
+      for (size_t r = 0; r < len; ++r)
+        out[r] = kernels::dot(q.data(), matrix_.narrow_row(start + r), embedding_dim_, matrix_.type());
+    };
+    TopK selector = scan(top_k, better_than_threshold, filter, mask, score_block);
+    return rank_results(selector);
+  }
+
+  /**
+   * @brief Split [0, rows) into chunk ranges for the parallel scan.
+   *
+   * @param n_rows Number of rows to scan.
+   * @return std::vector<std::pair<size_t, size_t>> Half-open row ranges, one per chunk.
+   */
+  std::vector<std::pair<size_t, size_t>> scan_chunks(size_t n_rows) const
+  {
+    size_t n_chunks = 1;
+    if (thread_pool_ && n_rows > 0)
+    {
+      const size_t by_size = std::max<size_t>(1, n_rows / std::max<size_t>(1, scan_options_.min_chunk_rows));
+      n_chunks = std::min(by_size, thread_pool_->size() + 1);
+    }
+    std::vector<std::pair<size_t, size_t>> chunks;
+    const size_t per_chunk = (n_rows + n_chunks - 1) / n_chunks;
+    for (size_t begin = 0; begin < n_rows; begin += per_chunk)
+      chunks.emplace_back(begin, std::min(n_rows, begin + per_chunk));
+    return chunks;
+  }
+
+  /**
+   * @brief Scan every row with a block scorer and keep the best top_k.
+   *
+   * The row range is split into chunks scanned on the thread pool, each with its own selector; the
+   * per-chunk selections are merged at the end.
+   *
+   * Blocks without a row in mask are skipped; blocks where only a few rows match are scored row by row.
+   *
+   * @param top_k Number of top results to keep.
+   * @param better_than_threshold Optional threshold applied during the scan.
+   * @param filter Optional filter function (called concurrently when the scan is parallel).
+   * @param mask Optional compiled predicate (rows to keep, tombstones already removed).
+   * @param score_block Callable (start, len, out) writing the scores of rows [start, start + len).
+   * @return TopK Selected candidates.
+   */
+  template <typename Scorer>
+  TopK scan(int top_k, std::optional<float> better_than_threshold,
+            const std::function<bool(const DataView&)>& filter, const Bitmap* mask,
+            const Scorer& score_block) const
+  {
+    auto scan_range = [&](size_t begin, size_t end, TopK& selector) {
+      std::vector<float> scores(std::min(end - begin, kScanBlockRows));
+      std::vector<char> keep(scores.size(), 1);
+      bool masked = false;  // keep holds a mask from an earlier block
+      for (size_t start = begin; start < end; start += kScanBlockRows)
+      {
+        const size_t len = std::min(kScanBlockRows, end - start);
+        if (mask && !mask->any(start, start + len))
+          continue;
+        const bool has_tombstones = !mask && !free_rows_.empty() && deleted_.any(start, start + len);
+        if (filter || mask || has_tombstones)
+        {
+          masked = true;
+          size_t kept = 0;
+          for (size_t r = 0; r < len; ++r)
+          {
+            const size_t row = start + r;
+            const bool live = mask ? mask->test(row) : !(has_tombstones && deleted_.test(row));
+            keep[r] = live && (!filter || filter(view_at(row)));
+            kept += keep[r] ? 1 : 0;
+          }
+          if (kept == 0)
+            continue;
+          if (kept < len / 8)
+          {
+            // Selective block: scoring the few kept rows beats scoring the whole block
+            for (size_t r = 0; r < len; ++r)
+            {
+              if (!keep[r])
+                continue;
+              score_block(start + r, 1, &scores[r]);
+              selector.push(static_cast<int>(start + r), scores[r]);
+            }
+            continue;
+          }
+        }
+        else if (masked)
+        {
+          std::fill(keep.begin(), keep.begin() + len, 1);
+          masked = false;
+        }
+        score_block(start, len, scores.data());
+        for (size_t r = 0; r < len; ++r)
+        {
+          if (keep[r])
+            selector.push(static_cast<int>(start + r), scores[r]);
+        }
+      }
+    };
+    const auto chunks = scan_chunks(ids_.size());
+    TopK selected(top_k, better_than_threshold);
+    if (chunks.size() <= 1)
     {
-      matrix_ = Eigen::MatrixXf(0, embedding_dim_);
+      scan_range(0, ids_.size(), selected);
+      return selected;
     }
+    std::vector<TopK> partial;
+    partial.reserve(chunks.size());
+    for (const auto& [begin, end] : chunks)
+      partial.emplace_back(static_cast<int>(std::min<size_t>(top_k, end - begin)), better_than_threshold);
+    thread_pool_->parallel_for(chunks.size(),
+                               [&](size_t c) { scan_range(chunks[c].first, chunks[c].second, partial[c]); });
+    for (const auto& p : partial)
+      selected.merge(p);
+    return selected;
   }
 
   /**
-   * @brief Pre-process the matrix (e.g., normalize for cosine)
+   * @brief Convert the candidates held by a selector into query results, best first.
+   *
+   * @param selector Selector holding row indices and scores (higher is better).
+   * @return std::vector<QueryResult> Query results.
    */
-  void pre_process()
+  std::vector<QueryResult> rank_results(TopK& selector) const
   {
-    NVDB_LOG("[NanoVectorDB::pre_process] matrix shape: (" << matrix_.rows() << ", " << matrix_.cols()
-                                                           << ")");
-    if (metric_ == "cosine")
+    std::vector<QueryResult> results;
+    for (const auto& [idx, score] : selector.take_sorted())
     {
-      if (matrix_.rows() > 0)
-        matrix_ = normalize_rows(matrix_);
+      results.push_back({ view_at(idx), score });
     }
+    return results;
   }
 
   /**
-   * @brief Upsert data entries into the database.
+   * @brief Check whether the live fraction has fallen below the compaction threshold.
+   */
+  bool needs_compaction() const
+  {
+    return !free_rows_.empty() && compaction_threshold_ > 0.0f &&
+           static_cast<float>(size()) < compaction_threshold_ * static_cast<float>(ids_.size());
+  }
+
+  /**
+   * @brief Row holding a record id.
+   */
+  size_t row_of(const std::string& id) const
+  {
+    const int row = id_index_.find(id, id_at());
+    if (row < 0)
+      throw std::runtime_error("Unknown id: " + id);
+    return static_cast<size_t>(row);
+  }
+
+  /**
+   * @brief Live rows matching a predicate.
+   */
+  Bitmap compile(const Predicate& where) const
+  {
+    Bitmap mask = metadata_.evaluate(where, ids_.size());
+    mask.subtract(deleted_);
+    return mask;
+  }
+
+  /**
+   * @brief Zero-copy view of one stored row.
+   */
+  DataView view_at(size_t row) const
+  {
+    DataView view;
+    view.id = ids_[row];
+    view.row = static_cast<int>(row);
+    view.dim = embedding_dim_;
+    view.type = matrix_.type();
+    if (view.type == precision::F32)
+      view.values = matrix_.row(row);
+    else
+      view.narrow = matrix_.narrow_row(row);
+    return view;
+  }
+
+  /**
+   * @brief Whether queries go through index_.
    *
-   * @param datas Eigen::VectorXf of Data entries to upsert.
+   * Indexes rank by cosine on normalized rows or by squared L2; custom metrics keep the exact scan.
    */
-  void upsert(const std::vector<Data>& datas)
+  bool index_enabled() const
   {
-    NVDB_LOG("[NanoVectorDB::upsert] datas.size()=" << datas.size());
-    std::unordered_map<std::string, Data> index_datas;
-    for (const auto& data : datas)
-    {
-      if (data.vector.size() != embedding_dim_)
-      {
-        throw std::runtime_error("Eigen::VectorXf dimension mismatch in upsert: expected " +
-                                 std::to_string(embedding_dim_) + ", got " +
-                                 std::to_string(data.vector.size()));
-      }
-      // Always use hash of vector as ID if id is empty, to match Python behavior
-      std::string id = data.id.empty() ? hash_vector(data.vector) : data.id;
-      Data entry = data;
-      entry.id = id;
-      index_datas[id] = entry;
-    }
-    if (metric_ == "cosine")
-    {
-      for (auto& [id, d] : index_datas)
-      {
-        d.vector = normalize(d.vector);
-      }
-    }
-    std::unordered_set<std::string> updated;
-    NVDB_LOG("[NanoVectorDB::upsert] data_.size() before update=" << data_.size());
-    int updated_count = 0;
-    int inserted_count = 0;
-    for (size_t i = 0; i < data_.size(); ++i)
+    return index_ && (metric_ == "cosine" || std::dynamic_pointer_cast<L2Metric>(metric_strategy_) != nullptr);
+  }
+
+  IndexSpace index_space() const
+  {
+    IndexSpace space;
+    space.vectors = row_block(0, matrix_.rows());
+    space.inner_product = metric_ == "cosine";
+    space.mapped = matrix_.borrowed();
+    return space;
+  }
+
+  std::vector<int> live_rows() const
+  {
+    std::vector<int> rows;
+    rows.reserve(size());
+    for (size_t i = 0; i < ids_.size(); ++i)
     {
-      auto it = index_datas.find(data_[i].id);
-      if (it != index_datas.end())
-      {
-        data_[i] = it->second;
-        const auto& vec = it->second.vector;
-        if (vec.size() != embedding_dim_)
-        {
-          throw std::runtime_error("[upsert] Eigen::VectorXf size mismatch before assignment");
-        }
-        matrix_.row(i) = Eigen::Map<const Eigen::RowVectorXf>(vec.data(), vec.size());
-        updated.insert(it->first);
-        ++updated_count;
-      }
+      if (!deleted_.test(i))
+        rows.push_back(static_cast<int>(i));
     }
-    for (const auto& [id, d] : index_datas)
+    return rows;
+  }
+
+  std::vector<int> all_rows() const
+  {
+    std::vector<int> rows(ids_.size());
+    std::iota(rows.begin(), rows.end(), 0);
+    return rows;
+  }
+
+  /**
+   * @brief FNV-1a hash of the ids and stored norms of rows, in order; identifies the rows of a storage
+   *        file to the index saved with it.
+   */
+  std::uint64_t rows_fingerprint(const std::vector<int>& rows) const
+  {
+    std::uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const void* data, size_t bytes) {
+      const auto* p = static_cast<const unsigned char*>(data);
+      for (size_t i = 0; i < bytes; ++i)
+        h = (h ^ p[i]) * 1099511628211ull;
+    };
+    const std::uint64_t n = rows.size();
+    mix(&n, sizeof(n));
+    for (int row : rows)
     {
-      if (updated.count(id) == 0)
-      {
-        if (d.vector.size() != embedding_dim_)
-        {
-          throw std::runtime_error("[upsert] Eigen::VectorXf size mismatch before assignment (new row)");
-        }
-        data_.push_back(d);
-        matrix_.conservativeResize(matrix_.rows() + 1, embedding_dim_);
-        matrix_.row(matrix_.rows() - 1) =
-            Eigen::Map<const Eigen::RowVectorXf>(d.vector.data(), d.vector.size());
-        ++inserted_count;
-      }
+      const std::string& id = ids_[static_cast<size_t>(row)];
+      const std::uint64_t len = id.size();
+      mix(&len, sizeof(len));
+      mix(id.data(), id.size());
+      mix(&row_sq_norms_[static_cast<size_t>(row)], sizeof(float));
     }
-    NVDB_LOG("[NanoVectorDB::upsert] summary: updated=" << updated_count << ", inserted=" << inserted_count);
+    return h;
+  }
+
+  /**
+   * @brief Save the index for `rows`, the rows of the storage file in file order; the caller holds the
+   *        read lock and save_mutex_.
+   */
+  bool write_index(const std::vector<int>& rows) const
+  {
+    auto persistent = std::dynamic_pointer_cast<IPersistentIndex>(index_);
+    if (!persistent || !index_enabled())
+      return false;
+    persistent->save(IPersistentIndex::path_for(storage_file_), rows, rows_fingerprint(rows));
+    return true;
   }
 
   /**
-   * @brief Retrieve data entries by their IDs.
+   * @brief Whether a query restricted to mask should go through index_.
    *
-   * @param ids Eigen::VectorXf of IDs to retrieve.
-   * @return std::vector<Data> Retrieved data entries.
+   * Graph and list searches visit many non-matching rows before they find top_k matches under a
+   * selective predicate, so masks with few rows are answered by an exact scan instead.
    */
-  std::vector<Data> get(const std::vector<std::string>& ids) const
+  bool use_index(const Bitmap* mask) const
   {
-    std::vector<Data> result;
-    for (const auto& d : data_)
-    {
-      if (std::find(ids.begin(), ids.end(), d.id) != ids.end())
-      {
-        result.push_back(d);
-      }
-    }
-    return result;
+    return index_enabled() && (!mask || mask->count() > kPrefilterScanRows);
+  }
+
+  std::vector<QueryResult> index_query(const Eigen::VectorXf& query, int top_k,
+                                       std::optional<float> better_than_threshold,
+                                       const std::function<bool(const DataView&)>& filter,
+                                       const Bitmap* mask = nullptr) const
+  {
+    const IndexSpace space = index_space();
+    const Eigen::VectorXf q = space.inner_product ? normalize(query) : query;
+    RowFilter allow;
+    if (mask)
+      allow = [&](int row) { return mask->test(row) && (!filter || filter(view_at(row))); };
+    else if (filter)
+      allow = [&](int row) { return filter(view_at(row)); };
+    TopK selector(top_k, better_than_threshold);
+    for (const auto& [row, score] : index_->search(q.data(), top_k, space, allow))
+      selector.push(row, score);
+    return rank_results(selector);
   }
 
   /**
-   * @brief Remove data entries by their IDs.
+   * @brief Copy a vector into a row, normalizing it in place for cosine, and refresh its cached norm.
+   *
+   * @param row Row index (must exist).
+   * @param values embedding_dim_ floats.
    */
-  void remove(const std::vector<std::string>& ids)
+  void write_row(size_t row, const float* values)
   {
-    std::unordered_set<std::string> id_set(ids.begin(), ids.end());
-    std::vector<Data> new_data;
-    std::vector<int> keep_indices;
-    for (size_t i = 0; i < data_.size(); ++i)
-    {
-      if (id_set.count(data_[i].id) == 0)
-      {
-        new_data.push_back(data_[i]);
-        keep_indices.push_back(i);
-      }
-    }
-    data_ = std::move(new_data);
-    Eigen::MatrixXf new_matrix(keep_indices.size(), embedding_dim_);
-    for (size_t i = 0; i < keep_indices.size(); ++i)
+    if (matrix_.type() != precision::F32)
     {
-      new_matrix.row(i) = matrix_.row(keep_indices[i]);
+      // Normalize in fp32 before encoding; the cached norm is that of the stored (rounded) values
+      Eigen::VectorXf v = Eigen::Map<const Eigen::VectorXf>(values, embedding_dim_);
+      if (metric_ == "cosine")
+        v /= v.norm();
+      matrix_.set_row(row, v.data());
+      row_sq_norms_[row] = stored_sq_norm(row, v.data());
+      return;
     }
-    matrix_ = std::move(new_matrix);
-    if (matrix_.rows() != static_cast<int>(data_.size()))
+    matrix_.set_row(row, values);
+    float* dst = matrix_.row(row);
+    float sq_norm = kernels::dot(dst, dst, embedding_dim_);
+    if (metric_ == "cosine")
     {
-      throw std::runtime_error("Eigen::MatrixXf row count does not match data size after remove");
+      Eigen::Map<Eigen::VectorXf>(dst, embedding_dim_) /= std::sqrt(sq_norm);
+      sq_norm = kernels::dot(dst, dst, embedding_dim_);
     }
+    row_sq_norms_[row] = sq_norm;
   }
 
   /**
-   * @brief Perform a similarity query.
+   * @brief Body of the bulk upserts; the caller holds the write lock and indexes the rows afterwards.
    *
-   * @param query Input query vector.
-   * @param top_k Number of top results to return.
-   * @param better_than_threshold Optional threshold to filter results.
-   * @param filter Optional filter function to apply on data entries.
-   * @return std::vector<QueryResult>
+   * Ids are resolved to rows first, so the row store grows once; the vectors are then written in row
+   * order, on the thread pool when the batch is large enough.
+   *
+   * @param written Receives the rows written, for index_rows().
    */
-  std::vector<QueryResult> query(const Eigen::VectorXf& query, int top_k = 10,
-                                 std::optional<float> better_than_threshold = std::nullopt,
-                                 std::function<bool(const Data&)> filter = nullptr) const
+  void upsert_rows(const float* rows, size_t n, const std::string* ids, std::vector<int>& written)
   {
-    if (query.size() != embedding_dim_)
-    {
-      throw std::runtime_error("Query vector dimension mismatch: expected " + std::to_string(embedding_dim_) +
-                               ", got " + std::to_string(query.size()));
-    }
-    // If a strategy is provided, use it for general distance-based querying
-    if (metric_strategy_)
+    const size_t dim = static_cast<size_t>(embedding_dim_);
+    if (metric_ == "cosine")
     {
-      std::vector<int> indices;
-      if (filter)
+      for (size_t s = 0; s < n; ++s)
       {
-        for (size_t i = 0; i < data_.size(); ++i)
-        {
-          if (filter(data_[i]))
-            indices.push_back(static_cast<int>(i));
-        }
+        if (kernels::dot(rows + s * dim, rows + s * dim, embedding_dim_) == 0.0f)
+          throw std::runtime_error("Cannot normalize zero-norm vector");
       }
-      else
+    }
+    if (metric_ != "cosine")
+      rows_normalized_ = false;
+    // Growing the store also copies borrowed (mapped) rows out before the parallel writes
+    const size_t grown = ids_.size() + n;
+    ids_.reserve(grown);
+    matrix_.reserve(grown);
+    row_sq_norms_.reserve(grown);
+    id_index_.reserve(grown);
+
+    std::vector<std::pair<int, size_t>> targets;  // (row, source row)
+    targets.reserve(n);
+    std::string hashed;
+    for (size_t s = 0; s < n; ++s)
+    {
+      const bool has_id = ids && !ids[s].empty();
+      if (!has_id)
+        hashed = hash_vector(rows + s * dim, embedding_dim_);
+      const std::string& id = has_id ? ids[s] : hashed;
+      int i = id_index_.find(id, id_at());
+      if (i >= 0)
       {
-        indices.resize(data_.size());
-        std::iota(indices.begin(), indices.end(), 0);
+        if (index_enabled())
+          index_->remove(i, index_space());
       }
-      std::vector<std::pair<int, float>> scored;  // store index and score (higher is better)
-      const bool is_cosine = (std::dynamic_pointer_cast<CosineMetric>(metric_strategy_) != nullptr);
-      for (int idx : indices)
+      else if (!free_rows_.empty())
       {
-        const Eigen::VectorXf& v = data_[idx].vector;
-        float dist = metric_strategy_->distance(query, v);
-        float score = is_cosine ? (1.0f - dist) : (-dist);
-        scored.emplace_back(idx, score);
+        i = free_rows_.back();
+        free_rows_.pop_back();
+        deleted_.reset(i);
+        ids_[i] = id;
+        id_index_.insert(id, i, id_at());
       }
-      std::sort(scored.begin(), scored.end(), [](auto& a, auto& b) { return a.second > b.second; });
-      std::vector<QueryResult> results;
-      for (int i = 0; i < std::min(top_k, (int)scored.size()); ++i)
+      else
       {
-        float score = scored[i].second;
-        if (better_than_threshold && score < *better_than_threshold)
-          break;
-        results.push_back({ data_[scored[i].first], score });
+        i = static_cast<int>(ids_.size());
+        ids_.push_back(id);
+        id_index_.insert(id, i, id_at());
       }
-      return results;
+      track_upsert(id);
+      targets.emplace_back(i, s);
     }
-    if (metric_ == "cosine")
+    matrix_.resize(ids_.size());
+    row_sq_norms_.resize(ids_.size());
+    deleted_.resize(ids_.size());
+
+    // Keep the last source of each row (later duplicates of an id win) and write in row order
+    std::stable_sort(targets.begin(), targets.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    size_t unique = 0;
+    for (size_t k = 0; k < targets.size(); ++k)
     {
-      return cosine_query(query, top_k, better_than_threshold, filter);
+      if (k + 1 < targets.size() && targets[k + 1].first == targets[k].first)
+        continue;
+      targets[unique++] = targets[k];
     }
-    return {};
+    targets.resize(unique);
+    const auto write_range = [&](size_t begin, size_t end) {
+      for (size_t k = begin; k < end; ++k)
+        write_row(static_cast<size_t>(targets[k].first), rows + targets[k].second * dim);
+    };
+    const auto chunks = scan_chunks(targets.size());
+    if (chunks.size() > 1)
+      thread_pool_->parallel_for(chunks.size(),
+                                 [&](size_t c) { write_range(chunks[c].first, chunks[c].second); });
+    else
+      write_range(0, targets.size());
+    for (const auto& target : targets)
+      written.push_back(target.first);
   }
 
   /**
-   * @brief Get the number of data entries in the database.
+   * @brief Index rows written by upsert_rows().
    *
-   * @return int Number of data entries.
+   * A load that at least doubles the live rows rebuilds the index in one pass (IVF retrains its
+   * centroids on the new data); smaller ones add the rows one at a time.
+   *
+   * @param live_before Live rows before the load.
    */
-  int size() const
+  void index_rows(const std::vector<int>& rows, size_t live_before)
   {
-    return data_.size();
+    if (!index_enabled() || rows.empty())
+      return;
+    if (rows.size() >= live_before)
+    {
+      rebuild_index();
+      return;
+    }
+    const IndexSpace space = index_space();
+    for (int row : rows)
+      index_->add(row, space);
   }
 
   /**
-   * @brief Save the database to a JSON file.
-   *
+   * @brief Key accessor handing the id index the id stored at a row.
    */
-  void save() const
+  struct IdAt
   {
-    if (storage_strategy_) {
-      if (auto rs = std::dynamic_pointer_cast<IStorageRecords>(storage_strategy_))
-      {
-        rs->write_records(storage_file_, data_, embedding_dim_, additional_data_);
-        return;
-      }
-    }
-    nlohmann::json storage;
-    std::string dumped;
-    storage["embedding_dim"] = embedding_dim_;
-    storage["matrix"] = array_to_buffer_string(matrix_);
-    std::vector<nlohmann::json> data_json;
-    for (const auto& d : data_)
-    {
-      nlohmann::json entry;
-      entry["id"] = d.id;
-      data_json.push_back(entry);
-    }
-    storage["data"] = data_json;
-    if (!additional_data_.is_null())
-    {
-      storage["additional_data"] = additional_data_;
-    }
-    dumped = storage.dump();
-    if (storage_strategy_)
-    {
-      std::vector<uint8_t> bytes(dumped.begin(), dumped.end());
-      storage_strategy_->write(storage_file_, bytes);
-    }
-    else
+    const NanoVectorDB* db;
+    const std::string& operator()(int row) const
     {
-      std::ofstream f(storage_file_);
-      if (!f.is_open())
-      {
-        throw std::runtime_error("Failed to open storage file for saving: " + storage_file_);
-      }
-      f << dumped;
+      return db->ids_[row];
     }
+  };
+
+  IdAt id_at() const
+  {
+    return IdAt{ this };
   }
 
   /**
-   * @brief Get additional stored data.
-   *
-   * @return nlohmann::json Additional data.
+   * @brief View of matrix_ rows [start, start + len) with their cached squared norms.
    */
-  nlohmann::json get_additional_data() const
+  RowBlock row_block(size_t start, size_t len) const
   {
-    return additional_data_;
+    RowBlock block;
+    block.type = matrix_.type();
+    if (block.type == precision::F32)
+      block.data = matrix_.row(start);
+    else
+      block.narrow = matrix_.narrow_row(start);
+    block.rows = len;
+    block.stride = matrix_.stride();
+    block.dim = static_cast<size_t>(embedding_dim_);
+    block.sq_norms = row_sq_norms_.data() + start;
+    return block;
   }
 
   /**
-   * @brief Store additional data.
-   *
-   * @param data Additional data to store.
+   * @brief Decode rows [start, start + len) of a narrow store into an fp32 tile.
    */
-  void store_additional_data(const nlohmann::json& data)
+  void decode_block(size_t start, size_t len, RowMatrixXf& tile) const
   {
-    additional_data_ = data;
+    tile.resize(static_cast<Eigen::Index>(len), embedding_dim_);
+    for (size_t r = 0; r < len; ++r)
+      matrix_.decode_row(start + r, tile.row(static_cast<Eigen::Index>(r)).data());
   }
 
   /**
-   * @brief Initialize metric strategy
-   * @param metric_strategy Metric strategy See enum in metric/base.hpp
+   * @brief Run the metric strategy over rows [start, start + len).
+   *
+   * CosineMetric and L2Metric score F16 / BF16 rows in place; other metrics receive the rows decoded
+   * to fp32, so custom distances() overrides only ever see F32 blocks.
    */
-  void initialize_metric(::nano_vectordb::metric type)
+  void block_distances(const Eigen::VectorXf& query, size_t start, size_t len, float* out) const
   {
-    metric_strategy_ = ::nano_vectordb::make(type);
-
-    // Keep legacy string in sync for preprocessing
-    switch (type)
+    RowBlock block = row_block(start, len);
+    if (block.type == precision::F32 || std::dynamic_pointer_cast<CosineMetric>(metric_strategy_) ||
+        std::dynamic_pointer_cast<L2Metric>(metric_strategy_))
     {
-      case ::nano_vectordb::metric::Cosine:
-        metric_ = "cosine";
-        break;
-      case ::nano_vectordb::metric::L2:
-        metric_ = "l2";
-        break;
+      metric_strategy_->distances(query, block, out);
+      return;
     }
-    pre_process();
+    thread_local RowMatrixXf tile;
+    decode_block(start, len, tile);
+    block.data = tile.data();
+    block.stride = static_cast<size_t>(embedding_dim_);
+    block.narrow = nullptr;
+    block.type = precision::F32;
+    metric_strategy_->distances(query, block, out);
   }
 
-  // Overload: initialize metric with a strategy instance
-  void initialize_metric(const std::shared_ptr<IMetric>& strategy)
+  /**
+   * @brief Squared norm of a narrow row, decoded into scratch (embedding_dim_ floats).
+   */
+  float stored_sq_norm(size_t row, float* scratch) const
   {
-    metric_strategy_ = strategy;
-    if (std::dynamic_pointer_cast<CosineMetric>(strategy))
-      metric_ = "cosine";
-    else
-      metric_ = "l2";
-    pre_process();
+    matrix_.decode_row(row, scratch);
+    return kernels::dot(scratch, scratch, embedding_dim_);
   }
 
   /**
-   * @brief Initialize serializer strategy
-   * @param serializer_strategy Serializer strategy. See enum in serializer/base.hpp
+   * @brief Recompute the cached squared norm of every row, in parallel row ranges.
    */
-  // Serializer support removed; JSON persistence handled internally.
+  void refresh_row_norms()
+  {
+    row_sq_norms_.resize(matrix_.rows());
+    const RowStore& rows = matrix_;  // read through the const accessors: borrowed rows stay borrowed
+    parallel_rows(rows.rows(), [&](size_t begin, size_t end) {
+      if (rows.type() != precision::F32)
+      {
+        Eigen::VectorXf v(embedding_dim_);
+        for (size_t i = begin; i < end; ++i)
+          row_sq_norms_[i] = stored_sq_norm(i, v.data());
+        return;
+      }
+      for (size_t i = begin; i < end; ++i)
+        row_sq_norms_[i] = kernels::dot(rows.row(i), rows.row(i), embedding_dim_);
+    });
+  }
+
   /**
-   * @brief Initialize storage strategy
-   * @param storage_strategy Storage strategy. See enum in storage/base.hpp
+   * @brief Scale every stored row to unit length, in parallel row ranges.
    */
-  void initialize_storage(::nano_vectordb::storage type, const std::string& path)
+  void normalize_stored_rows()
   {
-    storage_strategy_ = ::nano_vectordb::make(type);
-    storage_file_ = path;
+    matrix_.make_owned();  // copy borrowed rows once, before the threads write
+    const bool f32 = matrix_.type() == precision::F32;
+    parallel_rows(matrix_.rows(), [&](size_t begin, size_t end) {
+      // Narrow rows are normalized in fp32 and re-encoded
+      Eigen::VectorXf scratch(f32 ? 0 : embedding_dim_);
+      for (size_t i = begin; i < end; ++i)
+      {
+        float* v = f32 ? matrix_.row(i) : scratch.data();
+        if (!f32)
+          matrix_.decode_row(i, v);
+        const float n = std::sqrt(kernels::dot(v, v, embedding_dim_));
+        if (n == 0)
+        {
+          throw std::runtime_error("Cannot normalize zero-norm row in matrix at row " + std::to_string(i));
+        }
+        Eigen::Map<Eigen::VectorXf>(v, embedding_dim_) /= n;
+        if (!f32)
+          matrix_.set_row(i, v);
+      }
+    });
   }
 
-  // Overload: initialize storage with a strategy instance, keep current storage_file_
-  void initialize_storage(const std::shared_ptr<IStorage>& strategy)
+  /**
+   * @brief Take over rows just read from storage, with what the storage recorded about them.
+   *
+   * @param normalized Whether the stored rows are unit length; a cosine database then keeps them as is.
+   * @param sq_norms Stored squared norm of each row, or empty to compute them.
+   */
+  void adopt_rows(bool normalized, std::vector<float> sq_norms)
   {
-    storage_strategy_ = strategy;
+    rows_normalized_ = normalized;
+    row_sq_norms_ = std::move(sq_norms);
+    if (row_sq_norms_.size() != matrix_.rows())
+      row_sq_norms_.clear();
+    pre_process();
   }
 
-private:
   /**
-   * @brief Perform a cosine similarity query.
+   * @brief Run fn(begin, end) over row ranges covering [0, n), in parallel when the work is large.
    *
-   * @param query Input query vector.
-   * @param top_k Number of top results to return.
-   * @param better_than_threshold Optional threshold to filter results.
-   * @param filter Optional filter function to apply on data entries.
-   * @return std::vector<QueryResult> Query results.
+   * Uses the scan pool when one is set. Without one, e.g. while the constructor loads the storage
+   * file, large jobs run on short-lived threads, one per core.
    */
-  std::vector<QueryResult> cosine_query(const Eigen::VectorXf& query, int top_k,
-                                        std::optional<float> better_than_threshold,
-                                        std::function<bool(const Data&)> filter) const
+  void parallel_rows(size_t n, const std::function<void(size_t, size_t)>& fn) const
   {
-    Eigen::VectorXf q = normalize(query);
-    std::vector<int> indices;
-    if (filter)
-    {
-      for (size_t i = 0; i < data_.size(); ++i)
-      {
-        if (filter(data_[i]))
-          indices.push_back(i);
-      }
-    }
-    else
+    const size_t by_size = n * static_cast<size_t>(embedding_dim_) / kParallelRowFloats;
+    const size_t threads = thread_pool_ ? thread_pool_->size() + 1
+                                        : std::max<size_t>(1, std::thread::hardware_concurrency());
+    const size_t parts = std::min(threads, by_size);
+    if (parts <= 1)
     {
-      indices.resize(data_.size());
-      std::iota(indices.begin(), indices.end(), 0);
+      if (n > 0)
+        fn(0, n);
+      return;
     }
-    std::vector<std::pair<int, float>> scored;
-    for (int idx : indices)
+    const size_t per_part = (n + parts - 1) / parts;
+    const auto part = [&](size_t p) {
+      const size_t begin = p * per_part;
+      if (begin < n)
+        fn(begin, std::min(n, begin + per_part));
+    };
+    if (thread_pool_)
     {
-      float score = matrix_.row(idx).dot(q);
-      scored.emplace_back(idx, score);
+      thread_pool_->parallel_for(parts, part);
+      return;
     }
-    std::sort(scored.begin(), scored.end(), [](auto& a, auto& b) { return a.second > b.second; });
-    std::vector<QueryResult> results;
-    for (int i = 0; i < std::min(top_k, (int)scored.size()); ++i)
-    {
-      if (better_than_threshold && scored[i].second < *better_than_threshold)
-        break;
-      results.push_back({ data_[scored[i].first], scored[i].second });
-    }
-    return results;
+    ThreadPool pool(parts - 1);
+    pool.parallel_for(parts, part);
   }
 
+  // Rows scored per metric kernel call in query()
+  static constexpr size_t kScanBlockRows = 1024;
+  // Bytes of stored vectors scored per tile in query_batch (sized to stay resident in L2)
+  static constexpr size_t kBatchTileBytes = 256 * 1024;
+  // Predicates matching at most this many rows skip the index and scan their matches exactly
+  static constexpr size_t kPrefilterScanRows = 2048;
+  // Changed records tracked for an incremental save before falling back to a full rewrite (at least)
+  static constexpr size_t kMinTrackedChanges = 1024;
+  // Stored floats per thread below which load-time row passes stay on one thread
+  static constexpr size_t kParallelRowFloats = size_t(1) << 18;
+
   int embedding_dim_;
   std::string metric_;
   std::string storage_file_;
-  std::vector<Data> data_;
-  Eigen::MatrixXf matrix_;
+  std::vector<std::string> ids_;  // record id of each row of matrix_
+  RowStore matrix_;
+  std::vector<float> row_sq_norms_;  // squared L2 norm of each row of matrix_
+  bool rows_normalized_ = true;      // every row of matrix_ is unit length; see pre_process()
+  IdIndex id_index_;                 // id -> row, keyed on the ids held in ids_
+  Bitmap deleted_;                   // tombstoned rows, skipped by scans
+  std::vector<int> free_rows_;       // tombstoned rows available for reuse by upsert
+  MetadataStore metadata_;           // typed filter columns, indexed by row
+
+  mutable RWMutex mutex_;           // shared by readers, exclusive while the database changes
+  mutable std::mutex write_mutex_;   // serializes writers; see WriteGuard
+  mutable std::mutex save_mutex_;    // serializes save() and checkpoint()
+  mutable std::uint64_t version_ = 0;  // bumped each time a writer releases the exclusive lock
+  // memory_usage() result and the version it was measured at
+  mutable std::mutex usage_mutex_;
+  mutable std::uint64_t usage_version_ = ~std::uint64_t(0);
+  mutable MemoryUsage usage_{};
+  std::shared_ptr<Metrics> metrics_;  // null while loading and when recording is off
+  std::unique_ptr<QueryCache> query_cache_;  // query() results of the current version_; null when off
+  // Changes since the last save or load; mutable because save() only brings the storage up to date
+  // Cleared by save paths under a shared lock; tracking_mutex_ orders that against the readers
+  mutable std::mutex tracking_mutex_;
+  mutable std::unordered_set<std::string> dirty_ids_;    // upserted, or metadata changed
+  mutable std::unordered_set<std::string> removed_ids_;  // removed and not upserted again
+  mutable bool full_save_ = true;          // storage does not hold the state the changes apply to
+  mutable bool metadata_dirty_ = false;
+  mutable bool additional_dirty_ = false;
+  mutable std::uint64_t wal_bytes_ = 0;    // size of the write-ahead log
+  mutable std::uint64_t checkpoint_generation_ = 0;  // stored in the storage file; see WriteAheadLog
+  WalOptions wal_options_{};
+  float compaction_threshold_ = 0.5f;
   nlohmann::json additional_data_ = nlohmann::json::object();
 
   // Strategy pointers (optional)
   std::shared_ptr<IMetric> metric_strategy_{};
   // Serializer removed
   std::shared_ptr<IStorage> storage_strategy_{};
+  std::shared_ptr<IIndex> index_{};
+
+  // Parallel scan configuration; no pool means queries run on the calling thread
+  ScanOptions scan_options_{};
+  std::shared_ptr<ThreadPool> thread_pool_{};
 };
 
 }  // namespace nano_vectordb
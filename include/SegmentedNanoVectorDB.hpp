@@ -0,0 +1,782 @@
+#pragma once
+#include "NanoVectorDB.hpp"
+#include "fan_out.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Segment layout and merge policy of a SegmentedNanoVectorDB
+ */
+struct SegmentOptions
+{
+  std::size_t seal_rows = 65536;   // write segment size at which it is sealed
+  std::size_t merge_factor = 4;    // sealed segments of one size tier merged into one
+  float max_dead_fraction = 0.5f;  // a sealed segment with this fraction of its rows removed is rewritten
+  ::nano_vectordb::index index_type = ::nano_vectordb::index::Flat;  // index built for each sealed segment
+  int threads = 0;                 // threads searching segments, including the caller; 0 = hardware threads
+  bool background = true;          // seal and merge on a background thread; false runs them in the writer
+};
+
+/**
+ * @brief One segment of a SegmentedNanoVectorDB; see SegmentedNanoVectorDB::segments().
+ */
+struct SegmentInfo
+{
+  std::string name;            // file name in the collection directory
+  std::size_t rows = 0;        // live rows
+  std::size_t tombstones = 0;  // removed rows still stored
+  bool sealed = false;         // immutable and memory-mapped; false for write segments
+  bool busy = false;           // being sealed or merged
+};
+
+/**
+ * @brief One hit of SegmentedNanoVectorDB::query(); an owned copy, valid after the collection changes.
+ */
+struct SegmentQueryResult
+{
+  std::string id;
+  float score;
+};
+
+/**
+ * @brief Collection split into a small mutable write segment and immutable sealed segments.
+ *
+ * Upserts go to the write segment, a NanoVectorDB saved as JSON with a write-ahead log. Once it holds
+ * SegmentOptions::seal_rows rows it is frozen, a new write segment takes over, and a background task
+ * writes the frozen rows to an MMap file and maps it back read-only as a sealed segment with its own
+ * index. Sealed segments never change rows: removing or upserting one of their records tombstones it
+ * there (saved in the segment's own log), and the new copy lives in the write segment. A tiered merge
+ * policy combines merge_factor sealed segments of similar size into one, and rewrites a segment alone
+ * once max_dead_fraction of it is removed.
+ *
+ * Queries search every segment as its own task and merge the hits with fan_out_top_k(). save() only
+ * writes the segments that changed, then the manifest (`manifest.json`) that lists the segments; the
+ * manifest is replaced atomically. A finished seal or merge does the same, so the saved segments always
+ * hold the new copy of a record whose old copy the manifest drops. All methods may be called from
+ * several threads at once.
+ */
+class SegmentedNanoVectorDB
+{
+public:
+  /**
+   * @param embedding_dim Dimension of the embedding vectors.
+   * @param type Similarity metric.
+   * @param dir Directory holding the segment files and the manifest; created if missing.
+   * @param options Segment sizes, merge policy, sealed segment index and query threads.
+   */
+  SegmentedNanoVectorDB(int embedding_dim, ::nano_vectordb::metric type = ::nano_vectordb::metric::Cosine,
+                        const std::string& dir = "./nano_segmented_storage",
+                        const SegmentOptions& options = SegmentOptions{})
+    : embedding_dim_(embedding_dim), metric_type_(type), dir_(dir), options_(options)
+  {
+    if (embedding_dim_ <= 0)
+    {
+      throw std::runtime_error("Embedding dimension must be positive");
+    }
+    if (dir_.empty())
+    {
+      throw std::runtime_error("Storage directory must not be empty");
+    }
+    if (options_.seal_rows == 0 || options_.merge_factor < 2)
+    {
+      throw std::runtime_error("SegmentOptions: seal_rows must be positive and merge_factor at least 2");
+    }
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    const int threads = options_.threads > 0 ? options_.threads : static_cast<int>(hardware);
+    if (threads > 1)
+      pool_ = std::make_shared<ThreadPool>(static_cast<std::size_t>(threads - 1));
+    const auto start = Metrics::clock::now();
+    std::filesystem::create_directories(dir_);
+    open();
+    metrics_->record(operation::Load, start);
+    if (options_.background)
+      background_ = std::make_unique<ThreadPool>(1);
+    // Segments frozen before a crash are sealed now
+    maintain();
+  }
+
+  SegmentedNanoVectorDB(const SegmentedNanoVectorDB&) = delete;
+  SegmentedNanoVectorDB& operator=(const SegmentedNanoVectorDB&) = delete;
+
+  /**
+   * @brief Finish background seals and merges; other unsaved changes are not written.
+   */
+  ~SegmentedNanoVectorDB()
+  {
+    wait_for_background();
+  }
+
+  /**
+   * @brief Upsert records; older copies in other segments are removed.
+   */
+  void upsert(const std::vector<Data>& datas)
+  {
+    const auto start = Metrics::clock::now();
+    std::vector<std::string> ids;
+    ids.reserve(datas.size());
+    for (const auto& data : datas)
+    {
+      check_row(data.vector.data(), data.vector.size());
+      ids.push_back(data.id.empty() ? hash_vector(data.vector) : data.id);
+    }
+    {
+      std::unique_lock<RWMutex> write(mutex_);
+      drop_from_segments(ids);
+      write_->db->upsert(datas);
+      rotate_if_full();
+    }
+    metrics_->record(operation::Upsert, start);
+    metrics_->add(counter::RowsUpserted, datas.size());
+    maintain();
+  }
+
+  /**
+   * @brief Upsert n vectors stored contiguously; see NanoVectorDB::upsert(const float*, size_t, ...).
+   */
+  void upsert(const float* rows, size_t n, const std::string* ids = nullptr)
+  {
+    const auto start = Metrics::clock::now();
+    std::vector<std::string> resolved(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      const float* row = rows + i * static_cast<size_t>(embedding_dim_);
+      check_row(row, embedding_dim_);
+      resolved[i] = ids && !ids[i].empty() ? ids[i] : hash_vector(row, embedding_dim_);
+    }
+    {
+      std::unique_lock<RWMutex> write(mutex_);
+      drop_from_segments(resolved);
+      write_->db->upsert(rows, n, resolved.data());
+      rotate_if_full();
+    }
+    metrics_->record(operation::Upsert, start);
+    metrics_->add(counter::RowsUpserted, n);
+    maintain();
+  }
+
+  /**
+   * @brief Remove records by id from whichever segment holds them; unknown ids are skipped.
+   */
+  void remove(const std::vector<std::string>& ids)
+  {
+    const auto start = Metrics::clock::now();
+    size_t removed = 0;
+    {
+      std::unique_lock<RWMutex> write(mutex_);
+      const size_t before = write_->db->size();
+      write_->db->remove(ids);
+      removed = before - static_cast<size_t>(write_->db->size()) + drop_from_segments(ids);
+    }
+    metrics_->record(operation::Remove, start);
+    metrics_->add(counter::RowsRemoved, removed);
+    maintain();
+  }
+
+  /**
+   * @brief Retrieve records by id, in the order of `ids`; unknown ids are skipped.
+   */
+  std::vector<Data> get(const std::vector<std::string>& ids) const
+  {
+    std::unordered_map<std::string, Data> found;
+    {
+      std::shared_lock<RWMutex> read(mutex_);
+      for (const auto& segment : all_segments())
+      {
+        for (auto& data : segment->db->get(ids))
+          found.emplace(data.id, std::move(data));
+      }
+    }
+    std::vector<Data> out;
+    out.reserve(found.size());
+    for (const auto& id : ids)
+    {
+      auto it = found.find(id);
+      if (it != found.end())
+        out.push_back(it->second);
+    }
+    return out;
+  }
+
+  /**
+   * @brief Search every segment and return the top-k over all of them.
+   *
+   * Segments are searched in parallel on the collection's pool. Writers wait until the query finished,
+   * so it sees every record exactly once.
+   *
+   * @param query Input query vector.
+   * @param top_k Number of results to return.
+   * @param better_than_threshold Optional threshold to filter results.
+   * @param filter Optional filter on the stored records; called concurrently from the pool threads.
+   * @return std::vector<SegmentQueryResult> Best first.
+   */
+  std::vector<SegmentQueryResult> query(const Eigen::VectorXf& query, int top_k = 10,
+                                        std::optional<float> better_than_threshold = std::nullopt,
+                                        std::function<bool(const DataView&)> filter = nullptr) const
+  {
+    const auto start = Metrics::clock::now();
+    std::shared_lock<RWMutex> read(mutex_);
+    const std::vector<std::shared_ptr<Segment>> segments = all_segments();
+    // Largest segments first, so the longest scans start earliest and raise the shared bound
+    std::vector<std::size_t> schedule(segments.size());
+    std::vector<int> sizes(segments.size());
+    for (std::size_t i = 0; i < segments.size(); ++i)
+    {
+      schedule[i] = i;
+      sizes[i] = segments[i]->db->size();
+    }
+    std::stable_sort(schedule.begin(), schedule.end(),
+                     [&](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+    auto out = fan_out_top_k<SegmentQueryResult>(
+      pool_.get(), schedule, segments.size(), top_k, better_than_threshold,
+      [&](std::size_t i, std::optional<float> bound) {
+        const NanoVectorDB& db = *segments[i]->db;
+        NanoVectorDB::ReadGuard guard(db);
+        const auto results = db.query(query, top_k, bound, filter);
+        std::vector<SegmentQueryResult> hits;
+        hits.reserve(results.size());
+        for (const auto& r : results)
+          hits.push_back({ std::string(r.data.id), r.score });
+        return hits;
+      });
+    metrics_->record(operation::Query, start);
+    return out;
+  }
+
+  /**
+   * @brief Number of live records over all segments.
+   */
+  int size() const
+  {
+    std::shared_lock<RWMutex> read(mutex_);
+    int total = 0;
+    for (const auto& segment : all_segments())
+      total += segment->db->size();
+    return total;
+  }
+
+  /**
+   * @brief Write the segments that changed since the last save, then the manifest.
+   *
+   * Write segments append to their write-ahead logs and sealed segments only log their tombstones, so
+   * the cost follows the changes rather than the collection size.
+   */
+  void save()
+  {
+    const auto start = Metrics::clock::now();
+    std::lock_guard<std::mutex> saving(save_mutex_);
+    save_segments();
+    write_manifest();
+    metrics_->record(operation::Save, start);
+  }
+
+  /**
+   * @brief Block until every queued seal and merge has finished.
+   */
+  void wait_for_background()
+  {
+    std::unique_lock<std::mutex> lock(background_mutex_);
+    background_idle_.wait(lock, [this] { return background_pending_ == 0; });
+  }
+
+  /**
+   * @brief The write segment first, then the other segments oldest first.
+   */
+  std::vector<SegmentInfo> segments() const
+  {
+    std::shared_lock<RWMutex> read(mutex_);
+    std::vector<SegmentInfo> out;
+    for (const auto& segment : all_segments())
+      out.push_back({ segment->name, static_cast<std::size_t>(segment->db->size()),
+                      segment->db->tombstones(), segment->sealed, segment->busy });
+    return out;
+  }
+
+  /**
+   * @brief Heap memory of all segments; rows of sealed segments are counted as `mapped`.
+   */
+  MemoryUsage memory_usage() const
+  {
+    std::shared_lock<RWMutex> read(mutex_);
+    MemoryUsage total;
+    for (const auto& segment : all_segments())
+    {
+      const MemoryUsage usage = segment->db->memory_usage();
+      total.vectors += usage.vectors;
+      total.ids += usage.ids;
+      total.metadata += usage.metadata;
+      total.index += usage.index;
+      total.other += usage.other;
+      total.mapped += usage.mapped;
+    }
+    return total;
+  }
+
+  /**
+   * @brief Latencies of collection-level upsert, remove, query, save and load, and the row counters.
+   */
+  MetricsSnapshot stats() const
+  {
+    return metrics_->snapshot();
+  }
+
+private:
+  struct Segment
+  {
+    std::string name;  // file in dir_
+    std::shared_ptr<NanoVectorDB> db;
+    bool sealed = false;
+    bool busy = false;                  // input of a seal or merge in progress
+    std::vector<std::string> removed;  // ids removed while busy, replayed on the rebuilt segment
+  };
+
+  std::string path_for(const std::string& name) const
+  {
+    return dir_ + "/" + name;
+  }
+
+  const char* metric_name() const
+  {
+    return metric_type_ == ::nano_vectordb::metric::Cosine ? "cosine" : "l2";
+  }
+
+  std::string next_name(bool sealed)
+  {
+    return "seg-" + std::to_string(next_segment_++) + (sealed ? ".nvdb" : ".json");
+  }
+
+  std::shared_ptr<NanoVectorDB> open_segment(const std::string& name, bool sealed) const
+  {
+    auto storage =
+      ::nano_vectordb::make(sealed ? ::nano_vectordb::storage::MMap : ::nano_vectordb::storage::File);
+    // Collection-level operations are recorded instead of the per-segment ones
+    auto db = std::make_shared<NanoVectorDB>(embedding_dim_, metric_name(), path_for(name),
+                                             ::nano_vectordb::make(metric_type_), std::move(storage),
+                                             nullptr);
+    // Saves append to the segment's log: new rows for the write segment, tombstones for sealed ones
+    WalOptions wal = db->wal_options();
+    wal.enabled = true;
+    db->set_wal_options(wal);
+    if (sealed)
+    {
+      // Tombstones stay until a merge, so the rows are never copied out of the mapping
+      db->set_compaction_threshold(0.0f);
+      if (options_.index_type != ::nano_vectordb::index::Flat)
+        db->initialize_index(options_.index_type);
+    }
+    return db;
+  }
+
+  /**
+   * @brief Load the segments listed in the manifest and delete segment files it does not list.
+   */
+  void open()
+  {
+    const std::string manifest = path_for(kManifest);
+    std::vector<std::string> keep;
+    if (std::filesystem::exists(manifest))
+    {
+      std::ifstream in(manifest, std::ios::binary);
+      const nlohmann::json j = nlohmann::json::parse(in);
+      if (j.at("embedding_dim").get<int>() != embedding_dim_)
+      {
+        throw std::runtime_error("SegmentedNanoVectorDB: manifest dimension mismatch in " + manifest);
+      }
+      next_segment_ = j.at("next_segment").get<std::uint64_t>();
+      for (const auto& entry : j.at("segments"))
+      {
+        auto segment = std::make_shared<Segment>();
+        segment->name = entry.at("name").get<std::string>();
+        segment->sealed = entry.at("sealed").get<bool>();
+        segment->db = open_segment(segment->name, segment->sealed);
+        segments_.push_back(segment);
+        keep.push_back(segment->name);
+      }
+      write_ = std::make_shared<Segment>();
+      write_->name = j.at("write").get<std::string>();
+      write_->db = open_segment(write_->name, false);
+      keep.push_back(write_->name);
+    }
+    else
+    {
+      write_ = std::make_shared<Segment>();
+      write_->name = next_name(false);
+      write_->db = open_segment(write_->name, false);
+    }
+    // Left behind by a seal or merge that did not finish
+    for (const auto& entry : std::filesystem::directory_iterator(dir_))
+    {
+      const std::string file = entry.path().filename().string();
+      if (file.rfind("seg-", 0) != 0)
+        continue;
+      const bool listed = std::any_of(keep.begin(), keep.end(), [&](const std::string& name) {
+        return file == name || file == WriteAheadLog::path_for(name) || file == name + ".tmp" ||
+               file == IPersistentIndex::path_for(name);
+      });
+      if (!listed)
+        std::filesystem::remove(entry.path());
+    }
+  }
+
+  void check_row(const float* row, Eigen::Index dim) const
+  {
+    if (dim != embedding_dim_)
+    {
+      throw std::runtime_error("Eigen::VectorXf dimension mismatch in upsert: expected " +
+                               std::to_string(embedding_dim_) + ", got " + std::to_string(dim));
+    }
+    // Checked before older copies are removed, so a rejected batch changes nothing
+    if (metric_type_ == ::nano_vectordb::metric::Cosine &&
+        Eigen::Map<const Eigen::VectorXf>(row, embedding_dim_).squaredNorm() == 0.0f)
+    {
+      throw std::runtime_error("Cannot normalize zero-norm vector");
+    }
+  }
+
+  /**
+   * @brief The write segment followed by every other segment; the caller holds mutex_.
+   */
+  std::vector<std::shared_ptr<Segment>> all_segments() const
+  {
+    std::vector<std::shared_ptr<Segment>> out;
+    out.reserve(segments_.size() + 1);
+    out.push_back(write_);
+    out.insert(out.end(), segments_.begin(), segments_.end());
+    return out;
+  }
+
+  /**
+   * @brief Remove ids from every segment except the write segment; the caller holds mutex_ exclusively.
+   *
+   * @return size_t Number of records removed.
+   */
+  size_t drop_from_segments(const std::vector<std::string>& ids)
+  {
+    size_t removed = 0;
+    for (const auto& segment : segments_)
+    {
+      std::vector<std::string> present;
+      for (const auto& view : segment->db->get_views(ids))
+        present.emplace_back(view.id);
+      if (present.empty())
+        continue;
+      segment->db->remove(present);
+      removed += present.size();
+      if (segment->busy)
+        segment->removed.insert(segment->removed.end(), present.begin(), present.end());
+    }
+    return removed;
+  }
+
+  /**
+   * @brief Freeze a full write segment and start a new one; the caller holds mutex_ exclusively.
+   */
+  void rotate_if_full()
+  {
+    if (static_cast<size_t>(write_->db->size()) < options_.seal_rows)
+      return;
+    segments_.push_back(write_);
+    write_ = std::make_shared<Segment>();
+    write_->name = next_name(false);
+    write_->db = open_segment(write_->name, false);
+  }
+
+  static std::size_t tier(std::size_t rows, const SegmentOptions& options)
+  {
+    std::size_t t = 0;
+    std::size_t bound = options.seal_rows * options.merge_factor;
+    for (; rows >= bound; bound *= options.merge_factor)
+      ++t;
+    return t;
+  }
+
+  /**
+   * @brief Claim the next seal or merge and mark its inputs busy; empty when there is nothing to do.
+   *
+   * Frozen write segments are sealed first. Then a sealed segment with too many tombstones is rewritten
+   * alone, and otherwise the oldest merge_factor sealed segments of one size tier are merged.
+   */
+  std::vector<std::shared_ptr<Segment>> claim_work()
+  {
+    std::unique_lock<RWMutex> write(mutex_);
+    std::vector<std::shared_ptr<Segment>> inputs;
+    for (const auto& segment : segments_)
+    {
+      if (!segment->sealed && !segment->busy)
+      {
+        inputs.push_back(segment);
+        break;
+      }
+    }
+    if (inputs.empty())
+    {
+      for (const auto& segment : segments_)
+      {
+        const std::size_t dead = segment->db->tombstones();
+        const std::size_t stored = dead + static_cast<std::size_t>(segment->db->size());
+        if (segment->sealed && !segment->busy && dead > 0 &&
+            static_cast<float>(dead) >= options_.max_dead_fraction * static_cast<float>(stored))
+        {
+          inputs.push_back(segment);
+          break;
+        }
+      }
+    }
+    if (inputs.empty())
+    {
+      std::unordered_map<std::size_t, std::vector<std::shared_ptr<Segment>>> tiers;
+      for (const auto& segment : segments_)
+      {
+        if (!segment->sealed || segment->busy)
+          continue;
+        auto& members = tiers[tier(static_cast<std::size_t>(segment->db->size()), options_)];
+        members.push_back(segment);
+        if (members.size() == options_.merge_factor)
+        {
+          inputs = members;
+          break;
+        }
+      }
+    }
+    for (const auto& segment : inputs)
+      segment->busy = true;
+    return inputs;
+  }
+
+  /**
+   * @brief Run seals and merges until none is due, on the background thread when there is one.
+   */
+  void maintain()
+  {
+    for (;;)
+    {
+      std::vector<std::shared_ptr<Segment>> inputs = claim_work();
+      if (inputs.empty())
+        return;
+      if (!background_)
+      {
+        rebuild(inputs);
+        continue;
+      }
+      {
+        std::lock_guard<std::mutex> lock(background_mutex_);
+        ++background_pending_;
+      }
+      background_->submit([this, inputs] {
+        try
+        {
+          rebuild(inputs);
+        }
+        catch (const std::exception& e)
+        {
+          NVDB_LOG("[SegmentedNanoVectorDB::maintain] " << e.what());
+        }
+        // Claims the next seal or merge before this one counts as finished
+        maintain();
+        std::lock_guard<std::mutex> lock(background_mutex_);
+        if (--background_pending_ == 0)
+          background_idle_.notify_all();
+      });
+    }
+  }
+
+  /**
+   * @brief Write the live rows of `inputs` to a new sealed segment and swap it in for them.
+   *
+   * The rows are copied in chunks without holding mutex_, so readers and writers continue. Records
+   * removed from the inputs meanwhile are logged in Segment::removed and removed from the output before
+   * it replaces them. On failure the inputs stay in place and are retried by a later maintain().
+   *
+   * Every changed segment is saved before the new manifest is written and the inputs' files are deleted,
+   * so a finished seal or merge also persists the changes made since the last save().
+   */
+  void rebuild(const std::vector<std::shared_ptr<Segment>>& inputs)
+  {
+    const std::string name = next_name(true);
+    std::shared_ptr<NanoVectorDB> out;
+    try
+    {
+      out = build(inputs, name);
+    }
+    catch (...)
+    {
+      std::unique_lock<RWMutex> write(mutex_);
+      for (const auto& segment : inputs)
+        segment->busy = false;
+      throw;
+    }
+    std::lock_guard<std::mutex> saving(save_mutex_);
+    auto sealed = std::make_shared<Segment>();
+    sealed->name = name;
+    sealed->db = out;
+    sealed->sealed = true;
+    {
+      std::unique_lock<RWMutex> write(mutex_);
+      for (const auto& segment : inputs)
+        out->remove(segment->removed);
+      auto first = std::find(segments_.begin(), segments_.end(), inputs.front());
+      *first = sealed;
+      segments_.erase(std::remove_if(segments_.begin(), segments_.end(),
+                                     [&](const std::shared_ptr<Segment>& s) {
+                                       return std::find(inputs.begin(), inputs.end(), s) != inputs.end();
+                                     }),
+                      segments_.end());
+    }
+    // An upsert tombstones the old copy of a record and keeps the new one in the write segment, which may
+    // not be saved yet; once the manifest drops the inputs, the saved state must hold that copy
+    save_segments();
+    write_manifest();
+    for (const auto& segment : inputs)
+      remove_files(segment->name);
+  }
+
+  /**
+   * @brief Copy the live rows of `inputs` into a new MMap file and map it back as a sealed segment.
+   */
+  std::shared_ptr<NanoVectorDB> build(const std::vector<std::shared_ptr<Segment>>& inputs,
+                                      const std::string& name) const
+  {
+    remove_files(name);
+    size_t expected = 0;
+    std::vector<std::vector<std::string>> ids;
+    for (const auto& segment : inputs)
+    {
+      ids.push_back(segment->db->ids());
+      expected += ids.back().size();
+    }
+    {
+      NanoVectorDB staging(embedding_dim_, metric_name(), path_for(name), ::nano_vectordb::make(metric_type_),
+                           ::nano_vectordb::make(::nano_vectordb::storage::MMap), nullptr);
+      size_t input = 0;
+      size_t next = 0;
+      staging.ingest(
+        [&](float* rows, std::string* out_ids, size_t capacity) {
+          for (; input < inputs.size(); ++input, next = 0)
+          {
+            const auto& all = ids[input];
+            if (next >= all.size())
+              continue;
+            const size_t n = std::min(capacity, all.size() - next);
+            const std::vector<std::string> chunk(all.begin() + static_cast<std::ptrdiff_t>(next),
+                                                 all.begin() + static_cast<std::ptrdiff_t>(next + n));
+            next += n;
+            // Records removed since ids() are skipped; removals after this read are replayed later
+            const std::vector<Data> found = inputs[input]->db->get(chunk);
+            for (size_t r = 0; r < found.size(); ++r)
+            {
+              std::copy(found[r].vector.data(), found[r].vector.data() + embedding_dim_,
+                        rows + r * static_cast<size_t>(embedding_dim_));
+              out_ids[r] = found[r].id;
+            }
+            if (!found.empty())
+              return found.size();
+          }
+          return size_t(0);
+        },
+        kBuildChunkRows, expected);
+      staging.checkpoint();
+    }
+    auto db = open_segment(name, true);
+    // Reopening the collection then loads the index instead of re-encoding the segment
+    db->save_index();
+    return db;
+  }
+
+  /**
+   * @brief Save every segment that changed since its last save; the caller holds save_mutex_.
+   */
+  void save_segments() const
+  {
+    std::vector<std::shared_ptr<Segment>> segments;
+    {
+      std::shared_lock<RWMutex> read(mutex_);
+      segments = all_segments();
+    }
+    // Sealed and merged segments are only swapped in under save_mutex_, so these files stay in use
+    for (const auto& segment : segments)
+    {
+      if (segment->db->dirty())
+        segment->db->save();
+    }
+  }
+
+  /**
+   * @brief Replace the manifest with the current segment list; the caller holds save_mutex_.
+   */
+  void write_manifest() const
+  {
+    nlohmann::json j;
+    {
+      std::shared_lock<RWMutex> read(mutex_);
+      j["embedding_dim"] = embedding_dim_;
+      j["next_segment"] = next_segment_.load();
+      j["write"] = write_->name;
+      j["segments"] = nlohmann::json::array();
+      for (const auto& segment : segments_)
+        j["segments"].push_back({ { "name", segment->name }, { "sealed", segment->sealed } });
+    }
+    const std::string path = path_for(kManifest);
+    const std::string tmp = path + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out << j.dump();
+      if (!out)
+      {
+        throw std::runtime_error("SegmentedNanoVectorDB: cannot write " + tmp);
+      }
+    }
+    std::filesystem::rename(tmp, path);
+  }
+
+  void remove_files(const std::string& name) const
+  {
+    const std::string path = path_for(name);
+    const std::string index = IPersistentIndex::path_for(path);
+    for (const std::string& file :
+         { path, WriteAheadLog::path_for(path), path + ".tmp", index, index + ".tmp" })
+      std::filesystem::remove(file);
+  }
+
+  static constexpr const char* kManifest = "manifest.json";
+  // Rows copied per chunk when sealing or merging
+  static constexpr size_t kBuildChunkRows = 4096;
+
+  int embedding_dim_;
+  ::nano_vectordb::metric metric_type_;
+  std::string dir_;
+  SegmentOptions options_;
+
+  // Readers hold it shared for a whole call; writers and segment swaps hold it exclusively
+  mutable RWMutex mutex_;
+  mutable std::mutex save_mutex_;  // serializes save(), manifest writes and segment swaps
+  std::shared_ptr<Segment> write_;                  // receives upserts
+  std::vector<std::shared_ptr<Segment>> segments_;  // frozen and sealed segments, oldest first
+  std::atomic<std::uint64_t> next_segment_{ 0 };    // number of the next segment file
+
+  const std::shared_ptr<Metrics> metrics_ = std::make_shared<Metrics>();
+  std::shared_ptr<ThreadPool> pool_;  // searches segments in parallel; null for a single thread
+
+  // Seals and merges; declared last so its worker stops before the state it uses goes
+  std::mutex background_mutex_;
+  std::condition_variable background_idle_;
+  std::size_t background_pending_ = 0;
+  std::unique_ptr<ThreadPool> background_;
+};
+
+}  // namespace nano_vectordb
@@ -0,0 +1,170 @@
+#pragma once
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Growable bitset with one bit per row
+ */
+class Bitmap
+{
+public:
+  Bitmap() = default;
+
+  /**
+   * @brief Construct a bitmap of n bits
+   *
+   * @param n Number of bits.
+   * @param value Initial value of every bit.
+   */
+  explicit Bitmap(std::size_t n, bool value = false)
+  {
+    resize(n, value);
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+  /**
+   * @brief Change the number of bits; new bits take `value`.
+   */
+  void resize(std::size_t n, bool value = false)
+  {
+    if (n > size_ && value)
+    {
+      // Set the tail of the last partially used word before growing
+      for (std::size_t i = size_; i < n && (i & 63) != 0; ++i)
+        set(i);
+    }
+    words_.resize((n + 63) / 64, value ? ~std::uint64_t(0) : 0);
+    size_ = n;
+    trim();
+  }
+
+  bool test(std::size_t i) const
+  {
+    return (words_[i >> 6] >> (i & 63)) & 1u;
+  }
+
+  void set(std::size_t i)
+  {
+    words_[i >> 6] |= std::uint64_t(1) << (i & 63);
+  }
+
+  void reset(std::size_t i)
+  {
+    words_[i >> 6] &= ~(std::uint64_t(1) << (i & 63));
+  }
+
+  void assign(std::size_t i, bool value)
+  {
+    if (value)
+      set(i);
+    else
+      reset(i);
+  }
+
+  /**
+   * @brief Clear every bit, keeping the size.
+   */
+  void reset_all()
+  {
+    for (auto& w : words_)
+      w = 0;
+  }
+
+  /**
+   * @brief Number of set bits.
+   */
+  std::size_t count() const
+  {
+    std::size_t n = 0;
+    for (auto w : words_)
+      n += std::bitset<64>(w).count();
+    return n;
+  }
+
+  /**
+   * @brief Check whether any bit in [begin, end) is set.
+   */
+  bool any(std::size_t begin, std::size_t end) const
+  {
+    for (std::size_t i = begin; i < end;)
+    {
+      if ((i & 63) == 0 && i + 64 <= end)
+      {
+        if (words_[i >> 6])
+          return true;
+        i += 64;
+      }
+      else
+      {
+        if (test(i))
+          return true;
+        ++i;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Keep only the bits also set in other; bits past other.size() are cleared.
+   */
+  Bitmap& operator&=(const Bitmap& other)
+  {
+    for (std::size_t w = 0; w < words_.size(); ++w)
+      words_[w] &= w < other.words_.size() ? other.words_[w] : 0;
+    return *this;
+  }
+
+  /**
+   * @brief Set the bits set in other; bits past size() are ignored.
+   */
+  Bitmap& operator|=(const Bitmap& other)
+  {
+    const std::size_t n = std::min(words_.size(), other.words_.size());
+    for (std::size_t w = 0; w < n; ++w)
+      words_[w] |= other.words_[w];
+    trim();
+    return *this;
+  }
+
+  /**
+   * @brief Clear the bits set in other.
+   */
+  Bitmap& subtract(const Bitmap& other)
+  {
+    const std::size_t n = std::min(words_.size(), other.words_.size());
+    for (std::size_t w = 0; w < n; ++w)
+      words_[w] &= ~other.words_[w];
+    return *this;
+  }
+
+  /**
+   * @brief Bytes allocated for the bits.
+   */
+  std::size_t memory_bytes() const
+  {
+    return words_.capacity() * sizeof(std::uint64_t);
+  }
+
+private:
+  // Keep bits past size_ cleared so count() stays exact
+  void trim()
+  {
+    if (size_ & 63)
+      words_.back() &= (std::uint64_t(1) << (size_ & 63)) - 1;
+  }
+
+  std::vector<std::uint64_t> words_;
+  std::size_t size_ = 0;
+};
+
+}  // namespace nano_vectordb
@@ -0,0 +1,141 @@
+#pragma once
+#include "thread_pool.hpp"
+#include "topk.hpp"
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Partitions of a fan_out_top_k() call that run on one pool.
+ */
+struct FanOutGroup
+{
+  ThreadPool* pool = nullptr;         // nullptr: search in turn on the calling thread
+  std::vector<std::size_t> schedule;  // partitions, in the order to start them
+  bool run_here = false;              // drive pool->parallel_for() from the calling thread, not a task
+};
+
+/**
+ * @brief Search several partitions (tenants, segments) for one query and merge their hits into one top-k.
+ *
+ * Each group of partitions runs on its own pool at the same time as the others: as one task started on
+ * that pool, or from the calling thread when `run_here` is set or the group has no pool. Within a group
+ * every partition is one task, claimed by whichever thread of the pool is free. `search(i, threshold)`
+ * searches partition i and returns its hits, each with a `score` member; higher is better. The k-th best
+ * score merged so far (or the caller's threshold) is shared between all tasks and passed in as the
+ * threshold of every later search. It only rises, so no task rejects a hit the final top-k keeps. The
+ * first exception thrown by a search is rethrown once every group finished.
+ *
+ * @param groups Partitions to search and the pool of each; every partition in [0, partitions), once.
+ * @param partitions Number of partitions; hits are merged in partition order, so ties resolve the same
+ *        way however the tasks were scheduled.
+ * @param top_k Number of hits to return.
+ * @param threshold Optional minimum score.
+ * @param search Callable `std::vector<Hit>(std::size_t i, std::optional<float> threshold)`.
+ * @return std::vector<Hit> Best first.
+ */
+template <typename Hit, typename Search>
+std::vector<Hit> fan_out_top_k(const std::vector<FanOutGroup>& groups, std::size_t partitions, int top_k,
+                               std::optional<float> threshold, const Search& search)
+{
+  if (top_k <= 0)
+    return {};
+  const float floor = threshold ? *threshold : -std::numeric_limits<float>::infinity();
+  std::atomic<float> bound{ floor };
+  std::mutex merge_mutex;
+  TopK best(top_k, threshold);  // scores only, to maintain bound
+  std::vector<std::vector<Hit>> found(partitions);
+  auto task = [&](std::size_t i) {
+    const float current = bound.load(std::memory_order_relaxed);
+    std::vector<Hit> hits = search(i, current > floor ? std::optional<float>(current) : threshold);
+    {
+      std::lock_guard<std::mutex> lock(merge_mutex);
+      for (const auto& hit : hits)
+        best.push(0, hit.score);
+      bound.store(best.bound(), std::memory_order_relaxed);
+    }
+    found[i] = std::move(hits);
+  };
+  auto run = [&](const FanOutGroup& group) {
+    if (group.pool)
+      group.pool->parallel_for(group.schedule.size(), [&](std::size_t k) { task(group.schedule[k]); });
+    else
+      for (std::size_t i : group.schedule)
+        task(i);
+  };
+  std::vector<std::future<void>> started;
+  for (const FanOutGroup& group : groups)
+  {
+    if (group.pool && !group.run_here && !group.schedule.empty())
+      started.push_back(group.pool->submit([&run, &group] { run(group); }));
+  }
+  std::exception_ptr error;
+  for (const FanOutGroup& group : groups)
+  {
+    if (!group.pool || group.run_here)
+    {
+      try
+      {
+        run(group);
+      }
+      catch (...)
+      {
+        if (!error)
+          error = std::current_exception();
+      }
+    }
+  }
+  // Every started group still reads the state above, so wait for all of them before leaving
+  for (auto& f : started)
+  {
+    try
+    {
+      f.get();
+    }
+    catch (...)
+    {
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+  if (error)
+    std::rethrow_exception(error);
+
+  std::vector<Hit> all;
+  for (auto& hits : found)
+    std::move(hits.begin(), hits.end(), std::back_inserter(all));
+  TopK merged(top_k, threshold);
+  for (std::size_t i = 0; i < all.size(); ++i)
+    merged.push(static_cast<int>(i), all[i].score);
+  std::vector<Hit> out;
+  for (const auto& [i, score] : merged.take_sorted())
+    out.push_back(std::move(all[static_cast<std::size_t>(i)]));
+  return out;
+}
+
+/**
+ * @brief fan_out_top_k() over one pool driven from the calling thread, or in turn on it without a pool.
+ *
+ * @param pool Worker pool, or nullptr to search on the calling thread.
+ * @param schedule Partitions to search, in the order to start them; each in [0, partitions).
+ */
+template <typename Hit, typename Search>
+std::vector<Hit> fan_out_top_k(ThreadPool* pool, const std::vector<std::size_t>& schedule,
+                               std::size_t partitions, int top_k, std::optional<float> threshold,
+                               const Search& search)
+{
+  const std::vector<FanOutGroup> groups{ { pool, schedule, true } };
+  return fan_out_top_k<Hit>(groups, partitions, top_k, threshold, search);
+}
+
+}  // namespace nano_vectordb
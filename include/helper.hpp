@@ -10,6 +10,7 @@
 #include <openssl/bio.h>
 #include <openssl/buffer.h>
 #include <iostream>
+#include "precision.hpp"
 
 #ifndef NANOVDB_ENABLE_LOG
 #define NANOVDB_ENABLE_LOG 0
@@ -24,19 +25,17 @@ namespace nano_vectordb
 {
 
 /**
- * @brief Convert a matrix to a base64-encoded string
- * 
- * @param array The matrix to encode
+ * @brief Base64-encode a byte buffer
+ *
+ * @param bytes First byte
+ * @param byte_len Number of bytes
  * @return std::string The base64-encoded string
  */
-inline std::string array_to_buffer_string(const Eigen::MatrixXf& array)
+inline std::string bytes_to_base64(const void* bytes, size_t byte_len)
 {
-  // Allow empty matrix: encode as empty string
-  if (array.size() == 0 || array.rows() == 0 || array.cols() == 0) {
+  if (byte_len == 0) {
     return std::string();
   }
-  const char* bytes = reinterpret_cast<const char*>(array.data());
-  size_t byte_len = sizeof(float) * array.size();
   BIO *bio, *b64;
   BUF_MEM* bufferPtr;
   b64 = BIO_new(BIO_f_base64());
@@ -52,20 +51,15 @@ inline std::string array_to_buffer_string(const Eigen::MatrixXf& array)
 }
 
 /**
- * @brief Decode a base64-encoded string to a matrix
- * 
+ * @brief Decode a base64-encoded string into bytes
+ *
  * @param base64_str The base64-encoded string
- * @param embedding_dim The dimension of the embedding vectors
- * @return Eigen::MatrixXf The decoded matrix
+ * @return std::vector<char> The decoded bytes (empty when decoding fails)
  */
-inline Eigen::MatrixXf buffer_string_to_array(const std::string& base64_str, int embedding_dim)
+inline std::vector<char> base64_to_bytes(const std::string& base64_str)
 {
-  if (embedding_dim <= 0) {
-    throw std::runtime_error("Embedding dimension must be positive in buffer_string_to_array");
-  }
-  // Allow empty base64 string meaning zero rows
   if (base64_str.empty()) {
-    return Eigen::MatrixXf(0, embedding_dim);
+    return {};
   }
   BIO *bio, *b64;
   int decodeLen = (base64_str.length() * 3) / 4;
@@ -76,16 +70,58 @@ inline Eigen::MatrixXf buffer_string_to_array(const std::string& base64_str, int
   BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
   int len = BIO_read(bio, buffer.data(), base64_str.length());
   BIO_free_all(bio);
+  buffer.resize(std::max(0, len));
+  return buffer;
+}
+
+/**
+ * @brief Convert a matrix to a base64-encoded string
+ * 
+ * @param array The matrix to encode
+ * @param type Element type written to the buffer; F16 / BF16 halve its size
+ * @return std::string The base64-encoded string
+ */
+inline std::string array_to_buffer_string(const Eigen::MatrixXf& array, precision type = precision::F32)
+{
+  // Allow empty matrix: encode as empty string
+  if (array.size() == 0 || array.rows() == 0 || array.cols() == 0) {
+    return std::string();
+  }
+  if (type == precision::F32) {
+    return bytes_to_base64(array.data(), sizeof(float) * array.size());
+  }
+  std::vector<uint16_t> narrow(array.size());
+  encode_values(type, array.data(), narrow.data(), narrow.size());
+  return bytes_to_base64(narrow.data(), sizeof(uint16_t) * narrow.size());
+}
+
+/**
+ * @brief Decode a base64-encoded string to a matrix
+ * 
+ * @param base64_str The base64-encoded string
+ * @param embedding_dim The dimension of the embedding vectors
+ * @param type Element type the buffer was written with
+ * @return Eigen::MatrixXf The decoded matrix
+ */
+inline Eigen::MatrixXf buffer_string_to_array(const std::string& base64_str, int embedding_dim,
+                                              precision type = precision::F32)
+{
+  if (embedding_dim <= 0) {
+    throw std::runtime_error("Embedding dimension must be positive in buffer_string_to_array");
+  }
+  // Allow empty base64 string meaning zero rows
+  std::vector<char> buffer = base64_to_bytes(base64_str);
+  int len = static_cast<int>(buffer.size());
   if (len <= 0) {
     return Eigen::MatrixXf(0, embedding_dim);
   }
-  int row_size_bytes = embedding_dim * sizeof(float);
+  int row_size_bytes = embedding_dim * element_size(type);
   if (len % row_size_bytes != 0) {
     throw std::runtime_error("Invalid decoded length for embedding_dim in buffer_string_to_array: len=" + std::to_string(len) + ", embedding_dim=" + std::to_string(embedding_dim));
   }
   int rows = len / row_size_bytes;
   Eigen::MatrixXf mat(rows, embedding_dim);
-  std::memcpy(mat.data(), buffer.data(), rows * embedding_dim * sizeof(float));
+  decode_values(type, buffer.data(), mat.data(), static_cast<size_t>(rows) * embedding_dim);
   return mat;
 }
 
@@ -142,25 +178,63 @@ inline Eigen::MatrixXf normalize_rows(const Eigen::MatrixXf& m)
 }
 
 /**
- * @brief Generate a hash string for a given vector.
+ * @brief Normalize each row of a matrix (or matrix view) to unit length, in place.
  *
- * @param v Input vector.
+ * @param m Matrix whose rows are normalized.
+ */
+template <typename Derived>
+inline void normalize_rows_inplace(Eigen::MatrixBase<Derived>& m)
+{
+  for (Eigen::Index i = 0; i < m.rows(); ++i) {
+    float n = m.row(i).norm();
+    if (n == 0) {
+      throw std::runtime_error("Cannot normalize zero-norm row in matrix at row " + std::to_string(i));
+    }
+    m.row(i) /= n;
+  }
+}
+
+/**
+ * @brief Generate a hash string for a vector given as dim contiguous floats.
+ *
+ * Formats the hash as lowercase hex without a stream, so bulk loads with generated ids do not
+ * allocate per row beyond the id itself.
+ *
+ * @param v First element.
+ * @param dim Number of elements.
  * @return std::string Hash string.
  */
-inline std::string hash_vector(const Eigen::VectorXf& v)
+inline std::string hash_vector(const float* v, int dim)
 {
-  if (v.size() == 0) {
+  if (dim <= 0) {
     throw std::runtime_error("Cannot hash empty vector");
   }
   std::hash<float> hasher;
   size_t hash = 0;
-  for (int i = 0; i < v.size(); ++i)
+  for (int i = 0; i < dim; ++i)
   {
     hash ^= hasher(v[i]) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
   }
-  std::ostringstream oss;
-  oss << std::hex << hash;
-  return oss.str();
+  static constexpr char kDigits[] = "0123456789abcdef";
+  char buf[2 * sizeof(size_t)];
+  size_t n = 0;
+  do
+  {
+    buf[sizeof(buf) - ++n] = kDigits[hash & 0xf];
+    hash >>= 4;
+  } while (hash);
+  return std::string(buf + sizeof(buf) - n, n);
+}
+
+/**
+ * @brief Generate a hash string for a given vector.
+ *
+ * @param v Input vector.
+ * @return std::string Hash string.
+ */
+inline std::string hash_vector(const Eigen::VectorXf& v)
+{
+  return hash_vector(v.data(), static_cast<int>(v.size()));
 }
 
 /**
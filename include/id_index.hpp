@@ -0,0 +1,206 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Flat open-addressing hash index from record id to row number.
+ *
+ * Slots hold only a cached hash and a row number; the id strings themselves are not copied. Every
+ * operation takes a `key_at(row)` callable returning the id stored for a row, so the owning database's
+ * id column is the single interned copy of each key. Collisions are resolved by linear probing and
+ * erase uses backward-shift deletion, so there are no tombstone slots.
+ */
+class IdIndex
+{
+public:
+  /**
+   * @brief Number of ids in the index.
+   */
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+  /**
+   * @brief Bytes allocated for the slots; the ids are owned by the caller.
+   */
+  std::size_t memory_bytes() const
+  {
+    return slots_.capacity() * sizeof(Slot);
+  }
+
+  /**
+   * @brief Remove every entry.
+   */
+  void clear()
+  {
+    slots_.clear();
+    size_ = 0;
+  }
+
+  /**
+   * @brief Look up the row of an id.
+   *
+   * @param id Record id.
+   * @param key_at Callable returning the id stored at a row.
+   * @return int Row number, or -1 when absent.
+   */
+  template <typename KeyAt>
+  int find(std::string_view id, const KeyAt& key_at) const
+  {
+    if (slots_.empty())
+      return -1;
+    const std::uint64_t h = hash(id);
+    for (std::size_t i = h & mask(); slots_[i].row >= 0; i = (i + 1) & mask())
+    {
+      if (slots_[i].hash == h && std::string_view(key_at(slots_[i].row)) == id)
+        return slots_[i].row;
+    }
+    return -1;
+  }
+
+  /**
+   * @brief Insert an id that is not yet present, or repoint an existing one.
+   *
+   * @param id Record id (must equal key_at(row) once the row is written).
+   * @param row Row number.
+   * @param key_at Callable returning the id stored at a row.
+   */
+  template <typename KeyAt>
+  void insert(std::string_view id, int row, const KeyAt& key_at)
+  {
+    if ((size_ + 1) * 10 > slots_.size() * 7)
+      grow();
+    const std::uint64_t h = hash(id);
+    std::size_t i = h & mask();
+    for (; slots_[i].row >= 0; i = (i + 1) & mask())
+    {
+      if (slots_[i].hash == h && std::string_view(key_at(slots_[i].row)) == id)
+      {
+        slots_[i].row = row;
+        return;
+      }
+    }
+    slots_[i] = { h, row };
+    ++size_;
+  }
+
+  /**
+   * @brief Remove an id.
+   *
+   * @param id Record id.
+   * @param key_at Callable returning the id stored at a row.
+   * @return bool True if the id was present.
+   */
+  template <typename KeyAt>
+  bool erase(std::string_view id, const KeyAt& key_at)
+  {
+    if (slots_.empty())
+      return false;
+    const std::uint64_t h = hash(id);
+    std::size_t i = h & mask();
+    for (; slots_[i].row >= 0; i = (i + 1) & mask())
+    {
+      if (slots_[i].hash == h && std::string_view(key_at(slots_[i].row)) == id)
+        break;
+    }
+    if (slots_[i].row < 0)
+      return false;
+    // Backward-shift: pull later members of the probe chain into the hole
+    for (std::size_t j = (i + 1) & mask(); slots_[j].row >= 0; j = (j + 1) & mask())
+    {
+      const std::size_t home = slots_[j].hash & mask();
+      const bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+      if (movable)
+      {
+        slots_[i] = slots_[j];
+        i = j;
+      }
+    }
+    slots_[i] = Slot{};
+    --size_;
+    return true;
+  }
+
+  /**
+   * @brief Rebuild the index from rows [0, n).
+   *
+   * @param n Number of rows.
+   * @param key_at Callable returning the id stored at a row.
+   */
+  template <typename KeyAt>
+  void rebuild(std::size_t n, const KeyAt& key_at)
+  {
+    clear();
+    reserve(n);
+    for (std::size_t r = 0; r < n; ++r)
+      insert(key_at(static_cast<int>(r)), static_cast<int>(r), key_at);
+  }
+
+  /**
+   * @brief Pre-size the table for n ids.
+   *
+   * @param n Expected number of ids.
+   */
+  void reserve(std::size_t n)
+  {
+    std::size_t cap = 16;
+    while (cap * 7 < n * 10)
+      cap <<= 1;
+    if (cap > slots_.size())
+      rehash(cap);
+  }
+
+private:
+  struct Slot
+  {
+    std::uint64_t hash = 0;
+    int row = -1;  // -1 marks an empty slot
+  };
+
+  static std::uint64_t hash(std::string_view id)
+  {
+    // Mix the standard hash so low bits are usable as a table index
+    std::uint64_t h = std::hash<std::string_view>{}(id);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  std::size_t mask() const
+  {
+    return slots_.size() - 1;
+  }
+
+  void grow()
+  {
+    rehash(slots_.empty() ? 16 : slots_.size() * 2);
+  }
+
+  void rehash(std::size_t cap)
+  {
+    std::vector<Slot> old = std::move(slots_);
+    slots_.assign(cap, Slot{});
+    for (const Slot& s : old)
+    {
+      if (s.row < 0)
+        continue;
+      std::size_t i = s.hash & mask();
+      while (slots_[i].row >= 0)
+        i = (i + 1) & mask();
+      slots_[i] = s;
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::size_t size_ = 0;
+};
+
+}  // namespace nano_vectordb
@@ -0,0 +1,257 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../metric/base.hpp"
+#include "../metric/kernels.hpp"
+#include "../memory_usage.hpp"
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Optional row predicate passed to index searches; nullptr accepts every row
+ */
+using RowFilter = std::function<bool(int)>;
+
+/**
+ * @brief Vectors seen by an index, with the distance the database ranks by.
+ *
+ * The rows are the database's own storage, so indexes keep row numbers rather than copies of the
+ * vectors. The view is passed to every call because the storage may move between calls.
+ */
+struct IndexSpace
+{
+  RowBlock vectors;            // every row of the database, including tombstoned ones
+  bool inner_product = false;  // 1 - dot product on normalized rows (cosine), otherwise squared L2
+  bool mapped = false;         // rows are read from a file mapping and may not be resident
+
+  float distance(const float* a, const float* b) const
+  {
+    return inner_product ? 1.0f - kernels::dot(a, b, vectors.dim) : kernels::l2sq(a, b, vectors.dim);
+  }
+
+  /**
+   * @brief Distance from a float query to a stored row, scoring F16 / BF16 rows without decoding them.
+   */
+  float distance(const float* query, int row) const
+  {
+    const auto r = static_cast<std::size_t>(row);
+    if (vectors.type == precision::F32)
+      return distance(query, vectors.row(r));
+    const std::uint16_t* v = vectors.narrow_row(r);
+    return inner_product ? 1.0f - kernels::dot(query, v, vectors.dim, vectors.type)
+                         : kernels::l2sq(query, v, vectors.dim, vectors.type);
+  }
+
+  /**
+   * @brief Floats of scratch that row() needs: 0 for F32 rows, which are read in place.
+   */
+  std::size_t scratch_size() const
+  {
+    return vectors.type == precision::F32 ? 0 : vectors.dim;
+  }
+
+  /**
+   * @brief A stored row as floats (decoded into scratch for F16 / BF16 rows).
+   *
+   * @param row Row number.
+   * @param scratch scratch_size() floats.
+   */
+  const float* row(int row, float* scratch) const
+  {
+    return vectors.row(static_cast<std::size_t>(row), scratch);
+  }
+
+  /**
+   * @brief Ask the OS to read the pages of mapped rows now, so scoring them does not wait on one page
+   *        fault after another. No-op for rows held in memory.
+   *
+   * All ranges are submitted before any is read, so the reads are in flight at the same time.
+   */
+  void prefetch(const std::vector<std::pair<int, float>>& rows) const
+  {
+#if !defined(_WIN32)
+    if (!mapped || rows.empty())
+      return;
+    const auto page = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+    const auto* base = vectors.type == precision::F32 ? static_cast<const void*>(vectors.data)
+                                                      : static_cast<const void*>(vectors.narrow);
+    const std::size_t row_bytes = vectors.stride * (vectors.type == precision::F32 ? sizeof(float)
+                                                                                   : sizeof(std::uint16_t));
+    std::vector<std::pair<std::uintptr_t, std::uintptr_t>> ranges;
+    ranges.reserve(rows.size());
+    for (const auto& entry : rows)
+    {
+      const std::uintptr_t begin =
+          reinterpret_cast<std::uintptr_t>(base) + static_cast<std::size_t>(entry.first) * row_bytes;
+      ranges.emplace_back(begin / page * page, begin + row_bytes);
+    }
+    // Neighbouring rows share pages; one call per run of touching pages
+    std::sort(ranges.begin(), ranges.end());
+    std::uintptr_t start = ranges.front().first;
+    std::uintptr_t end = ranges.front().second;
+    for (std::size_t i = 1; i <= ranges.size(); ++i)
+    {
+      if (i < ranges.size() && ranges[i].first <= end)
+      {
+        end = std::max(end, ranges[i].second);
+        continue;
+      }
+      ::madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED);
+      if (i < ranges.size())
+      {
+        start = ranges[i].first;
+        end = ranges[i].second;
+      }
+    }
+#else
+    (void)rows;
+#endif
+  }
+
+  /**
+   * @brief Convert a distance into the database's score (higher is better).
+   */
+  float score(float distance) const
+  {
+    return inner_product ? 1.0f - distance : -distance;
+  }
+};
+
+/**
+ * @brief Strategy interface for approximate nearest-neighbour indexes
+ *
+ * Indexes map row numbers of the owning database to search structures. The database keeps them in
+ * sync: rows are added after they are written, removed before they are tombstoned, and renumbered
+ * when the row store is compacted.
+ */
+struct IIndex
+{
+  /**
+   * @brief Virtual destructor for the index interface.
+   */
+  virtual ~IIndex() = default;
+
+  /**
+   * @brief Rebuild the index from a set of rows.
+   *
+   * The default clears the index and adds the rows one at a time.
+   *
+   * @param space Stored vectors.
+   * @param rows Live rows to index.
+   */
+  virtual void build(const IndexSpace& space, const std::vector<int>& rows)
+  {
+    clear();
+    for (int row : rows)
+      add(row, space);
+  }
+
+  /**
+   * @brief Remove every row.
+   */
+  virtual void clear() = 0;
+
+  /**
+   * @brief Index a row, replacing it if it is already present.
+   *
+   * @param row Row number.
+   * @param space Stored vectors; the row must already hold its vector.
+   */
+  virtual void add(int row, const IndexSpace& space) = 0;
+
+  /**
+   * @brief Remove a row; unknown rows are ignored.
+   *
+   * @param row Row number.
+   * @param space Stored vectors.
+   */
+  virtual void remove(int row, const IndexSpace& space) = 0;
+
+  /**
+   * @brief Renumber rows after the database compacted its storage.
+   *
+   * @param new_row_of New row number of every old row, or -1 for dropped rows.
+   */
+  virtual void remap(const std::vector<int>& new_row_of) = 0;
+
+  /**
+   * @brief Find the nearest rows to a query.
+   *
+   * @param query Query vector (normalized for inner-product spaces).
+   * @param k Number of results.
+   * @param space Stored vectors.
+   * @param allow Optional predicate; rows it rejects are never returned.
+   * @return std::vector<std::pair<int, float>> (row, score) pairs, best first.
+   */
+  virtual std::vector<std::pair<int, float>> search(const float* query, int k, const IndexSpace& space,
+                                                    const RowFilter& allow) const = 0;
+
+  /**
+   * @brief Number of indexed rows.
+   */
+  virtual std::size_t size() const = 0;
+
+  /**
+   * @brief Bytes allocated by the index structures (graph, lists, codes, codebooks).
+   */
+  virtual std::size_t memory_bytes() const
+  {
+    return 0;
+  }
+};
+
+/**
+ * @brief Optional interface for indexes that can be saved next to a column storage file.
+ *
+ * A saved index describes the rows of one storage file, in file order. The database passes a
+ * fingerprint of those rows (ids and stored norms) to both calls, so an index written for a different
+ * state of the file is never loaded.
+ */
+struct IPersistentIndex
+{
+  virtual ~IPersistentIndex() = default;
+
+  /**
+   * @brief Index file of a storage file.
+   */
+  static std::string path_for(const std::string& storage_file)
+  {
+    return storage_file + ".index";
+  }
+
+  /**
+   * @brief Write the index entries of `rows` as rows 0..n-1 of the file; removes the file when the
+   *        index has nothing worth saving (e.g. before training).
+   *
+   * @param path Index file.
+   * @param rows Rows of the database stored in the storage file, in file order.
+   * @param fingerprint Fingerprint of those rows.
+   */
+  virtual void save(const std::string& path, const std::vector<int>& rows,
+                    std::uint64_t fingerprint) const = 0;
+
+  /**
+   * @brief Replace the index with the one saved at path, if it was written for these rows.
+   *
+   * @param path Index file.
+   * @param space Stored vectors; row i must be row i of the storage file.
+   * @param live Rows to index.
+   * @param fingerprint Fingerprint of every row of space.
+   * @return bool false, leaving the index empty, if the file is missing, corrupt or for other rows.
+   */
+  virtual bool load(const std::string& path, const IndexSpace& space, const std::vector<int>& live,
+                    std::uint64_t fingerprint) = 0;
+};
+
+}  // namespace nano_vectordb
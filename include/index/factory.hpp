@@ -0,0 +1,53 @@
+#pragma once
+#include <memory>
+#include "hnsw.hpp"
+#include "ivf.hpp"
+#include "pq.hpp"
+#include "sq8.hpp"
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Enum for selecting index types
+ *
+ * @param Flat Exact brute-force scan (no index)
+ * @param HNSW Hierarchical Navigable Small World graph
+ * @param IVF Inverted file over k-means centroids
+ * @param SQ8 Per-dimension int8 scalar quantization with exact re-ranking
+ * @param PQ Product quantization (ADC) with exact re-ranking
+ */
+enum class index
+{
+  Flat,
+  HNSW,
+  IVF,
+  SQ8,
+  PQ
+};
+
+/**
+ * @brief Factory function to create index strategy instances based on the specified type.
+ *
+ * @param t Index type.
+ * @return std::shared_ptr<::nano_vectordb::IIndex> Instance of the corresponding index strategy, or nullptr
+ * for Flat.
+ */
+inline std::shared_ptr<::nano_vectordb::IIndex> make(index t)
+{
+  switch (t)
+  {
+    case index::Flat:
+      return nullptr;
+    case index::HNSW:
+      return std::make_shared<::nano_vectordb::HNSWIndex>();
+    case index::IVF:
+      return std::make_shared<::nano_vectordb::IVFIndex>();
+    case index::SQ8:
+      return std::make_shared<::nano_vectordb::SQ8Index>();
+    case index::PQ:
+      return std::make_shared<::nano_vectordb::PQIndex>();
+  }
+  return nullptr;
+}
+}  // namespace nano_vectordb
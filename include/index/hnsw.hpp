@@ -0,0 +1,508 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "base.hpp"
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Tuning parameters of the HNSW index
+ *
+ * @param M Links per node on the upper layers (2 * M on the base layer).
+ * @param ef_construction Candidate list size while inserting; higher builds a better graph, slower.
+ * @param ef_search Candidate list size while querying; higher raises recall, slower.
+ * @param seed Seed of the level generator.
+ */
+struct HNSWParams
+{
+  int M = 16;
+  int ef_construction = 200;
+  int ef_search = 64;
+  std::uint64_t seed = 100;
+};
+
+/**
+ * @brief Hierarchical Navigable Small World graph index (Malkov & Yashunin)
+ *
+ * Nodes are row numbers of the owning database; vectors are read through the IndexSpace, so the graph
+ * holds only links. Deleting a node unlinks it and reconnects its neighbours with the same heuristic
+ * used on insert, so freed rows can be reused. Searches are const and may run concurrently; mutations
+ * need exclusive access.
+ */
+class HNSWIndex : public IIndex
+{
+public:
+  explicit HNSWIndex(const HNSWParams& params = {})
+    : M_(params.M)
+    , M0_(2 * params.M)
+    , ef_construction_(std::max(params.ef_construction, params.M))
+    , ef_search_(params.ef_search)
+    , level_mult_(1.0 / std::log(static_cast<double>(std::max(2, params.M))))
+    , rng_(params.seed)
+  {
+    if (params.M < 2)
+    {
+      throw std::runtime_error("HNSWIndex: M must be at least 2, got " + std::to_string(params.M));
+    }
+  }
+
+  /**
+   * @brief Change the query-time candidate list size.
+   *
+   * @param ef Candidate list size; searches always use at least k.
+   */
+  void set_ef_search(int ef)
+  {
+    ef_search_ = ef;
+  }
+
+  int ef_search() const
+  {
+    return ef_search_;
+  }
+
+  void clear() override
+  {
+    levels_.clear();
+    links0_.clear();
+    upper_.clear();
+    entry_ = -1;
+    max_level_ = -1;
+    size_ = 0;
+  }
+
+  void add(int row, const IndexSpace& space) override
+  {
+    ensure_row(row);
+    if (levels_[row] >= 0)
+      remove(row, space);
+
+    const int level = random_level();
+    levels_[row] = level;
+    links0_[static_cast<std::size_t>(row) * (M0_ + 1)] = 0;
+    upper_[row].assign(static_cast<std::size_t>(level) * (M_ + 1), 0);
+    ++size_;
+    if (entry_ < 0)
+    {
+      entry_ = row;
+      max_level_ = level;
+      return;
+    }
+
+    std::vector<float> scratch(space.scratch_size());
+    const float* q = space.row(row, scratch.data());
+    Candidate ep{ space.distance(q, entry_), entry_ };
+    for (int lc = max_level_; lc > level; --lc)
+      ep = greedy(q, ep, lc, space);
+    for (int lc = std::min(level, max_level_); lc >= 0; --lc)
+    {
+      std::vector<Candidate> found = search_layer(q, ep, ef_construction_, lc, space, nullptr);
+      // Stale links may still point at a reused row; never link a node to itself
+      auto self = [row](const Candidate& c) { return c.row == row; };
+      found.erase(std::remove_if(found.begin(), found.end(), self), found.end());
+      if (found.empty())
+        continue;
+      const std::vector<Candidate> chosen = select_neighbors(found, M_, space);
+      int* own = links(row, lc);
+      own[0] = 0;
+      for (const Candidate& c : chosen)
+      {
+        own[1 + own[0]++] = c.row;
+        connect(c.row, row, lc, space);
+      }
+      ep = found.front();
+    }
+    if (level > max_level_)
+    {
+      entry_ = row;
+      max_level_ = level;
+    }
+  }
+
+  void remove(int row, const IndexSpace& space) override
+  {
+    if (row < 0 || static_cast<std::size_t>(row) >= levels_.size() || levels_[row] < 0)
+      return;
+    const int level = levels_[row];
+    levels_[row] = -1;  // excluded from traversal from here on
+    --size_;
+    for (int lc = 0; lc <= level; ++lc)
+    {
+      const int* gone = links(row, lc);
+      const std::vector<int> orphans(gone + 1, gone + 1 + gone[0]);
+      for (int n : orphans)
+      {
+        if (levels_[n] < lc)
+          continue;
+        repair(n, row, orphans, lc, space);
+      }
+    }
+    links0_[static_cast<std::size_t>(row) * (M0_ + 1)] = 0;
+    std::vector<int>().swap(upper_[row]);
+    if (row == entry_)
+      pick_entry();
+  }
+
+  void remap(const std::vector<int>& new_row_of) override
+  {
+    std::size_t n = 0;
+    for (std::size_t old = 0; old < new_row_of.size() && old < levels_.size(); ++old)
+    {
+      if (new_row_of[old] >= 0 && levels_[old] >= 0)
+        n = std::max(n, static_cast<std::size_t>(new_row_of[old]) + 1);
+    }
+    std::vector<int> levels(n, -1);
+    std::vector<int> links0(n * (M0_ + 1), 0);
+    std::vector<std::vector<int>> upper(n);
+    auto translate = [&](const int* src, int* dst) {
+      dst[0] = 0;
+      for (int j = 1; j <= src[0]; ++j)
+      {
+        const int to = src[j];
+        if (static_cast<std::size_t>(to) < new_row_of.size() && new_row_of[to] >= 0)
+          dst[1 + dst[0]++] = new_row_of[to];
+      }
+    };
+    for (std::size_t old = 0; old < levels_.size(); ++old)
+    {
+      if (levels_[old] < 0 || old >= new_row_of.size() || new_row_of[old] < 0)
+        continue;
+      const int nr = new_row_of[old];
+      levels[nr] = levels_[old];
+      translate(&links0_[old * (M0_ + 1)], &links0[static_cast<std::size_t>(nr) * (M0_ + 1)]);
+      upper[nr].assign(upper_[old].size(), 0);
+      for (int lc = 1; lc <= levels_[old]; ++lc)
+      {
+        const std::size_t off = static_cast<std::size_t>(lc - 1) * (M_ + 1);
+        translate(&upper_[old][off], &upper[nr][off]);
+      }
+    }
+    const bool entry_kept = entry_ >= 0 && static_cast<std::size_t>(entry_) < new_row_of.size();
+    const int entry = entry_kept ? new_row_of[entry_] : -1;
+    levels_ = std::move(levels);
+    links0_ = std::move(links0);
+    upper_ = std::move(upper);
+    entry_ = entry;
+    if (entry_ < 0)
+      pick_entry();
+  }
+
+  std::vector<std::pair<int, float>> search(const float* query, int k, const IndexSpace& space,
+                                            const RowFilter& allow) const override
+  {
+    std::vector<std::pair<int, float>> out;
+    if (entry_ < 0 || k <= 0)
+      return out;
+    Candidate ep{ space.distance(query, entry_), entry_ };
+    for (int lc = max_level_; lc > 0; --lc)
+      ep = greedy(query, ep, lc, space);
+    const std::vector<Candidate> found = search_layer(query, ep, std::max(ef_search_, k), 0, space, &allow);
+    for (std::size_t i = 0; i < found.size() && static_cast<int>(i) < k; ++i)
+      out.emplace_back(found[i].row, space.score(found[i].dist));
+    return out;
+  }
+
+  std::size_t size() const override
+  {
+    return size_;
+  }
+
+  std::size_t memory_bytes() const override
+  {
+    std::size_t bytes = capacity_bytes(levels_) + capacity_bytes(links0_) + capacity_bytes(upper_);
+    for (const auto& layer : upper_)
+      bytes += capacity_bytes(layer);
+    return bytes;
+  }
+
+private:
+  struct Candidate
+  {
+    float dist;
+    int row;
+
+    bool operator<(const Candidate& o) const
+    {
+      return dist < o.dist || (dist == o.dist && row < o.row);
+    }
+    bool operator>(const Candidate& o) const
+    {
+      return o < *this;
+    }
+  };
+
+  /**
+   * @brief Per-thread visited marks, reset in O(1) by bumping the epoch
+   */
+  struct Visited
+  {
+    std::vector<std::uint32_t> marks;
+    std::uint32_t epoch = 0;
+
+    void begin(std::size_t n)
+    {
+      if (marks.size() < n)
+        marks.resize(n, 0);
+      if (++epoch == 0)
+      {
+        std::fill(marks.begin(), marks.end(), 0);
+        epoch = 1;
+      }
+    }
+
+    bool visit(int row)
+    {
+      if (marks[row] == epoch)
+        return false;
+      marks[row] = epoch;
+      return true;
+    }
+  };
+
+  static Visited& visited()
+  {
+    thread_local Visited v;
+    return v;
+  }
+
+  int* links(int row, int level)
+  {
+    return level == 0 ? &links0_[static_cast<std::size_t>(row) * (M0_ + 1)]
+                      : &upper_[row][static_cast<std::size_t>(level - 1) * (M_ + 1)];
+  }
+
+  const int* links(int row, int level) const
+  {
+    return const_cast<HNSWIndex*>(this)->links(row, level);
+  }
+
+  void ensure_row(int row)
+  {
+    if (row < 0)
+      throw std::runtime_error("HNSWIndex: negative row " + std::to_string(row));
+    if (static_cast<std::size_t>(row) < levels_.size())
+      return;
+    const std::size_t n = static_cast<std::size_t>(row) + 1;
+    levels_.resize(n, -1);
+    links0_.resize(n * (M0_ + 1), 0);
+    upper_.resize(n);
+  }
+
+  int random_level()
+  {
+    const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng_);
+    return std::min(kMaxLevel, static_cast<int>(-std::log(std::max(u, 1e-12)) * level_mult_));
+  }
+
+  Candidate greedy(const float* q, Candidate ep, int level, const IndexSpace& space) const
+  {
+    for (bool moved = true; moved;)
+    {
+      moved = false;
+      const int* l = links(ep.row, level);
+      for (int j = 1; j <= l[0]; ++j)
+      {
+        const int n = l[j];
+        if (levels_[n] < level)
+          continue;
+        const float d = space.distance(q, n);
+        if (d < ep.dist)
+        {
+          ep = { d, n };
+          moved = true;
+        }
+      }
+    }
+    return ep;
+  }
+
+  /**
+   * @brief Best-first search of one layer.
+   *
+   * Rows rejected by `allow` are traversed but not returned.
+   *
+   * @return std::vector<Candidate> Up to ef nearest accepted rows, nearest first.
+   */
+  std::vector<Candidate> search_layer(const float* q, Candidate ep, int ef, int level,
+                                      const IndexSpace& space, const RowFilter* allow) const
+  {
+    auto accepted = [&](int row) { return !allow || !*allow || (*allow)(row); };
+    Visited& seen = visited();
+    seen.begin(levels_.size());
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> frontier;
+    std::priority_queue<Candidate> best;  // worst kept result on top
+    seen.visit(ep.row);
+    frontier.push(ep);
+    if (accepted(ep.row))
+      best.push(ep);
+    while (!frontier.empty())
+    {
+      const Candidate c = frontier.top();
+      if (static_cast<int>(best.size()) >= ef && c.dist > best.top().dist)
+        break;
+      frontier.pop();
+      const int* l = links(c.row, level);
+      for (int j = 1; j <= l[0]; ++j)
+      {
+        const int n = l[j];
+        if (levels_[n] < level || !seen.visit(n))
+          continue;
+        const float d = space.distance(q, n);
+        if (static_cast<int>(best.size()) < ef || d < best.top().dist)
+        {
+          frontier.push({ d, n });
+          if (accepted(n))
+          {
+            best.push({ d, n });
+            if (static_cast<int>(best.size()) > ef)
+              best.pop();
+          }
+        }
+      }
+    }
+    std::vector<Candidate> out(best.size());
+    for (std::size_t i = out.size(); i-- > 0; best.pop())
+      out[i] = best.top();
+    return out;
+  }
+
+  /**
+   * @brief Neighbour selection heuristic: keep a candidate only if it is closer to the base than to
+   * every neighbour already kept, which spreads links across directions.
+   *
+   * @param sorted Candidates sorted nearest first.
+   * @param m Maximum number of neighbours.
+   */
+  std::vector<Candidate> select_neighbors(const std::vector<Candidate>& sorted, int m,
+                                          const IndexSpace& space) const
+  {
+    std::vector<Candidate> kept;
+    std::vector<float> scratch(space.scratch_size());
+    for (const Candidate& c : sorted)
+    {
+      if (static_cast<int>(kept.size()) >= m)
+        break;
+      const float* cv = space.row(c.row, scratch.data());
+      bool diverse = true;
+      for (const Candidate& k : kept)
+      {
+        if (space.distance(cv, k.row) < c.dist)
+        {
+          diverse = false;
+          break;
+        }
+      }
+      if (diverse)
+        kept.push_back(c);
+    }
+    return kept;
+  }
+
+  /**
+   * @brief Add a link from `from` to `to`, pruning `from`'s list when it is full.
+   */
+  void connect(int from, int to, int level, const IndexSpace& space)
+  {
+    int* l = links(from, level);
+    const int cap = level == 0 ? M0_ : M_;
+    for (int j = 1; j <= l[0]; ++j)
+    {
+      if (l[j] == to)
+        return;
+    }
+    if (l[0] < cap)
+    {
+      l[1 + l[0]++] = to;
+      return;
+    }
+    std::vector<int> rows(l + 1, l + 1 + l[0]);
+    rows.push_back(to);
+    relink(from, rows, level, space);
+  }
+
+  /**
+   * @brief Replace a node's links with the heuristic selection from a candidate set.
+   */
+  void relink(int node, const std::vector<int>& rows, int level, const IndexSpace& space)
+  {
+    std::vector<float> scratch(space.scratch_size());
+    const float* base = space.row(node, scratch.data());
+    std::vector<Candidate> cands;
+    cands.reserve(rows.size());
+    for (int r : rows)
+      cands.push_back({ space.distance(base, r), r });
+    std::sort(cands.begin(), cands.end());
+    const std::vector<Candidate> chosen = select_neighbors(cands, level == 0 ? M0_ : M_, space);
+    int* l = links(node, level);
+    l[0] = 0;
+    for (const Candidate& c : chosen)
+      l[1 + l[0]++] = c.row;
+  }
+
+  /**
+   * @brief Drop a deleted node from a neighbour's links and reconnect it through the deleted node's
+   * other neighbours.
+   */
+  void repair(int node, int gone, const std::vector<int>& orphans, int level, const IndexSpace& space)
+  {
+    int* l = links(node, level);
+    std::vector<int> rows;
+    bool linked = false;
+    for (int j = 1; j <= l[0]; ++j)
+    {
+      if (l[j] == gone)
+        linked = true;
+      else if (levels_[l[j]] >= level)
+        rows.push_back(l[j]);
+    }
+    if (!linked)
+      return;
+    for (int o : orphans)
+    {
+      if (o != node && levels_[o] >= level && std::find(rows.begin(), rows.end(), o) == rows.end())
+        rows.push_back(o);
+    }
+    relink(node, rows, level, space);
+  }
+
+  void pick_entry()
+  {
+    entry_ = -1;
+    max_level_ = -1;
+    for (std::size_t r = 0; r < levels_.size(); ++r)
+    {
+      if (levels_[r] > max_level_)
+      {
+        max_level_ = levels_[r];
+        entry_ = static_cast<int>(r);
+      }
+    }
+  }
+
+  static constexpr int kMaxLevel = 16;
+
+  int M_;
+  int M0_;
+  int ef_construction_;
+  int ef_search_;
+  double level_mult_;
+  std::mt19937_64 rng_;
+
+  std::vector<int> levels_;               // top layer of each row, -1 if not indexed
+  std::vector<int> links0_;               // base layer: per row [count, M0 neighbours]
+  std::vector<std::vector<int>> upper_;   // layers 1..level: per layer [count, M neighbours]
+  int entry_ = -1;
+  int max_level_ = -1;
+  std::size_t size_ = 0;
+};
+
+}  // namespace nano_vectordb
@@ -0,0 +1,358 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+#include "base.hpp"
+#include "kmeans.hpp"
+#include "../structs.hpp"
+#include "../topk.hpp"
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Tuning parameters of the IVF index
+ *
+ * @param nlist Number of inverted lists (k-means centroids); 0 picks sqrt(rows) at training time.
+ * @param nprobe Lists scanned per query; higher raises recall, slower.
+ * @param train_sample Maximum number of rows sampled to train the centroids.
+ * @param iterations k-means iterations.
+ * @param min_train_rows Rows collected (and scanned exhaustively) before the first automatic training.
+ * @param retrain_growth Retrain once the rows added since training exceed this fraction of the trained
+ * size; 0 disables.
+ * @param retrain_drift Retrain once the mean distance of newly added rows to their centroid exceeds this
+ * multiple of the mean at training time; 0 disables.
+ * @param seed Seed of the sampler and centroid initialization.
+ */
+struct IVFParams
+{
+  int nlist = 0;
+  int nprobe = 8;
+  std::size_t train_sample = 65536;
+  int iterations = 10;
+  std::size_t min_train_rows = 1024;
+  float retrain_growth = 1.0f;
+  float retrain_drift = 1.5f;
+  std::uint64_t seed = 100;
+};
+
+/**
+ * @brief Inverted-file index over a k-means coarse quantizer
+ *
+ * Each row is assigned to its nearest centroid and its row number stored in that centroid's list, so
+ * the index costs 8 bytes per row plus the centroids; vectors stay in the database's row store. A query
+ * ranks the centroids and scans only the `nprobe` nearest lists, reading each member row from the row
+ * store (a random gather, not a contiguous block). Rows added before the first training are kept in an
+ * unassigned list that every query scans.
+ */
+class IVFIndex : public IIndex
+{
+public:
+  explicit IVFIndex(const IVFParams& params = {}) : params_(params), rng_(params.seed)
+  {
+  }
+
+  /**
+   * @brief Change the number of lists scanned per query.
+   */
+  void set_nprobe(int nprobe)
+  {
+    params_.nprobe = nprobe;
+  }
+
+  int nprobe() const
+  {
+    return params_.nprobe;
+  }
+
+  /**
+   * @brief Number of trained lists (0 before training).
+   */
+  int nlist() const
+  {
+    return static_cast<int>(lists_.size());
+  }
+
+  bool trained() const
+  {
+    return !lists_.empty();
+  }
+
+  void build(const IndexSpace& space, const std::vector<int>& rows) override
+  {
+    clear();
+    train(space, rows);
+    if (!trained())
+    {
+      for (int row : rows)
+        add(row, space);
+      return;
+    }
+    std::vector<int> labels(rows.size());
+    std::vector<float> dists(rows.size());
+    assign(space, rows, labels.data(), dists.data());
+    double err = 0.0;
+    for (std::size_t i = 0; i < rows.size(); ++i)
+    {
+      place(rows[i], labels[i]);
+      err += dists[i];
+    }
+    trained_rows_ = rows.size();
+    train_error_ = rows.empty() ? 0.0 : err / static_cast<double>(rows.size());
+  }
+
+  /**
+   * @brief Retrain the centroids on the currently indexed rows and reassign every row.
+   *
+   * @param space Stored vectors.
+   */
+  void retrain(const IndexSpace& space)
+  {
+    std::vector<int> rows;
+    rows.reserve(size_);
+    for (const auto& list : lists_)
+      rows.insert(rows.end(), list.begin(), list.end());
+    rows.insert(rows.end(), unassigned_.begin(), unassigned_.end());
+    std::sort(rows.begin(), rows.end());
+    build(space, rows);
+  }
+
+  /**
+   * @brief Whether growth or drift since the last training calls for retrain().
+   */
+  bool needs_retrain() const
+  {
+    if (!trained())
+      return unassigned_.size() >= params_.min_train_rows;
+    if (params_.retrain_growth > 0.0f &&
+        static_cast<double>(added_since_train_) > params_.retrain_growth * static_cast<double>(trained_rows_))
+      return true;
+    return params_.retrain_drift > 0.0f && train_error_ > 0.0 && added_since_train_ >= kMinDriftSamples &&
+           added_error_ / static_cast<double>(added_since_train_) > params_.retrain_drift * train_error_;
+  }
+
+  void clear() override
+  {
+    lists_.clear();
+    unassigned_.clear();
+    list_of_.clear();
+    pos_of_.clear();
+    centroids_.resize(0, 0);
+    centroid_sq_.clear();
+    size_ = 0;
+    trained_rows_ = 0;
+    added_since_train_ = 0;
+    train_error_ = 0.0;
+    added_error_ = 0.0;
+  }
+
+  void add(int row, const IndexSpace& space) override
+  {
+    remove(row, space);
+    if (!trained())
+    {
+      place(row, kUnassigned);
+    }
+    else
+    {
+      std::vector<float> scratch(space.scratch_size());
+      const auto [list, dist] = nearest_centroid(space.row(row, scratch.data()), space);
+      place(row, list);
+      ++added_since_train_;
+      added_error_ += dist;
+    }
+    if (needs_retrain())
+      retrain(space);
+  }
+
+  void remove(int row, const IndexSpace&) override
+  {
+    if (row < 0 || static_cast<std::size_t>(row) >= list_of_.size() || list_of_[row] == kAbsent)
+      return;
+    std::vector<int>& list = list_ref(list_of_[row]);
+    // Swap-remove keeps the list contiguous
+    const int pos = pos_of_[row];
+    list[pos] = list.back();
+    pos_of_[list[pos]] = pos;
+    list.pop_back();
+    list_of_[row] = kAbsent;
+    --size_;
+  }
+
+  void remap(const std::vector<int>& new_row_of) override
+  {
+    auto translate = [&](std::vector<int>& list) {
+      std::size_t keep = 0;
+      for (int row : list)
+      {
+        if (static_cast<std::size_t>(row) < new_row_of.size() && new_row_of[row] >= 0)
+          list[keep++] = new_row_of[row];
+      }
+      list.resize(keep);
+    };
+    for (auto& list : lists_)
+      translate(list);
+    translate(unassigned_);
+    list_of_.clear();
+    pos_of_.clear();
+    size_ = 0;
+    for (int l = 0; l < static_cast<int>(lists_.size()); ++l)
+      reindex_list(l);
+    reindex_list(kUnassigned);
+  }
+
+  std::vector<std::pair<int, float>> search(const float* query, int k, const IndexSpace& space,
+                                            const RowFilter& allow) const override
+  {
+    TopK selected(k, std::nullopt);
+    auto scan = [&](const std::vector<int>& list) {
+      for (int row : list)
+      {
+        if (allow && !allow(row))
+          continue;
+        selected.push(row, space.score(space.distance(query, row)));
+      }
+    };
+    scan(unassigned_);
+    if (trained())
+    {
+      std::vector<std::pair<float, int>> order(lists_.size());
+      for (std::size_t c = 0; c < lists_.size(); ++c)
+        order[c] = { centroid_distance(query, c, space), static_cast<int>(c) };
+      const std::size_t probes =
+          std::min(order.size(), static_cast<std::size_t>(std::max(1, params_.nprobe)));
+      std::partial_sort(order.begin(), order.begin() + probes, order.end());
+      for (std::size_t p = 0; p < probes; ++p)
+        scan(lists_[order[p].second]);
+    }
+    return selected.take_sorted();
+  }
+
+  std::size_t size() const override
+  {
+    return size_;
+  }
+
+  std::size_t memory_bytes() const override
+  {
+    std::size_t bytes = static_cast<std::size_t>(centroids_.size()) * sizeof(float) +
+                        capacity_bytes(centroid_sq_) + capacity_bytes(lists_) + capacity_bytes(unassigned_) +
+                        capacity_bytes(list_of_) + capacity_bytes(pos_of_);
+    for (const auto& list : lists_)
+      bytes += capacity_bytes(list);
+    return bytes;
+  }
+
+private:
+  static constexpr int kUnassigned = -1;
+  static constexpr int kAbsent = -2;
+  static constexpr std::size_t kMinDriftSamples = 256;
+
+  std::vector<int>& list_ref(int list)
+  {
+    return list == kUnassigned ? unassigned_ : lists_[list];
+  }
+
+  void ensure_row(int row)
+  {
+    if (static_cast<std::size_t>(row) >= list_of_.size())
+    {
+      list_of_.resize(static_cast<std::size_t>(row) + 1, kAbsent);
+      pos_of_.resize(static_cast<std::size_t>(row) + 1, 0);
+    }
+  }
+
+  void place(int row, int list)
+  {
+    ensure_row(row);
+    std::vector<int>& l = list_ref(list);
+    list_of_[row] = list;
+    pos_of_[row] = static_cast<int>(l.size());
+    l.push_back(row);
+    ++size_;
+  }
+
+  void reindex_list(int list)
+  {
+    std::vector<int>& l = list_ref(list);
+    for (std::size_t p = 0; p < l.size(); ++p)
+    {
+      ensure_row(l[p]);
+      list_of_[l[p]] = list;
+      pos_of_[l[p]] = static_cast<int>(p);
+    }
+    size_ += l.size();
+  }
+
+  float centroid_distance(const float* v, std::size_t c, const IndexSpace& space) const
+  {
+    const float d = kernels::dot(v, centroids_.row(c).data(), space.vectors.dim);
+    if (space.inner_product)
+      return 1.0f - d;
+    // |c|^2 - 2 v.c ranks centroids like the squared distance; add |v|^2 for the true value
+    return centroid_sq_[c] - 2.0f * d + kernels::dot(v, v, space.vectors.dim);
+  }
+
+  std::pair<int, float> nearest_centroid(const float* v, const IndexSpace& space) const
+  {
+    std::pair<int, float> best{ 0, std::numeric_limits<float>::infinity() };
+    for (std::size_t c = 0; c < lists_.size(); ++c)
+    {
+      const float d = centroid_distance(v, c, space);
+      if (d < best.second)
+        best = { static_cast<int>(c), d };
+    }
+    return best;
+  }
+
+  void assign(const IndexSpace& space, const std::vector<int>& rows, int* labels, float* dists) const
+  {
+    RowMatrixXf tile;
+    for (std::size_t start = 0; start < rows.size(); start += kmeans::kTileRows)
+    {
+      const std::size_t len = std::min(kmeans::kTileRows, rows.size() - start);
+      kmeans::gather(space, rows.data() + start, len, tile);
+      kmeans::assign(tile, centroids_, centroid_sq_, space.inner_product, labels + start, dists + start);
+    }
+  }
+
+  /**
+   * @brief k-means on a random sample of rows (spherical for inner-product spaces).
+   */
+  void train(const IndexSpace& space, const std::vector<int>& rows)
+  {
+    if (rows.empty())
+      return;
+    std::size_t k = params_.nlist > 0 ? static_cast<std::size_t>(params_.nlist)
+                                      : static_cast<std::size_t>(std::lround(std::sqrt(double(rows.size()))));
+    k = std::max<std::size_t>(1, std::min(k, rows.size()));
+    const std::vector<int> sample = kmeans::sample_rows(rows, std::max(params_.train_sample, k), rng_);
+    RowMatrixXf x;
+    kmeans::gather(space, sample.data(), sample.size(), x);
+    centroids_ = kmeans::train(x, k, params_.iterations, space.inner_product);
+    centroid_sq_ = kmeans::squared_norms(centroids_);
+    lists_.assign(k, {});
+  }
+
+  IVFParams params_;
+  std::mt19937_64 rng_;
+  RowMatrixXf centroids_;               // nlist x dim
+  std::vector<float> centroid_sq_;      // squared norm of each centroid
+  std::vector<std::vector<int>> lists_;  // row numbers of each list's members
+  std::vector<int> unassigned_;         // rows indexed before training
+  std::vector<int> list_of_;            // list of each row, kUnassigned or kAbsent
+  std::vector<int> pos_of_;             // position of each row within its list
+  std::size_t size_ = 0;
+  std::size_t trained_rows_ = 0;
+  std::size_t added_since_train_ = 0;
+  double train_error_ = 0.0;  // mean row-to-centroid distance at training time
+  double added_error_ = 0.0;  // summed row-to-centroid distance of rows added since
+};
+
+}  // namespace nano_vectordb
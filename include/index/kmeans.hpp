@@ -0,0 +1,162 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+#include "base.hpp"
+#include "../structs.hpp"
+
+namespace nano_vectordb
+{
+namespace kmeans
+{
+
+/**
+ * @brief Rows assigned per matrix-matrix product
+ */
+constexpr std::size_t kTileRows = 1024;
+
+/**
+ * @brief Pick n rows uniformly at random without replacement, in random order.
+ *
+ * @param rows Candidate rows.
+ * @param n Number of rows to keep.
+ * @param rng Random generator.
+ * @return std::vector<int> Sampled rows.
+ */
+inline std::vector<int> sample_rows(std::vector<int> rows, std::size_t n, std::mt19937_64& rng)
+{
+  n = std::min(n, rows.size());
+  for (std::size_t i = 0; i < n; ++i)
+    std::swap(rows[i], rows[std::uniform_int_distribution<std::size_t>(i, rows.size() - 1)(rng)]);
+  rows.resize(n);
+  return rows;
+}
+
+/**
+ * @brief Copy rows of the index space into a dense matrix.
+ */
+inline void gather(const IndexSpace& space, const int* rows, std::size_t n, RowMatrixXf& out)
+{
+  const auto dim = static_cast<Eigen::Index>(space.vectors.dim);
+  out.resize(static_cast<Eigen::Index>(n), dim);
+  std::vector<float> scratch(space.scratch_size());
+  for (std::size_t i = 0; i < n; ++i)
+    out.row(static_cast<Eigen::Index>(i)) =
+        Eigen::Map<const Eigen::RowVectorXf>(space.row(rows[i], scratch.data()), dim);
+}
+
+inline std::vector<float> squared_norms(const RowMatrixXf& centroids)
+{
+  std::vector<float> sq(static_cast<std::size_t>(centroids.rows()));
+  for (Eigen::Index c = 0; c < centroids.rows(); ++c)
+    sq[c] = centroids.row(c).squaredNorm();
+  return sq;
+}
+
+/**
+ * @brief Assign every row of x to its nearest centroid, one matrix product per tile of rows.
+ *
+ * @param x Rows to assign.
+ * @param centroids Centroids, one per row.
+ * @param centroid_sq Squared norm of each centroid.
+ * @param inner_product Rank by 1 - dot product instead of squared L2.
+ * @param labels Output: nearest centroid of each row.
+ * @param dists Output: distance of each row to its centroid.
+ */
+inline void assign(const RowMatrixXf& x, const RowMatrixXf& centroids, const std::vector<float>& centroid_sq,
+                   bool inner_product, int* labels, float* dists)
+{
+  const Eigen::Index k = centroids.rows();
+  Eigen::MatrixXf prod;
+  for (Eigen::Index start = 0; start < x.rows(); start += static_cast<Eigen::Index>(kTileRows))
+  {
+    const Eigen::Index len = std::min<Eigen::Index>(kTileRows, x.rows() - start);
+    prod.noalias() = x.middleRows(start, len) * centroids.transpose();
+    for (Eigen::Index r = 0; r < len; ++r)
+    {
+      Eigen::Index best = 0;
+      float best_d = std::numeric_limits<float>::infinity();
+      for (Eigen::Index c = 0; c < k; ++c)
+      {
+        // |c|^2 - 2 x.c ranks like the squared distance; |x|^2 is added back for the winner only
+        const float d = inner_product ? 1.0f - prod(r, c) : centroid_sq[c] - 2.0f * prod(r, c);
+        if (d < best_d)
+        {
+          best_d = d;
+          best = c;
+        }
+      }
+      labels[start + r] = static_cast<int>(best);
+      dists[start + r] = inner_product ? best_d : std::max(0.0f, best_d + x.row(start + r).squaredNorm());
+    }
+  }
+}
+
+/**
+ * @brief Lloyd's k-means, seeded with the first k rows of x.
+ *
+ * Pass rows in random order (see sample_rows()) so the seeds are a random sample. Empty clusters are
+ * re-seeded by splitting the largest cluster.
+ *
+ * @param x Training rows, at least k of them.
+ * @param k Number of centroids.
+ * @param iterations Lloyd iterations.
+ * @param spherical Normalize centroids and assign by dot product (for cosine spaces).
+ * @return RowMatrixXf k x cols centroids.
+ */
+inline RowMatrixXf train(const RowMatrixXf& x, std::size_t k, int iterations, bool spherical)
+{
+  constexpr float kSplitEps = 1.0f / 1024.0f;
+  k = std::max<std::size_t>(1, std::min(k, static_cast<std::size_t>(x.rows())));
+  RowMatrixXf centroids = x.topRows(static_cast<Eigen::Index>(k));
+  auto normalize_centroids = [&] {
+    if (!spherical)
+      return;
+    for (Eigen::Index c = 0; c < centroids.rows(); ++c)
+    {
+      const float norm = centroids.row(c).norm();
+      if (norm > 0.0f)
+        centroids.row(c) /= norm;
+    }
+  };
+  normalize_centroids();
+  const std::size_t n = static_cast<std::size_t>(x.rows());
+  std::vector<int> labels(n);
+  std::vector<float> dists(n);
+  for (int it = 0; it < iterations; ++it)
+  {
+    assign(x, centroids, squared_norms(centroids), spherical, labels.data(), dists.data());
+    RowMatrixXf sums = RowMatrixXf::Zero(centroids.rows(), centroids.cols());
+    std::vector<std::size_t> counts(k, 0);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      sums.row(labels[i]) += x.row(static_cast<Eigen::Index>(i));
+      ++counts[labels[i]];
+    }
+    for (std::size_t c = 0; c < k; ++c)
+    {
+      if (counts[c] > 0)
+        centroids.row(c) = sums.row(c) / static_cast<float>(counts[c]);
+    }
+    for (std::size_t c = 0; c < k; ++c)
+    {
+      if (counts[c] > 0)
+        continue;
+      // Empty cluster: split the largest one by nudging two copies of its centroid apart
+      const std::size_t big = std::max_element(counts.begin(), counts.end()) - counts.begin();
+      centroids.row(c) = centroids.row(big) * (1.0f + kSplitEps);
+      centroids.row(big) *= (1.0f - kSplitEps);
+      counts[c] = counts[big] / 2;
+      counts[big] -= counts[c];
+    }
+    normalize_centroids();
+  }
+  return centroids;
+}
+
+}  // namespace kmeans
+}  // namespace nano_vectordb
@@ -0,0 +1,199 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "quantized.hpp"
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Tuning parameters of the product-quantized index
+ *
+ * @param m Number of sub-quantizers (bytes per code); must divide the dimension. 0 uses dim / 4 (or the
+ * nearest smaller sub-vector width that divides the dimension).
+ * @param iterations k-means iterations per sub-quantizer.
+ * @param rerank Candidates re-ranked at full precision per requested result (0 disables re-ranking).
+ * @param train_sample Maximum number of rows sampled to train the codebooks.
+ * @param min_train_rows Rows collected (and scored exactly) before the codebooks are trained.
+ * @param seed Seed of the sampler.
+ */
+struct PQParams
+{
+  int m = 0;
+  int iterations = 10;
+  int rerank = 8;
+  std::size_t train_sample = 16384;
+  std::size_t min_train_rows = 1024;
+  std::uint64_t seed = 100;
+};
+
+/**
+ * @brief Product quantization with asymmetric distance computation (ADC)
+ *
+ * Vectors are split into `m` sub-vectors, each replaced by the index of its nearest of 256 centroids
+ * trained by k-means on that sub-space, so a code is `m` bytes. A query builds an m x 256 table of
+ * sub-distances once; scoring a code is then `m` table lookups.
+ */
+class PQIndex : public QuantizedIndex
+{
+public:
+  explicit PQIndex(const PQParams& params = {})
+    : QuantizedIndex(params.rerank, params.train_sample, params.min_train_rows, params.seed)
+    , params_(params)
+  {
+  }
+
+  std::size_t code_size() const override
+  {
+    return m_;
+  }
+
+protected:
+  void train_codec(const RowMatrixXf& sample, const IndexSpace&) override
+  {
+    const std::size_t dim = static_cast<std::size_t>(sample.cols());
+    m_ = params_.m > 0 ? static_cast<std::size_t>(params_.m) : dim / default_sub_dim(dim);
+    if (m_ == 0 || dim % m_ != 0)
+    {
+      throw std::runtime_error("PQIndex: m=" + std::to_string(m_) + " does not divide dimension " +
+                               std::to_string(dim));
+    }
+    dsub_ = dim / m_;
+    codebooks_.resize(m_);
+    for (std::size_t j = 0; j < m_; ++j)
+    {
+      const RowMatrixXf sub =
+          sample.middleCols(static_cast<Eigen::Index>(j * dsub_), static_cast<Eigen::Index>(dsub_));
+      codebooks_[j] = kmeans::train(sub, kCentroids, params_.iterations, false);
+    }
+  }
+
+  void encode(const float* v, std::uint8_t* code, const IndexSpace&) const override
+  {
+    for (std::size_t j = 0; j < m_; ++j)
+    {
+      const RowMatrixXf& book = codebooks_[j];
+      const float* sub = v + j * dsub_;
+      int best = 0;
+      float best_d = std::numeric_limits<float>::infinity();
+      for (Eigen::Index c = 0; c < book.rows(); ++c)
+      {
+        const float d = kernels::l2sq(sub, book.row(c).data(), dsub_);
+        if (d < best_d)
+        {
+          best_d = d;
+          best = static_cast<int>(c);
+        }
+      }
+      code[j] = static_cast<std::uint8_t>(best);
+    }
+  }
+
+  void prepare(const float* query, const IndexSpace& space, std::vector<float>& lut) const override
+  {
+    // lut[0] is a per-query constant, then 256 sub-distances per sub-quantizer
+    lut.assign(1 + m_ * kCentroids, 0.0f);
+    lut[0] = space.inner_product ? 1.0f : 0.0f;
+    for (std::size_t j = 0; j < m_; ++j)
+    {
+      const RowMatrixXf& book = codebooks_[j];
+      const float* sub = query + j * dsub_;
+      float* table = lut.data() + 1 + j * kCentroids;
+      for (Eigen::Index c = 0; c < book.rows(); ++c)
+      {
+        table[c] = space.inner_product ? -kernels::dot(sub, book.row(c).data(), dsub_)
+                                       : kernels::l2sq(sub, book.row(c).data(), dsub_);
+      }
+    }
+  }
+
+  void approx_distances(const std::vector<float>& lut, const std::uint8_t* codes, std::size_t n, float* out,
+                        const IndexSpace&) const override
+  {
+    const float* tables = lut.data() + 1;
+    for (std::size_t r = 0; r < n; ++r)
+    {
+      const std::uint8_t* code = codes + r * m_;
+      float d0 = 0.0f, d1 = 0.0f;
+      std::size_t j = 0;
+      for (; j + 2 <= m_; j += 2)
+      {
+        d0 += tables[j * kCentroids + code[j]];
+        d1 += tables[(j + 1) * kCentroids + code[j + 1]];
+      }
+      for (; j < m_; ++j)
+        d0 += tables[j * kCentroids + code[j]];
+      out[r] = lut[0] + d0 + d1;
+    }
+  }
+
+  std::size_t codec_bytes() const override
+  {
+    std::size_t bytes = capacity_bytes(codebooks_);
+    for (const auto& book : codebooks_)
+      bytes += static_cast<std::size_t>(book.size()) * sizeof(float);
+    return bytes;
+  }
+
+  const char* codec_name() const override
+  {
+    return "pq";
+  }
+
+  void write_codec(std::string& out) const override
+  {
+    put(out, static_cast<std::uint64_t>(m_));
+    put(out, static_cast<std::uint64_t>(dsub_));
+    for (const RowMatrixXf& book : codebooks_)
+    {
+      put(out, static_cast<std::uint64_t>(book.rows()));
+      put(out, book.data(), static_cast<std::size_t>(book.size()));
+    }
+  }
+
+  bool read_codec(const std::string& in, const IndexSpace& space) override
+  {
+    std::size_t pos = 0;
+    std::uint64_t m = 0, dsub = 0;
+    if (!take(in, pos, m) || !take(in, pos, dsub) || m == 0 || m * dsub != space.vectors.dim)
+      return false;
+    m_ = m;
+    dsub_ = dsub;
+    codebooks_.assign(m_, RowMatrixXf());
+    for (RowMatrixXf& book : codebooks_)
+    {
+      std::uint64_t centroids = 0;
+      if (!take(in, pos, centroids) || centroids == 0 || centroids > kCentroids)
+        return false;
+      book.resize(static_cast<Eigen::Index>(centroids), static_cast<Eigen::Index>(dsub_));
+      if (!take(in, pos, book.data(), static_cast<std::size_t>(book.size())))
+        return false;
+    }
+    return true;
+  }
+
+private:
+  static constexpr std::size_t kCentroids = 256;
+
+  static std::size_t default_sub_dim(std::size_t dim)
+  {
+    for (std::size_t d : { 4, 2 })
+    {
+      if (dim % d == 0)
+        return d;
+    }
+    return 1;
+  }
+
+  PQParams params_;
+  std::size_t m_ = 0;
+  std::size_t dsub_ = 0;
+  std::vector<RowMatrixXf> codebooks_;  // per sub-quantizer: up to 256 x dsub centroids
+};
+
+}  // namespace nano_vectordb
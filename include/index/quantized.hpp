@@ -0,0 +1,422 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "base.hpp"
+#include "kmeans.hpp"
+#include "../bitmap.hpp"
+#include "../structs.hpp"
+#include "../topk.hpp"
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Common machinery of indexes that scan compressed codes and re-rank exactly
+ *
+ * Each indexed row holds a fixed-size code in one contiguous array. A query scores every code with an
+ * approximate distance, keeps the best `rerank * k` candidates and re-scores those against the
+ * full-precision rows of the IndexSpace. Rows indexed before the codec is trained are scored exactly.
+ * Derived classes provide the codec: training, encoding, and a per-query lookup table with a block
+ * scorer.
+ *
+ * A trained index can be saved next to a column storage file (see IPersistentIndex), so a database
+ * mapped from that file loads the codes instead of reading every full-precision row to encode them.
+ * Candidate rows of a mapped database are prefetched together before they are re-ranked.
+ */
+class QuantizedIndex : public IIndex, public IPersistentIndex
+{
+public:
+  /**
+   * @brief Change the number of candidates re-ranked per result.
+   *
+   * @param factor Candidates kept per requested result; 0 returns approximate scores without re-ranking.
+   */
+  void set_rerank(int factor)
+  {
+    rerank_ = factor;
+  }
+
+  int rerank() const
+  {
+    return rerank_;
+  }
+
+  bool trained() const
+  {
+    return trained_;
+  }
+
+  void build(const IndexSpace& space, const std::vector<int>& rows) override
+  {
+    clear();
+    if (rows.size() >= min_train_rows_)
+      train(space, rows);
+    for (int row : rows)
+      add(row, space);
+  }
+
+  void clear() override
+  {
+    codes_.clear();
+    present_ = Bitmap();
+    pending_.clear();
+    trained_ = false;
+    size_ = 0;
+  }
+
+  void add(int row, const IndexSpace& space) override
+  {
+    remove(row, space);
+    if (!trained_)
+    {
+      pending_.push_back(row);
+      ++size_;
+      if (pending_.size() >= min_train_rows_)
+      {
+        // Enough rows to train the codec: encode everything collected so far
+        std::vector<int> rows;
+        rows.swap(pending_);
+        size_ = 0;
+        train(space, rows);
+        for (int r : rows)
+          add(r, space);
+      }
+      return;
+    }
+    const std::size_t cs = code_size();
+    if (static_cast<std::size_t>(row) >= present_.size())
+    {
+      present_.resize(static_cast<std::size_t>(row) + 1);
+      codes_.resize(present_.size() * cs);
+    }
+    std::uint8_t* code = &codes_[static_cast<std::size_t>(row) * cs];
+    std::vector<float> scratch(space.scratch_size());
+    encode(space.row(row, scratch.data()), code, space);
+    present_.set(row);
+    ++size_;
+  }
+
+  void remove(int row, const IndexSpace&) override
+  {
+    if (static_cast<std::size_t>(row) < present_.size() && present_.test(row))
+    {
+      present_.reset(row);
+      --size_;
+      return;
+    }
+    auto it = std::find(pending_.begin(), pending_.end(), row);
+    if (it != pending_.end())
+    {
+      pending_.erase(it);
+      --size_;
+    }
+  }
+
+  void remap(const std::vector<int>& new_row_of) override
+  {
+    const std::size_t cs = code_size();
+    std::size_t n = 0;
+    for (std::size_t old = 0; old < present_.size() && old < new_row_of.size(); ++old)
+    {
+      if (present_.test(old) && new_row_of[old] >= 0)
+        n = std::max(n, static_cast<std::size_t>(new_row_of[old]) + 1);
+    }
+    std::vector<std::uint8_t> codes(n * cs);
+    Bitmap present(n);
+    for (std::size_t old = 0; old < present_.size() && old < new_row_of.size(); ++old)
+    {
+      const int nr = new_row_of[old];
+      if (!present_.test(old) || nr < 0)
+        continue;
+      std::copy_n(&codes_[old * cs], cs, &codes[static_cast<std::size_t>(nr) * cs]);
+      present.set(nr);
+    }
+    codes_ = std::move(codes);
+    present_ = std::move(present);
+    std::size_t keep = 0;
+    for (int row : pending_)
+    {
+      if (static_cast<std::size_t>(row) < new_row_of.size() && new_row_of[row] >= 0)
+        pending_[keep++] = new_row_of[row];
+    }
+    pending_.resize(keep);
+    size_ = present_.count() + pending_.size();
+  }
+
+  std::vector<std::pair<int, float>> search(const float* query, int k, const IndexSpace& space,
+                                            const RowFilter& allow) const override
+  {
+    // Candidates are ranked by negated distance so TopK keeps the nearest
+    TopK candidates(rerank_ > 0 ? k * rerank_ : k, std::nullopt);
+    for (int row : pending_)
+    {
+      if (!allow || allow(row))
+        candidates.push(row, -space.distance(query, row));
+    }
+    if (trained_)
+    {
+      std::vector<float> lut;
+      prepare(query, space, lut);
+      const std::size_t cs = code_size();
+      std::vector<float> dists(kBlockRows);
+      for (std::size_t start = 0; start < present_.size(); start += kBlockRows)
+      {
+        const std::size_t len = std::min(kBlockRows, present_.size() - start);
+        if (!present_.any(start, start + len))
+          continue;
+        approx_distances(lut, &codes_[start * cs], len, dists.data(), space);
+        for (std::size_t r = 0; r < len; ++r)
+        {
+          const int row = static_cast<int>(start + r);
+          if (present_.test(row) && (!allow || allow(row)))
+            candidates.push(row, -dists[r]);
+        }
+      }
+    }
+    std::vector<std::pair<int, float>> ranked = candidates.take_sorted();
+    if (rerank_ <= 0)
+    {
+      for (auto& [row, s] : ranked)
+        s = space.score(-s);
+      return ranked;
+    }
+    space.prefetch(ranked);
+    TopK exact(k, std::nullopt);
+    for (const auto& [row, s] : ranked)
+      exact.push(row, space.score(space.distance(query, row)));
+    return exact.take_sorted();
+  }
+
+  std::size_t size() const override
+  {
+    return size_;
+  }
+
+  std::size_t memory_bytes() const override
+  {
+    return capacity_bytes(codes_) + present_.memory_bytes() + capacity_bytes(pending_) + codec_bytes();
+  }
+
+  /**
+   * @brief Bytes of code stored per row.
+   */
+  virtual std::size_t code_size() const = 0;
+
+  void save(const std::string& path, const std::vector<int>& rows, std::uint64_t fingerprint) const override
+  {
+    std::error_code ec;
+    if (!trained_)
+    {
+      // Rows before training are scored exactly; rebuilding them is cheaper than a file
+      std::filesystem::remove(path, ec);
+      return;
+    }
+    std::string codec;
+    write_codec(codec);
+    const std::size_t cs = code_size();
+    FileHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    codec_field(h.codec);
+    h.version = kVersion;
+    h.code_size = static_cast<std::uint32_t>(cs);
+    h.fingerprint = fingerprint;
+    h.rows = rows.size();
+    h.codec_bytes = codec.size();
+    const std::string tmp = path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!out)
+      throw std::runtime_error("QuantizedIndex: cannot open for write: " + tmp);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(codec.data(), static_cast<std::streamsize>(codec.size()));
+    // Rows without a code (never indexed) are written as zeros; load() does not mark them present
+    const std::vector<std::uint8_t> blank(cs, 0);
+    for (int row : rows)
+    {
+      const auto r = static_cast<std::size_t>(row);
+      const std::uint8_t* code = r < present_.size() ? &codes_[r * cs] : blank.data();
+      out.write(reinterpret_cast<const char*>(code), static_cast<std::streamsize>(cs));
+    }
+    out.close();
+    if (!out)
+      throw std::runtime_error("QuantizedIndex: write failed: " + tmp);
+    std::filesystem::rename(tmp, path);
+  }
+
+  bool load(const std::string& path, const IndexSpace& space, const std::vector<int>& live,
+            std::uint64_t fingerprint) override
+  {
+    clear();
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      return false;
+    FileHeader h{};
+    in.read(reinterpret_cast<char*>(&h), sizeof(h));
+    char name[sizeof(h.codec)];
+    codec_field(name);
+    if (!in || std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion ||
+        std::memcmp(h.codec, name, sizeof(name)) != 0 || h.fingerprint != fingerprint ||
+        h.rows != space.vectors.rows)
+      return false;
+    std::string codec(h.codec_bytes, '\0');
+    in.read(codec.data(), static_cast<std::streamsize>(codec.size()));
+    if (!in || !read_codec(codec, space) || code_size() != h.code_size)
+      return false;
+    const std::size_t cs = code_size();
+    std::vector<std::uint8_t> codes(h.rows * cs);
+    in.read(reinterpret_cast<char*>(codes.data()), static_cast<std::streamsize>(codes.size()));
+    if (!in)
+      return false;
+    codes_ = std::move(codes);
+    present_ = Bitmap(h.rows);
+    for (int row : live)
+      present_.set(row);
+    size_ = live.size();
+    trained_ = true;
+    return true;
+  }
+
+protected:
+  QuantizedIndex(int rerank, std::size_t train_sample, std::size_t min_train_rows, std::uint64_t seed)
+    : rerank_(rerank)
+    , train_sample_(train_sample)
+    , min_train_rows_(std::max<std::size_t>(1, min_train_rows))
+    , rng_(seed)
+  {
+  }
+
+  /**
+   * @brief Fit the codec to a random sample of the rows (one row per matrix row).
+   */
+  virtual void train_codec(const RowMatrixXf& sample, const IndexSpace& space) = 0;
+
+  /**
+   * @brief Write the code of one vector.
+   */
+  virtual void encode(const float* v, std::uint8_t* code, const IndexSpace& space) const = 0;
+
+  /**
+   * @brief Build the per-query lookup table used by approx_distances().
+   */
+  virtual void prepare(const float* query, const IndexSpace& space, std::vector<float>& lut) const = 0;
+
+  /**
+   * @brief Approximate distances of the query to n consecutive codes.
+   */
+  virtual void approx_distances(const std::vector<float>& lut, const std::uint8_t* codes, std::size_t n,
+                                float* out, const IndexSpace& space) const = 0;
+
+  /**
+   * @brief Bytes allocated by the trained codec.
+   */
+  virtual std::size_t codec_bytes() const = 0;
+
+  /**
+   * @brief Name of the codec in saved index files (at most 8 characters).
+   */
+  virtual const char* codec_name() const = 0;
+
+  /**
+   * @brief Append the trained codec to out, in the form read_codec() reads back.
+   */
+  virtual void write_codec(std::string& out) const = 0;
+
+  /**
+   * @brief Restore a codec written by write_codec(); false if it is malformed or does not fit space.
+   */
+  virtual bool read_codec(const std::string& in, const IndexSpace& space) = 0;
+
+  template <typename T>
+  static void put(std::string& out, T value)
+  {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+  }
+
+  static void put(std::string& out, const float* values, std::size_t n)
+  {
+    out.append(reinterpret_cast<const char*>(values), n * sizeof(float));
+  }
+
+  /**
+   * @brief Read sizeof(T) bytes at pos and advance it; false past the end of in.
+   */
+  template <typename T>
+  static bool take(const std::string& in, std::size_t& pos, T& value)
+  {
+    if (in.size() - pos < sizeof(T))
+      return false;
+    std::memcpy(&value, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
+
+  static bool take(const std::string& in, std::size_t& pos, float* values, std::size_t n)
+  {
+    if ((in.size() - pos) / sizeof(float) < n)
+      return false;
+    std::memcpy(values, in.data() + pos, n * sizeof(float));
+    pos += n * sizeof(float);
+    return true;
+  }
+
+private:
+  static constexpr std::size_t kBlockRows = 1024;
+  static constexpr char kMagic[8] = { 'N', 'V', 'D', 'B', 'Q', 'I', 'D', 'X' };
+  static constexpr std::uint32_t kVersion = 1;
+
+  // Index file layout: header, codec bytes, then code_size bytes per row; host byte order
+  struct FileHeader
+  {
+    char magic[8];
+    char codec[8];
+    std::uint32_t version;
+    std::uint32_t code_size;
+    std::uint64_t fingerprint;
+    std::uint64_t rows;
+    std::uint64_t codec_bytes;
+  };
+
+  /**
+   * @brief codec_name() as stored in FileHeader::codec: zero padded, cut to the field and compared with
+   *        memcmp(), so it need not be null-terminated.
+   */
+  void codec_field(char (&out)[sizeof(FileHeader::codec)]) const
+  {
+    const char* name = codec_name();
+    std::memset(out, 0, sizeof(out));
+    std::memcpy(out, name, std::min(std::strlen(name), sizeof(out)));
+  }
+
+  void train(const IndexSpace& space, const std::vector<int>& rows)
+  {
+    const std::vector<int> sample = kmeans::sample_rows(rows, train_sample_, rng_);
+    RowMatrixXf x;
+    kmeans::gather(space, sample.data(), sample.size(), x);
+    train_codec(x, space);
+    codes_.clear();
+    present_ = Bitmap();
+    trained_ = true;
+  }
+
+  int rerank_;
+  std::size_t train_sample_;
+  std::size_t min_train_rows_;
+  std::mt19937_64 rng_;
+  bool trained_ = false;
+  std::vector<std::uint8_t> codes_;  // code_size() bytes per row
+  Bitmap present_;                   // rows holding a code
+  std::vector<int> pending_;         // rows indexed before training, scored exactly
+  std::size_t size_ = 0;
+};
+
+}  // namespace nano_vectordb
@@ -0,0 +1,157 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "quantized.hpp"
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Tuning parameters of the int8 scalar-quantized index
+ *
+ * @param rerank Candidates re-ranked at full precision per requested result (0 disables re-ranking).
+ * @param train_sample Maximum number of rows sampled to fit the per-dimension ranges.
+ * @param min_train_rows Rows collected (and scored exactly) before the codec is trained.
+ * @param seed Seed of the sampler.
+ */
+struct SQ8Params
+{
+  int rerank = 4;
+  std::size_t train_sample = 65536;
+  std::size_t min_train_rows = 1024;
+  std::uint64_t seed = 100;
+};
+
+/**
+ * @brief Per-dimension 8-bit scalar quantization
+ *
+ * Every dimension is mapped linearly from its trained [min, max] range onto 0..255, so a code is one
+ * byte per dimension (4x smaller than fp32) plus a cached float. Both distances reduce to a dot product
+ * of per-query float weights with the byte codes, scored by the SIMD `kernels::dot_u8` kernel.
+ */
+class SQ8Index : public QuantizedIndex
+{
+public:
+  explicit SQ8Index(const SQ8Params& params = {})
+    : QuantizedIndex(params.rerank, params.train_sample, params.min_train_rows, params.seed)
+  {
+  }
+
+  std::size_t code_size() const override
+  {
+    // dim bytes, then sum_i (scale_i * c_i)^2 for the squared-L2 expansion
+    return min_.size() + sizeof(float);
+  }
+
+protected:
+  void train_codec(const RowMatrixXf& sample, const IndexSpace&) override
+  {
+    const std::size_t dim = static_cast<std::size_t>(sample.cols());
+    min_.resize(dim);
+    scale_.resize(dim);
+    for (std::size_t i = 0; i < dim; ++i)
+    {
+      const float lo = sample.col(i).minCoeff();
+      const float hi = sample.col(i).maxCoeff();
+      min_[i] = lo;
+      scale_[i] = hi > lo ? (hi - lo) / 255.0f : 1.0f;
+    }
+  }
+
+  void encode(const float* v, std::uint8_t* code, const IndexSpace&) const override
+  {
+    float sq = 0.0f;
+    for (std::size_t i = 0; i < min_.size(); ++i)
+    {
+      // Values outside the trained range saturate
+      const float q = std::round((v[i] - min_[i]) / scale_[i]);
+      code[i] = static_cast<std::uint8_t>(std::clamp(q, 0.0f, 255.0f));
+      const float dq = scale_[i] * code[i];
+      sq += dq * dq;
+    }
+    std::memcpy(code + min_.size(), &sq, sizeof(float));
+  }
+
+  void prepare(const float* query, const IndexSpace& space, std::vector<float>& lut) const override
+  {
+    // lut[0] is a per-query constant, lut[1..dim] the weights applied to the codes
+    const std::size_t dim = min_.size();
+    lut.assign(dim + 1, 0.0f);
+    for (std::size_t i = 0; i < dim; ++i)
+    {
+      if (space.inner_product)
+      {
+        // 1 - q.(min + scale * c)
+        lut[0] -= query[i] * min_[i];
+        lut[1 + i] = -query[i] * scale_[i];
+      }
+      else
+      {
+        // |q - min|^2 - 2 (q - min).(scale * c) + |scale * c|^2
+        const float d = query[i] - min_[i];
+        lut[0] += d * d;
+        lut[1 + i] = -2.0f * d * scale_[i];
+      }
+    }
+    if (space.inner_product)
+      lut[0] += 1.0f;
+  }
+
+  void approx_distances(const std::vector<float>& lut, const std::uint8_t* codes, std::size_t n, float* out,
+                        const IndexSpace& space) const override
+  {
+    const std::size_t dim = min_.size();
+    const std::size_t cs = code_size();
+    for (std::size_t r = 0; r < n; ++r)
+    {
+      const std::uint8_t* code = codes + r * cs;
+      float d = lut[0] + kernels::dot_u8(lut.data() + 1, code, dim);
+      if (!space.inner_product)
+      {
+        float sq;
+        std::memcpy(&sq, code + dim, sizeof(float));
+        d += sq;
+      }
+      out[r] = d;
+    }
+  }
+
+  std::size_t codec_bytes() const override
+  {
+    return capacity_bytes(min_) + capacity_bytes(scale_);
+  }
+
+  const char* codec_name() const override
+  {
+    return "sq8";
+  }
+
+  void write_codec(std::string& out) const override
+  {
+    put(out, static_cast<std::uint64_t>(min_.size()));
+    put(out, min_.data(), min_.size());
+    put(out, scale_.data(), scale_.size());
+  }
+
+  bool read_codec(const std::string& in, const IndexSpace& space) override
+  {
+    std::size_t pos = 0;
+    std::uint64_t dim = 0;
+    if (!take(in, pos, dim) || dim != space.vectors.dim)
+      return false;
+    min_.resize(dim);
+    scale_.resize(dim);
+    return take(in, pos, min_.data(), dim) && take(in, pos, scale_.data(), dim);
+  }
+
+private:
+  std::vector<float> min_;    // lower end of each dimension's range
+  std::vector<float> scale_;  // width of one quantization step per dimension
+};
+
+}  // namespace nano_vectordb
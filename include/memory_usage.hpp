@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Heap bytes held by a database, by component; see NanoVectorDB::memory_usage().
+ */
+struct MemoryUsage
+{
+  std::size_t vectors = 0;   // owned row store and cached row norms
+  std::size_t ids = 0;       // record ids and the id -> row index
+  std::size_t metadata = 0;  // metadata columns and additional data
+  std::size_t index = 0;     // approximate index structures
+  std::size_t other = 0;     // tombstones, free rows and saved-change tracking
+  std::size_t mapped = 0;    // rows read in place from a file mapping; not part of total()
+
+  /**
+   * @brief Bytes of heap memory, excluding file mappings the OS can reclaim.
+   */
+  std::size_t total() const
+  {
+    return vectors + ids + metadata + index + other;
+  }
+};
+
+/**
+ * @brief Bytes allocated by a vector (its capacity, not its size).
+ */
+template <typename T>
+inline std::size_t capacity_bytes(const std::vector<T>& v)
+{
+  return v.capacity() * sizeof(T);
+}
+
+/**
+ * @brief Heap bytes of a string; short strings stored inline (SSO) count as 0.
+ */
+inline std::size_t heap_bytes(const std::string& s)
+{
+  const char* data = s.data();
+  const char* self = reinterpret_cast<const char*>(&s);
+  if (data >= self && data < self + sizeof(std::string))
+    return 0;
+  return s.capacity() + 1;
+}
+
+/**
+ * @brief Allocated bytes of a vector of strings, including out-of-line characters.
+ */
+inline std::size_t heap_bytes(const std::vector<std::string>& v)
+{
+  std::size_t bytes = capacity_bytes(v);
+  for (const auto& s : v)
+    bytes += heap_bytes(s);
+  return bytes;
+}
+
+/**
+ * @brief Allocated bytes of a node-based hash container: bucket array plus one node (value and next
+ *        pointer, plus the cached hash) per element.
+ */
+template <typename Container>
+inline std::size_t hash_table_bytes(const Container& c)
+{
+  using value_type = typename Container::value_type;
+  return c.bucket_count() * sizeof(void*) + c.size() * (sizeof(value_type) + 2 * sizeof(void*));
+}
+
+/**
+ * @brief hash_table_bytes() plus the out-of-line characters of string keys.
+ */
+template <typename Value>
+inline std::size_t heap_bytes(const std::unordered_map<std::string, Value>& m)
+{
+  std::size_t bytes = hash_table_bytes(m);
+  for (const auto& entry : m)
+    bytes += heap_bytes(entry.first);
+  return bytes;
+}
+
+inline std::size_t heap_bytes(const std::unordered_set<std::string>& s)
+{
+  std::size_t bytes = hash_table_bytes(s);
+  for (const auto& key : s)
+    bytes += heap_bytes(key);
+  return bytes;
+}
+
+}  // namespace nano_vectordb
@@ -0,0 +1,560 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "bitmap.hpp"
+#include "memory_usage.hpp"
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Type of a metadata column
+ *
+ * @param Int One 64-bit integer per row; supports equality, set and range predicates
+ * @param Enum One string label per row, dictionary-encoded
+ * @param Tags Any number of string labels per row, stored as one row bitmap per label
+ */
+enum class column_type
+{
+  Int,
+  Enum,
+  Tags
+};
+
+inline std::string column_type_name(column_type type)
+{
+  switch (type)
+  {
+    case column_type::Enum:
+      return "enum";
+    case column_type::Tags:
+      return "tags";
+    case column_type::Int:
+      break;
+  }
+  return "int";
+}
+
+inline column_type column_type_from_name(const std::string& name)
+{
+  if (name == "int")
+    return column_type::Int;
+  if (name == "enum")
+    return column_type::Enum;
+  if (name == "tags")
+    return column_type::Tags;
+  throw std::runtime_error("Unknown metadata column type: " + name);
+}
+
+/**
+ * @brief Filter over metadata columns, built with the helpers in namespace `where`
+ *
+ * Predicates are evaluated once per query into a row bitmap, so the scan tests one bit per row
+ * instead of calling a filter function.
+ */
+struct Predicate
+{
+  enum class kind
+  {
+    In,     // column value is one of ints / labels (a Tags row matches if it carries any of them)
+    Range,  // lo <= value <= hi on an Int column
+    And,
+    Or
+  };
+
+  kind op = kind::And;
+  std::string column;
+  std::vector<std::int64_t> ints;   // In on an Int column
+  std::vector<std::string> labels;  // In on an Enum or Tags column
+  std::int64_t lo = 0;
+  std::int64_t hi = 0;
+  std::vector<Predicate> children;  // And / Or operands
+};
+
+namespace detail
+{
+inline Predicate combine(Predicate::kind op, Predicate a, Predicate b)
+{
+  Predicate p;
+  p.op = op;
+  for (Predicate* side : { &a, &b })
+  {
+    // Flatten chains such as a && b && c into one node
+    if (side->op == op)
+    {
+      for (auto& c : side->children)
+        p.children.push_back(std::move(c));
+    }
+    else
+    {
+      p.children.push_back(std::move(*side));
+    }
+  }
+  return p;
+}
+}  // namespace detail
+
+/**
+ * @brief Rows matching both predicates.
+ */
+inline Predicate operator&&(Predicate a, Predicate b)
+{
+  return detail::combine(Predicate::kind::And, std::move(a), std::move(b));
+}
+
+/**
+ * @brief Rows matching either predicate.
+ */
+inline Predicate operator||(Predicate a, Predicate b)
+{
+  return detail::combine(Predicate::kind::Or, std::move(a), std::move(b));
+}
+
+/**
+ * @brief Predicate builders, e.g. `where::eq("lang", "en") && where::range("year", 2000, 2010)`
+ */
+namespace where
+{
+
+inline Predicate in(const std::string& column, std::vector<std::int64_t> values)
+{
+  Predicate p;
+  p.op = Predicate::kind::In;
+  p.column = column;
+  p.ints = std::move(values);
+  return p;
+}
+
+inline Predicate in(const std::string& column, std::vector<std::string> labels)
+{
+  Predicate p;
+  p.op = Predicate::kind::In;
+  p.column = column;
+  p.labels = std::move(labels);
+  return p;
+}
+
+/**
+ * @brief Label list written as string literals, e.g. `where::in("lang", { "en", "fr" })`.
+ */
+inline Predicate in(const std::string& column, std::initializer_list<const char*> labels)
+{
+  return in(column, std::vector<std::string>(labels.begin(), labels.end()));
+}
+
+inline Predicate eq(const std::string& column, std::int64_t value)
+{
+  return in(column, std::vector<std::int64_t>{ value });
+}
+
+/**
+ * @brief Enum column equal to label, or Tags column carrying label.
+ */
+inline Predicate eq(const std::string& column, const std::string& label)
+{
+  return in(column, std::vector<std::string>{ label });
+}
+
+/**
+ * @brief Int column within [lo, hi].
+ */
+inline Predicate range(const std::string& column, std::int64_t lo, std::int64_t hi)
+{
+  Predicate p;
+  p.op = Predicate::kind::Range;
+  p.column = column;
+  p.lo = lo;
+  p.hi = hi;
+  return p;
+}
+
+}  // namespace where
+
+/**
+ * @brief Typed metadata columns, indexed by database row
+ *
+ * Int and Enum columns hold one value per row in a dense array with a presence bitmap; Tags columns
+ * hold one row bitmap per label, so tag predicates reduce to bitmap unions. Rows without a value never
+ * match. Columns grow on demand as values are set.
+ */
+class MetadataStore
+{
+public:
+  /**
+   * @brief Declare a column; re-declaring it with the same type is a no-op.
+   */
+  void add_column(const std::string& name, column_type type)
+  {
+    auto it = index_.find(name);
+    if (it != index_.end())
+    {
+      if (columns_[it->second].type != type)
+        throw std::runtime_error("Metadata column '" + name + "' already exists with another type");
+      return;
+    }
+    index_.emplace(name, columns_.size());
+    Column column;
+    column.name = name;
+    column.type = type;
+    columns_.push_back(std::move(column));
+  }
+
+  bool empty() const
+  {
+    return columns_.empty();
+  }
+
+  bool has_column(const std::string& name) const
+  {
+    return index_.count(name) > 0;
+  }
+
+  void set_int(std::size_t row, const std::string& name, std::int64_t value)
+  {
+    Column& c = column(name, column_type::Int);
+    grow(c, row);
+    c.ints[row] = value;
+    c.present.set(row);
+  }
+
+  void set_enum(std::size_t row, const std::string& name, const std::string& label)
+  {
+    Column& c = column(name, column_type::Enum);
+    grow(c, row);
+    c.codes[row] = intern(c, label);
+    c.present.set(row);
+  }
+
+  /**
+   * @brief Replace the tags of a row.
+   */
+  void set_tags(std::size_t row, const std::string& name, const std::vector<std::string>& tags)
+  {
+    Column& c = column(name, column_type::Tags);
+    clear_tags(c, row);
+    for (const auto& tag : tags)
+    {
+      Bitmap& rows = c.tag_rows[intern(c, tag)];
+      if (row >= rows.size())
+        rows.resize(std::max(row + 1, rows.size() + rows.size() / 2));
+      rows.set(row);
+    }
+  }
+
+  /**
+   * @brief Drop every value held by a row (called when the row is removed).
+   */
+  void clear_row(std::size_t row)
+  {
+    for (Column& c : columns_)
+    {
+      if (c.type == column_type::Tags)
+        clear_tags(c, row);
+      else if (row < c.present.size())
+        c.present.reset(row);
+    }
+  }
+
+  /**
+   * @brief Renumber rows after the database compacted its storage.
+   *
+   * @param new_row_of New row number of every old row, or -1 for dropped rows.
+   * @param rows Number of rows after compaction.
+   */
+  void remap(const std::vector<int>& new_row_of, std::size_t rows)
+  {
+    auto moved = [&](std::size_t old) {
+      return old < new_row_of.size() ? new_row_of[old] : -1;
+    };
+    for (Column& c : columns_)
+    {
+      if (c.type == column_type::Tags)
+      {
+        for (Bitmap& tag : c.tag_rows)
+        {
+          Bitmap fresh(rows);
+          for (std::size_t old = 0; old < tag.size(); ++old)
+          {
+            if (tag.test(old) && moved(old) >= 0)
+              fresh.set(moved(old));
+          }
+          tag = std::move(fresh);
+        }
+        continue;
+      }
+      Bitmap present(rows);
+      std::vector<std::int64_t> ints(c.type == column_type::Int ? rows : 0);
+      std::vector<std::uint32_t> codes(c.type == column_type::Enum ? rows : 0);
+      for (std::size_t old = 0; old < c.present.size(); ++old)
+      {
+        const int nr = moved(old);
+        if (!c.present.test(old) || nr < 0)
+          continue;
+        present.set(nr);
+        if (c.type == column_type::Int)
+          ints[nr] = c.ints[old];
+        else
+          codes[nr] = c.codes[old];
+      }
+      c.present = std::move(present);
+      c.ints = std::move(ints);
+      c.codes = std::move(codes);
+    }
+  }
+
+  /**
+   * @brief Rows in [0, rows) matching a predicate.
+   */
+  Bitmap evaluate(const Predicate& p, std::size_t rows) const
+  {
+    switch (p.op)
+    {
+      case Predicate::kind::And:
+      {
+        Bitmap out(rows, true);
+        for (const auto& c : p.children)
+          out &= evaluate(c, rows);
+        return out;
+      }
+      case Predicate::kind::Or:
+      {
+        Bitmap out(rows);
+        for (const auto& c : p.children)
+          out |= evaluate(c, rows);
+        return out;
+      }
+      case Predicate::kind::Range:
+      {
+        auto within = [&](std::int64_t v) { return p.lo <= v && v <= p.hi; };
+        return match_ints(column(p.column), rows, within, "range");
+      }
+      case Predicate::kind::In:
+        break;
+    }
+    const Column& c = column(p.column);
+    if (c.type == column_type::Int)
+    {
+      if (!p.labels.empty())
+        throw std::runtime_error("Metadata column '" + c.name + "' holds integers, not labels");
+      std::vector<std::int64_t> wanted = p.ints;
+      std::sort(wanted.begin(), wanted.end());
+      auto listed = [&](std::int64_t v) { return std::binary_search(wanted.begin(), wanted.end(), v); };
+      return match_ints(c, rows, listed, "in");
+    }
+    if (!p.ints.empty())
+      throw std::runtime_error("Metadata column '" + c.name + "' holds labels, not integers");
+    Bitmap out(rows);
+    if (c.type == column_type::Tags)
+    {
+      for (const auto& label : p.labels)
+      {
+        auto it = c.code_of.find(label);
+        if (it != c.code_of.end())
+          out |= c.tag_rows[it->second];
+      }
+      return out;
+    }
+    std::vector<char> wanted(c.dictionary.size(), 0);
+    bool any = false;
+    for (const auto& label : p.labels)
+    {
+      auto it = c.code_of.find(label);
+      if (it != c.code_of.end())
+      {
+        wanted[it->second] = 1;
+        any = true;
+      }
+    }
+    if (!any)
+      return out;
+    const std::size_t n = std::min(rows, c.present.size());
+    for (std::size_t r = 0; r < n; ++r)
+    {
+      if (c.present.test(r) && wanted[c.codes[r]])
+        out.set(r);
+    }
+    return out;
+  }
+
+  /**
+   * @brief Values held by a row, as {column: value}; tags are arrays of labels.
+   */
+  nlohmann::json row_json(std::size_t row) const
+  {
+    nlohmann::json out = nlohmann::json::object();
+    for (const Column& c : columns_)
+    {
+      if (c.type == column_type::Tags)
+      {
+        nlohmann::json tags = nlohmann::json::array();
+        for (std::size_t t = 0; t < c.tag_rows.size(); ++t)
+        {
+          if (row < c.tag_rows[t].size() && c.tag_rows[t].test(row))
+            tags.push_back(c.dictionary[t]);
+        }
+        if (!tags.empty())
+          out[c.name] = tags;
+      }
+      else if (row < c.present.size() && c.present.test(row))
+      {
+        if (c.type == column_type::Int)
+          out[c.name] = c.ints[row];
+        else
+          out[c.name] = c.dictionary[c.codes[row]];
+      }
+    }
+    return out;
+  }
+
+  /**
+   * @brief Set the values of a row from the format written by row_json().
+   */
+  void set_row_json(std::size_t row, const nlohmann::json& values)
+  {
+    for (const auto& [name, value] : values.items())
+    {
+      auto it = index_.find(name);
+      if (it == index_.end())
+        throw std::runtime_error("Unknown metadata column: " + name);
+      switch (columns_[it->second].type)
+      {
+        case column_type::Int:
+          set_int(row, name, value.get<std::int64_t>());
+          break;
+        case column_type::Enum:
+          set_enum(row, name, value.get<std::string>());
+          break;
+        case column_type::Tags:
+          set_tags(row, name, value.get<std::vector<std::string>>());
+          break;
+      }
+    }
+  }
+
+  /**
+   * @brief Column names and types, as [{name, type}].
+   */
+  nlohmann::json schema_json() const
+  {
+    nlohmann::json out = nlohmann::json::array();
+    for (const Column& c : columns_)
+      out.push_back({ { "name", c.name }, { "type", column_type_name(c.type) } });
+    return out;
+  }
+
+  /**
+   * @brief Bytes allocated for the columns, their values, dictionaries and tag bitmaps.
+   */
+  std::size_t memory_bytes() const
+  {
+    std::size_t bytes = capacity_bytes(columns_) + heap_bytes(index_);
+    for (const Column& c : columns_)
+    {
+      bytes += heap_bytes(c.name) + c.present.memory_bytes() + capacity_bytes(c.ints) +
+               capacity_bytes(c.codes) + heap_bytes(c.dictionary) + heap_bytes(c.code_of) +
+               capacity_bytes(c.tag_rows);
+      for (const Bitmap& rows : c.tag_rows)
+        bytes += rows.memory_bytes();
+    }
+    return bytes;
+  }
+
+private:
+  struct Column
+  {
+    std::string name;
+    column_type type;
+    Bitmap present;                       // Int / Enum: rows holding a value
+    std::vector<std::int64_t> ints;       // Int: value of each row
+    std::vector<std::uint32_t> codes;     // Enum: dictionary code of each row
+    std::vector<std::string> dictionary;  // Enum / Tags: label of each code
+    std::unordered_map<std::string, std::uint32_t> code_of;
+    std::vector<Bitmap> tag_rows;         // Tags: rows carrying each label
+  };
+
+  Column& column(const std::string& name, column_type expected)
+  {
+    auto it = index_.find(name);
+    if (it == index_.end())
+      throw std::runtime_error("Unknown metadata column: " + name);
+    Column& c = columns_[it->second];
+    if (c.type != expected)
+    {
+      throw std::runtime_error("Metadata column '" + name + "' has type " + column_type_name(c.type) +
+                               ", not " + column_type_name(expected));
+    }
+    return c;
+  }
+
+  const Column& column(const std::string& name) const
+  {
+    auto it = index_.find(name);
+    if (it == index_.end())
+      throw std::runtime_error("Unknown metadata column: " + name);
+    return columns_[it->second];
+  }
+
+  static void grow(Column& c, std::size_t row)
+  {
+    if (row < c.present.size())
+      return;
+    const std::size_t n = std::max(row + 1, c.present.size() + c.present.size() / 2);
+    c.present.resize(n);
+    if (c.type == column_type::Int)
+      c.ints.resize(n);
+    else
+      c.codes.resize(n);
+  }
+
+  static std::uint32_t intern(Column& c, const std::string& label)
+  {
+    auto [it, inserted] = c.code_of.emplace(label, static_cast<std::uint32_t>(c.dictionary.size()));
+    if (inserted)
+    {
+      c.dictionary.push_back(label);
+      if (c.type == column_type::Tags)
+        c.tag_rows.emplace_back();
+    }
+    return it->second;
+  }
+
+  static void clear_tags(Column& c, std::size_t row)
+  {
+    for (Bitmap& rows : c.tag_rows)
+    {
+      if (row < rows.size())
+        rows.reset(row);
+    }
+  }
+
+  template <typename Match>
+  static Bitmap match_ints(const Column& c, std::size_t rows, const Match& match, const char* what)
+  {
+    if (c.type != column_type::Int)
+    {
+      throw std::runtime_error(std::string("Metadata predicate '") + what + "' on '" + c.name +
+                               "' needs an int column");
+    }
+    Bitmap out(rows);
+    const std::size_t n = std::min(rows, c.present.size());
+    for (std::size_t r = 0; r < n; ++r)
+    {
+      if (c.present.test(r) && match(c.ints[r]))
+        out.set(r);
+    }
+    return out;
+  }
+
+  std::vector<Column> columns_;
+  std::unordered_map<std::string, std::size_t> index_;  // column name -> position in columns_
+};
+
+}  // namespace nano_vectordb
@@ -1,9 +1,52 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <Eigen/Dense>
+#include "../precision.hpp"
 
 namespace nano_vectordb
 {
 
+/**
+ * @brief Non-owning view of a block of contiguous rows
+ *
+ * F32 rows are read through `data`; F16 and BF16 rows through `narrow`, with `type` naming the format.
+ */
+struct RowBlock
+{
+  const float* data = nullptr;            // first element of row 0 (F32 rows)
+  std::size_t rows = 0;                   // number of rows in the block
+  std::size_t stride = 0;                 // elements between the starts of consecutive rows
+  std::size_t dim = 0;                    // elements per row
+  const float* sq_norms = nullptr;        // optional cached squared L2 norm of each row
+  const std::uint16_t* narrow = nullptr;  // first element of row 0 (F16 / BF16 rows)
+  precision type = precision::F32;        // element type of the rows
+
+  const float* row(std::size_t i) const
+  {
+    return data + i * stride;
+  }
+
+  const std::uint16_t* narrow_row(std::size_t i) const
+  {
+    return narrow + i * stride;
+  }
+
+  /**
+   * @brief Row i as floats: a pointer into the block for F32 rows, otherwise decoded into scratch.
+   *
+   * @param i Row index.
+   * @param scratch dim floats, used only for narrow rows.
+   */
+  const float* row(std::size_t i, float* scratch) const
+  {
+    if (type == precision::F32)
+      return row(i);
+    decode_values(type, narrow_row(i), scratch, dim);
+    return scratch;
+  }
+};
+
 /**
  * @brief Strategy interface for similarity metrics
  */
@@ -23,6 +66,31 @@ struct IMetric
    * @return float Distance between the two vectors.
    */
   virtual float distance(const Eigen::VectorXf& a, const Eigen::VectorXf& b) const = 0;
+
+  /**
+   * @brief Compute the distance between a query and every row of a block.
+   *
+   * Called once per block by the scan loop, so implementations can run a tight non-virtual kernel
+   * over the rows. The default falls back to `distance()` row by row, decoding F16 / BF16 rows.
+   * Overrides that read `block.data` directly may assume F32 rows: the database decodes narrow rows
+   * for metrics other than CosineMetric and L2Metric before calling them.
+   *
+   * @param query Query vector of length block.dim.
+   * @param block Rows to score.
+   * @param out Output buffer receiving block.rows distances.
+   */
+  virtual void distances(const Eigen::VectorXf& query, const RowBlock& block, float* out) const
+  {
+    Eigen::VectorXf v(static_cast<Eigen::Index>(block.dim));
+    for (std::size_t i = 0; i < block.rows; ++i)
+    {
+      if (block.type == precision::F32)
+        v = Eigen::Map<const Eigen::VectorXf>(block.row(i), static_cast<Eigen::Index>(block.dim));
+      else
+        decode_values(block.type, block.narrow_row(i), v.data(), block.dim);
+      out[i] = distance(query, v);
+    }
+  }
 };
 
 }  // namespace nano_vectordb
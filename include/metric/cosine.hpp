@@ -1,5 +1,8 @@
 #pragma once
+#include <cmath>
 #include "base.hpp"
+#include "fixed_kernels.hpp"
+#include "kernels.hpp"
 
 namespace nano_vectordb
 {
@@ -26,6 +29,49 @@ struct CosineMetric : public IMetric
     float sim = a.dot(b) / denom;
     return 1.0f - sim;
   }
+
+  /**
+   * @brief Compute the Cosine distance between a query and every row of a block.
+   *
+   * The query norm is computed once; row norms come from block.sq_norms when cached. F32 rows are
+   * scored by kernels::dot_rows() (specialized for the common dimensions), F16 / BF16 rows by the
+   * mixed-precision kernels.
+   *
+   * @param query Query vector.
+   * @param block Rows to score.
+   * @param out Output buffer receiving block.rows distances.
+   */
+  void distances(const Eigen::VectorXf& query, const RowBlock& block, float* out) const override
+  {
+    const float qn = query.norm();
+    if (block.type != precision::F32)
+    {
+      for (std::size_t i = 0; i < block.rows; ++i)
+      {
+        const std::uint16_t* r = block.narrow_row(i);
+        const float rsq = block.sq_norms ? block.sq_norms[i] : narrow_sq_norm(r, block);
+        const float denom = qn * std::sqrt(rsq);
+        out[i] = denom == 0.0f ? 1.0f : 1.0f - kernels::dot(query.data(), r, block.dim, block.type) / denom;
+      }
+      return;
+    }
+    kernels::dot_rows(query.data(), block.data, block.stride, block.rows, block.dim, out);
+    for (std::size_t i = 0; i < block.rows; ++i)
+    {
+      const float* r = block.row(i);
+      const float rsq = block.sq_norms ? block.sq_norms[i] : kernels::dot(r, r, block.dim);
+      const float denom = qn * std::sqrt(rsq);
+      out[i] = denom == 0.0f ? 1.0f : 1.0f - out[i] / denom;
+    }
+  }
+
+private:
+  static float narrow_sq_norm(const std::uint16_t* r, const RowBlock& block)
+  {
+    Eigen::VectorXf v(static_cast<Eigen::Index>(block.dim));
+    decode_values(block.type, r, v.data(), block.dim);
+    return v.squaredNorm();
+  }
 };
 
 }  // namespace nano_vectordb
@@ -0,0 +1,318 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include "kernels.hpp"
+
+namespace nano_vectordb
+{
+namespace kernels
+{
+
+/**
+ * @brief Embedding dimensions with compile-time specialized block kernels (see dot_rows()).
+ */
+inline constexpr std::array<std::size_t, 4> kFixedDims = { 384, 768, 1024, 1536 };
+
+namespace detail
+{
+
+/**
+ * @brief Kernel scoring one query against n rows `stride` floats apart, writing n results.
+ */
+using RowsKernel = void (*)(const float* q, const float* rows, std::size_t stride, std::size_t n, float* out);
+
+// The fixed-width kernels run the same accumulators in the same order as the dynamic kernels of their
+// instruction set, so each result is bit-identical; the gain is a constant trip count with no tail, one
+// call per block instead of one per row, and two rows per pass sharing every query load. The scalar
+// kernels have no such variant.
+
+#if NANOVDB_KERNELS_X86
+template <std::size_t Dim>
+__attribute__((target("avx2,fma"))) inline void dot_rows_avx2(const float* q, const float* rows,
+                                                               std::size_t stride, std::size_t n, float* out)
+{
+  static_assert(Dim % 16 == 0, "AVX2 fixed kernels take whole 16-float steps");
+  std::size_t r = 0;
+  for (; r + 2 <= n; r += 2)
+  {
+    const float* a = rows + r * stride;
+    const float* b = a + stride;
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+    __m256 b0 = _mm256_setzero_ps(), b1 = _mm256_setzero_ps();
+    for (std::size_t i = 0; i < Dim; i += 16)
+    {
+      const __m256 q0 = _mm256_loadu_ps(q + i);
+      const __m256 q1 = _mm256_loadu_ps(q + i + 8);
+      a0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), q0, a0);
+      a1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), q1, a1);
+      b0 = _mm256_fmadd_ps(_mm256_loadu_ps(b + i), q0, b0);
+      b1 = _mm256_fmadd_ps(_mm256_loadu_ps(b + i + 8), q1, b1);
+    }
+    out[r] = hsum_avx2(_mm256_add_ps(a0, a1));
+    out[r + 1] = hsum_avx2(_mm256_add_ps(b0, b1));
+  }
+  if (r < n)
+    out[r] = dot_avx2(q, rows + r * stride, Dim);
+}
+
+template <std::size_t Dim>
+__attribute__((target("avx2,fma"))) inline void l2sq_rows_avx2(const float* q, const float* rows,
+                                                                std::size_t stride, std::size_t n, float* out)
+{
+  static_assert(Dim % 16 == 0, "AVX2 fixed kernels take whole 16-float steps");
+  std::size_t r = 0;
+  for (; r + 2 <= n; r += 2)
+  {
+    const float* a = rows + r * stride;
+    const float* b = a + stride;
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+    __m256 b0 = _mm256_setzero_ps(), b1 = _mm256_setzero_ps();
+    for (std::size_t i = 0; i < Dim; i += 16)
+    {
+      const __m256 q0 = _mm256_loadu_ps(q + i);
+      const __m256 q1 = _mm256_loadu_ps(q + i + 8);
+      const __m256 da0 = _mm256_sub_ps(q0, _mm256_loadu_ps(a + i));
+      const __m256 da1 = _mm256_sub_ps(q1, _mm256_loadu_ps(a + i + 8));
+      const __m256 db0 = _mm256_sub_ps(q0, _mm256_loadu_ps(b + i));
+      const __m256 db1 = _mm256_sub_ps(q1, _mm256_loadu_ps(b + i + 8));
+      a0 = _mm256_fmadd_ps(da0, da0, a0);
+      a1 = _mm256_fmadd_ps(da1, da1, a1);
+      b0 = _mm256_fmadd_ps(db0, db0, b0);
+      b1 = _mm256_fmadd_ps(db1, db1, b1);
+    }
+    out[r] = hsum_avx2(_mm256_add_ps(a0, a1));
+    out[r + 1] = hsum_avx2(_mm256_add_ps(b0, b1));
+  }
+  if (r < n)
+    out[r] = l2sq_avx2(q, rows + r * stride, Dim);
+}
+
+template <std::size_t Dim>
+__attribute__((target("avx512f"))) inline void dot_rows_avx512(const float* q, const float* rows,
+                                                                std::size_t stride, std::size_t n, float* out)
+{
+  static_assert(Dim % 32 == 0, "AVX-512 fixed kernels take whole 32-float steps");
+  std::size_t r = 0;
+  for (; r + 2 <= n; r += 2)
+  {
+    const float* a = rows + r * stride;
+    const float* b = a + stride;
+    __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps();
+    __m512 b0 = _mm512_setzero_ps(), b1 = _mm512_setzero_ps();
+    for (std::size_t i = 0; i < Dim; i += 32)
+    {
+      const __m512 q0 = _mm512_loadu_ps(q + i);
+      const __m512 q1 = _mm512_loadu_ps(q + i + 16);
+      a0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), q0, a0);
+      a1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), q1, a1);
+      b0 = _mm512_fmadd_ps(_mm512_loadu_ps(b + i), q0, b0);
+      b1 = _mm512_fmadd_ps(_mm512_loadu_ps(b + i + 16), q1, b1);
+    }
+    out[r] = hsum_avx512(_mm512_add_ps(a0, a1));
+    out[r + 1] = hsum_avx512(_mm512_add_ps(b0, b1));
+  }
+  if (r < n)
+    out[r] = dot_avx512(q, rows + r * stride, Dim);
+}
+
+template <std::size_t Dim>
+__attribute__((target("avx512f"))) inline void l2sq_rows_avx512(const float* q, const float* rows,
+                                                                 std::size_t stride, std::size_t n,
+                                                                 float* out)
+{
+  static_assert(Dim % 32 == 0, "AVX-512 fixed kernels take whole 32-float steps");
+  std::size_t r = 0;
+  for (; r + 2 <= n; r += 2)
+  {
+    const float* a = rows + r * stride;
+    const float* b = a + stride;
+    __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps();
+    __m512 b0 = _mm512_setzero_ps(), b1 = _mm512_setzero_ps();
+    for (std::size_t i = 0; i < Dim; i += 32)
+    {
+      const __m512 q0 = _mm512_loadu_ps(q + i);
+      const __m512 q1 = _mm512_loadu_ps(q + i + 16);
+      const __m512 da0 = _mm512_sub_ps(q0, _mm512_loadu_ps(a + i));
+      const __m512 da1 = _mm512_sub_ps(q1, _mm512_loadu_ps(a + i + 16));
+      const __m512 db0 = _mm512_sub_ps(q0, _mm512_loadu_ps(b + i));
+      const __m512 db1 = _mm512_sub_ps(q1, _mm512_loadu_ps(b + i + 16));
+      a0 = _mm512_fmadd_ps(da0, da0, a0);
+      a1 = _mm512_fmadd_ps(da1, da1, a1);
+      b0 = _mm512_fmadd_ps(db0, db0, b0);
+      b1 = _mm512_fmadd_ps(db1, db1, b1);
+    }
+    out[r] = hsum_avx512(_mm512_add_ps(a0, a1));
+    out[r + 1] = hsum_avx512(_mm512_add_ps(b0, b1));
+  }
+  if (r < n)
+    out[r] = l2sq_avx512(q, rows + r * stride, Dim);
+}
+#endif
+
+#if NANOVDB_KERNELS_NEON
+template <std::size_t Dim>
+inline void dot_rows_neon(const float* q, const float* rows, std::size_t stride, std::size_t n, float* out)
+{
+  static_assert(Dim % 8 == 0, "NEON fixed kernels take whole 8-float steps");
+  std::size_t r = 0;
+  for (; r + 2 <= n; r += 2)
+  {
+    const float* a = rows + r * stride;
+    const float* b = a + stride;
+    float32x4_t a0 = vdupq_n_f32(0.0f), a1 = vdupq_n_f32(0.0f);
+    float32x4_t b0 = vdupq_n_f32(0.0f), b1 = vdupq_n_f32(0.0f);
+    for (std::size_t i = 0; i < Dim; i += 8)
+    {
+      const float32x4_t q0 = vld1q_f32(q + i);
+      const float32x4_t q1 = vld1q_f32(q + i + 4);
+      a0 = vfmaq_f32(a0, q0, vld1q_f32(a + i));
+      a1 = vfmaq_f32(a1, q1, vld1q_f32(a + i + 4));
+      b0 = vfmaq_f32(b0, q0, vld1q_f32(b + i));
+      b1 = vfmaq_f32(b1, q1, vld1q_f32(b + i + 4));
+    }
+    out[r] = vaddvq_f32(vaddq_f32(a0, a1));
+    out[r + 1] = vaddvq_f32(vaddq_f32(b0, b1));
+  }
+  if (r < n)
+    out[r] = dot_neon(q, rows + r * stride, Dim);
+}
+
+template <std::size_t Dim>
+inline void l2sq_rows_neon(const float* q, const float* rows, std::size_t stride, std::size_t n, float* out)
+{
+  static_assert(Dim % 8 == 0, "NEON fixed kernels take whole 8-float steps");
+  std::size_t r = 0;
+  for (; r + 2 <= n; r += 2)
+  {
+    const float* a = rows + r * stride;
+    const float* b = a + stride;
+    float32x4_t a0 = vdupq_n_f32(0.0f), a1 = vdupq_n_f32(0.0f);
+    float32x4_t b0 = vdupq_n_f32(0.0f), b1 = vdupq_n_f32(0.0f);
+    for (std::size_t i = 0; i < Dim; i += 8)
+    {
+      const float32x4_t q0 = vld1q_f32(q + i);
+      const float32x4_t q1 = vld1q_f32(q + i + 4);
+      const float32x4_t da0 = vsubq_f32(q0, vld1q_f32(a + i));
+      const float32x4_t da1 = vsubq_f32(q1, vld1q_f32(a + i + 4));
+      const float32x4_t db0 = vsubq_f32(q0, vld1q_f32(b + i));
+      const float32x4_t db1 = vsubq_f32(q1, vld1q_f32(b + i + 4));
+      a0 = vfmaq_f32(a0, da0, da0);
+      a1 = vfmaq_f32(a1, da1, da1);
+      b0 = vfmaq_f32(b0, db0, db0);
+      b1 = vfmaq_f32(b1, db1, db1);
+    }
+    out[r] = vaddvq_f32(vaddq_f32(a0, a1));
+    out[r + 1] = vaddvq_f32(vaddq_f32(b0, b1));
+  }
+  if (r < n)
+    out[r] = l2sq_neon(q, rows + r * stride, Dim);
+}
+#endif
+
+/**
+ * @brief Block kernels of one fixed dimension
+ */
+struct FixedKernels
+{
+  std::size_t dim;
+  RowsKernel dot_rows;
+  RowsKernel l2sq_rows;
+};
+
+/**
+ * @brief Kernels of width Dim for the instruction set the dynamic kernels were resolved to, null for scalar.
+ */
+template <std::size_t Dim>
+inline FixedKernels select_fixed_kernels(isa level)
+{
+  switch (level)
+  {
+#if NANOVDB_KERNELS_X86
+    case isa::AVX512:
+      return { Dim, dot_rows_avx512<Dim>, l2sq_rows_avx512<Dim> };
+    case isa::AVX2:
+      return { Dim, dot_rows_avx2<Dim>, l2sq_rows_avx2<Dim> };
+#endif
+#if NANOVDB_KERNELS_NEON
+    case isa::NEON:
+      return { Dim, dot_rows_neon<Dim>, l2sq_rows_neon<Dim> };
+#endif
+    default:
+      return { Dim, nullptr, nullptr };
+  }
+}
+
+/**
+ * @brief Fixed-dimension kernels for dim, or nullptr when dim has none.
+ */
+inline const FixedKernels* fixed_kernels(std::size_t dim)
+{
+#if defined(NANOVDB_DISABLE_FIXED_KERNELS)
+  (void)dim;
+  return nullptr;
+#else
+  static const std::array<FixedKernels, kFixedDims.size()> table = {
+    select_fixed_kernels<kFixedDims[0]>(active().level), select_fixed_kernels<kFixedDims[1]>(active().level),
+    select_fixed_kernels<kFixedDims[2]>(active().level), select_fixed_kernels<kFixedDims[3]>(active().level)
+  };
+  for (const FixedKernels& k : table)
+  {
+    if (k.dim == dim && k.dot_rows)
+      return &k;
+  }
+  return nullptr;
+#endif
+}
+
+}  // namespace detail
+
+/**
+ * @brief Whether rows of this dimension are scored by the fixed-dimension block kernels.
+ */
+inline bool has_fixed_kernels(std::size_t dim)
+{
+  return detail::fixed_kernels(dim) != nullptr;
+}
+
+/**
+ * @brief Dot product of a query with each of n rows.
+ *
+ * Dimensions in kFixedDims run a kernel specialized for that width when a SIMD instruction set is active;
+ * others call dot() per row. Both give the same results.
+ *
+ * @param q Query of dim floats.
+ * @param rows First row.
+ * @param stride Floats between the starts of consecutive rows.
+ * @param n Number of rows.
+ * @param dim Floats per row.
+ * @param out Receives n dot products.
+ */
+inline void dot_rows(const float* q, const float* rows, std::size_t stride, std::size_t n, std::size_t dim,
+                     float* out)
+{
+  if (const detail::FixedKernels* fixed = detail::fixed_kernels(dim))
+  {
+    fixed->dot_rows(q, rows, stride, n, out);
+    return;
+  }
+  for (std::size_t r = 0; r < n; ++r)
+    out[r] = dot(q, rows + r * stride, dim);
+}
+
+/**
+ * @brief Squared Euclidean distance from a query to each of n rows; see dot_rows().
+ */
+inline void l2sq_rows(const float* q, const float* rows, std::size_t stride, std::size_t n, std::size_t dim,
+                      float* out)
+{
+  if (const detail::FixedKernels* fixed = detail::fixed_kernels(dim))
+  {
+    fixed->l2sq_rows(q, rows, stride, n, out);
+    return;
+  }
+  for (std::size_t r = 0; r < n; ++r)
+    out[r] = l2sq(q, rows + r * stride, dim);
+}
+
+}  // namespace kernels
+}  // namespace nano_vectordb
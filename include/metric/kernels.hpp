@@ -0,0 +1,665 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "../precision.hpp"
+
+#if !defined(NANOVDB_DISABLE_SIMD) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define NANOVDB_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+#if !defined(NANOVDB_DISABLE_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#define NANOVDB_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace nano_vectordb
+{
+namespace kernels
+{
+
+/**
+ * @brief Instruction set used by the dispatched kernels
+ */
+enum class isa
+{
+  Scalar,
+  NEON,
+  AVX2,
+  AVX512
+};
+
+namespace detail
+{
+
+inline float dot_scalar(const float* a, const float* b, std::size_t n)
+{
+  // Four independent accumulators so the compiler can vectorize without -ffast-math
+  float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    s0 += a[i] * b[i];
+    s1 += a[i + 1] * b[i + 1];
+    s2 += a[i + 2] * b[i + 2];
+    s3 += a[i + 3] * b[i + 3];
+  }
+  for (; i < n; ++i)
+    s0 += a[i] * b[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+inline float l2sq_scalar(const float* a, const float* b, std::size_t n)
+{
+  float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const float d0 = a[i] - b[i], d1 = a[i + 1] - b[i + 1];
+    const float d2 = a[i + 2] - b[i + 2], d3 = a[i + 3] - b[i + 3];
+    s0 += d0 * d0;
+    s1 += d1 * d1;
+    s2 += d2 * d2;
+    s3 += d3 * d3;
+  }
+  for (; i < n; ++i)
+  {
+    const float d = a[i] - b[i];
+    s0 += d * d;
+  }
+  return (s0 + s1) + (s2 + s3);
+}
+
+inline float dot_u8_scalar(const float* w, const std::uint8_t* c, std::size_t n)
+{
+  float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    s0 += w[i] * c[i];
+    s1 += w[i + 1] * c[i + 1];
+    s2 += w[i + 2] * c[i + 2];
+    s3 += w[i + 3] * c[i + 3];
+  }
+  for (; i < n; ++i)
+    s0 += w[i] * c[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+// Narrow kernels score a float query against 16-bit rows (fp16 or bf16), widening each element to
+// fp32 before it is multiplied so accumulation keeps full precision.
+template <bool BF16>
+inline float narrow_to_float(std::uint16_t v)
+{
+  return BF16 ? bf16_to_float(v) : half_to_float(v);
+}
+
+template <bool BF16>
+inline float dot_narrow_scalar(const float* q, const std::uint16_t* r, std::size_t n)
+{
+  float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    s0 += q[i] * narrow_to_float<BF16>(r[i]);
+    s1 += q[i + 1] * narrow_to_float<BF16>(r[i + 1]);
+    s2 += q[i + 2] * narrow_to_float<BF16>(r[i + 2]);
+    s3 += q[i + 3] * narrow_to_float<BF16>(r[i + 3]);
+  }
+  for (; i < n; ++i)
+    s0 += q[i] * narrow_to_float<BF16>(r[i]);
+  return (s0 + s1) + (s2 + s3);
+}
+
+template <bool BF16>
+inline float l2sq_narrow_scalar(const float* q, const std::uint16_t* r, std::size_t n)
+{
+  float s0 = 0.0f, s1 = 0.0f;
+  std::size_t i = 0;
+  for (; i + 2 <= n; i += 2)
+  {
+    const float d0 = q[i] - narrow_to_float<BF16>(r[i]);
+    const float d1 = q[i + 1] - narrow_to_float<BF16>(r[i + 1]);
+    s0 += d0 * d0;
+    s1 += d1 * d1;
+  }
+  for (; i < n; ++i)
+  {
+    const float d = q[i] - narrow_to_float<BF16>(r[i]);
+    s0 += d * d;
+  }
+  return s0 + s1;
+}
+
+#if NANOVDB_KERNELS_X86
+__attribute__((target("avx2,fma"))) inline float hsum_avx2(__m256 v)
+{
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  lo = _mm_add_ps(lo, hi);
+  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+  lo = _mm_add_ss(lo, _mm_movehdup_ps(lo));
+  return _mm_cvtss_f32(lo);
+}
+
+__attribute__((target("avx2,fma"))) inline float dot_avx2(const float* a, const float* b, std::size_t n)
+{
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+  }
+  for (; i + 8 <= n; i += 8)
+  {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+  }
+  float s = hsum_avx2(_mm256_add_ps(acc0, acc1));
+  for (; i < n; ++i)
+    s += a[i] * b[i];
+  return s;
+}
+
+__attribute__((target("avx2,fma"))) inline float l2sq_avx2(const float* a, const float* b, std::size_t n)
+{
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    const __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+    acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+    acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+  }
+  for (; i + 8 <= n; i += 8)
+  {
+    const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+  }
+  float s = hsum_avx2(_mm256_add_ps(acc0, acc1));
+  for (; i < n; ++i)
+  {
+    const float d = a[i] - b[i];
+    s += d * d;
+  }
+  return s;
+}
+
+__attribute__((target("avx2,fma"))) inline float dot_u8_avx2(const float* w, const std::uint8_t* c,
+                                                              std::size_t n)
+{
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i));
+    const __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+    const __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(w + i), lo, acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(w + i + 8), hi, acc1);
+  }
+  float s = hsum_avx2(_mm256_add_ps(acc0, acc1));
+  for (; i < n; ++i)
+    s += w[i] * c[i];
+  return s;
+}
+
+template <bool BF16>
+__attribute__((target("avx2,fma,f16c"))) inline __m256 load_narrow_avx2(const std::uint16_t* p)
+{
+  const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  if constexpr (BF16)
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+  else
+    return _mm256_cvtph_ps(h);
+}
+
+template <bool BF16>
+__attribute__((target("avx2,fma,f16c"))) inline float dot_narrow_avx2(const float* q, const std::uint16_t* r,
+                                                                      std::size_t n)
+{
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(q + i), load_narrow_avx2<BF16>(r + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(q + i + 8), load_narrow_avx2<BF16>(r + i + 8), acc1);
+  }
+  for (; i + 8 <= n; i += 8)
+  {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(q + i), load_narrow_avx2<BF16>(r + i), acc0);
+  }
+  float s = hsum_avx2(_mm256_add_ps(acc0, acc1));
+  for (; i < n; ++i)
+    s += q[i] * narrow_to_float<BF16>(r[i]);
+  return s;
+}
+
+template <bool BF16>
+__attribute__((target("avx2,fma,f16c"))) inline float l2sq_narrow_avx2(const float* q, const std::uint16_t* r,
+                                                                       std::size_t n)
+{
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(q + i), load_narrow_avx2<BF16>(r + i));
+    const __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(q + i + 8), load_narrow_avx2<BF16>(r + i + 8));
+    acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+    acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+  }
+  for (; i + 8 <= n; i += 8)
+  {
+    const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(q + i), load_narrow_avx2<BF16>(r + i));
+    acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+  }
+  float s = hsum_avx2(_mm256_add_ps(acc0, acc1));
+  for (; i < n; ++i)
+  {
+    const float d = q[i] - narrow_to_float<BF16>(r[i]);
+    s += d * d;
+  }
+  return s;
+}
+
+// GCC 12 builds the unmasked AVX-512 extracts and widening conversions (and _mm512_reduce_add_ps on top
+// of them) from an undefined register and warns -Wmaybe-uninitialized in every includer; the zero-masked
+// forms with every lane set compile to the same instructions without it
+constexpr __mmask16 kAllLanes = 0xFFFF;
+
+__attribute__((target("avx512f"))) inline float hsum_avx512(__m512 v)
+{
+  const __m512d d = _mm512_castps_pd(v);
+  const __m256 lo = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, d, 0));
+  const __m256 hi = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, d, 1));
+  return hsum_avx2(_mm256_add_ps(lo, hi));
+}
+
+__attribute__((target("avx512f"))) inline float dot_avx512(const float* a, const float* b, std::size_t n)
+{
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+  }
+  for (; i + 16 <= n; i += 16)
+  {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+  }
+  if (i < n)
+  {
+    const __mmask16 m = static_cast<__mmask16>((1u << (n - i)) - 1u);
+    acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), acc1);
+  }
+  return hsum_avx512(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f"))) inline float l2sq_avx512(const float* a, const float* b, std::size_t n)
+{
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+    const __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+    acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+    acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+  }
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+    acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+  }
+  if (i < n)
+  {
+    const __mmask16 m = static_cast<__mmask16>((1u << (n - i)) - 1u);
+    const __m512 d0 = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i));
+    acc1 = _mm512_fmadd_ps(d0, d0, acc1);
+  }
+  return hsum_avx512(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f"))) inline float dot_u8_avx512(const float* w, const std::uint8_t* c,
+                                                              std::size_t n)
+{
+  __m512 acc = _mm512_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i));
+    const __m512i wide = _mm512_maskz_cvtepu8_epi32(kAllLanes, bytes);
+    acc = _mm512_fmadd_ps(_mm512_loadu_ps(w + i), _mm512_maskz_cvtepi32_ps(kAllLanes, wide), acc);
+  }
+  float s = hsum_avx512(acc);
+  for (; i < n; ++i)
+    s += w[i] * c[i];
+  return s;
+}
+
+template <bool BF16>
+__attribute__((target("avx512f"))) inline __m512 load_narrow_avx512(const std::uint16_t* p)
+{
+  const __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  if constexpr (BF16)
+    return _mm512_castsi512_ps(
+      _mm512_maskz_slli_epi32(kAllLanes, _mm512_maskz_cvtepu16_epi32(kAllLanes, h), 16));
+  else
+    return _mm512_maskz_cvtph_ps(kAllLanes, h);
+}
+
+template <bool BF16>
+__attribute__((target("avx512f"))) inline float dot_narrow_avx512(const float* q, const std::uint16_t* r,
+                                                                  std::size_t n)
+{
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(q + i), load_narrow_avx512<BF16>(r + i), acc0);
+    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(q + i + 16), load_narrow_avx512<BF16>(r + i + 16), acc1);
+  }
+  for (; i + 16 <= n; i += 16)
+  {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(q + i), load_narrow_avx512<BF16>(r + i), acc0);
+  }
+  float s = hsum_avx512(_mm512_add_ps(acc0, acc1));
+  for (; i < n; ++i)
+    s += q[i] * narrow_to_float<BF16>(r[i]);
+  return s;
+}
+
+template <bool BF16>
+__attribute__((target("avx512f"))) inline float l2sq_narrow_avx512(const float* q, const std::uint16_t* r,
+                                                                   std::size_t n)
+{
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(q + i), load_narrow_avx512<BF16>(r + i));
+    const __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(q + i + 16), load_narrow_avx512<BF16>(r + i + 16));
+    acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+    acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+  }
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(q + i), load_narrow_avx512<BF16>(r + i));
+    acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+  }
+  float s = hsum_avx512(_mm512_add_ps(acc0, acc1));
+  for (; i < n; ++i)
+  {
+    const float d = q[i] - narrow_to_float<BF16>(r[i]);
+    s += d * d;
+  }
+  return s;
+}
+#endif
+
+#if NANOVDB_KERNELS_NEON
+inline float dot_neon(const float* a, const float* b, std::size_t n)
+{
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  float s = vaddvq_f32(vaddq_f32(acc0, acc1));
+  for (; i < n; ++i)
+    s += a[i] * b[i];
+  return s;
+}
+
+inline float l2sq_neon(const float* a, const float* b, std::size_t n)
+{
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    const float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+    const float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    acc0 = vfmaq_f32(acc0, d0, d0);
+    acc1 = vfmaq_f32(acc1, d1, d1);
+  }
+  float s = vaddvq_f32(vaddq_f32(acc0, acc1));
+  for (; i < n; ++i)
+  {
+    const float d = a[i] - b[i];
+    s += d * d;
+  }
+  return s;
+}
+
+inline float dot_u8_neon(const float* w, const std::uint8_t* c, std::size_t n)
+{
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    const uint16x8_t wide = vmovl_u8(vld1_u8(c + i));
+    acc0 = vfmaq_f32(acc0, vld1q_f32(w + i), vcvtq_f32_u32(vmovl_u16(vget_low_u16(wide))));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(w + i + 4), vcvtq_f32_u32(vmovl_u16(vget_high_u16(wide))));
+  }
+  float s = vaddvq_f32(vaddq_f32(acc0, acc1));
+  for (; i < n; ++i)
+    s += w[i] * c[i];
+  return s;
+}
+
+template <bool BF16>
+inline float32x4_t load_narrow_neon(const std::uint16_t* p)
+{
+  const uint16x4_t h = vld1_u16(p);
+  if constexpr (BF16)
+    return vreinterpretq_f32_u32(vshll_n_u16(h, 16));
+  else
+    return vcvt_f32_f16(vreinterpret_f16_u16(h));
+}
+
+template <bool BF16>
+inline float dot_narrow_neon(const float* q, const std::uint16_t* r, std::size_t n)
+{
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(q + i), load_narrow_neon<BF16>(r + i));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(q + i + 4), load_narrow_neon<BF16>(r + i + 4));
+  }
+  float s = vaddvq_f32(vaddq_f32(acc0, acc1));
+  for (; i < n; ++i)
+    s += q[i] * narrow_to_float<BF16>(r[i]);
+  return s;
+}
+
+template <bool BF16>
+inline float l2sq_narrow_neon(const float* q, const std::uint16_t* r, std::size_t n)
+{
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    const float32x4_t d0 = vsubq_f32(vld1q_f32(q + i), load_narrow_neon<BF16>(r + i));
+    const float32x4_t d1 = vsubq_f32(vld1q_f32(q + i + 4), load_narrow_neon<BF16>(r + i + 4));
+    acc0 = vfmaq_f32(acc0, d0, d0);
+    acc1 = vfmaq_f32(acc1, d1, d1);
+  }
+  float s = vaddvq_f32(vaddq_f32(acc0, acc1));
+  for (; i < n; ++i)
+  {
+    const float d = q[i] - narrow_to_float<BF16>(r[i]);
+    s += d * d;
+  }
+  return s;
+}
+#endif
+
+/**
+ * @brief Function table for one instruction set
+ */
+struct KernelTable
+{
+  isa level;
+  float (*dot)(const float*, const float*, std::size_t);
+  float (*l2sq)(const float*, const float*, std::size_t);
+  float (*dot_u8)(const float*, const std::uint8_t*, std::size_t);
+  float (*dot_f16)(const float*, const std::uint16_t*, std::size_t);
+  float (*l2sq_f16)(const float*, const std::uint16_t*, std::size_t);
+  float (*dot_bf16)(const float*, const std::uint16_t*, std::size_t);
+  float (*l2sq_bf16)(const float*, const std::uint16_t*, std::size_t);
+};
+
+inline KernelTable select_kernels()
+{
+#if NANOVDB_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return { isa::AVX512,
+             dot_avx512,
+             l2sq_avx512,
+             dot_u8_avx512,
+             dot_narrow_avx512<false>,
+             l2sq_narrow_avx512<false>,
+             dot_narrow_avx512<true>,
+             l2sq_narrow_avx512<true> };
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+    return { isa::AVX2,
+             dot_avx2,
+             l2sq_avx2,
+             dot_u8_avx2,
+             dot_narrow_avx2<false>,
+             l2sq_narrow_avx2<false>,
+             dot_narrow_avx2<true>,
+             l2sq_narrow_avx2<true> };
+#endif
+#if NANOVDB_KERNELS_NEON
+  return { isa::NEON,
+           dot_neon,
+           l2sq_neon,
+           dot_u8_neon,
+           dot_narrow_neon<false>,
+           l2sq_narrow_neon<false>,
+           dot_narrow_neon<true>,
+           l2sq_narrow_neon<true> };
+#endif
+  return { isa::Scalar,
+           dot_scalar,
+           l2sq_scalar,
+           dot_u8_scalar,
+           dot_narrow_scalar<false>,
+           l2sq_narrow_scalar<false>,
+           dot_narrow_scalar<true>,
+           l2sq_narrow_scalar<true> };
+}
+
+/**
+ * @brief Kernel table for the running CPU, resolved once on first use.
+ */
+inline const KernelTable& active()
+{
+  static const KernelTable table = select_kernels();
+  return table;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Instruction set selected by runtime dispatch.
+ *
+ * @return isa Active instruction set.
+ */
+inline isa active_isa()
+{
+  return detail::active().level;
+}
+
+/**
+ * @brief Dot product of two float arrays.
+ *
+ * @param a First array.
+ * @param b Second array.
+ * @param n Number of elements.
+ * @return float Dot product.
+ */
+inline float dot(const float* a, const float* b, std::size_t n)
+{
+  return detail::active().dot(a, b, n);
+}
+
+/**
+ * @brief Squared Euclidean distance between two float arrays.
+ *
+ * @param a First array.
+ * @param b Second array.
+ * @param n Number of elements.
+ * @return float Squared L2 distance.
+ */
+inline float l2sq(const float* a, const float* b, std::size_t n)
+{
+  return detail::active().l2sq(a, b, n);
+}
+
+/**
+ * @brief Dot product of float weights with unsigned 8-bit codes.
+ *
+ * @param w Float weights.
+ * @param c Byte codes.
+ * @param n Number of elements.
+ * @return float Sum of w[i] * c[i].
+ */
+inline float dot_u8(const float* w, const std::uint8_t* c, std::size_t n)
+{
+  return detail::active().dot_u8(w, c, n);
+}
+
+/**
+ * @brief Dot product of a float query with a row stored in 16-bit floats.
+ *
+ * @param q Float query.
+ * @param r Row elements (fp16 or bf16 bit patterns).
+ * @param n Number of elements.
+ * @param type Element type of the row, F16 or BF16.
+ * @return float Dot product, accumulated in fp32.
+ */
+inline float dot(const float* q, const std::uint16_t* r, std::size_t n, precision type)
+{
+  const detail::KernelTable& k = detail::active();
+  return type == precision::BF16 ? k.dot_bf16(q, r, n) : k.dot_f16(q, r, n);
+}
+
+/**
+ * @brief Squared Euclidean distance between a float query and a row stored in 16-bit floats.
+ *
+ * @param q Float query.
+ * @param r Row elements (fp16 or bf16 bit patterns).
+ * @param n Number of elements.
+ * @param type Element type of the row, F16 or BF16.
+ * @return float Squared L2 distance, accumulated in fp32.
+ */
+inline float l2sq(const float* q, const std::uint16_t* r, std::size_t n, precision type)
+{
+  const detail::KernelTable& k = detail::active();
+  return type == precision::BF16 ? k.l2sq_bf16(q, r, n) : k.l2sq_f16(q, r, n);
+}
+
+}  // namespace kernels
+}  // namespace nano_vectordb
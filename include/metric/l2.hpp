@@ -1,5 +1,8 @@
 #pragma once
+#include <algorithm>
 #include "base.hpp"
+#include "fixed_kernels.hpp"
+#include "kernels.hpp"
 
 namespace nano_vectordb
 {
@@ -20,6 +23,42 @@ struct L2Metric : public IMetric
   {
     return (a - b).squaredNorm();
   }
+
+  /**
+   * @brief Compute the L2 distance between a query and every row of a block.
+   *
+   * With cached row norms this uses ||a||^2 + ||b||^2 - 2 a.b, so each row costs one dot product.
+   * F32 rows are scored by the block kernels (specialized for the common dimensions), F16 / BF16 rows
+   * by the mixed-precision kernels.
+   *
+   * @param query Query vector.
+   * @param block Rows to score.
+   * @param out Output buffer receiving block.rows distances.
+   */
+  void distances(const Eigen::VectorXf& query, const RowBlock& block, float* out) const override
+  {
+    const bool narrow = block.type != precision::F32;
+    if (!block.sq_norms)
+    {
+      if (!narrow)
+      {
+        kernels::l2sq_rows(query.data(), block.data, block.stride, block.rows, block.dim, out);
+        return;
+      }
+      for (std::size_t i = 0; i < block.rows; ++i)
+        out[i] = kernels::l2sq(query.data(), block.narrow_row(i), block.dim, block.type);
+      return;
+    }
+    const float qsq = query.squaredNorm();
+    if (!narrow)
+      kernels::dot_rows(query.data(), block.data, block.stride, block.rows, block.dim, out);
+    for (std::size_t i = 0; i < block.rows; ++i)
+    {
+      const float dot =
+          narrow ? kernels::dot(query.data(), block.narrow_row(i), block.dim, block.type) : out[i];
+      out[i] = std::max(0.0f, qsq + block.sq_norms[i] - 2.0f * dot);
+    }
+  }
 };
 
 }  // namespace nano_vectordb
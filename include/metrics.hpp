@@ -0,0 +1,409 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Timed operations; see Metrics.
+ */
+enum class operation : std::uint8_t
+{
+  Query,       // query()
+  QueryBatch,  // query_batch()
+  Upsert,      // upsert()
+  Remove,      // remove()
+  Save,        // save() and checkpoint()
+  Load,        // opening a database from its storage file
+  Ingest,      // ingest()
+  QueryMany    // MultiTenantNanoVDB::query_many()
+};
+
+/**
+ * @brief Event counters; see Metrics.
+ */
+enum class counter : std::uint8_t
+{
+  RowsUpserted,
+  RowsRemoved,
+  TenantHits,      // MultiTenantNanoVDB::get_tenant served from memory
+  TenantMisses,    // MultiTenantNanoVDB::get_tenant loaded from disk
+  TenantEvictions,  // tenants evicted from a MultiTenantNanoVDB cache
+  QueryCacheHits,   // query() answered from the result cache
+  QueryCacheMisses  // cacheable query() that ran the scan
+};
+
+constexpr std::size_t kOperations = 8;
+constexpr std::size_t kCounters = 7;
+
+inline const char* operation_name(operation op)
+{
+  switch (op)
+  {
+    case operation::Query:
+      return "query";
+    case operation::QueryBatch:
+      return "query_batch";
+    case operation::Upsert:
+      return "upsert";
+    case operation::Remove:
+      return "remove";
+    case operation::Save:
+      return "save";
+    case operation::Load:
+      return "load";
+    case operation::Ingest:
+      return "ingest";
+    case operation::QueryMany:
+      return "query_many";
+  }
+  return "unknown";
+}
+
+inline const char* counter_name(counter c)
+{
+  switch (c)
+  {
+    case counter::RowsUpserted:
+      return "rows_upserted";
+    case counter::RowsRemoved:
+      return "rows_removed";
+    case counter::TenantHits:
+      return "tenant_hits";
+    case counter::TenantMisses:
+      return "tenant_misses";
+    case counter::TenantEvictions:
+      return "tenant_evictions";
+    case counter::QueryCacheHits:
+      return "query_cache_hits";
+    case counter::QueryCacheMisses:
+      return "query_cache_misses";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief Log-linear latency buckets in the style of HdrHistogram.
+ *
+ * Values below 8 ns get a bucket each; above that every power of two is split into 8 buckets, so a
+ * bucket's width is at most 1/8 of its lower bound (about 3 significant bits). Values past 2^40 ns
+ * (about 18 minutes) land in the last bucket.
+ */
+struct LatencyBuckets
+{
+  static constexpr int kSubBits = 3;
+  static constexpr std::size_t kSub = std::size_t(1) << kSubBits;
+  static constexpr int kMaxBits = 40;
+  static constexpr std::size_t kCount = kSub + (kMaxBits - kSubBits) * kSub;
+
+  static std::size_t index(std::uint64_t ns)
+  {
+    if (ns < kSub)
+      return static_cast<std::size_t>(ns);
+    int msb = 63;
+    while (!(ns >> msb))
+      --msb;
+    if (msb >= kMaxBits)
+      return kCount - 1;
+    const int shift = msb - kSubBits;
+    return kSub + static_cast<std::size_t>(shift) * kSub + static_cast<std::size_t>((ns >> shift) - kSub);
+  }
+
+  /**
+   * @brief Largest value counted in bucket i.
+   */
+  static std::uint64_t upper_bound(std::size_t i)
+  {
+    if (i < kSub)
+      return i;
+    const std::size_t shift = (i - kSub) / kSub;
+    const std::uint64_t sub = kSub + (i - kSub) % kSub;
+    return ((sub + 1) << shift) - 1;
+  }
+};
+
+/**
+ * @brief Latency distribution of one operation in a MetricsSnapshot.
+ */
+struct LatencyStats
+{
+  std::uint64_t count = 0;
+  std::uint64_t sum_ns = 0;
+  std::uint64_t max_ns = 0;
+  std::vector<std::uint64_t> buckets = std::vector<std::uint64_t>(LatencyBuckets::kCount);
+
+  double mean_ns() const
+  {
+    return count ? static_cast<double>(sum_ns) / static_cast<double>(count) : 0.0;
+  }
+
+  /**
+   * @brief Latency at quantile q in [0, 1], as the upper bound of its bucket (at most max_ns).
+   */
+  std::uint64_t percentile_ns(double q) const
+  {
+    if (count == 0)
+      return 0;
+    const auto rank = static_cast<std::uint64_t>(std::max(1.0, q * static_cast<double>(count) + 0.5));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets.size(); ++i)
+    {
+      seen += buckets[i];
+      if (seen >= rank)
+        return std::min(LatencyBuckets::upper_bound(i), max_ns);
+    }
+    return max_ns;
+  }
+
+  void merge(const LatencyStats& other)
+  {
+    count += other.count;
+    sum_ns += other.sum_ns;
+    max_ns = std::max(max_ns, other.max_ns);
+    for (std::size_t i = 0; i < buckets.size(); ++i)
+      buckets[i] += other.buckets[i];
+  }
+};
+
+/**
+ * @brief Point-in-time copy of the counters and latency histograms of a Metrics collector.
+ */
+struct MetricsSnapshot
+{
+  std::array<LatencyStats, kOperations> operations;
+  std::array<std::uint64_t, kCounters> counters{};
+
+  const LatencyStats& operator[](operation op) const
+  {
+    return operations[static_cast<std::size_t>(op)];
+  }
+
+  std::uint64_t operator[](counter c) const
+  {
+    return counters[static_cast<std::size_t>(c)];
+  }
+
+  void merge(const MetricsSnapshot& other)
+  {
+    for (std::size_t o = 0; o < kOperations; ++o)
+      operations[o].merge(other.operations[o]);
+    for (std::size_t c = 0; c < kCounters; ++c)
+      counters[c] += other.counters[c];
+  }
+
+  /**
+   * @brief Prometheus text exposition: one histogram of operation latency (seconds) labelled by op,
+   *        plus one counter per event.
+   *
+   * The exported `le` bounds are fixed (1us to 60s) so series stay stable across scrapes; each counts
+   * the fine buckets that end at or below it.
+   *
+   * @param prefix Metric name prefix.
+   */
+  std::string to_prometheus(const std::string& prefix = "nanovdb") const
+  {
+    static constexpr double kBounds[] = { 1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4,
+                                          5e-4, 1e-3,   2.5e-3, 5e-3, 1e-2,   2.5e-2, 5e-2, 0.1,
+                                          0.25, 0.5,    1.0,  2.5,  5.0,    10.0, 30.0, 60.0 };
+    std::ostringstream out;
+    const std::string hist = prefix + "_operation_duration_seconds";
+    out << "# HELP " << hist << " Latency of database operations.\n";
+    out << "# TYPE " << hist << " histogram\n";
+    for (std::size_t o = 0; o < kOperations; ++o)
+    {
+      const LatencyStats& s = operations[o];
+      const std::string label = std::string("op=\"") + operation_name(static_cast<operation>(o)) + "\"";
+      std::size_t i = 0;
+      std::uint64_t cumulative = 0;
+      for (double bound : kBounds)
+      {
+        const auto bound_ns = static_cast<std::uint64_t>(bound * 1e9);
+        for (; i < s.buckets.size() && LatencyBuckets::upper_bound(i) <= bound_ns; ++i)
+          cumulative += s.buckets[i];
+        out << hist << "_bucket{" << label << ",le=\"" << bound << "\"} " << cumulative << "\n";
+      }
+      out << hist << "_bucket{" << label << ",le=\"+Inf\"} " << s.count << "\n";
+      out << hist << "_sum{" << label << "} " << static_cast<double>(s.sum_ns) * 1e-9 << "\n";
+      out << hist << "_count{" << label << "} " << s.count << "\n";
+    }
+    for (std::size_t c = 0; c < kCounters; ++c)
+    {
+      const std::string name = prefix + "_" + counter_name(static_cast<counter>(c)) + "_total";
+      out << "# TYPE " << name << " counter\n";
+      out << name << " " << counters[c] << "\n";
+    }
+    return out.str();
+  }
+};
+
+/**
+ * @brief Low-overhead collector of operation counts, latency histograms and event counters.
+ *
+ * Every thread accumulates into its own block, so recording is a few uncontended relaxed stores with
+ * no lock or atomic read-modify-write; snapshot() sums the blocks. One collector can be shared by
+ * many databases, e.g. all tenants of a MultiTenantNanoVDB.
+ */
+class Metrics
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  Metrics() : id_(next_id())
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    live_ids().insert(id_);
+  }
+
+  ~Metrics()
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    live_ids().erase(id_);
+  }
+
+  Metrics(const Metrics&) = delete;
+  Metrics& operator=(const Metrics&) = delete;
+
+  /**
+   * @brief Count one operation that took ns nanoseconds.
+   */
+  void record(operation op, std::uint64_t ns)
+  {
+    Block& b = local();
+    const auto o = static_cast<std::size_t>(op);
+    bump(b.buckets[o][LatencyBuckets::index(ns)], 1);
+    bump(b.count[o], 1);
+    bump(b.sum_ns[o], ns);
+    if (ns > b.max_ns[o].load(std::memory_order_relaxed))
+      b.max_ns[o].store(ns, std::memory_order_relaxed);
+  }
+
+  void record(operation op, clock::time_point start)
+  {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+    record(op, static_cast<std::uint64_t>(std::max<std::int64_t>(0, elapsed)));
+  }
+
+  void add(counter c, std::uint64_t n = 1)
+  {
+    bump(local().counters[static_cast<std::size_t>(c)], n);
+  }
+
+  /**
+   * @brief Sum of every thread's counts so far; concurrent recordings may or may not be included.
+   */
+  MetricsSnapshot snapshot() const
+  {
+    MetricsSnapshot out;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& b : blocks_)
+    {
+      for (std::size_t o = 0; o < kOperations; ++o)
+      {
+        LatencyStats& s = out.operations[o];
+        s.count += b->count[o].load(std::memory_order_relaxed);
+        s.sum_ns += b->sum_ns[o].load(std::memory_order_relaxed);
+        s.max_ns = std::max(s.max_ns, b->max_ns[o].load(std::memory_order_relaxed));
+        for (std::size_t i = 0; i < LatencyBuckets::kCount; ++i)
+          s.buckets[i] += b->buckets[o][i].load(std::memory_order_relaxed);
+      }
+      for (std::size_t c = 0; c < kCounters; ++c)
+        out.counters[c] += b->counters[c].load(std::memory_order_relaxed);
+    }
+    return out;
+  }
+
+private:
+  // Written only by its thread; relaxed atomics let snapshot() read it without tearing
+  struct Block
+  {
+    std::array<std::array<std::atomic<std::uint64_t>, LatencyBuckets::kCount>, kOperations> buckets;
+    std::array<std::atomic<std::uint64_t>, kOperations> count;
+    std::array<std::atomic<std::uint64_t>, kOperations> sum_ns;
+    std::array<std::atomic<std::uint64_t>, kOperations> max_ns;
+    std::array<std::atomic<std::uint64_t>, kCounters> counters;
+  };
+
+  static void bump(std::atomic<std::uint64_t>& v, std::uint64_t n)
+  {
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  static std::uint64_t next_id()
+  {
+    static std::atomic<std::uint64_t> id{ 0 };
+    return ++id;
+  }
+
+  // Ids of the collectors not destroyed yet; lets threads drop the blocks they cached for the others
+  static std::mutex& registry_mutex()
+  {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static std::unordered_set<std::uint64_t>& live_ids()
+  {
+    static std::unordered_set<std::uint64_t> ids;
+    return ids;
+  }
+
+  /**
+   * @brief The calling thread's block, registered on first use.
+   *
+   * Keyed by a never-reused collector id rather than the address, so a block cached for a destroyed
+   * collector is never handed out for a new one at the same address. Entries of destroyed collectors
+   * are dropped whenever the map doubles, so threads outliving many short-lived collectors (e.g.
+   * evicted tenants) do not keep growing it.
+   */
+  Block& local()
+  {
+    struct Last
+    {
+      std::uint64_t id = 0;
+      Block* block = nullptr;
+    };
+    thread_local Last last;
+    if (last.id == id_)
+      return *last.block;
+    thread_local std::unordered_map<std::uint64_t, Block*> owned;
+    thread_local std::size_t prune_at = kMinPrune;
+    if (owned.size() >= prune_at && owned.find(id_) == owned.end())
+    {
+      std::lock_guard<std::mutex> lock(registry_mutex());
+      for (auto it = owned.begin(); it != owned.end();)
+        it = live_ids().count(it->first) ? std::next(it) : owned.erase(it);
+      prune_at = std::max(kMinPrune, owned.size() * 2);
+    }
+    Block*& block = owned[id_];
+    if (!block)
+    {
+      auto fresh = std::make_unique<Block>();  // value-initialized: all counts zero
+      block = fresh.get();
+      std::lock_guard<std::mutex> lock(mutex_);
+      blocks_.push_back(std::move(fresh));
+    }
+    last = { id_, block };
+    return *block;
+  }
+
+  static constexpr std::size_t kMinPrune = 64;  // cached blocks per thread before the first prune
+
+  const std::uint64_t id_;
+  mutable std::mutex mutex_;  // guards blocks_ (registration and snapshot only)
+  std::vector<std::unique_ptr<Block>> blocks_;
+};
+
+}  // namespace nano_vectordb
@@ -0,0 +1,161 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <filesystem>
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace nano_vectordb
+{
+namespace numa
+{
+
+/**
+ * @brief One NUMA node: its operating system id and the CPUs attached to it.
+ */
+struct Node
+{
+  int id = 0;
+  std::vector<int> cpus;
+};
+
+/**
+ * @brief Parse a kernel CPU list such as "0-3,8,10-11".
+ */
+inline std::vector<int> parse_cpu_list(const std::string& list)
+{
+  std::vector<int> cpus;
+  std::size_t pos = 0;
+  while (pos < list.size())
+  {
+    std::size_t end = list.find(',', pos);
+    if (end == std::string::npos)
+      end = list.size();
+    const std::string range = list.substr(pos, end - pos);
+    pos = end + 1;
+    if (range.find_first_of("0123456789") == std::string::npos)
+      continue;
+    const std::size_t dash = range.find('-');
+    const int first = std::stoi(range.substr(0, dash));
+    const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+/**
+ * @brief NUMA nodes of this machine that have CPUs, from /sys/devices/system/node.
+ *
+ * Without that directory (not Linux, or a kernel without NUMA) the machine is one node 0 holding every
+ * hardware thread.
+ */
+inline std::vector<Node> detect_nodes()
+{
+  std::vector<Node> nodes;
+  std::error_code ec;
+  const std::filesystem::path root("/sys/devices/system/node");
+  for (const auto& entry : std::filesystem::directory_iterator(root, ec))
+  {
+    const std::string name = entry.path().filename().string();
+    if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+        name.find_first_not_of("0123456789", 4) != std::string::npos)
+      continue;
+    std::ifstream in(entry.path() / "cpulist");
+    std::string list;
+    std::getline(in, list);
+    Node node{ std::stoi(name.substr(4)), parse_cpu_list(list) };
+    if (!node.cpus.empty())
+      nodes.push_back(std::move(node));
+  }
+  if (nodes.empty())
+  {
+    Node all;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned cpu = 0; cpu < threads; ++cpu)
+      all.cpus.push_back(static_cast<int>(cpu));
+    nodes.push_back(std::move(all));
+  }
+  std::sort(nodes.begin(), nodes.end(), [](const Node& a, const Node& b) { return a.id < b.id; });
+  return nodes;
+}
+
+/**
+ * @brief Restrict the calling thread to the given CPUs.
+ *
+ * @return bool Whether the affinity was set; false on platforms without thread affinity or when the CPUs
+ *         are not available to this process.
+ */
+inline bool pin_this_thread(const std::vector<int>& cpus)
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+  {
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  }
+  return CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  (void)cpus;
+  return false;
+#endif
+}
+
+/**
+ * @brief Node index (see MultiTenantNanoVDB::set_numa_options) of the pool the calling thread works for,
+ *        -1 for threads outside a node pool.
+ */
+inline int& this_thread_node()
+{
+  thread_local int node = -1;
+  return node;
+}
+
+/**
+ * @brief Prefer a node for the pages of [p, p + bytes) and move the pages already there.
+ *
+ * Only whole pages inside the range are bound, so neighbouring allocations keep their placement. Pages
+ * a node cannot take stay where they are, and the call is a no-op without Linux mbind(2).
+ *
+ * @return bool Whether the policy was applied to at least one page.
+ */
+inline bool bind_memory(const void* p, std::size_t bytes, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+  if (!p || node < 0)
+    return false;
+  constexpr unsigned long kPreferred = 1;  // MPOL_PREFERRED
+  constexpr unsigned long kMove = 1 << 1;  // MPOL_MF_MOVE
+  constexpr std::size_t kBits = sizeof(unsigned long) * 8;
+  constexpr std::size_t kMaxNodes = 1024;
+  if (static_cast<std::size_t>(node) >= kMaxNodes)
+    return false;
+  const std::uintptr_t page = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+  const std::uintptr_t begin = (reinterpret_cast<std::uintptr_t>(p) + page - 1) / page * page;
+  const std::uintptr_t end = (reinterpret_cast<std::uintptr_t>(p) + bytes) / page * page;
+  if (end <= begin)
+    return false;
+  unsigned long mask[kMaxNodes / kBits] = {};
+  mask[static_cast<std::size_t>(node) / kBits] |= 1ul << (static_cast<std::size_t>(node) % kBits);
+  return syscall(SYS_mbind, begin, end - begin, kPreferred, mask, kMaxNodes + 1, kMove) == 0;
+#else
+  (void)p;
+  (void)bytes;
+  (void)node;
+  return false;
+#endif
+}
+
+}  // namespace numa
+}  // namespace nano_vectordb
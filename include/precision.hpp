@@ -0,0 +1,196 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Element type used to store vectors
+ *
+ * @param F32 IEEE single precision (4 bytes)
+ * @param F16 IEEE half precision (2 bytes, 10-bit mantissa, range +-65504)
+ * @param BF16 bfloat16 (2 bytes, fp32 range with a 7-bit mantissa)
+ */
+enum class precision
+{
+  F32,
+  F16,
+  BF16
+};
+
+/**
+ * @brief Bytes per stored element.
+ */
+inline std::size_t element_size(precision p)
+{
+  return p == precision::F32 ? sizeof(float) : sizeof(std::uint16_t);
+}
+
+/**
+ * @brief Name used in storage metadata ("f32", "f16", "bf16").
+ */
+inline std::string precision_name(precision p)
+{
+  switch (p)
+  {
+    case precision::F16:
+      return "f16";
+    case precision::BF16:
+      return "bf16";
+    case precision::F32:
+      break;
+  }
+  return "f32";
+}
+
+/**
+ * @brief Parse a name written by precision_name().
+ */
+inline precision precision_from_name(const std::string& name)
+{
+  if (name == "f32")
+    return precision::F32;
+  if (name == "f16")
+    return precision::F16;
+  if (name == "bf16")
+    return precision::BF16;
+  throw std::runtime_error("Unknown precision: " + name);
+}
+
+/**
+ * @brief Convert to IEEE half precision, rounding to nearest even.
+ */
+inline std::uint16_t float_to_half(float f)
+{
+  std::uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  const std::uint16_t sign = static_cast<std::uint16_t>((x >> 16) & 0x8000u);
+  x &= 0x7FFFFFFFu;
+  if (x >= 0x7F800000u)  // Inf or NaN
+    return sign | (x > 0x7F800000u ? 0x7E00u : 0x7C00u);
+  if (x >= 0x477FF000u)  // rounds past the largest half (65504)
+    return sign | 0x7C00u;
+  if (x < 0x38800000u)
+  {
+    // Subnormal half: value = h * 2^-24
+    if (x < 0x33000000u)
+      return sign;
+    const std::uint32_t m = (x & 0x7FFFFFu) | 0x800000u;
+    const std::uint32_t shift = 126u - (x >> 23);
+    std::uint32_t h = m >> shift;
+    const std::uint32_t rem = m & ((1u << shift) - 1u);
+    const std::uint32_t half = 1u << (shift - 1u);
+    if (rem > half || (rem == half && (h & 1u)))
+      ++h;
+    return sign | static_cast<std::uint16_t>(h);
+  }
+  std::uint32_t h = (x - 0x38000000u) >> 13;
+  const std::uint32_t rem = x & 0x1FFFu;
+  if (rem > 0x1000u || (rem == 0x1000u && (h & 1u)))
+    ++h;
+  return sign | static_cast<std::uint16_t>(h);
+}
+
+inline float half_to_float(std::uint16_t h)
+{
+  const std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000u) << 16;
+  std::uint32_t exp = (h >> 10) & 0x1Fu;
+  std::uint32_t man = h & 0x3FFu;
+  std::uint32_t bits;
+  if (exp == 0)
+  {
+    if (man == 0)
+    {
+      bits = sign;
+    }
+    else
+    {
+      // Renormalize the subnormal into a float
+      exp = 113;
+      while (!(man & 0x400u))
+      {
+        man <<= 1;
+        --exp;
+      }
+      bits = sign | (exp << 23) | ((man & 0x3FFu) << 13);
+    }
+  }
+  else if (exp == 0x1F)
+  {
+    bits = sign | 0x7F800000u | (man << 13);
+  }
+  else
+  {
+    bits = sign | ((exp + 112u) << 23) | (man << 13);
+  }
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+/**
+ * @brief Convert to bfloat16, rounding to nearest even.
+ */
+inline std::uint16_t float_to_bf16(float f)
+{
+  std::uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  if ((x & 0x7FFFFFFFu) > 0x7F800000u)
+    return static_cast<std::uint16_t>((x >> 16) | 0x40u);  // keep NaN quiet
+  x += 0x7FFFu + ((x >> 16) & 1u);
+  return static_cast<std::uint16_t>(x >> 16);
+}
+
+inline float bf16_to_float(std::uint16_t b)
+{
+  const std::uint32_t bits = static_cast<std::uint32_t>(b) << 16;
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+/**
+ * @brief Convert n floats to the storage element type.
+ *
+ * @param p Target element type.
+ * @param src n floats.
+ * @param dst n * element_size(p) bytes.
+ * @param n Number of elements.
+ */
+inline void encode_values(precision p, const float* src, void* dst, std::size_t n)
+{
+  if (p == precision::F32)
+  {
+    std::memcpy(dst, src, n * sizeof(float));
+    return;
+  }
+  auto* out = static_cast<std::uint16_t*>(dst);
+  for (std::size_t i = 0; i < n; ++i)
+    out[i] = p == precision::F16 ? float_to_half(src[i]) : float_to_bf16(src[i]);
+}
+
+/**
+ * @brief Convert n stored elements back to floats.
+ *
+ * @param p Source element type.
+ * @param src n * element_size(p) bytes.
+ * @param dst n floats.
+ * @param n Number of elements.
+ */
+inline void decode_values(precision p, const void* src, float* dst, std::size_t n)
+{
+  if (p == precision::F32)
+  {
+    std::memcpy(dst, src, n * sizeof(float));
+    return;
+  }
+  const auto* in = static_cast<const std::uint16_t*>(src);
+  for (std::size_t i = 0; i < n; ++i)
+    dst[i] = p == precision::F16 ? half_to_float(in[i]) : bf16_to_float(in[i]);
+}
+
+}  // namespace nano_vectordb
@@ -0,0 +1,206 @@
+#pragma once
+#include "structs.hpp"
+#include "metadata.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Query result cache counters; see NanoVectorDB::query_cache_stats().
+ */
+struct QueryCacheStats
+{
+  std::size_t capacity = 0;  // entries kept at most; 0 when the cache is off
+  std::size_t entries = 0;   // cached result lists
+  std::size_t bytes = 0;     // heap bytes of the cached keys and results
+  std::uint64_t hits = 0;    // query() calls answered from the cache
+  std::uint64_t misses = 0;  // cacheable query() calls that ran the scan
+
+  double hit_rate() const
+  {
+    const std::uint64_t lookups = hits + misses;
+    return lookups ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+  }
+};
+
+/**
+ * @brief LRU cache of query() results, valid for one data version of the owning database.
+ *
+ * Keys are the exact bytes of (query vector, top_k, threshold, predicate), so two queries only share an
+ * entry when they would run the same scan. Every entry belongs to the version it was computed at; the
+ * first lookup or insert at a newer version drops them all. The cached DataViews point into the
+ * database and stay valid for as long as that version does. Internally synchronized, so readers
+ * holding the database's shared lock can use it concurrently.
+ */
+class QueryCache
+{
+public:
+  explicit QueryCache(std::size_t capacity) : capacity_(capacity)
+  {
+  }
+
+  /**
+   * @brief Cache key of a query; `where` is null for an unfiltered query.
+   */
+  static std::string key(const Eigen::VectorXf& query, int top_k, std::optional<float> threshold,
+                         const Predicate* where)
+  {
+    std::string out;
+    const std::size_t vector_bytes = sizeof(float) * static_cast<std::size_t>(query.size());
+    out.reserve(vector_bytes + 16);
+    put(out, static_cast<std::int64_t>(query.size()));
+    out.append(reinterpret_cast<const char*>(query.data()), vector_bytes);
+    put(out, static_cast<std::int32_t>(top_k));
+    out.push_back(threshold ? 1 : 0);
+    if (threshold)
+      put(out, *threshold);
+    out.push_back(where ? 1 : 0);
+    if (where)
+      encode(*where, out);
+    return out;
+  }
+
+  /**
+   * @brief Results cached for key at version, marking them most recently used.
+   */
+  std::optional<std::vector<QueryResult>> find(const std::string& key, std::uint64_t version)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!current(version))
+    {
+      ++misses_;
+      return std::nullopt;
+    }
+    auto it = map_.find(key);
+    if (it == map_.end())
+    {
+      ++misses_;
+      return std::nullopt;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    ++hits_;
+    return it->second->results;
+  }
+
+  /**
+   * @brief Cache the results computed for key at version, evicting the least recently used entry
+   *        when full.
+   */
+  void insert(std::string key, std::uint64_t version, std::vector<QueryResult> results)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!current(version) || capacity_ == 0)
+      return;
+    auto it = map_.find(key);
+    if (it != map_.end())
+    {
+      bytes_ -= entry_bytes(*it->second);
+      it->second->results = std::move(results);
+      bytes_ += entry_bytes(*it->second);
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return;
+    }
+    if (map_.size() >= capacity_)
+    {
+      bytes_ -= entry_bytes(lru_.back());
+      map_.erase(lru_.back().key);
+      lru_.pop_back();
+    }
+    lru_.push_front({ std::move(key), std::move(results) });
+    bytes_ += entry_bytes(lru_.front());
+    map_.emplace(lru_.front().key, lru_.begin());
+  }
+
+  QueryCacheStats stats() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    QueryCacheStats out;
+    out.capacity = capacity_;
+    out.entries = map_.size();
+    out.bytes = bytes_;
+    out.hits = hits_;
+    out.misses = misses_;
+    return out;
+  }
+
+private:
+  struct Entry
+  {
+    std::string key;
+    std::vector<QueryResult> results;
+  };
+
+  template <typename T>
+  static void put(std::string& out, T value)
+  {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+  }
+
+  static void put(std::string& out, const std::string& s)
+  {
+    put(out, static_cast<std::uint64_t>(s.size()));
+    out.append(s);
+  }
+
+  static void encode(const Predicate& p, std::string& out)
+  {
+    out.push_back(static_cast<char>(p.op));
+    put(out, p.column);
+    put(out, static_cast<std::uint64_t>(p.ints.size()));
+    for (std::int64_t v : p.ints)
+      put(out, v);
+    put(out, static_cast<std::uint64_t>(p.labels.size()));
+    for (const auto& label : p.labels)
+      put(out, label);
+    put(out, p.lo);
+    put(out, p.hi);
+    put(out, static_cast<std::uint64_t>(p.children.size()));
+    for (const auto& child : p.children)
+      encode(child, out);
+  }
+
+  static std::size_t entry_bytes(const Entry& e)
+  {
+    // The key is held twice, once by the list entry and once by the map
+    return sizeof(Entry) + 2 * e.key.capacity() + e.results.capacity() * sizeof(QueryResult);
+  }
+
+  /**
+   * @brief Adopt a newer version, dropping every entry; false for a version older than the entries.
+   */
+  bool current(std::uint64_t version)
+  {
+    if (version == version_)
+      return true;
+    if (version < version_)
+      return false;
+    map_.clear();
+    lru_.clear();
+    bytes_ = 0;
+    version_ = version;
+    return true;
+  }
+
+  const std::size_t capacity_;
+  mutable std::mutex mutex_;
+  std::uint64_t version_ = 0;
+  std::list<Entry> lru_;  // most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> map_;
+  std::size_t bytes_ = 0;
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+};
+
+}  // namespace nano_vectordb
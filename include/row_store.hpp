@@ -0,0 +1,477 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <Eigen/Dense>
+#include "numa.hpp"
+#include "precision.hpp"
+#include "structs.hpp"
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Capacity-managed, row-major vector storage.
+ *
+ * Every row starts on a 64-byte boundary: the row stride is the embedding dimension rounded up to a
+ * whole cache line (no padding for the usual 384/768/1024/1536 dimensions). Capacity grows
+ * geometrically, so appending rows one at a time is amortized O(dim) per row, and `reserve` lets bulk
+ * loads allocate once.
+ *
+ * Elements are fp32 by default; an F16 or BF16 store keeps each element in 2 bytes, converting on
+ * set_row() and decode_row(). The float accessors (row(), matrix(), block()) are only valid for F32
+ * stores; narrow stores are read through narrow_row() or decode_row().
+ *
+ * A store can also borrow rows from memory it does not own, such as a read-only file mapping (see
+ * borrow()). Borrowed rows are read in place; the first call that writes or grows the store copies
+ * them into owned memory.
+ *
+ * set_node() places the owned rows on one NUMA node, including every later allocation. The node belongs
+ * to the store object, so it survives assigning another store to it.
+ */
+class RowStore
+{
+public:
+  static constexpr std::size_t kAlignment = 64;
+
+  using MatrixMap = Eigen::Map<RowMatrixXf, Eigen::Unaligned, Eigen::OuterStride<>>;
+  using ConstMatrixMap = Eigen::Map<const RowMatrixXf, Eigen::Unaligned, Eigen::OuterStride<>>;
+
+  RowStore() = default;
+
+  /**
+   * @brief Construct an empty store
+   *
+   * @param dim Elements per row.
+   * @param type Element type.
+   */
+  explicit RowStore(int dim, precision type = precision::F32)
+    : type_(type)
+    , elem_(element_size(type))
+    , dim_(static_cast<std::size_t>(std::max(0, dim)))
+    , stride_(padded_stride(dim_, elem_))
+  {
+  }
+
+  /**
+   * @brief Store that reads its rows from external memory
+   *
+   * @param dim Elements per row.
+   * @param type Element type.
+   * @param data rows * row_bytes() bytes laid out with this store's stride, on a kAlignment boundary.
+   * @param rows Number of rows at data.
+   * @param owner Keeps data alive (e.g. unmaps the file) for as long as any store borrows it.
+   */
+  static RowStore borrow(int dim, precision type, const unsigned char* data, std::size_t rows,
+                         std::shared_ptr<const void> owner)
+  {
+    RowStore store(dim, type);
+    if (reinterpret_cast<std::uintptr_t>(data) % kAlignment != 0)
+      throw std::runtime_error("RowStore: borrowed rows must be " + std::to_string(kAlignment) +
+                               "-byte aligned");
+    store.data_ = const_cast<unsigned char*>(data);  // never written while borrowed
+    store.rows_ = rows;
+    store.capacity_ = rows;
+    store.owner_ = std::move(owner);
+    return store;
+  }
+
+  RowStore(const RowStore& other)
+    : type_(other.type_)
+    , elem_(other.elem_)
+    , dim_(other.dim_)
+    , stride_(other.stride_)
+    , node_(other.node_)
+  {
+    if (other.owner_)
+    {
+      // Borrowed rows are immutable, so copies share them
+      data_ = other.data_;
+      rows_ = other.rows_;
+      capacity_ = other.capacity_;
+      owner_ = other.owner_;
+      return;
+    }
+    reserve(other.rows_);
+    if (other.rows_ > 0)
+      std::memcpy(data_, other.data_, other.rows_ * row_bytes());
+    rows_ = other.rows_;
+  }
+
+  RowStore(RowStore&& other) noexcept
+  {
+    swap(other);
+  }
+
+  RowStore& operator=(RowStore other) noexcept
+  {
+    const int node = node_;
+    swap(other);
+    node_ = node;
+    bind();
+    return *this;
+  }
+
+  ~RowStore()
+  {
+    if (!owner_)
+      release(data_);
+  }
+
+  void swap(RowStore& other) noexcept
+  {
+    std::swap(data_, other.data_);
+    std::swap(rows_, other.rows_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(type_, other.type_);
+    std::swap(elem_, other.elem_);
+    std::swap(dim_, other.dim_);
+    std::swap(stride_, other.stride_);
+    std::swap(owner_, other.owner_);
+    std::swap(node_, other.node_);
+  }
+
+  std::size_t rows() const
+  {
+    return rows_;
+  }
+
+  std::size_t capacity() const
+  {
+    return capacity_;
+  }
+
+  int dim() const
+  {
+    return static_cast<int>(dim_);
+  }
+
+  precision type() const
+  {
+    return type_;
+  }
+
+  /**
+   * @brief Bytes reserved for rows: owned memory, or the borrowed range when borrowed().
+   */
+  std::size_t memory_bytes() const
+  {
+    return capacity_ * row_bytes();
+  }
+
+  /**
+   * @brief Keep the owned rows on a NUMA node, moving the pages already allocated.
+   *
+   * Borrowed rows stay in the page cache where the kernel put them; the node applies once they are
+   * copied into owned memory. Binding is best effort (see numa::bind_memory()).
+   *
+   * @param node Operating system node id, or -1 for the default placement of later allocations.
+   */
+  void set_node(int node)
+  {
+    node_ = node;
+    bind();
+  }
+
+  /**
+   * @brief NUMA node set by set_node(), -1 if none.
+   */
+  int node() const
+  {
+    return node_;
+  }
+
+  /**
+   * @brief Whether the rows are borrowed from external memory (see borrow()).
+   */
+  bool borrowed() const
+  {
+    return owner_ != nullptr;
+  }
+
+  /**
+   * @brief Elements between the starts of consecutive rows.
+   */
+  std::size_t stride() const
+  {
+    return stride_;
+  }
+
+  /**
+   * @brief Bytes between the starts of consecutive rows.
+   */
+  std::size_t row_bytes() const
+  {
+    return stride_ * elem_;
+  }
+
+  const float* data() const
+  {
+    return reinterpret_cast<const float*>(data_);
+  }
+
+  /**
+   * @brief First element of row i of an F32 store.
+   */
+  float* row(std::size_t i)
+  {
+    return reinterpret_cast<float*>(raw_row(i));
+  }
+
+  const float* row(std::size_t i) const
+  {
+    return reinterpret_cast<const float*>(raw_row(i));
+  }
+
+  /**
+   * @brief First element of row i of an F16 or BF16 store, as raw bit patterns.
+   */
+  const std::uint16_t* narrow_row(std::size_t i) const
+  {
+    return reinterpret_cast<const std::uint16_t*>(raw_row(i));
+  }
+
+  unsigned char* raw_row(std::size_t i)
+  {
+    own();
+    return data_ + i * row_bytes();
+  }
+
+  const unsigned char* raw_row(std::size_t i) const
+  {
+    return data_ + i * row_bytes();
+  }
+
+  /**
+   * @brief Make room for at least n rows without further reallocation.
+   *
+   * @param n Row capacity.
+   */
+  void reserve(std::size_t n)
+  {
+    if (n <= capacity_)
+      return;
+    reallocate(n);
+  }
+
+  /**
+   * @brief Change the number of rows; new rows are zero-filled.
+   *
+   * @param n Row count.
+   */
+  void resize(std::size_t n)
+  {
+    if (n > capacity_)
+      reserve(grown_capacity(n));
+    if (n > rows_)
+      std::memset(raw_row(rows_), 0, (n - rows_) * row_bytes());
+    rows_ = n;
+  }
+
+  /**
+   * @brief Append one row.
+   *
+   * @param values dim() floats to copy.
+   */
+  void push_back(const float* values)
+  {
+    if (rows_ == capacity_)
+      reserve(grown_capacity(rows_ + 1));
+    set_row(rows_++, values);
+  }
+
+  /**
+   * @brief Overwrite one row, zeroing its padding.
+   *
+   * @param i Row index.
+   * @param values dim() floats, converted to the element type.
+   */
+  void set_row(std::size_t i, const float* values)
+  {
+    unsigned char* dst = raw_row(i);
+    encode_values(type_, values, dst, dim_);
+    std::memset(dst + dim_ * elem_, 0, (stride_ - dim_) * elem_);
+  }
+
+  /**
+   * @brief Copy one row out as floats.
+   *
+   * @param i Row index.
+   * @param out dim() floats.
+   */
+  void decode_row(std::size_t i, float* out) const
+  {
+    decode_values(type_, raw_row(i), out, dim_);
+  }
+
+  /**
+   * @brief Append one row already encoded in the element type, e.g. a blob read back from storage.
+   *
+   * @param bytes dim() elements of type().
+   */
+  void append_encoded(const void* bytes)
+  {
+    if (rows_ == capacity_)
+      reserve(grown_capacity(rows_ + 1));
+    unsigned char* dst = raw_row(rows_++);
+    std::memcpy(dst, bytes, dim_ * elem_);
+    std::memset(dst + dim_ * elem_, 0, (stride_ - dim_) * elem_);
+  }
+
+  /**
+   * @brief Append a row of another store with the same dimension and element type, without conversion.
+   */
+  void append_row(const RowStore& src, std::size_t i)
+  {
+    if (rows_ == capacity_)
+      reserve(grown_capacity(rows_ + 1));
+    std::memcpy(raw_row(rows_++), src.raw_row(i), row_bytes());
+  }
+
+  /**
+   * @brief Copy borrowed rows into owned memory now, e.g. before several threads write rows.
+   */
+  void make_owned()
+  {
+    own();
+  }
+
+  void clear()
+  {
+    if (owner_)
+    {
+      owner_.reset();
+      data_ = nullptr;
+      capacity_ = 0;
+    }
+    rows_ = 0;
+  }
+
+  /**
+   * @brief Replace the contents with the rows of a matrix.
+   *
+   * @param m Matrix with dim() columns.
+   */
+  template <typename Derived>
+  void assign(const Eigen::MatrixBase<Derived>& m)
+  {
+    if (static_cast<std::size_t>(m.cols()) != dim_)
+    {
+      throw std::runtime_error("RowStore: column count mismatch: expected " + std::to_string(dim_) + ", got " +
+                               std::to_string(m.cols()));
+    }
+    clear();
+    resize(static_cast<std::size_t>(m.rows()));
+    if (type_ == precision::F32)
+    {
+      matrix() = m;
+      return;
+    }
+    Eigen::RowVectorXf v(static_cast<Eigen::Index>(dim_));
+    for (Eigen::Index i = 0; i < m.rows(); ++i)
+    {
+      v = m.row(i);
+      set_row(static_cast<std::size_t>(i), v.data());
+    }
+  }
+
+  /**
+   * @brief Eigen view of all rows of an F32 store.
+   */
+  MatrixMap matrix()
+  {
+    own();
+    return MatrixMap(row(0), static_cast<Eigen::Index>(rows_), static_cast<Eigen::Index>(dim_),
+                     Eigen::OuterStride<>(static_cast<Eigen::Index>(stride_)));
+  }
+
+  ConstMatrixMap matrix() const
+  {
+    return block(0, rows_);
+  }
+
+  /**
+   * @brief Eigen view of rows [start, start + len) of an F32 store.
+   */
+  ConstMatrixMap block(std::size_t start, std::size_t len) const
+  {
+    return ConstMatrixMap(row(start), static_cast<Eigen::Index>(len), static_cast<Eigen::Index>(dim_),
+                          Eigen::OuterStride<>(static_cast<Eigen::Index>(stride_)));
+  }
+
+private:
+  static std::size_t padded_stride(std::size_t dim, std::size_t elem)
+  {
+    const std::size_t per_line = kAlignment / elem;
+    return (dim + per_line - 1) / per_line * per_line;
+  }
+
+  /**
+   * @brief Copy borrowed rows into owned memory before they are written.
+   */
+  void own()
+  {
+    if (owner_)
+      reallocate(capacity_);
+  }
+
+  /**
+   * @brief Move the rows into a fresh owned allocation of n rows (n >= rows_).
+   */
+  void reallocate(std::size_t n)
+  {
+    unsigned char* fresh = allocate(n * row_bytes());
+    // Bound before the copy touches the pages, so they are faulted in on the node
+    if (node_ >= 0)
+      numa::bind_memory(fresh, n * row_bytes(), node_);
+    if (rows_ > 0)
+      std::memcpy(fresh, data_, rows_ * row_bytes());
+    if (owner_)
+      owner_.reset();
+    else
+      release(data_);
+    data_ = fresh;
+    capacity_ = n;
+  }
+
+  void bind()
+  {
+    if (node_ >= 0 && !owner_ && data_)
+      numa::bind_memory(data_, capacity_ * row_bytes(), node_);
+  }
+
+  std::size_t grown_capacity(std::size_t needed) const
+  {
+    return std::max<std::size_t>({ needed, capacity_ + capacity_ / 2, 64 });
+  }
+
+  static unsigned char* allocate(std::size_t bytes)
+  {
+    return static_cast<unsigned char*>(::operator new(std::max<std::size_t>(1, bytes),
+                                                      std::align_val_t(kAlignment)));
+  }
+
+  static void release(unsigned char* p)
+  {
+    if (p)
+      ::operator delete(p, std::align_val_t(kAlignment));
+  }
+
+  unsigned char* data_ = nullptr;
+  std::size_t rows_ = 0;
+  std::size_t capacity_ = 0;
+  precision type_ = precision::F32;
+  std::size_t elem_ = sizeof(float);  // bytes per element
+  std::size_t dim_ = 0;
+  std::size_t stride_ = 0;
+  std::shared_ptr<const void> owner_;  // set while data_ is borrowed
+  int node_ = -1;                      // NUMA node of owned rows, -1 for default placement
+};
+
+}  // namespace nano_vectordb
@@ -0,0 +1,69 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Reader-writer mutex that prefers writers.
+ *
+ * std::shared_mutex is reader-preferring on common platforms, so a steady stream of queries can keep an
+ * upsert waiting indefinitely. Here a waiting writer stops new readers from entering; readers that hold
+ * the lock finish first. Not recursive: a thread must not take a shared lock it already holds while a
+ * writer may be waiting.
+ *
+ * Meets the SharedMutex requirements, so it works with std::unique_lock and std::shared_lock.
+ */
+class RWMutex
+{
+public:
+  void lock()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++waiting_writers_;
+    writer_cv_.wait(lock, [this] { return !writer_ && readers_ == 0; });
+    --waiting_writers_;
+    writer_ = true;
+  }
+
+  void unlock()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      writer_ = false;
+    }
+    // Hand over to the next writer if there is one; readers re-check and keep waiting otherwise
+    writer_cv_.notify_one();
+    reader_cv_.notify_all();
+  }
+
+  void lock_shared()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    reader_cv_.wait(lock, [this] { return !writer_ && waiting_writers_ == 0; });
+    ++readers_;
+  }
+
+  void unlock_shared()
+  {
+    bool last = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      last = --readers_ == 0;
+    }
+    if (last)
+      writer_cv_.notify_one();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable reader_cv_;
+  std::condition_variable writer_cv_;
+  std::size_t readers_ = 0;
+  std::size_t waiting_writers_ = 0;
+  bool writer_ = false;
+};
+
+}  // namespace nano_vectordb
@@ -2,7 +2,11 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <optional>
 #include <nlohmann/json.hpp>
+#include "../bitmap.hpp"
+#include "../precision.hpp"
+#include "../row_store.hpp"
 #include "../structs.hpp"
 
 namespace nano_vectordb
@@ -43,6 +47,38 @@ struct StorageLoad
   std::vector<Data> records;
   nlohmann::json additional = nlohmann::json::object();
   int embedding_dim = 0;
+  precision type = precision::F32;  // element type the vectors were stored with
+  nlohmann::json metadata;          // metadata columns and values, null when none were stored
+};
+
+/**
+ * @brief Database state handed to column-oriented backends on save; nothing is copied.
+ */
+struct ColumnSnapshot
+{
+  const RowStore* rows = nullptr;
+  const std::vector<std::string>* ids = nullptr;  // id of each row
+  const std::vector<float>* sq_norms = nullptr;   // cached squared norm of each row
+  const Bitmap* deleted = nullptr;                // rows to skip (tombstones)
+  bool normalized = false;                        // rows are unit length (cosine)
+  nlohmann::json additional = nlohmann::json::object();
+  nlohmann::json metadata;
+  std::uint64_t generation = 0;  // checkpoint generation, compared with write-ahead log batches
+};
+
+/**
+ * @brief Columns read back by a column-oriented backend, or by IStorageRecords::read_rows().
+ */
+struct ColumnLoad
+{
+  RowStore rows;  // may borrow the backend's file mapping
+  std::vector<std::string> ids;
+  std::vector<float> sq_norms;
+  bool normalized = false;
+  int embedding_dim = 0;  // 0 when nothing was stored at the path
+  nlohmann::json additional = nlohmann::json::object();
+  nlohmann::json metadata;
+  std::uint64_t generation = 0;  // 0 when the backend does not store one
 };
 
 /**
@@ -58,14 +94,71 @@ struct IStorageRecords : public IStorage
 
   /**
    * @brief Write all records and metadata to the storage path.
+   *
+   * @param type Element type to store the vectors in; reported back by read_records().
+   * @param metadata Metadata columns and values (opaque JSON); reported back by read_records().
    */
   virtual void write_records(const std::string& path, const std::vector<Data>& records, int embedding_dim,
-                             const nlohmann::json& additional) const = 0;
+                             const nlohmann::json& additional, precision type = precision::F32,
+                             const nlohmann::json& metadata = nlohmann::json()) const = 0;
+
+  /**
+   * @brief Apply the changes made since the last save to records already stored at the path.
+   *
+   * @param upserts Records inserted or updated since the last save.
+   * @param removed Ids removed since the last save.
+   * @param metadata Metadata columns and values, when they changed since the last save.
+   * @return bool false if the backend cannot update in place; the caller then calls write_records().
+   */
+  virtual bool write_changes(const std::string& path, const std::vector<Data>& upserts,
+                             const std::vector<std::string>& removed, int embedding_dim,
+                             const nlohmann::json& additional, precision type,
+                             const std::optional<nlohmann::json>& metadata) const
+  {
+    (void)path, (void)upserts, (void)removed, (void)embedding_dim;
+    (void)additional, (void)type, (void)metadata;
+    return false;
+  }
 
   /**
    * @brief Read all records and metadata from the storage path.
    */
   virtual StorageLoad read_records(const std::string& path) const = 0;
+
+  /**
+   * @brief Read the stored rows straight into a row store, in the element type they were saved with.
+   *
+   * sq_norms is left empty when the backend does not store norms; embedding_dim is 0 if nothing was
+   * stored at the path.
+   *
+   * @return std::optional<ColumnLoad> nullopt if the backend only supports read_records().
+   */
+  virtual std::optional<ColumnLoad> read_rows(const std::string& path) const
+  {
+    (void)path;
+    return std::nullopt;
+  }
+};
+
+/**
+ * @brief Optional interface for backends that persist the row store itself.
+ *
+ * Rows are written in their in-memory layout (element type, stride and alignment), so a backend can
+ * hand them back without decoding, e.g. straight from a memory-mapped file.
+ */
+struct IStorageColumns : public IStorage
+{
+  virtual ~IStorageColumns() = default;
+
+  /**
+   * @brief Write the live rows and their ids, norms and metadata to the storage path.
+   */
+  virtual void write_columns(const std::string& path, const ColumnSnapshot& snapshot) const = 0;
+
+  /**
+   * @brief Read the columns stored at the path; embedding_dim is 0 if the path does not exist.
+   */
+  virtual ColumnLoad read_columns(const std::string& path) const = 0;
 };
 
 }  // namespace nano_vectordb
@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "file.hpp"
+#include "mmap.hpp"
 #include "sqlite.hpp"
 
 namespace nano_vectordb
@@ -10,12 +11,14 @@ namespace nano_vectordb
  * @brief Enum-based selection helpers
  *
  * @param File File-based storage backend
- * @param MMap Memory-mapped file storage backend
+ * @param SQLite Row-wise SQLite storage backend
+ * @param MMap Binary columnar file, memory-mapped on load
  */
 enum class storage
 {
   File,
-  SQLite
+  SQLite,
+  MMap
 };
 
 /**
@@ -32,6 +35,8 @@ inline std::shared_ptr<::nano_vectordb::IStorage> make(storage t)
       return std::make_shared<struct ::nano_vectordb::FileStorage>();
     case storage::SQLite:
       return std::make_shared<struct ::nano_vectordb::SQLiteStorage>();
+    case storage::MMap:
+      return std::make_shared<struct ::nano_vectordb::MMapStorage>();
   }
   return nullptr;
 }
@@ -0,0 +1,285 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "base.hpp"
+
+#if defined(_WIN32)
+#include <new>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Binary columnar storage backend with memory-mapped loading
+ *
+ * File layout (version 1, host byte order):
+ * - header (kHeaderBytes): magic, version, element type, dimension, row stride, flags, row count, the
+ *   offset of every section and the checkpoint generation (0 in files written before it was added)
+ * - rows: the row store as laid out in memory (stride and 64-byte alignment included)
+ * - norms: one fp32 squared L2 norm per row
+ * - ids: one uint64 end offset per row, then the concatenated id bytes
+ * - meta: JSON text holding additional_data and the metadata columns
+ *
+ * read_columns() maps the file read-only and returns a RowStore that borrows the row section, so
+ * opening a database costs one mmap plus parsing the ids; vector pages are faulted in by the first
+ * queries that touch them. write_columns() writes a temporary file and renames it over the target,
+ * which keeps stores still borrowing the previous file valid.
+ */
+struct MMapStorage : public IStorageColumns
+{
+  static constexpr char kMagic[8] = { 'N', 'V', 'D', 'B', 'C', 'O', 'L', 'S' };
+  static constexpr std::uint32_t kVersion = 1;
+  static constexpr std::uint32_t kByteOrderMark = 0x01020304u;
+  static constexpr std::size_t kHeaderBytes = 128;
+  static constexpr std::uint32_t kNormalized = 1u;  // flags: rows are unit length
+
+  struct Header
+  {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t type;  // precision
+    std::uint32_t dim;
+    std::uint32_t stride;  // elements per row
+    std::uint32_t flags;
+    std::uint64_t rows;
+    std::uint64_t rows_offset;
+    std::uint64_t norms_offset;
+    std::uint64_t ids_offset;
+    std::uint64_t meta_offset;
+    std::uint64_t meta_bytes;
+    std::uint64_t generation;
+  };
+  static_assert(sizeof(Header) <= kHeaderBytes, "header must fit its reserved bytes");
+
+  void write_columns(const std::string& path, const ColumnSnapshot& snapshot) const override
+  {
+    const RowStore& store = *snapshot.rows;
+    const std::vector<std::string>& ids = *snapshot.ids;
+    const std::string tmp = path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!out)
+      throw std::runtime_error("MMapStorage: cannot open for write: " + tmp);
+
+    auto live = [&](std::size_t i) { return !snapshot.deleted || !snapshot.deleted->test(i); };
+    std::uint64_t n_live = 0;
+    for (std::size_t i = 0; i < ids.size(); ++i)
+      n_live += live(i) ? 1 : 0;
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.byte_order = kByteOrderMark;
+    h.type = static_cast<std::uint32_t>(store.type());
+    h.dim = static_cast<std::uint32_t>(store.dim());
+    h.stride = static_cast<std::uint32_t>(store.stride());
+    h.flags = snapshot.normalized ? kNormalized : 0u;
+    h.rows = n_live;
+    h.generation = snapshot.generation;
+    std::uint64_t offset = kHeaderBytes;
+    // Sections are written in order; pad() keeps each one on a row-store alignment boundary
+    auto pad = [&]() {
+      static const char zeros[RowStore::kAlignment] = {};
+      const std::uint64_t aligned = (offset + RowStore::kAlignment - 1) / RowStore::kAlignment *
+                                    RowStore::kAlignment;
+      out.write(zeros, static_cast<std::streamsize>(aligned - offset));
+      offset = aligned;
+    };
+    auto put = [&](const void* data, std::size_t bytes) {
+      out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+      offset += bytes;
+    };
+    static const char blank[kHeaderBytes] = {};
+    out.write(blank, kHeaderBytes);
+
+    // Runs of consecutive live rows go out in one write
+    h.rows_offset = offset;
+    for (std::size_t i = 0; i < ids.size();)
+    {
+      if (!live(i))
+      {
+        ++i;
+        continue;
+      }
+      std::size_t end = i + 1;
+      while (end < ids.size() && live(end))
+        ++end;
+      put(store.raw_row(i), (end - i) * store.row_bytes());
+      i = end;
+    }
+    pad();
+    h.norms_offset = offset;
+    for (std::size_t i = 0; i < ids.size(); ++i)
+    {
+      if (live(i))
+        put(&(*snapshot.sq_norms)[i], sizeof(float));
+    }
+    pad();
+    h.ids_offset = offset;
+    std::uint64_t id_end = 0;
+    for (std::size_t i = 0; i < ids.size(); ++i)
+    {
+      if (!live(i))
+        continue;
+      id_end += ids[i].size();
+      put(&id_end, sizeof(id_end));
+    }
+    for (std::size_t i = 0; i < ids.size(); ++i)
+    {
+      if (live(i))
+        put(ids[i].data(), ids[i].size());
+    }
+    pad();
+    nlohmann::json meta_json;
+    meta_json["additional_data"] = snapshot.additional;
+    meta_json["metadata"] = snapshot.metadata;
+    const std::string meta = meta_json.dump();
+    h.meta_offset = offset;
+    h.meta_bytes = meta.size();
+    put(meta.data(), meta.size());
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.close();
+    if (!out)
+      throw std::runtime_error("MMapStorage: write failed: " + tmp);
+    std::filesystem::rename(tmp, path);
+  }
+
+  ColumnLoad read_columns(const std::string& path) const override
+  {
+    ColumnLoad res;
+    if (!std::filesystem::exists(path))
+      return res;
+    std::size_t size = 0;
+    std::shared_ptr<const void> mapping = map_file(path, size);
+    const auto* base = static_cast<const unsigned char*>(mapping.get());
+    if (size < kHeaderBytes)
+      throw std::runtime_error("MMapStorage: truncated file: " + path);
+    Header h;
+    std::memcpy(&h, base, sizeof(h));
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0)
+      throw std::runtime_error("MMapStorage: not a nano-vectordb columnar file: " + path);
+    if (h.version != kVersion)
+      throw std::runtime_error("MMapStorage: unsupported format version " + std::to_string(h.version));
+    if (h.byte_order != kByteOrderMark)
+      throw std::runtime_error("MMapStorage: file was written with a different byte order: " + path);
+    if (h.type > static_cast<std::uint32_t>(precision::BF16))
+      throw std::runtime_error("MMapStorage: unknown element type " + std::to_string(h.type));
+
+    const auto type = static_cast<precision>(h.type);
+    RowStore layout(static_cast<int>(h.dim), type);
+    if (layout.stride() != h.stride)
+      throw std::runtime_error("MMapStorage: row stride " + std::to_string(h.stride) + " does not match " +
+                               std::to_string(layout.stride()));
+    auto section = [&](std::uint64_t offset, std::uint64_t bytes, const char* what) {
+      if (offset > size || bytes > size - offset)
+        throw std::runtime_error(std::string("MMapStorage: ") + what + " section out of bounds: " + path);
+    };
+    section(h.rows_offset, h.rows * layout.row_bytes(), "rows");
+    section(h.norms_offset, h.rows * sizeof(float), "norms");
+    section(h.ids_offset, h.rows * sizeof(std::uint64_t), "ids");
+    section(h.meta_offset, h.meta_bytes, "meta");
+
+    res.embedding_dim = static_cast<int>(h.dim);
+    res.normalized = (h.flags & kNormalized) != 0;
+    res.generation = h.generation;
+    res.rows = RowStore::borrow(res.embedding_dim, type, base + h.rows_offset, h.rows, mapping);
+    res.sq_norms.resize(h.rows);
+    if (h.rows > 0)
+      std::memcpy(res.sq_norms.data(), base + h.norms_offset, h.rows * sizeof(float));
+
+    const unsigned char* ends = base + h.ids_offset;
+    const auto* chars = reinterpret_cast<const char*>(ends + h.rows * sizeof(std::uint64_t));
+    const std::uint64_t chars_room = size - (h.ids_offset + h.rows * sizeof(std::uint64_t));
+    res.ids.reserve(h.rows);
+    std::uint64_t begin = 0;
+    for (std::uint64_t i = 0; i < h.rows; ++i)
+    {
+      std::uint64_t end;
+      std::memcpy(&end, ends + i * sizeof(end), sizeof(end));
+      if (end < begin || end > chars_room)
+        throw std::runtime_error("MMapStorage: corrupt id table: " + path);
+      res.ids.emplace_back(chars + begin, end - begin);
+      begin = end;
+    }
+
+    const auto* meta = reinterpret_cast<const char*>(base + h.meta_offset);
+    const nlohmann::json j = nlohmann::json::parse(meta, meta + h.meta_bytes);
+    if (j.contains("additional_data") && !j["additional_data"].is_null())
+      res.additional = j["additional_data"];
+    if (j.contains("metadata"))
+      res.metadata = j["metadata"];
+    return res;
+  }
+
+  // Byte-oriented API unused for the columnar backend; provide minimal implementations.
+  void write(const std::string& path, const std::vector<uint8_t>&) const override
+  {
+    throw std::runtime_error("MMapStorage: write(bytes) unsupported; use write_columns: " + path);
+  }
+  std::vector<uint8_t> read(const std::string& path) const override
+  {
+    (void)path;
+    return {};  // no-op; columns API should be used
+  }
+
+private:
+  /**
+   * @brief Map a whole file read-only; the returned pointer unmaps it when the last owner goes away.
+   */
+  static std::shared_ptr<const void> map_file(const std::string& path, std::size_t& size)
+  {
+#if defined(_WIN32)
+    // No mmap: read the file into page-aligned memory instead
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+      throw std::runtime_error("MMapStorage: cannot open for read: " + path);
+    size = static_cast<std::size_t>(in.tellg());
+    in.seekg(0);
+    void* buf = ::operator new(std::max<std::size_t>(1, size), std::align_val_t(4096));
+    std::shared_ptr<const void> owner(buf, [](const void* p) {
+      ::operator delete(const_cast<void*>(p), std::align_val_t(4096));
+    });
+    in.read(static_cast<char*>(buf), static_cast<std::streamsize>(size));
+    return owner;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("MMapStorage: cannot open for read: " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+      ::close(fd);
+      throw std::runtime_error("MMapStorage: cannot stat: " + path);
+    }
+    size = static_cast<std::size_t>(st.st_size);
+    void* addr = size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : nullptr;
+    ::close(fd);  // the mapping keeps the file open
+    if (addr == MAP_FAILED)
+      throw std::runtime_error("MMapStorage: mmap failed: " + path);
+    const std::size_t len = size;
+    return std::shared_ptr<const void>(addr, [len](const void* p) {
+      if (p)
+        ::munmap(const_cast<void*>(p), len);
+    });
+#endif
+  }
+};
+
+}  // namespace nano_vectordb
@@ -1,274 +1,579 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
 #include <cstdint>
 #include <stdexcept>
 #include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
 #include <sqlite3.h>
 #include <nlohmann/json.hpp>
 #include "base.hpp"
+#include "../metric/kernels.hpp"
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
 namespace nano_vectordb
 {
 
+/**
+ * @brief Connection settings of the SQLite backend, applied when a connection is opened.
+ */
+struct SQLiteOptions
+{
+  std::string journal_mode = "WAL";      // PRAGMA journal_mode: DELETE, TRUNCATE, PERSIST, MEMORY, WAL or OFF
+  std::string synchronous = "NORMAL";    // PRAGMA synchronous: OFF, NORMAL, FULL or EXTRA
+  std::int64_t mmap_size = 256ll << 20;  // PRAGMA mmap_size, in bytes; 0 reads through the page cache only
+  int cache_size = -8192;                // PRAGMA cache_size: pages if positive, KiB if negative
+  int busy_timeout_ms = 5000;            // wait for locks held by other connections
+  std::size_t max_connections = 64;      // open connections kept; the least recently used is closed first
+  int batch_rows = 64;                   // rows bound into one multi-row INSERT, REPLACE or DELETE
+};
+
 /**
  * @brief SQLite storage backend (row-wise).
  *
  * Schema:
  *  - meta(key TEXT PRIMARY KEY, value TEXT)
- *  - vectors(id TEXT PRIMARY KEY, dim INTEGER NOT NULL, vec BLOB NOT NULL)
- * Stores Eigen::VectorXf as raw float BLOBs.
+ *  - vectors(id TEXT PRIMARY KEY, dim INTEGER NOT NULL, vec BLOB NOT NULL, sq_norm REAL)
+ * Stores Eigen::VectorXf as raw BLOBs of the database's element type (float, fp16 or bf16); the type
+ * is recorded under the "precision" meta key. sq_norm caches the squared norm of each vector, so a
+ * load neither recomputes norms nor re-normalizes rows that are already unit length; files written
+ * before the column existed get it added, NULL, on open.
+ *
+ * Each path keeps one long-lived connection with its prepared statements, so reloading a database
+ * (e.g. a tenant evicted by MultiTenantNanoVDB) skips the open, pragma, schema and prepare steps. A
+ * connection whose file was deleted or replaced is reopened. Call close() before deleting a file to
+ * fold its `-wal` journal back in.
  */
 struct SQLiteStorage : public IStorageRecords
 {
+  explicit SQLiteStorage(SQLiteOptions options = {}) : options_(std::move(options))
+  {
+    auto upper = [](std::string s) {
+      std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::toupper(c); });
+      return s;
+    };
+    options_.journal_mode = upper(options_.journal_mode);
+    options_.synchronous = upper(options_.synchronous);
+    const std::vector<std::string> journal_modes = { "DELETE", "TRUNCATE", "PERSIST",
+                                                      "MEMORY", "WAL",      "OFF" };
+    const std::vector<std::string> sync_modes = { "OFF", "NORMAL", "FULL", "EXTRA" };
+    if (std::find(journal_modes.begin(), journal_modes.end(), options_.journal_mode) == journal_modes.end())
+      throw std::runtime_error("SQLiteStorage: unsupported journal_mode: " + options_.journal_mode);
+    if (std::find(sync_modes.begin(), sync_modes.end(), options_.synchronous) == sync_modes.end())
+      throw std::runtime_error("SQLiteStorage: unsupported synchronous mode: " + options_.synchronous);
+  }
+
+  SQLiteStorage(const SQLiteStorage&) = delete;
+  SQLiteStorage& operator=(const SQLiteStorage&) = delete;
+
+  const SQLiteOptions& options() const
+  {
+    return options_;
+  }
+
   void write_records(const std::string& path, const std::vector<Data>& records, int embedding_dim,
-                     const nlohmann::json& additional) const override
+                     const nlohmann::json& additional, precision type = precision::F32,
+                     const nlohmann::json& metadata = nlohmann::json()) const override
   {
-    sqlite3* db = nullptr;
-    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
-    {
-      std::string msg = "SQLiteStorage: open failed: ";
-      msg += sqlite3_errmsg(db);
-      if (db)
-        sqlite3_close(db);
-      throw std::runtime_error(msg);
-    }
-    char* err = nullptr;
-    const char* create_meta = "CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY, value TEXT NOT NULL)";
-    const char* create_vecs = "CREATE TABLE IF NOT EXISTS vectors ("
-                              " id TEXT PRIMARY KEY,"
-                              " dim INTEGER NOT NULL,"
-                              " vec BLOB NOT NULL"
-                              ")";
-    if (sqlite3_exec(db, create_meta, nullptr, nullptr, &err) != SQLITE_OK)
+    auto conn = connect(path, true);
+    std::lock_guard<std::mutex> lock(conn->mutex);
+    Transaction txn(*conn);
+    conn->exec("DELETE FROM vectors", "clear vectors");
+    write_vectors(*conn, "INSERT", records, embedding_dim, type);
+    write_meta(*conn, { { "embedding_dim", std::to_string(embedding_dim) },
+                        { "additional_data", additional.dump() },
+                        { "precision", precision_name(type) },
+                        { "metadata", metadata.dump() } });
+    txn.commit();
+  }
+
+  bool write_changes(const std::string& path, const std::vector<Data>& upserts,
+                     const std::vector<std::string>& removed, int embedding_dim,
+                     const nlohmann::json& additional, precision type,
+                     const std::optional<nlohmann::json>& metadata) const override
+  {
+    // A missing file, or blobs of another dimension or element type, need a full write
+    auto conn = connect(path, false);
+    if (!conn)
+      return false;
+    std::lock_guard<std::mutex> lock(conn->mutex);
+    Transaction txn(*conn);
+    if (meta_value(*conn, "embedding_dim") != std::to_string(embedding_dim) ||
+        meta_value(*conn, "precision").value_or(precision_name(precision::F32)) != precision_name(type))
+      return false;
+    write_vectors(*conn, "REPLACE", upserts, embedding_dim, type);
+    delete_vectors(*conn, removed);
+    std::vector<std::pair<std::string, std::string>> entries = { { "additional_data", additional.dump() } };
+    if (metadata)
+      entries.emplace_back("metadata", metadata->dump());
+    write_meta(*conn, entries);
+    txn.commit();
+    return true;
+  }
+
+  StorageLoad read_records(const std::string& path) const override
+  {
+    ColumnLoad loaded = *read_rows(path);
+    StorageLoad res;
+    res.embedding_dim = loaded.embedding_dim;
+    res.type = loaded.rows.type();
+    res.additional = std::move(loaded.additional);
+    res.metadata = std::move(loaded.metadata);
+    res.records.reserve(loaded.ids.size());
+    for (std::size_t i = 0; i < loaded.ids.size(); ++i)
     {
-      std::string msg = std::string("SQLiteStorage: create meta failed: ") + (err ? err : "");
-      sqlite3_free(err);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
+      Data r;
+      r.id = std::move(loaded.ids[i]);
+      r.vector.resize(loaded.embedding_dim);
+      loaded.rows.decode_row(i, r.vector.data());
+      res.records.push_back(std::move(r));
     }
-    if (sqlite3_exec(db, create_vecs, nullptr, nullptr, &err) != SQLITE_OK)
+    return res;
+  }
+
+  std::optional<ColumnLoad> read_rows(const std::string& path) const override
+  {
+    ColumnLoad res;
+    auto conn = connect(path, false);
+    if (!conn)
+      return res;
+    std::lock_guard<std::mutex> lock(conn->mutex);
+    precision type = precision::F32;
+    if (auto v = meta_value(*conn, "embedding_dim"))
+      res.embedding_dim = std::stoi(*v);
+    if (auto v = meta_value(*conn, "precision"))
+      type = precision_from_name(*v);
+    if (auto v = meta_value(*conn, "metadata"))
+      res.metadata = nlohmann::json::parse(*v);
+    if (auto v = meta_value(*conn, "additional_data"))
     {
-      std::string msg = std::string("SQLiteStorage: create vectors failed: ") + (err ? err : "");
-      sqlite3_free(err);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
+      try
+      {
+        res.additional = nlohmann::json::parse(*v);
+      }
+      catch (...)
+      {
+        res.additional = nlohmann::json::object();
+      }
     }
-    if (sqlite3_exec(db, "BEGIN", nullptr, nullptr, &err) != SQLITE_OK)
+    if (res.embedding_dim > 0)
+      res.rows = RowStore(res.embedding_dim, type);
+
+    // Blobs are already in the row store's element type, so each one is copied into its row as is
+    sqlite3_stmt* v = conn->prepare("SELECT id, dim, vec, sq_norm FROM vectors");
+    bool have_norms = true;
+    Reset reset{ v };
+    int rc;
+    while ((rc = sqlite3_step(v)) == SQLITE_ROW)
     {
-      std::string msg = std::string("SQLiteStorage: begin failed: ") + (err ? err : "");
-      sqlite3_free(err);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
+      const int dim = sqlite3_column_int(v, 1);
+      if (res.embedding_dim == 0)
+      {
+        res.embedding_dim = dim;
+        res.rows = RowStore(dim, type);
+      }
+      const void* blob = sqlite3_column_blob(v, 2);
+      const int size = sqlite3_column_bytes(v, 2);
+      if (dim != res.embedding_dim)
+        throw std::runtime_error("SQLiteStorage: record dim mismatch");
+      if (!blob || size != dim * static_cast<int>(element_size(type)))
+        throw std::runtime_error("SQLiteStorage: blob size mismatch");
+      const auto* idtxt = reinterpret_cast<const char*>(sqlite3_column_text(v, 0));
+      res.ids.emplace_back(idtxt ? idtxt : "", static_cast<std::size_t>(sqlite3_column_bytes(v, 0)));
+      res.rows.append_encoded(blob);
+      if (have_norms && sqlite3_column_type(v, 3) != SQLITE_NULL)
+        res.sq_norms.push_back(static_cast<float>(sqlite3_column_double(v, 3)));
+      else
+        have_norms = false;
     }
+    if (rc != SQLITE_DONE)
+      conn->fail("read vectors");
+    if (!have_norms)
+      res.sq_norms.clear();
+    res.normalized = unit_norms(res.sq_norms, type);
+    return res;
+  }
 
-    // Clear and insert records
-    if (sqlite3_exec(db, "DELETE FROM vectors", nullptr, nullptr, &err) != SQLITE_OK)
+  /**
+   * @brief Close the cached connection to a path, e.g. before deleting the file.
+   *
+   * In WAL journal mode, closing the last connection checkpoints `<path>-wal` into the database and
+   * removes it together with `<path>-shm`. Operations still running on the connection finish first.
+   */
+  void close(const std::string& path) const
+  {
+    std::shared_ptr<Connection> conn;
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = connections_.find(path);
+    if (it == connections_.end())
+      return;
+    conn = std::move(it->second->second);
+    lru_.erase(it->second);
+    connections_.erase(it);
+  }
+
+  /**
+   * @brief Close every cached connection.
+   */
+  void close_all() const
+  {
+    Lru closed;
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    closed.swap(lru_);
+    connections_.clear();
+  }
+
+  /**
+   * @brief Number of connections currently cached.
+   */
+  std::size_t open_connections() const
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    return lru_.size();
+  }
+
+  // Byte-oriented API unused for rows backend; provide minimal implementations.
+  void write(const std::string& path, const std::vector<uint8_t>&) const override
+  {
+    throw std::runtime_error("SQLiteStorage: write(bytes) unsupported; use write_records");
+  }
+  std::vector<uint8_t> read(const std::string& path) const override
+  {
+    (void)path;
+    return {};  // no-op; rows API should be used
+  }
+
+private:
+  /**
+   * @brief One open database with its prepared statements; mutex serializes the operations on it.
+   */
+  struct Connection
+  {
+    sqlite3* db = nullptr;
+    std::pair<std::uint64_t, std::uint64_t> identity;  // device and inode of the file when opened
+    std::unordered_map<std::string, sqlite3_stmt*> statements;
+    std::mutex mutex;
+
+    ~Connection()
     {
-      sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
-      std::string msg = std::string("SQLiteStorage: clear vectors failed: ") + (err ? err : "");
-      sqlite3_free(err);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
+      for (auto& entry : statements)
+        sqlite3_finalize(entry.second);
+      if (db)
+        sqlite3_close(db);
     }
 
-    const char* ins_sql = "INSERT INTO vectors(id, dim, vec) VALUES (?1, ?2, ?3)";
-    sqlite3_stmt* ins = nullptr;
-    if (sqlite3_prepare_v2(db, ins_sql, -1, &ins, nullptr) != SQLITE_OK)
+    [[noreturn]] void fail(const std::string& what) const
     {
-      sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
-      std::string msg = std::string("SQLiteStorage: prepare insert failed: ") + sqlite3_errmsg(db);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
+      const char* reason = db ? sqlite3_errmsg(db) : "out of memory";
+      throw std::runtime_error("SQLiteStorage: " + what + " failed: " + reason);
     }
-    for (const auto& r : records)
+
+    void exec(const std::string& sql, const std::string& what)
     {
-      if (r.vector.size() != embedding_dim)
-      {
-        sqlite3_finalize(ins);
-        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
-        sqlite3_close(db);
-        throw std::runtime_error("SQLiteStorage: record dim mismatch");
-      }
-      std::size_t bytes = static_cast<std::size_t>(r.vector.size()) * sizeof(float);
-      if (sqlite3_bind_text(ins, 1, r.id.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK ||
-          sqlite3_bind_int(ins, 2, embedding_dim) != SQLITE_OK ||
-          sqlite3_bind_blob(ins, 3, r.vector.data(), static_cast<int>(bytes), SQLITE_TRANSIENT) != SQLITE_OK)
+      char* err = nullptr;
+      if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK)
       {
-        sqlite3_finalize(ins);
-        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
-        sqlite3_close(db);
-        throw std::runtime_error("SQLiteStorage: bind insert failed");
-      }
-      if (sqlite3_step(ins) != SQLITE_DONE)
-      {
-        sqlite3_finalize(ins);
-        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
-        sqlite3_close(db);
-        throw std::runtime_error("SQLiteStorage: step insert failed");
+        std::string msg = "SQLiteStorage: " + what + " failed: " + (err ? err : "");
+        sqlite3_free(err);
+        throw std::runtime_error(msg);
       }
-      sqlite3_reset(ins);
-      sqlite3_clear_bindings(ins);
     }
-    sqlite3_finalize(ins);
 
-    // Upsert meta
-    const char* upsert_meta = "REPLACE INTO meta(key, value) VALUES (?1, ?2)";
-    sqlite3_stmt* meta = nullptr;
-    if (sqlite3_prepare_v2(db, upsert_meta, -1, &meta, nullptr) != SQLITE_OK)
+    /**
+     * @brief Prepared statement for sql, prepared on first use; reset it after use (see Reset).
+     */
+    sqlite3_stmt* prepare(const std::string& sql)
     {
-      sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
-      std::string msg = std::string("SQLiteStorage: prepare meta failed: ") + sqlite3_errmsg(db);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
+      auto it = statements.find(sql);
+      if (it != statements.end())
+        return it->second;
+      sqlite3_stmt* stmt = nullptr;
+      if (sqlite3_prepare_v3(db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+        fail("prepare " + sql);
+      statements.emplace(sql, stmt);
+      return stmt;
     }
-    // embedding_dim
-    std::string emb_key = "embedding_dim";
-    std::string emb_val = std::to_string(embedding_dim);
-    if (sqlite3_bind_text(meta, 1, emb_key.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK ||
-        sqlite3_bind_text(meta, 2, emb_val.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK ||
-        sqlite3_step(meta) != SQLITE_DONE)
+  };
+
+  // Returns a cached statement to its initial state when the scope using it ends
+  struct Reset
+  {
+    sqlite3_stmt* stmt;
+    ~Reset()
     {
-      sqlite3_finalize(meta);
-      sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
-      sqlite3_close(db);
-      throw std::runtime_error("SQLiteStorage: upsert embedding_dim failed");
+      sqlite3_reset(stmt);
+      sqlite3_clear_bindings(stmt);
     }
-    sqlite3_reset(meta);
-    sqlite3_clear_bindings(meta);
-    // additional_data as JSON
-    std::string add_key = "additional_data";
-    std::string add_val = additional.dump();
-    if (sqlite3_bind_text(meta, 1, add_key.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK ||
-        sqlite3_bind_text(meta, 2, add_val.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK ||
-        sqlite3_step(meta) != SQLITE_DONE)
+  };
+
+  // Rolls back unless committed, so every throw and early return leaves the file unchanged
+  struct Transaction
+  {
+    Connection& conn;
+    bool open = true;
+    explicit Transaction(Connection& c) : conn(c)
     {
-      sqlite3_finalize(meta);
-      sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
-      sqlite3_close(db);
-      throw std::runtime_error("SQLiteStorage: upsert additional_data failed");
+      conn.exec("BEGIN IMMEDIATE", "begin");
     }
-    sqlite3_finalize(meta);
-
-    if (sqlite3_exec(db, "COMMIT", nullptr, nullptr, &err) != SQLITE_OK)
+    void commit()
     {
-      std::string msg = std::string("SQLiteStorage: commit failed: ") + (err ? err : "");
-      sqlite3_free(err);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
+      conn.exec("COMMIT", "commit");
+      open = false;
     }
-    sqlite3_close(db);
-  }
+    ~Transaction()
+    {
+      if (open)
+        sqlite3_exec(conn.db, "ROLLBACK", nullptr, nullptr, nullptr);
+    }
+  };
 
-  StorageLoad read_records(const std::string& path) const override
+  /**
+   * @brief Cached connection to path, opened on first use.
+   *
+   * @param create Create the file if it does not exist; otherwise return nullptr for a missing file.
+   */
+  std::shared_ptr<Connection> connect(const std::string& path, bool create) const
   {
-    StorageLoad res;
-    sqlite3* db = nullptr;
-    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    const auto identity = file_identity(path);
+    auto it = connections_.find(path);
+    if (it != connections_.end())
     {
-      std::string msg = "SQLiteStorage: open failed: ";
-      msg += sqlite3_errmsg(db);
-      if (db)
-        sqlite3_close(db);
-      throw std::runtime_error(msg);
+      if (identity && *identity == it->second->second->identity)
+      {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->second;
+      }
+      // The file was deleted or replaced: let go of the old one before its journal path is reused
+      lru_.erase(it->second);
+      connections_.erase(it);
     }
-    char* err = nullptr;
-    const char* create_meta = "CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY, value TEXT NOT NULL)";
-    const char* create_vecs = "CREATE TABLE IF NOT EXISTS vectors ("
-                              " id TEXT PRIMARY KEY,"
-                              " dim INTEGER NOT NULL,"
-                              " vec BLOB NOT NULL"
-                              ")";
-    if (sqlite3_exec(db, create_meta, nullptr, nullptr, &err) != SQLITE_OK)
+    if (!identity && !create)
+      return nullptr;
+    if (!identity)
     {
-      std::string msg = std::string("SQLiteStorage: create meta failed: ") + (err ? err : "");
-      sqlite3_free(err);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
+      // Journal files left behind by a deleted database must not be replayed into a new one
+      std::error_code ec;
+      std::filesystem::remove(path + "-wal", ec);
+      std::filesystem::remove(path + "-shm", ec);
     }
-    if (sqlite3_exec(db, create_vecs, nullptr, nullptr, &err) != SQLITE_OK)
+    auto conn = open(path);
+    lru_.emplace_front(path, conn);
+    connections_[path] = lru_.begin();
+    while (lru_.size() > std::max<std::size_t>(1, options_.max_connections))
     {
-      std::string msg = std::string("SQLiteStorage: create vectors failed: ") + (err ? err : "");
-      sqlite3_free(err);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
+      connections_.erase(lru_.back().first);
+      lru_.pop_back();
     }
+    return conn;
+  }
+
+  std::shared_ptr<Connection> open(const std::string& path) const
+  {
+    auto conn = std::make_shared<Connection>();
+    if (sqlite3_open_v2(path.c_str(), &conn->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) !=
+        SQLITE_OK)
+      conn->fail("open " + path);
+    sqlite3_busy_timeout(conn->db, options_.busy_timeout_ms);
+    conn->exec("PRAGMA journal_mode=" + options_.journal_mode, "set journal_mode");
+    conn->exec("PRAGMA synchronous=" + options_.synchronous, "set synchronous");
+    conn->exec("PRAGMA mmap_size=" + std::to_string(options_.mmap_size), "set mmap_size");
+    conn->exec("PRAGMA cache_size=" + std::to_string(options_.cache_size), "set cache_size");
+    conn->exec("CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY, value TEXT NOT NULL)", "create meta");
+    conn->exec("CREATE TABLE IF NOT EXISTS vectors ("
+               " id TEXT PRIMARY KEY,"
+               " dim INTEGER NOT NULL,"
+               " vec BLOB NOT NULL,"
+               " sq_norm REAL"
+               ")",
+               "create vectors");
+    if (!has_column(*conn, "vectors", "sq_norm"))
+      conn->exec("ALTER TABLE vectors ADD COLUMN sq_norm REAL", "add sq_norm");
+    const auto identity = file_identity(path);
+    if (!identity)
+      throw std::runtime_error("SQLiteStorage: open did not create " + path);
+    conn->identity = *identity;
+    return conn;
+  }
+
+  static bool has_column(Connection& conn, const std::string& table, const std::string& column)
+  {
+    sqlite3_stmt* stmt = conn.prepare("PRAGMA table_info(" + table + ")");
+    Reset reset{ stmt };
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+      const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+      if (name && column == name)
+        return true;
+    }
+    if (rc != SQLITE_DONE)
+      conn.fail("table_info " + table);
+    return false;
+  }
+
+  /**
+   * @brief Whether stored squared norms show unit-length rows, allowing for the rounding of narrow
+   *        element types.
+   */
+  static bool unit_norms(const std::vector<float>& sq_norms, precision type)
+  {
+    if (sq_norms.empty())
+      return false;
+    const float tolerance = type == precision::F32 ? 1e-4f : 2e-2f;
+    return std::all_of(sq_norms.begin(), sq_norms.end(),
+                       [&](float n) { return std::abs(n - 1.0f) <= tolerance; });
+  }
 
-    // Read meta
-    const char* sel_meta = "SELECT key, value FROM meta WHERE key IN ('embedding_dim','additional_data')";
-    sqlite3_stmt* m = nullptr;
-    if (sqlite3_prepare_v2(db, sel_meta, -1, &m, nullptr) != SQLITE_OK)
+  /**
+   * @brief Device and inode of the file at path; nullopt if it does not exist.
+   */
+  static std::optional<std::pair<std::uint64_t, std::uint64_t>> file_identity(const std::string& path)
+  {
+#if defined(_WIN32)
+    // No inode: only a deleted file is detected
+    if (!std::filesystem::exists(path))
+      return std::nullopt;
+    return std::make_pair(std::uint64_t(0), std::uint64_t(0));
+#else
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0)
+      return std::nullopt;
+    return std::make_pair(static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino));
+#endif
+  }
+
+  /**
+   * @brief Rows bound per multi-row statement with params placeholders each, within SQLite's limit.
+   */
+  std::size_t batch_rows(const Connection& conn, int params) const
+  {
+    const int limit = sqlite3_limit(conn.db, SQLITE_LIMIT_VARIABLE_NUMBER, -1) / params;
+    return static_cast<std::size_t>(std::max(1, std::min(options_.batch_rows, limit)));
+  }
+
+  /**
+   * @brief prefix followed by n comma-separated copies of group, then suffix.
+   */
+  static std::string repeat_sql(const std::string& prefix, const char* group, std::size_t n,
+                                const char* suffix = "")
+  {
+    std::string sql = prefix;
+    for (std::size_t i = 0; i < n; ++i)
     {
-      std::string msg = std::string("SQLiteStorage: prepare meta select failed: ") + sqlite3_errmsg(db);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
+      if (i)
+        sql += ",";
+      sql += group;
     }
-    while (sqlite3_step(m) == SQLITE_ROW)
+    return sql + suffix;
+  }
+
+  /**
+   * @brief INSERT or REPLACE records, batch_rows() per statement; the remainder goes one row at a time.
+   */
+  void write_vectors(Connection& conn, const std::string& verb, const std::vector<Data>& records, int dim,
+                     precision type) const
+  {
+    const std::size_t blob_bytes = static_cast<std::size_t>(std::max(0, dim)) * element_size(type);
+    const std::size_t batch = batch_rows(conn, 4);
+    const std::string prefix = verb + " INTO vectors(id, dim, vec, sq_norm) VALUES ";
+    std::vector<unsigned char> blobs(batch * blob_bytes);
+    for (std::size_t begin = 0; begin < records.size();)
     {
-      std::string key(reinterpret_cast<const char*>(sqlite3_column_text(m, 0)));
-      std::string val(reinterpret_cast<const char*>(sqlite3_column_text(m, 1)));
-      if (key == "embedding_dim")
+      const std::size_t n = records.size() - begin >= batch ? batch : 1;
+      sqlite3_stmt* stmt = conn.prepare(repeat_sql(prefix, "(?,?,?,?)", n));
+      Reset reset{ stmt };
+      for (std::size_t k = 0; k < n; ++k)
       {
-        res.embedding_dim = std::stoi(val);
-      }
-      else if (key == "additional_data")
-      {
-        try
-        {
-          res.additional = nlohmann::json::parse(val);
-        }
-        catch (...)
-        {
-          res.additional = nlohmann::json::object();
-        }
+        const Data& r = records[begin + k];
+        if (r.vector.size() != dim)
+          throw std::runtime_error("SQLiteStorage: record dim mismatch");
+        unsigned char* blob = blobs.data() + k * blob_bytes;
+        encode_values(type, r.vector.data(), blob, static_cast<std::size_t>(dim));
+        // Records hold the stored values (already rounded for narrow types), so this is the stored norm
+        const float sq_norm = kernels::dot(r.vector.data(), r.vector.data(), static_cast<std::size_t>(dim));
+        const int p = static_cast<int>(4 * k);
+        if (sqlite3_bind_text(stmt, p + 1, r.id.data(), static_cast<int>(r.id.size()), SQLITE_STATIC) !=
+                SQLITE_OK ||
+            sqlite3_bind_int(stmt, p + 2, dim) != SQLITE_OK ||
+            sqlite3_bind_blob(stmt, p + 3, blob, static_cast<int>(blob_bytes), SQLITE_STATIC) != SQLITE_OK ||
+            sqlite3_bind_double(stmt, p + 4, sq_norm) != SQLITE_OK)
+          conn.fail("bind " + verb);
       }
+      if (sqlite3_step(stmt) != SQLITE_DONE)
+        conn.fail(verb + " vectors");
+      begin += n;
     }
-    sqlite3_finalize(m);
+  }
 
-    // Read vectors
-    const char* sel_vecs = "SELECT id, dim, vec FROM vectors";
-    sqlite3_stmt* v = nullptr;
-    if (sqlite3_prepare_v2(db, sel_vecs, -1, &v, nullptr) != SQLITE_OK)
-    {
-      std::string msg = std::string("SQLiteStorage: prepare vectors select failed: ") + sqlite3_errmsg(db);
-      sqlite3_close(db);
-      throw std::runtime_error(msg);
-    }
-    while (sqlite3_step(v) == SQLITE_ROW)
+  void delete_vectors(Connection& conn, const std::vector<std::string>& ids) const
+  {
+    const std::size_t batch = batch_rows(conn, 1);
+    for (std::size_t begin = 0; begin < ids.size();)
     {
-      const char* idtxt = reinterpret_cast<const char*>(sqlite3_column_text(v, 0));
-      int dim = sqlite3_column_int(v, 1);
-      const void* blob = sqlite3_column_blob(v, 2);
-      int size = sqlite3_column_bytes(v, 2);
-      if (!blob || size != dim * static_cast<int>(sizeof(float)))
+      const std::size_t n = ids.size() - begin >= batch ? batch : 1;
+      sqlite3_stmt* stmt = conn.prepare(repeat_sql("DELETE FROM vectors WHERE id IN (", "?", n, ")"));
+      Reset reset{ stmt };
+      for (std::size_t k = 0; k < n; ++k)
       {
-        sqlite3_finalize(v);
-        sqlite3_close(db);
-        throw std::runtime_error("SQLiteStorage: blob size mismatch");
+        const std::string& id = ids[begin + k];
+        if (sqlite3_bind_text(stmt, static_cast<int>(k + 1), id.data(), static_cast<int>(id.size()),
+                              SQLITE_STATIC) != SQLITE_OK)
+          conn.fail("bind delete");
       }
-      Data r;
-      r.id = idtxt ? std::string(idtxt) : std::string();
-      r.vector.resize(dim);
-      std::memcpy(r.vector.data(), blob, static_cast<std::size_t>(size));
-      res.records.push_back(std::move(r));
+      if (sqlite3_step(stmt) != SQLITE_DONE)
+        conn.fail("delete vectors");
+      begin += n;
     }
-    sqlite3_finalize(v);
-    sqlite3_close(db);
-
-    if (res.embedding_dim == 0 && !res.records.empty())
-      res.embedding_dim = static_cast<int>(res.records.front().vector.size());
-    return res;
   }
 
-  // Byte-oriented API unused for rows backend; provide minimal implementations.
-  void write(const std::string& path, const std::vector<uint8_t>&) const override
+  void write_meta(Connection& conn, const std::vector<std::pair<std::string, std::string>>& entries) const
   {
-    throw std::runtime_error("SQLiteStorage: write(bytes) unsupported; use write_records");
+    sqlite3_stmt* stmt = conn.prepare("REPLACE INTO meta(key, value) VALUES (?1, ?2)");
+    for (const auto& [key, value] : entries)
+    {
+      Reset reset{ stmt };
+      if (sqlite3_bind_text(stmt, 1, key.data(), static_cast<int>(key.size()), SQLITE_STATIC) != SQLITE_OK ||
+          sqlite3_bind_text(stmt, 2, value.data(), static_cast<int>(value.size()), SQLITE_STATIC) !=
+              SQLITE_OK ||
+          sqlite3_step(stmt) != SQLITE_DONE)
+        conn.fail("upsert " + key);
+    }
   }
-  std::vector<uint8_t> read(const std::string& path) const override
+
+  std::optional<std::string> meta_value(Connection& conn, const char* key) const
   {
-    (void)path;
-    return {};  // no-op; rows API should be used
+    sqlite3_stmt* stmt = conn.prepare("SELECT value FROM meta WHERE key = ?1");
+    Reset reset{ stmt };
+    if (sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC) != SQLITE_OK)
+      conn.fail("bind meta select");
+    const int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE)
+      return std::nullopt;
+    if (rc != SQLITE_ROW)
+      conn.fail("meta select");
+    const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    return std::string(text ? text : "", static_cast<std::size_t>(sqlite3_column_bytes(stmt, 0)));
   }
+
+  using Lru = std::list<std::pair<std::string, std::shared_ptr<Connection>>>;
+
+  SQLiteOptions options_;
+  mutable std::mutex cache_mutex_;
+  mutable Lru lru_;  // most recently used first
+  mutable std::unordered_map<std::string, Lru::iterator> connections_;
 };
 
 }  // namespace nano_vectordb
@@ -0,0 +1,207 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../structs.hpp"
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Changes made by one save(), as appended to the write-ahead log.
+ */
+struct WalBatch
+{
+  std::vector<Data> upserts;         // fp32 vectors, as returned by get()
+  std::vector<std::string> removes;  // ids removed since the previous batch
+  nlohmann::json metadata;           // {columns, rows} for the changed ids; null when unchanged
+  nlohmann::json additional;         // additional_data; null when unchanged
+  std::uint64_t generation = 0;      // checkpoint the batch comes after; see WriteAheadLog
+};
+
+/**
+ * @brief Append-only log of upserts and removes kept next to a storage file
+ *
+ * Each save() appends one batch: a header (magic, dimension, payload size, FNV-1a checksum, generation)
+ * followed by the upserted records, the removed ids and a JSON blob with metadata and additional_data. A
+ * batch that was only partly written (for example after a crash) fails its checksum; read() stops there
+ * and the caller truncates the log back to its last whole batch.
+ *
+ * The storage file records the generation of the checkpoint that wrote it, and batches appended on top
+ * of it carry that generation plus one. A log left behind by a checkpoint (a crash before it was removed)
+ * therefore only holds batches at or below the storage file's generation, which replay skips.
+ */
+struct WriteAheadLog
+{
+  static constexpr std::uint32_t kMagic = 0x4257564Eu;  // "NVWB"
+
+  /**
+   * @brief Log path used for a storage file.
+   */
+  static std::string path_for(const std::string& storage_file)
+  {
+    return storage_file + ".wal";
+  }
+
+  /**
+   * @brief Append one batch and flush it.
+   *
+   * @return std::uint64_t Size of the log after the append, in bytes.
+   */
+  static std::uint64_t append(const std::string& path, int dim, const WalBatch& batch)
+  {
+    std::string payload;
+    auto put = [&](const void* data, std::size_t bytes) {
+      payload.append(static_cast<const char*>(data), bytes);
+    };
+    auto put_string = [&](const std::string& s) {
+      const auto len = static_cast<std::uint32_t>(s.size());
+      put(&len, sizeof(len));
+      put(s.data(), s.size());
+    };
+    const std::uint64_t n_upserts = batch.upserts.size();
+    put(&n_upserts, sizeof(n_upserts));
+    for (const auto& d : batch.upserts)
+    {
+      if (d.vector.size() != dim)
+        throw std::runtime_error("WriteAheadLog: record dim mismatch for id " + d.id);
+      put_string(d.id);
+      put(d.vector.data(), static_cast<std::size_t>(dim) * sizeof(float));
+    }
+    const std::uint64_t n_removes = batch.removes.size();
+    put(&n_removes, sizeof(n_removes));
+    for (const auto& id : batch.removes)
+      put_string(id);
+    nlohmann::json extra = nlohmann::json::object();
+    if (!batch.metadata.is_null())
+      extra["metadata"] = batch.metadata;
+    if (!batch.additional.is_null())
+      extra["additional_data"] = batch.additional;
+    put_string(extra.dump());
+
+    const std::uint32_t header_dim = static_cast<std::uint32_t>(dim);
+    const std::uint64_t bytes = payload.size();
+    const std::uint64_t sum = checksum(payload.data(), payload.size(), checksum(batch.generation));
+    std::ofstream out(path, std::ios::binary | std::ios::out | std::ios::app);
+    if (!out)
+      throw std::runtime_error("WriteAheadLog: cannot open for append: " + path);
+    out.write(reinterpret_cast<const char*>(&kMagic), sizeof(kMagic));
+    out.write(reinterpret_cast<const char*>(&header_dim), sizeof(header_dim));
+    out.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+    out.write(reinterpret_cast<const char*>(&sum), sizeof(sum));
+    out.write(reinterpret_cast<const char*>(&batch.generation), sizeof(batch.generation));
+    out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    out.flush();
+    if (!out)
+      throw std::runtime_error("WriteAheadLog: append failed: " + path);
+    return static_cast<std::uint64_t>(out.tellp());
+  }
+
+  /**
+   * @brief Read every whole batch of a log, in append order.
+   *
+   * @param valid_bytes Set to the length of the prefix holding those batches.
+   */
+  static std::vector<WalBatch> read(const std::string& path, int dim, std::uint64_t& valid_bytes)
+  {
+    valid_bytes = 0;
+    std::vector<WalBatch> batches;
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+      return batches;
+    std::string file(static_cast<std::size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    in.read(file.data(), static_cast<std::streamsize>(file.size()));
+
+    constexpr std::size_t header = sizeof(std::uint32_t) * 2 + sizeof(std::uint64_t) * 3;
+    std::size_t pos = 0;
+    while (file.size() - pos >= header)
+    {
+      std::uint32_t magic, batch_dim;
+      std::uint64_t bytes, sum, generation;
+      std::memcpy(&magic, file.data() + pos, sizeof(magic));
+      std::memcpy(&batch_dim, file.data() + pos + 4, sizeof(batch_dim));
+      std::memcpy(&bytes, file.data() + pos + 8, sizeof(bytes));
+      std::memcpy(&sum, file.data() + pos + 16, sizeof(sum));
+      std::memcpy(&generation, file.data() + pos + 24, sizeof(generation));
+      if (magic != kMagic || bytes > file.size() - pos - header)
+        break;
+      const char* payload = file.data() + pos + header;
+      if (checksum(payload, bytes, checksum(generation)) != sum)
+        break;
+      if (batch_dim != static_cast<std::uint32_t>(dim))
+      {
+        throw std::runtime_error("WriteAheadLog: dimension mismatch: expected " + std::to_string(dim) +
+                                 ", got " + std::to_string(batch_dim));
+      }
+      batches.push_back(parse(payload, bytes, dim));
+      batches.back().generation = generation;
+      pos += header + bytes;
+      valid_bytes = pos;
+    }
+    return batches;
+  }
+
+private:
+  static std::uint64_t checksum(const char* data, std::size_t n, std::uint64_t h = 1469598103934665603ull)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      h ^= static_cast<unsigned char>(data[i]);
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  static std::uint64_t checksum(std::uint64_t value)
+  {
+    return checksum(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  static WalBatch parse(const char* p, std::uint64_t bytes, int dim)
+  {
+    // The checksum already matched, so only a writer bug can make these reads run off the end
+    const char* end = p + bytes;
+    auto take = [&](void* out, std::size_t n) {
+      if (static_cast<std::size_t>(end - p) < n)
+        throw std::runtime_error("WriteAheadLog: malformed batch");
+      std::memcpy(out, p, n);
+      p += n;
+    };
+    auto take_string = [&]() {
+      std::uint32_t len;
+      take(&len, sizeof(len));
+      std::string s(len, '\0');
+      take(s.data(), len);
+      return s;
+    };
+    WalBatch batch;
+    std::uint64_t n_upserts;
+    take(&n_upserts, sizeof(n_upserts));
+    for (std::uint64_t i = 0; i < n_upserts; ++i)
+    {
+      Data d;
+      d.id = take_string();
+      d.vector.resize(dim);
+      take(d.vector.data(), static_cast<std::size_t>(dim) * sizeof(float));
+      batch.upserts.push_back(std::move(d));
+    }
+    std::uint64_t n_removes;
+    take(&n_removes, sizeof(n_removes));
+    for (std::uint64_t i = 0; i < n_removes; ++i)
+      batch.removes.push_back(take_string());
+    const nlohmann::json extra = nlohmann::json::parse(take_string());
+    if (extra.contains("metadata"))
+      batch.metadata = extra["metadata"];
+    if (extra.contains("additional_data"))
+      batch.additional = extra["additional_data"];
+    return batch;
+  }
+};
+
+}  // namespace nano_vectordb
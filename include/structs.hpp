@@ -1,10 +1,20 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
 #include <Eigen/Dense>
+#include "precision.hpp"
 
 namespace nano_vectordb
 {
 
+/**
+ * @brief Row-major float matrix; each stored vector is one contiguous row
+ */
+using RowMatrixXf = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
 /**
  * @brief Data record structure
  */
@@ -14,14 +24,85 @@ struct Data
   Eigen::VectorXf vector;
 };
 
+/**
+ * @brief Lightweight, non-owning view of a stored record
+ *
+ * Points into the database's id column and row storage, so it is only valid until the database is
+ * next mutated. Use to_data() to copy the record out.
+ */
+struct DataView
+{
+  std::string_view id;
+  int row = -1;
+  const float* values = nullptr;          // F32 storage
+  int dim = 0;
+  const std::uint16_t* narrow = nullptr;  // F16 / BF16 storage
+  precision type = precision::F32;
+
+  /**
+   * @brief Zero-copy view of the stored vector; only available for F32 storage (see decode()).
+   */
+  Eigen::Map<const Eigen::VectorXf> vector() const
+  {
+    if (type != precision::F32)
+      throw std::runtime_error("DataView::vector() needs F32 storage; use decode()");
+    return Eigen::Map<const Eigen::VectorXf>(values, dim);
+  }
+
+  /**
+   * @brief Copy of the stored vector as floats, for any storage precision.
+   */
+  Eigen::VectorXf decode() const
+  {
+    if (type == precision::F32)
+      return vector();
+    Eigen::VectorXf v(dim);
+    decode_values(type, narrow, v.data(), static_cast<std::size_t>(dim));
+    return v;
+  }
+
+  Data to_data() const
+  {
+    return { std::string(id), decode() };
+  }
+
+  // Lets filters written against `const Data&` keep working (at the cost of a copy per call)
+  operator Data() const
+  {
+    return to_data();
+  }
+};
+
 /**
  * @brief Query result structure
  *
  */
 struct QueryResult
 {
-  Data data;
+  DataView data;
   float score;
 };
 
+/**
+ * @brief Parallel scan options
+ */
+struct ScanOptions
+{
+  int threads = 1;                     // threads scanning one query, including the caller
+  std::size_t min_chunk_rows = 16384;  // minimum rows per parallel chunk
+};
+
+/**
+ * @brief Write-ahead log options for storage other than SQLite
+ *
+ * Off by default: save() then rewrites the storage file, so other readers of the file (and older
+ * binaries, which do not replay a log) always see the saved state.
+ */
+struct WalOptions
+{
+  bool enabled = false;                                  // save() appends changes to <storage_file>.wal
+  std::size_t checkpoint_bytes = std::size_t(64) << 20;  // rewrite the storage file past this log size
+  float checkpoint_fraction = 0.25f;                     // or once a save changes this fraction of rows
+};
+
 }  // namespace nano_vectordb
@@ -0,0 +1,197 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Fixed-size worker pool used for parallel scans.
+ *
+ * A pool can be owned by a single NanoVectorDB or shared by many (e.g. all tenants of a
+ * MultiTenantNanoVDB). `parallel_for` lets the calling thread take part in the work, so it is safe to
+ * call from inside a task running on the same pool.
+ */
+class ThreadPool
+{
+public:
+  /**
+   * @brief Construct a new Thread Pool object
+   *
+   * @param threads Number of worker threads (0 = one per hardware thread).
+   */
+  explicit ThreadPool(std::size_t threads = 0) : ThreadPool(threads, nullptr)
+  {
+  }
+
+  /**
+   * @brief Pool whose workers each run a setup call (e.g. pin themselves to CPUs) before taking tasks
+   *
+   * @param threads Number of worker threads (0 = one per hardware thread).
+   * @param on_start Called on every worker thread with its index, before its first task.
+   */
+  ThreadPool(std::size_t threads, std::function<void(std::size_t)> on_start)
+  {
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    workers_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+      workers_.emplace_back([this, i, on_start] {
+        if (on_start)
+          on_start(i);
+        worker_loop();
+      });
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * @brief Stop accepting work, finish queued tasks and join the workers.
+   */
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_)
+      t.join();
+  }
+
+  /**
+   * @brief Number of worker threads.
+   */
+  std::size_t size() const
+  {
+    return workers_.size();
+  }
+
+  /**
+   * @brief Queue a task and get a future for its result.
+   *
+   * @param f Callable taking no arguments.
+   * @return std::future of the callable's result.
+   */
+  template <typename F>
+  auto submit(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+  {
+    using R = std::invoke_result_t<std::decay_t<F>>;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    std::future<R> fut = task->get_future();
+    enqueue([task] { (*task)(); });
+    return fut;
+  }
+
+  /**
+   * @brief Run fn(i) for every i in [0, n) and wait for all of them.
+   *
+   * Indices are claimed dynamically by the caller and by idle workers. The first exception thrown by
+   * fn is rethrown on the calling thread once every claimed index has finished.
+   *
+   * @param n Number of work items.
+   * @param fn Work item callable.
+   */
+  void parallel_for(std::size_t n, const std::function<void(std::size_t)>& fn)
+  {
+    if (n == 0)
+      return;
+    if (n == 1 || workers_.empty())
+    {
+      for (std::size_t i = 0; i < n; ++i)
+        fn(i);
+      return;
+    }
+    struct State
+    {
+      std::atomic<std::size_t> next{ 0 };
+      std::size_t done = 0;
+      std::exception_ptr error;
+      std::mutex mutex;
+      std::condition_variable cv;
+    };
+    auto state = std::make_shared<State>();
+    const std::function<void(std::size_t)>* body = &fn;
+    // Helpers may start after the loop finished; they then claim nothing and only touch `state`.
+    auto drain = [state, body, n] {
+      std::size_t finished = 0;
+      std::exception_ptr error;
+      for (std::size_t i = state->next.fetch_add(1); i < n; i = state->next.fetch_add(1))
+      {
+        try
+        {
+          (*body)(i);
+        }
+        catch (...)
+        {
+          if (!error)
+            error = std::current_exception();
+        }
+        ++finished;
+      }
+      if (finished == 0)
+        return;
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (error && !state->error)
+        state->error = error;
+      state->done += finished;
+      if (state->done == n)
+        state->cv.notify_all();
+    };
+    const std::size_t helpers = std::min(workers_.size(), n - 1);
+    for (std::size_t h = 0; h < helpers; ++h)
+      enqueue(drain);
+    drain();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&] { return state->done == n; });
+    if (state->error)
+      std::rethrow_exception(state->error);
+  }
+
+private:
+  void enqueue(std::function<void()> task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+  }
+
+  void worker_loop()
+  {
+    for (;;)
+    {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+        if (stop_ && tasks_.empty())
+          return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+};
+
+}  // namespace nano_vectordb
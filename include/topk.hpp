@@ -0,0 +1,109 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <optional>
+#include <limits>
+#include <algorithm>
+
+namespace nano_vectordb
+{
+
+/**
+ * @brief Streaming bounded top-k selector over (row index, score) pairs.
+ *
+ * Higher scores are better. The best k candidates are kept in a min-heap, so scanning n rows costs
+ * O(n log k) time and O(min(n, k)) memory: the heap grows with the candidates pushed, so a k far above
+ * the candidate count costs nothing up front. Candidates scoring below the optional threshold are
+ * rejected on push.
+ */
+class TopK
+{
+public:
+  /**
+   * @brief Construct a new TopK selector
+   *
+   * @param k Maximum number of candidates to keep.
+   * @param threshold Optional minimum score a candidate must reach.
+   */
+  explicit TopK(int k, std::optional<float> threshold = std::nullopt)
+    : k_(std::max(0, k)), floor_(threshold ? *threshold : -std::numeric_limits<float>::infinity())
+  {
+  }
+
+  /**
+   * @brief Lowest score a new candidate needs to be accepted.
+   *
+   * @return float Current admission bound.
+   */
+  float bound() const
+  {
+    return full() ? std::max(floor_, heap_.front().second) : floor_;
+  }
+
+  /**
+   * @brief Check whether k candidates are already held.
+   */
+  bool full() const
+  {
+    return static_cast<int>(heap_.size()) >= k_;
+  }
+
+  /**
+   * @brief Offer a candidate to the selector.
+   *
+   * @param idx Row index.
+   * @param score Candidate score.
+   */
+  void push(int idx, float score)
+  {
+    if (k_ == 0 || !(score >= floor_))
+      return;
+    if (!full())
+    {
+      heap_.emplace_back(idx, score);
+      std::push_heap(heap_.begin(), heap_.end(), better);
+    }
+    else if (better({ idx, score }, heap_.front()))
+    {
+      std::pop_heap(heap_.begin(), heap_.end(), better);
+      heap_.back() = { idx, score };
+      std::push_heap(heap_.begin(), heap_.end(), better);
+    }
+  }
+
+  /**
+   * @brief Merge the candidates held by another selector into this one.
+   *
+   * @param other Selector to merge from.
+   */
+  void merge(const TopK& other)
+  {
+    for (const auto& c : other.heap_)
+      push(c.first, c.second);
+  }
+
+  /**
+   * @brief Extract the held candidates, best first.
+   *
+   * @return std::vector<std::pair<int, float>> Candidates sorted by descending score.
+   */
+  std::vector<std::pair<int, float>> take_sorted()
+  {
+    std::sort(heap_.begin(), heap_.end(), better);
+    return std::move(heap_);
+  }
+
+private:
+  // Used as the heap "less than", so the heap front is the worst candidate kept.
+  // Ties are broken by row index to keep results deterministic.
+  static bool better(const std::pair<int, float>& a, const std::pair<int, float>& b)
+  {
+    return a.second > b.second || (a.second == b.second && a.first < b.first);
+  }
+
+  int k_;
+  float floor_;
+  std::vector<std::pair<int, float>> heap_;
+};
+
+}  // namespace nano_vectordb
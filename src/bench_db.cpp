@@ -0,0 +1,707 @@
+// Throughput benchmarks for NanoVectorDB and MultiTenantNanoVDB, built on Google Benchmark.
+//
+// Datasets: synthetic Gaussian vectors at 10k rows x 384/768/1536 dims, plus 1M rows x 384/768 when
+// NANOVDB_BENCH_LARGE=1, plus real embeddings read from an .fvecs file named by NANOVDB_BENCH_FVECS
+// (optionally "path:rows" to cap the row count).
+//
+// Machine-readable output: ./nanovdb_bench --benchmark_format=json --benchmark_out=run.json
+#include <benchmark/benchmark.h>
+#include "NanoVectorDB.hpp"
+#include "MultiTenantNanoVDB.hpp"
+#include "SegmentedNanoVectorDB.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace nano_vectordb;
+
+namespace
+{
+
+constexpr std::size_t kQueries = 256;     // distinct query vectors cycled through by query benchmarks
+constexpr std::size_t kBuckets = 100;     // values of the "bucket" metadata column
+constexpr std::int64_t kFilterHi = 9;     // where::range("bucket", 0, 9) keeps 10% of the rows
+constexpr std::size_t kBatchRows = 1000;  // rows per upsert() call
+constexpr std::size_t kTouchRows = 100;   // ids per get() / remove() / incremental save
+
+struct Shape
+{
+  std::string source;  // "synthetic" or "fvecs"
+  std::size_t rows;
+  int dim;
+};
+
+struct Dataset
+{
+  std::vector<Data> records;
+  std::vector<Eigen::VectorXf> queries;
+  int dim = 0;
+};
+
+std::string shape_name(const Shape& shape)
+{
+  return shape.source + "/rows:" + std::to_string(shape.rows) + "/dim:" + std::to_string(shape.dim);
+}
+
+std::string bench_dir()
+{
+  const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nanovdb_bench";
+  std::filesystem::create_directories(dir);
+  return dir.string();
+}
+
+// "path" or "path:rows" from NANOVDB_BENCH_FVECS
+std::pair<std::string, std::size_t> fvecs_spec()
+{
+  const char* env = std::getenv("NANOVDB_BENCH_FVECS");
+  if (!env || !*env)
+    return { std::string(), 0 };
+  std::string spec(env);
+  std::size_t limit = 0;
+  const auto colon = spec.rfind(':');
+  if (colon != std::string::npos && colon + 1 < spec.size() &&
+      spec.find_first_not_of("0123456789", colon + 1) == std::string::npos)
+  {
+    limit = std::stoull(spec.substr(colon + 1));
+    spec.resize(colon);
+  }
+  return { spec, limit };
+}
+
+/**
+ * @brief Read an .fvecs file: each vector is an int32 dimension followed by that many floats.
+ */
+std::vector<Eigen::VectorXf> read_fvecs(const std::string& path, std::size_t limit)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error("Cannot open fvecs file: " + path);
+  std::vector<Eigen::VectorXf> out;
+  std::int32_t dim = 0;
+  while ((limit == 0 || out.size() < limit) && in.read(reinterpret_cast<char*>(&dim), sizeof(dim)))
+  {
+    if (dim <= 0 || (!out.empty() && dim != out.front().size()))
+      throw std::runtime_error("Inconsistent dimension in fvecs file: " + path);
+    Eigen::VectorXf v(dim);
+    if (!in.read(reinterpret_cast<char*>(v.data()), sizeof(float) * static_cast<std::size_t>(dim)))
+      break;
+    out.push_back(std::move(v));
+  }
+  return out;
+}
+
+/**
+ * @brief Dataset for a shape, generated (or read) once per process.
+ */
+const Dataset& dataset(const Shape& shape)
+{
+  static std::map<std::string, Dataset> cache;
+  const std::string key = shape_name(shape);
+  auto it = cache.find(key);
+  if (it != cache.end())
+    return it->second;
+
+  Dataset data;
+  data.dim = shape.dim;
+  data.records.reserve(shape.rows);
+  if (shape.source == "fvecs")
+  {
+    // The last vectors of the file are held out as queries
+    std::vector<Eigen::VectorXf> vectors = read_fvecs(fvecs_spec().first, shape.rows + kQueries);
+    const std::size_t queries = std::min(kQueries, vectors.size() / 10 + 1);
+    for (std::size_t i = 0; i + queries < vectors.size(); ++i)
+      data.records.push_back({ "v" + std::to_string(i), std::move(vectors[i]) });
+    for (std::size_t i = vectors.size() - queries; i < vectors.size(); ++i)
+      data.queries.push_back(std::move(vectors[i]));
+  }
+  else
+  {
+    std::mt19937_64 rng(0x5eed ^ shape.rows ^ (static_cast<std::uint64_t>(shape.dim) << 32));
+    std::normal_distribution<float> normal;
+    auto vec = [&] {
+      Eigen::VectorXf v(shape.dim);
+      for (int d = 0; d < shape.dim; ++d)
+        v[d] = normal(rng);
+      return v;
+    };
+    for (std::size_t i = 0; i < shape.rows; ++i)
+      data.records.push_back({ "v" + std::to_string(i), vec() });
+    for (std::size_t i = 0; i < kQueries; ++i)
+      data.queries.push_back(vec());
+  }
+  return cache.emplace(key, std::move(data)).first->second;
+}
+
+/**
+ * @brief Fill a database with a dataset and tag every row with a "bucket" column for filters.
+ */
+void populate(NanoVectorDB& db, const Dataset& data)
+{
+  db.reserve(data.records.size());
+  for (std::size_t i = 0; i < data.records.size(); i += kBatchRows)
+  {
+    const auto first = data.records.begin() + static_cast<std::ptrdiff_t>(i);
+    const auto last =
+      data.records.begin() + static_cast<std::ptrdiff_t>(std::min(i + kBatchRows, data.records.size()));
+    db.upsert(std::vector<Data>(first, last));
+  }
+  db.add_column("bucket", column_type::Int);
+  for (std::size_t i = 0; i < data.records.size(); ++i)
+    db.set_metadata(data.records[i].id, "bucket", static_cast<std::int64_t>(i % kBuckets));
+}
+
+std::unique_ptr<NanoVectorDB> make_db(const Dataset& data, metric type, const std::string& path,
+                                      std::shared_ptr<IStorage> storage = nullptr)
+{
+  auto db = std::make_unique<NanoVectorDB>(data.dim, "cosine", path, nullptr, std::move(storage));
+  db->initialize_metric(type);
+  populate(*db, data);
+  return db;
+}
+
+/**
+ * @brief Populated in-memory database, built once per shape and metric and shared by read benchmarks.
+ */
+NanoVectorDB& shared_db(const Shape& shape, metric type)
+{
+  static std::map<std::pair<std::string, int>, std::unique_ptr<NanoVectorDB>> cache;
+  auto& db = cache[{ shape_name(shape), static_cast<int>(type) }];
+  if (!db)
+    db = make_db(dataset(shape), type, bench_dir() + "/unsaved.json");
+  return *db;
+}
+
+std::vector<std::string> sample_ids(const Dataset& data, std::mt19937_64& rng)
+{
+  std::uniform_int_distribution<std::size_t> pick(0, data.records.size() - 1);
+  std::vector<std::string> ids;
+  ids.reserve(kTouchRows);
+  for (std::size_t i = 0; i < kTouchRows; ++i)
+    ids.push_back(data.records[pick(rng)].id);
+  return ids;
+}
+
+void bm_upsert(benchmark::State& state, Shape shape)
+{
+  const Dataset& data = dataset(shape);
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    auto db = std::make_unique<NanoVectorDB>(data.dim, "cosine", bench_dir() + "/unsaved.json");
+    std::vector<std::vector<Data>> batches;
+    for (std::size_t i = 0; i < data.records.size(); i += kBatchRows)
+    {
+      const auto first = data.records.begin() + static_cast<std::ptrdiff_t>(i);
+      const auto last =
+        data.records.begin() + static_cast<std::ptrdiff_t>(std::min(i + kBatchRows, data.records.size()));
+      batches.emplace_back(first, last);
+    }
+    state.ResumeTiming();
+    for (const auto& batch : batches)
+      db->upsert(batch);
+    benchmark::DoNotOptimize(db->size());
+    state.PauseTiming();
+    db.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * data.records.size()));
+}
+
+/**
+ * @brief Same rows as bm_upsert, loaded from one contiguous buffer with a single bulk upsert.
+ */
+void bm_upsert_bulk(benchmark::State& state, Shape shape)
+{
+  const Dataset& data = dataset(shape);
+  RowMatrixXf rows(static_cast<Eigen::Index>(data.records.size()), data.dim);
+  std::vector<std::string> ids;
+  ids.reserve(data.records.size());
+  for (std::size_t i = 0; i < data.records.size(); ++i)
+  {
+    rows.row(static_cast<Eigen::Index>(i)) = data.records[i].vector.transpose();
+    ids.push_back(data.records[i].id);
+  }
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    auto db = std::make_unique<NanoVectorDB>(data.dim, "cosine", bench_dir() + "/unsaved.json");
+    state.ResumeTiming();
+    db->upsert(rows.data(), ids.size(), ids.data());
+    benchmark::DoNotOptimize(db->size());
+    state.PauseTiming();
+    db.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * data.records.size()));
+}
+
+void bm_query(benchmark::State& state, Shape shape, metric type, bool filtered)
+{
+  const Dataset& data = dataset(shape);
+  NanoVectorDB& db = shared_db(shape, type);
+  const Predicate where_bucket = where::range("bucket", 0, kFilterHi);
+  std::size_t q = 0;
+  for (auto _ : state)
+  {
+    const Eigen::VectorXf& query = data.queries[q++ % data.queries.size()];
+    auto results = filtered ? db.query(query, 10, std::nullopt, where_bucket) : db.query(query, 10);
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+
+/**
+ * @brief bm_query with the result cache on and warmed with every query, so each timed call hits.
+ */
+void bm_query_cached(benchmark::State& state, Shape shape)
+{
+  const Dataset& data = dataset(shape);
+  NanoVectorDB& db = shared_db(shape, metric::Cosine);
+  db.set_query_cache(data.queries.size());
+  for (const auto& query : data.queries)
+    db.query(query, 10);
+  std::size_t q = 0;
+  for (auto _ : state)
+  {
+    auto results = db.query(data.queries[q++ % data.queries.size()], 10);
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.counters["hit_rate"] = db.query_cache_stats().hit_rate();
+  db.set_query_cache(0);
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+
+void bm_get(benchmark::State& state, Shape shape)
+{
+  const Dataset& data = dataset(shape);
+  NanoVectorDB& db = shared_db(shape, metric::Cosine);
+  std::mt19937_64 rng(1);
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    const std::vector<std::string> ids = sample_ids(data, rng);
+    state.ResumeTiming();
+    auto records = db.get(ids);
+    benchmark::DoNotOptimize(records.data());
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kTouchRows));
+}
+
+void bm_remove(benchmark::State& state, Shape shape)
+{
+  const Dataset& data = dataset(shape);
+  auto db = make_db(data, metric::Cosine, bench_dir() + "/unsaved.json");
+  db->set_compaction_threshold(0.0f);  // measure tombstoning, not compaction
+  std::mt19937_64 rng(2);
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    const std::vector<std::string> ids = sample_ids(data, rng);
+    state.ResumeTiming();
+    db->remove(ids);
+    state.PauseTiming();
+    std::vector<Data> back;
+    for (const auto& id : ids)
+      back.push_back({ id, data.records[std::stoull(id.substr(1))].vector });
+    db->upsert(back);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kTouchRows));
+}
+
+const char* storage_name(storage type)
+{
+  switch (type)
+  {
+    case storage::File:
+      return "file";
+    case storage::SQLite:
+      return "sqlite";
+    case storage::MMap:
+      return "mmap";
+  }
+  return "unknown";
+}
+
+std::string storage_path(storage type)
+{
+  return bench_dir() + "/db_" + storage_name(type) + (type == storage::SQLite ? ".sqlite" : ".nvdb");
+}
+
+void remove_storage(const std::string& path)
+{
+  const std::string index = IPersistentIndex::path_for(path);
+  for (const std::string& file : { path, WriteAheadLog::path_for(path), path + "-wal", path + "-shm", index })
+    std::filesystem::remove(file);
+}
+
+// Full save: rewrite every row
+void bm_save(benchmark::State& state, Shape shape, storage type)
+{
+  const Dataset& data = dataset(shape);
+  const std::string path = storage_path(type);
+  remove_storage(path);
+  auto db = make_db(data, metric::Cosine, path, ::nano_vectordb::make(type));
+  for (auto _ : state)
+    db->checkpoint();
+  state.SetBytesProcessed(
+    static_cast<std::int64_t>(state.iterations() * data.records.size() * sizeof(float) * data.dim));
+  db.reset();
+  remove_storage(path);
+}
+
+// Incremental save after kTouchRows upserts (SQLite rows or write-ahead log)
+void bm_save_incremental(benchmark::State& state, Shape shape, storage type)
+{
+  const Dataset& data = dataset(shape);
+  const std::string path = storage_path(type);
+  remove_storage(path);
+  auto db = make_db(data, metric::Cosine, path, ::nano_vectordb::make(type));
+  WalOptions wal;
+  wal.enabled = true;  // opt-in; SQLite saves changed rows either way
+  db->set_wal_options(wal);
+  db->save();
+  std::mt19937_64 rng(3);
+  std::normal_distribution<float> normal;
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    std::vector<Data> changed;
+    for (const auto& id : sample_ids(data, rng))
+    {
+      Eigen::VectorXf v(data.dim);
+      for (int d = 0; d < data.dim; ++d)
+        v[d] = normal(rng);
+      changed.push_back({ id, v });
+    }
+    db->upsert(changed);
+    state.ResumeTiming();
+    db->save();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kTouchRows));
+  db.reset();
+  remove_storage(path);
+}
+
+// The same incremental save on a segmented collection: only the write segment and the tombstoned
+// sealed segments are written
+void bm_segmented_save_incremental(benchmark::State& state, Shape shape)
+{
+  const Dataset& data = dataset(shape);
+  const std::string dir = bench_dir() + "/segmented";
+  std::filesystem::remove_all(dir);
+  SegmentOptions options;
+  options.seal_rows = 2048;
+  options.background = false;
+  auto db = std::make_unique<SegmentedNanoVectorDB>(data.dim, metric::Cosine, dir, options);
+  db->upsert(data.records);
+  db->save();
+  std::mt19937_64 rng(3);
+  std::normal_distribution<float> normal;
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    std::vector<Data> changed;
+    for (const auto& id : sample_ids(data, rng))
+    {
+      Eigen::VectorXf v(data.dim);
+      for (int d = 0; d < data.dim; ++d)
+        v[d] = normal(rng);
+      changed.push_back({ id, v });
+    }
+    db->upsert(changed);
+    state.ResumeTiming();
+    db->save();
+  }
+  state.counters["segments"] = static_cast<double>(db->segments().size());
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kTouchRows));
+  db.reset();
+  std::filesystem::remove_all(dir);
+}
+
+void bm_load(benchmark::State& state, Shape shape, storage type)
+{
+  const Dataset& data = dataset(shape);
+  const std::string path = storage_path(type);
+  remove_storage(path);
+  make_db(data, metric::Cosine, path, ::nano_vectordb::make(type))->checkpoint();
+  for (auto _ : state)
+  {
+    NanoVectorDB loaded(data.dim, "cosine", path, nullptr, ::nano_vectordb::make(type));
+    benchmark::DoNotOptimize(loaded.size());
+  }
+  state.SetBytesProcessed(
+    static_cast<std::int64_t>(state.iterations() * data.records.size() * sizeof(float) * data.dim));
+  remove_storage(path);
+}
+
+// Open a mapped database and attach a PQ index: loaded from the saved index file, or trained and encoded
+// from the rows (on a reduced training sample, so the suite stays short)
+void bm_load_pq(benchmark::State& state, Shape shape, bool saved_index)
+{
+  const Dataset& data = dataset(shape);
+  PQParams params;
+  params.train_sample = 4096;
+  params.iterations = 5;
+  const std::string path = storage_path(storage::MMap);
+  remove_storage(path);
+  {
+    auto db = make_db(data, metric::Cosine, path, ::nano_vectordb::make(storage::MMap));
+    db->initialize_index(std::make_shared<PQIndex>(params));
+    db->checkpoint();
+  }
+  if (!saved_index)
+    std::filesystem::remove(IPersistentIndex::path_for(path));
+  for (auto _ : state)
+  {
+    NanoVectorDB loaded(data.dim, "cosine", path, nullptr, ::nano_vectordb::make(storage::MMap));
+    loaded.initialize_index(std::make_shared<PQIndex>(params));
+    benchmark::DoNotOptimize(loaded.size());
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * data.records.size()));
+  remove_storage(path);
+}
+
+/**
+ * @brief Zipf(s) sampler over ranks [0, n): rank r is drawn with probability proportional to 1/(r+1)^s.
+ */
+class Zipf
+{
+public:
+  Zipf(std::size_t n, double s)
+  {
+    cdf_.reserve(n);
+    double sum = 0.0;
+    for (std::size_t r = 0; r < n; ++r)
+      cdf_.push_back(sum += 1.0 / std::pow(static_cast<double>(r + 1), s));
+    for (double& c : cdf_)
+      c /= sum;
+  }
+
+  template <typename Rng>
+  std::size_t operator()(Rng& rng) const
+  {
+    const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    const auto rank = static_cast<std::size_t>(std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin());
+    return std::min(rank, cdf_.size() - 1);
+  }
+
+private:
+  std::vector<double> cdf_;
+};
+
+// Tenants accessed with a Zipfian skew through a cache holding a tenth of them; each access runs a query
+void bm_tenant_churn(benchmark::State& state, storage type, std::size_t tenants, double skew)
+{
+  constexpr int kDim = 128;
+  constexpr std::size_t kTenantRows = 200;
+  const std::string dir = bench_dir() + "/tenants_" + storage_name(type);
+  std::filesystem::remove_all(dir);
+  const Shape shape{ "synthetic", kTenantRows, kDim };
+  const Dataset& data = dataset(shape);
+  std::vector<std::string> ids;
+  {
+    MultiTenantNanoVDB setup(kDim, "cosine", static_cast<int>(tenants), dir);
+    setup.set_default_storage(type);
+    for (std::size_t t = 0; t < tenants; ++t)
+    {
+      ids.push_back(setup.create_tenant());
+      setup.get_tenant(ids.back())->upsert(data.records);
+    }
+    setup.save();
+  }
+  // Rank order is shuffled so the hot tenants spread over the cache shards
+  std::mt19937_64 rng(4);
+  std::shuffle(ids.begin(), ids.end(), rng);
+  const Zipf zipf(tenants, skew);
+
+  MultiTenantNanoVDB cache(kDim, "cosine", static_cast<int>(std::max<std::size_t>(1, tenants / 10)), dir);
+  cache.set_default_storage(type);
+  // Warm the cache so the timed loop sees the steady-state hit rate
+  for (std::size_t i = 0; i < tenants; ++i)
+    cache.get_tenant(ids[zipf(rng)]);
+  cache.wait_for_io();
+  const TenantCacheStats warm = cache.cache_stats();
+  std::size_t q = 0;
+  for (auto _ : state)
+  {
+    auto db = cache.get_tenant(ids[zipf(rng)]);
+    auto results = db->query(data.queries[q++ % data.queries.size()], 10);
+    benchmark::DoNotOptimize(results.data());
+  }
+  cache.wait_for_io();
+  const TenantCacheStats stats = cache.cache_stats();
+  const std::uint64_t hits = stats.hits - warm.hits;
+  const auto requests = std::max<std::uint64_t>(1, hits + stats.misses - warm.misses);
+  state.counters["hit_rate"] = static_cast<double>(hits) / static_cast<double>(requests);
+  state.counters["cached_bytes"] = static_cast<double>(stats.bytes);
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+  std::filesystem::remove_all(dir);
+}
+
+// One query over many cached tenants: a serial get_tenant + query loop, or query_many on a shared pool
+void bm_tenant_fanout(benchmark::State& state, std::size_t tenants, bool fan_out, bool numa)
+{
+  constexpr int kDim = 128;
+  constexpr std::size_t kTenantRows = 2000;
+  const std::string dir = bench_dir() + "/tenants_fanout";
+  std::filesystem::remove_all(dir);
+  const Shape shape{ "synthetic", kTenantRows, kDim };
+  const Dataset& data = dataset(shape);
+  MultiTenantNanoVDB cache(kDim, "cosine", static_cast<int>(tenants), dir);
+  cache.set_default_storage(storage::File);
+  const unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+  cache.set_scan_options(ScanOptions{ static_cast<int>(threads) });
+  // Tenants homed on the detected nodes and searched on their node's pinned pool
+  if (numa)
+    cache.set_numa_options(NumaOptions{});
+  std::vector<std::string> ids;
+  for (std::size_t t = 0; t < tenants; ++t)
+  {
+    ids.push_back(cache.create_tenant());
+    cache.get_tenant(ids.back())->upsert(data.records);
+  }
+  std::size_t q = 0;
+  for (auto _ : state)
+  {
+    const Eigen::VectorXf& query = data.queries[q++ % data.queries.size()];
+    if (fan_out)
+    {
+      auto results = cache.query_many(ids, query, 10);
+      benchmark::DoNotOptimize(results.data());
+      continue;
+    }
+    std::vector<TenantQueryResult> all;
+    for (const auto& id : ids)
+    {
+      auto db = cache.get_tenant(id);
+      for (const auto& r : db->query(query, 10))
+        all.push_back({ id, std::string(r.data.id), r.score });
+    }
+    const auto top = all.begin() + static_cast<std::ptrdiff_t>(std::min<std::size_t>(10, all.size()));
+    std::partial_sort(all.begin(), top, all.end(),
+                      [](const TenantQueryResult& a, const TenantQueryResult& b) {
+                        return a.score > b.score;
+                      });
+    benchmark::DoNotOptimize(all.data());
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+  std::filesystem::remove_all(dir);
+}
+
+std::vector<Shape> shapes()
+{
+  std::vector<Shape> out;
+  for (int dim : { 384, 768, 1536 })
+    out.push_back({ "synthetic", 10000, dim });
+  const char* large = std::getenv("NANOVDB_BENCH_LARGE");
+  if (large && std::string(large) == "1")
+  {
+    for (int dim : { 384, 768 })
+      out.push_back({ "synthetic", 1000000, dim });
+  }
+  const auto [path, limit] = fvecs_spec();
+  if (!path.empty())
+  {
+    // Probe the file for its dimension and row count
+    const std::vector<Eigen::VectorXf> first = read_fvecs(path, 1);
+    if (!first.empty())
+    {
+      std::size_t rows = limit;
+      if (rows == 0)
+      {
+        const auto bytes = std::filesystem::file_size(path);
+        const std::size_t dim = static_cast<std::size_t>(first.front().size());
+        rows = bytes / (sizeof(std::int32_t) + sizeof(float) * dim);
+        rows -= std::min(rows, kQueries);
+      }
+      out.push_back({ "fvecs", rows, static_cast<int>(first.front().size()) });
+    }
+  }
+  return out;
+}
+
+void register_benchmarks()
+{
+  for (const Shape& shape : shapes())
+  {
+    const std::string name = shape_name(shape);
+    benchmark::RegisterBenchmark(("upsert/" + name).c_str(), bm_upsert, shape)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(("upsert_bulk/" + name).c_str(), bm_upsert_bulk, shape)
+      ->Unit(benchmark::kMillisecond);
+    for (metric type : { metric::Cosine, metric::L2 })
+    {
+      const std::string metric_name = type == metric::Cosine ? "cosine" : "l2";
+      for (bool filtered : { false, true })
+      {
+        const std::string query_name = "query/" + metric_name + (filtered ? "/filtered/" : "/all/") + name;
+        benchmark::RegisterBenchmark(query_name.c_str(), bm_query, shape, type, filtered)
+          ->Unit(benchmark::kMicrosecond);
+      }
+    }
+    benchmark::RegisterBenchmark(("query/cosine/cached/" + name).c_str(), bm_query_cached, shape)
+      ->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark(("get/" + name).c_str(), bm_get, shape)->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark(("remove/" + name).c_str(), bm_remove, shape)->Unit(benchmark::kMicrosecond);
+    for (storage type : { storage::File, storage::SQLite, storage::MMap })
+    {
+      const std::string backend = storage_name(type);
+      benchmark::RegisterBenchmark(("save/" + backend + "/" + name).c_str(), bm_save, shape, type)
+        ->Unit(benchmark::kMillisecond);
+      benchmark::RegisterBenchmark(("save_incremental/" + backend + "/" + name).c_str(), bm_save_incremental,
+                                   shape, type)
+        ->Unit(benchmark::kMillisecond);
+      benchmark::RegisterBenchmark(("load/" + backend + "/" + name).c_str(), bm_load, shape, type)
+        ->Unit(benchmark::kMillisecond);
+    }
+    for (bool saved_index : { false, true })
+    {
+      const std::string pq_name =
+        std::string("load/mmap_pq/") + (saved_index ? "index_file/" : "encode/") + name;
+      benchmark::RegisterBenchmark(pq_name.c_str(), bm_load_pq, shape, saved_index)
+        ->Unit(benchmark::kMillisecond);
+    }
+    benchmark::RegisterBenchmark(("save_incremental/segmented/" + name).c_str(),
+                                 bm_segmented_save_incremental, shape)
+      ->Unit(benchmark::kMillisecond);
+  }
+  for (storage type : { storage::File, storage::SQLite })
+  {
+    const std::string churn_name =
+      std::string("tenant_churn/") + storage_name(type) + "/tenants:1000/zipf:1.1";
+    benchmark::RegisterBenchmark(churn_name.c_str(), bm_tenant_churn, type, std::size_t(1000), 1.1)
+      ->Unit(benchmark::kMicrosecond);
+  }
+  for (const auto& [mode, fan_out, numa] : { std::make_tuple("serial", false, false),
+                                             std::make_tuple("query_many", true, false),
+                                             std::make_tuple("query_many_numa", true, true) })
+  {
+    const std::string fanout_name = std::string("tenant_fanout/") + mode + "/tenants:64";
+    benchmark::RegisterBenchmark(fanout_name.c_str(), bm_tenant_fanout, std::size_t(64), fan_out, numa)
+      ->Unit(benchmark::kMicrosecond);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  register_benchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
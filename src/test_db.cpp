@@ -3,10 +3,15 @@
 // followed by comprehensive storage-specific tests at the end to exercise save/load behavior.
 #include "NanoVectorDB.hpp"
 #include "MultiTenantNanoVDB.hpp"
+#include "SegmentedNanoVectorDB.hpp"
 #include <iostream>
 #include <random>
 #include <cassert>
 #include <filesystem>
+#include <fstream>
+#include <atomic>
+#include <thread>
+#include <limits>
 
 using namespace nano_vectordb;
 
@@ -21,6 +26,13 @@ Eigen::VectorXf random_vector(int dim)
   return v;
 }
 
+// Remove a SQLite database together with the journal files WAL mode keeps next to it
+void remove_sqlite_files(const std::string& path)
+{
+  for (const std::string& file : { path, path + "-wal", path + "-shm" })
+    std::filesystem::remove(file);
+}
+
 // Basic initialization, upsert, save, reload, and query using default File storage.
 void test_init()
 {
@@ -54,6 +66,85 @@ void test_init()
   std::cerr << "[test_init] END" << std::endl;
 }
 
+// Row storage grows geometrically, keeps rows 64-byte aligned and survives reallocation intact.
+void test_row_store()
+{
+  std::cerr << "[test_row_store] START" << std::endl;
+  int dim = 20;
+  RowStore store(dim);
+  assert(store.stride() % 16 == 0 && store.stride() >= (size_t)dim);
+  std::vector<Eigen::VectorXf> rows;
+  size_t reallocations = 0;
+  size_t last_capacity = store.capacity();
+  for (int i = 0; i < 5000; ++i)
+  {
+    rows.push_back(random_vector(dim));
+    store.push_back(rows.back().data());
+    if (store.capacity() != last_capacity)
+    {
+      ++reallocations;
+      last_capacity = store.capacity();
+    }
+    assert(reinterpret_cast<uintptr_t>(store.row(i)) % RowStore::kAlignment == 0);
+  }
+  assert(reallocations < 20);
+  for (int i = 0; i < 5000; i += 97)
+    assert(Eigen::Map<const Eigen::VectorXf>(store.row(i), dim).isApprox(rows[i]));
+  RowStore reserved(dim);
+  reserved.reserve(1000);
+  const float* base = reserved.data();
+  for (int i = 0; i < 1000; ++i)
+    reserved.push_back(rows[i].data());
+  assert(reserved.data() == base);
+  assert(reserved.matrix().row(999).transpose().isApprox(rows[999]));
+
+  // A borrowed store reads external rows in place and copies them before its first write
+  auto shared = std::make_shared<RowStore>(reserved);
+  const auto* shared_rows = reinterpret_cast<const unsigned char*>(shared->data());
+  RowStore borrowed = RowStore::borrow(dim, precision::F32, shared_rows, shared->rows(), shared);
+  assert(borrowed.borrowed() && borrowed.data() == shared->data() && borrowed.rows() == 1000);
+  RowStore borrowed_copy(borrowed);
+  assert(borrowed_copy.data() == shared->data());
+  borrowed.set_row(0, rows[1].data());
+  assert(!borrowed.borrowed() && borrowed.data() != shared->data());
+  assert(Eigen::Map<const Eigen::VectorXf>(shared->row(0), dim).isApprox(rows[0]));
+  assert(Eigen::Map<const Eigen::VectorXf>(borrowed.row(0), dim).isApprox(rows[1]));
+  assert(Eigen::Map<const Eigen::VectorXf>(borrowed.row(999), dim).isApprox(rows[999]));
+  borrowed_copy.push_back(rows[0].data());
+  assert(!borrowed_copy.borrowed() && borrowed_copy.rows() == 1001);
+
+  NanoVectorDB a(dim, "cosine", "nvdb_row_store_test.json");
+  a.reserve(100);
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < 100; ++i)
+    fakes_data.push_back({ std::to_string(i), rows[i] });
+  a.upsert(fakes_data);
+  assert(a.query(rows[10], 1)[0].data.id == "10");
+  std::cerr << "[test_row_store] END" << std::endl;
+}
+
+// Query results and get_views() are views into row storage; get() copies vectors on request.
+void test_views()
+{
+  std::cerr << "[test_views] START" << std::endl;
+  NanoVectorDB a(16, "cosine", "nvdb_views_test.json");
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < 30; ++i)
+    fakes_data.push_back({ std::to_string(i), random_vector(16) });
+  a.upsert(fakes_data);
+  auto results = a.query(fakes_data[4].vector, 3);
+  assert(results[0].data.id == "4");
+  assert(results[0].data.vector().isApprox(normalize(fakes_data[4].vector)));
+  auto views = a.get_views({ "7", "nope" });
+  assert(views.size() == 1 && views[0].id == "7");
+  Data copy = views[0].to_data();
+  assert(copy.id == "7" && copy.vector.isApprox(views[0].vector()));
+  auto by_view = a.query(fakes_data[4].vector, 10, std::nullopt, [](const DataView& v) { return v.row % 2 == 1; });
+  for (const auto& r : by_view)
+    assert(r.data.row % 2 == 1);
+  std::cerr << "[test_views] END" << std::endl;
+}
+
 // Upserting the same records twice should not duplicate entries; count remains stable.
 void test_same_upsert()
 {
@@ -77,6 +168,86 @@ void test_same_upsert()
   std::cerr << "[test_same_upsert] END" << std::endl;
 }
 
+// Bulk loads from a contiguous buffer or a chunked reader match upsert() of the same records.
+void test_bulk_ingest()
+{
+  std::cerr << "[test_bulk_ingest] START" << std::endl;
+  const int dim = 32;
+  const int n = 600;
+  RowMatrixXf rows(n, dim);
+  std::vector<std::string> ids(n);
+  for (int i = 0; i < n; ++i)
+  {
+    rows.row(i) = random_vector(dim).transpose();
+    ids[i] = i % 10 == 0 ? "" : "r" + std::to_string(i);  // every tenth id is hashed
+  }
+  ids[n - 1] = "r1";  // duplicate: the last occurrence wins
+  std::vector<Data> records;
+  for (int i = 0; i < n; ++i)
+    records.push_back({ ids[i], rows.row(i).transpose() });
+
+  const std::string file = "nvdb_bulk_ingest.json";
+  std::filesystem::remove(file);
+  NanoVectorDB expected(dim, "cosine", file);
+  expected.upsert(records);
+  NanoVectorDB bulk(dim, "cosine", file);
+  bulk.set_scan_options({ 2, 64 });  // parallel row writes
+  bulk.upsert(rows.data(), n, ids.data());
+  assert(bulk.size() == expected.size() && bulk.size() == n - 1);
+  assert(bulk.get({ hash_vector(records[0].vector) }).size() == 1);
+  const Eigen::VectorXf r1 = bulk.get({ "r1" })[0].vector;
+  assert((r1 - expected.get({ "r1" })[0].vector).norm() < 1e-6f);
+  assert((r1 - rows.row(n - 1).transpose().normalized()).norm() < 1e-5f);
+  const Eigen::VectorXf q = random_vector(dim);
+  auto want = expected.query(q, 10);
+  auto got = bulk.query(q, 10);
+  assert(want.size() == got.size());
+  for (size_t i = 0; i < want.size(); ++i)
+    assert(want[i].data.id == got[i].data.id);
+
+  // Zero-norm rows are rejected before anything changes
+  RowMatrixXf bad = RowMatrixXf::Zero(2, dim);
+  bad.row(0) = random_vector(dim).transpose();
+  bool threw = false;
+  try
+  {
+    bulk.upsert(bad.data(), 2);
+  }
+  catch (const std::runtime_error&)
+  {
+    threw = true;
+  }
+  assert(threw && bulk.size() == n - 1);
+
+  // Chunked reader into an indexed database: the index is built once over the loaded rows
+  NanoVectorDB streamed(dim, "cosine", file);
+  streamed.initialize_index(nano_vectordb::index::HNSW);
+  size_t next = 0;
+  const size_t loaded = streamed.ingest(
+    [&](float* out, std::string* out_ids, size_t capacity) {
+      const size_t take = std::min(capacity, static_cast<size_t>(n) - next);
+      std::copy(rows.data() + next * dim, rows.data() + (next + take) * dim, out);
+      for (size_t i = 0; i < take; ++i)
+        out_ids[i] = ids[next + i];
+      next += take;
+      return take;
+    },
+    128, n);
+  assert(loaded == static_cast<size_t>(n) && streamed.size() == n - 1);
+  assert(streamed.stats()[operation::Ingest].count == 1);
+  assert(streamed.stats()[counter::RowsUpserted] == static_cast<std::uint64_t>(n));
+  got = streamed.query(rows.row(5).transpose(), 1);
+  assert(got.size() == 1 && got[0].data.id == "r5");
+  // A small batch after the load is added to the index incrementally
+  const Eigen::VectorXf extra = random_vector(dim);
+  const std::string extra_id = "extra";
+  streamed.upsert(extra.data(), 1, &extra_id);
+  got = streamed.query(extra, 1);
+  assert(got.size() == 1 && got[0].data.id == "extra");
+  std::filesystem::remove(file);
+  std::cerr << "[test_bulk_ingest] END" << std::endl;
+}
+
 // Retrieving a subset of IDs should return the exact number requested when present.
 void test_get()
 {
@@ -110,6 +281,95 @@ void test_delete()
   std::cerr << "[test_delete] END" << std::endl;
 }
 
+// Removed rows are tombstoned: queries skip them, upserts reuse them and compaction packs the rest.
+void test_tombstones()
+{
+  std::cerr << "[test_tombstones] START" << std::endl;
+  const std::string file = "nvdb_tombstone_test.json";
+  std::filesystem::remove(file);
+  NanoVectorDB a(32, "cosine", file);
+  a.set_compaction_threshold(0.0f);
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < 200; ++i)
+    fakes_data.push_back({ std::to_string(i), random_vector(32) });
+  a.upsert(fakes_data);
+  a.remove({ "5", "6", "7" });
+  assert(a.size() == 197 && a.tombstones() == 3);
+  for (const auto& r : a.query(fakes_data[5].vector, 200))
+    assert(r.data.id != "5" && r.data.id != "6" && r.data.id != "7");
+  assert(a.query_batch(fakes_data[6].vector.transpose(), 1)[0][0].data.id != "6");
+
+  // A new id takes over a free row instead of growing storage
+  a.upsert({ { "new", fakes_data[6].vector } });
+  assert(a.size() == 198 && a.tombstones() == 2);
+  assert(a.query(fakes_data[6].vector, 1)[0].data.id == "new");
+
+  // Views are invalidated by compaction, so keep copies of the ids
+  std::vector<std::string> before;
+  for (const auto& r : a.query(fakes_data[10].vector, 10))
+    before.emplace_back(r.data.id);
+  a.compact();
+  assert(a.tombstones() == 0 && a.size() == 198);
+  auto after = a.query(fakes_data[10].vector, 10);
+  assert(before.size() == after.size());
+  for (size_t i = 0; i < before.size(); ++i)
+    assert(before[i] == after[i].data.id);
+
+  a.remove({ "new", "8" });
+  a.save();
+  NanoVectorDB b(32, "cosine", file);
+  assert(b.size() == 196 && b.get({ "8", "new" }).empty() && b.get({ "9" }).size() == 1);
+
+  // Falling below the live-fraction threshold compacts automatically
+  b.set_compaction_threshold(0.5f);
+  std::vector<std::string> drop;
+  for (int i = 100; i < 200; ++i)
+    drop.push_back(std::to_string(i));
+  b.remove(drop);
+  assert(b.size() == 96 && b.tombstones() == 0);
+  b.remove({ "0" });
+  b.compact_async().get();
+  assert(b.size() == 95 && b.tombstones() == 0 && b.get({ "1" }).size() == 1);
+  std::filesystem::remove(file);
+  std::cerr << "[test_tombstones] END" << std::endl;
+}
+
+// The id index must follow inserts, updates and removals so lookups stay exact.
+void test_id_index()
+{
+  std::cerr << "[test_id_index] START" << std::endl;
+  IdIndex index;
+  std::vector<std::string> keys;
+  auto key_at = [&](int row) -> const std::string& { return keys[row]; };
+  for (int i = 0; i < 1000; ++i)
+  {
+    keys.push_back("k" + std::to_string(i));
+    index.insert(keys.back(), i, key_at);
+  }
+  for (int i = 0; i < 1000; i += 3)
+    assert(index.erase(keys[i], key_at));
+  for (int i = 0; i < 1000; ++i)
+    assert(index.find(keys[i], key_at) == (i % 3 == 0 ? -1 : i));
+  assert(index.size() == 666);
+
+  NanoVectorDB a(16, "cosine", "nvdb_id_index_test.json");
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < 50; ++i)
+    fakes_data.push_back({ std::to_string(i), random_vector(16) });
+  a.upsert(fakes_data);
+  auto r = a.get({ "49", "missing", "3" });
+  assert(r.size() == 2 && r[0].id == "49" && r[1].id == "3");
+  Eigen::VectorXf replacement = random_vector(16);
+  a.upsert({ { "3", replacement } });
+  assert(a.size() == 50);
+  assert(a.get({ "3" })[0].vector.isApprox(normalize(replacement)));
+  a.remove({ "0", "1" });
+  assert(a.get({ "49" }).size() == 1 && a.get({ "0", "1" }).empty());
+  a.upsert({ { "0", random_vector(16) } });
+  assert(a.size() == 49 && a.get({ "0" }).size() == 1);
+  std::cerr << "[test_id_index] END" << std::endl;
+}
+
 // Query with a filter lambda should restrict results to matching entries.
 void test_cond_filter()
 {
@@ -132,6 +392,637 @@ void test_cond_filter()
   std::cerr << "[test_cond_filter] END" << std::endl;
 }
 
+// Batched queries should return the same rankings as issuing each query on its own.
+void test_query_batch()
+{
+  std::cerr << "[test_query_batch] START" << std::endl;
+  int data_len = 500;
+  int fake_dim = 64;
+  for (auto type : { nano_vectordb::metric::Cosine, nano_vectordb::metric::L2 })
+  {
+    NanoVectorDB a(fake_dim, "cosine", "nvdb_query_batch_test.json");
+    a.initialize_metric(type);
+    std::vector<Data> fakes_data;
+    for (int i = 0; i < data_len; ++i)
+      fakes_data.push_back({ std::to_string(i), random_vector(fake_dim) });
+    a.upsert(fakes_data);
+    Eigen::MatrixXf queries(4, fake_dim);
+    for (int i = 0; i < queries.rows(); ++i)
+      queries.row(i) = fakes_data[i * 100].vector.transpose();
+    auto batch = a.query_batch(queries, 5);
+    assert(batch.size() == 4);
+    for (int i = 0; i < queries.rows(); ++i)
+    {
+      auto single = a.query(queries.row(i).transpose(), 5);
+      assert(batch[i].size() == single.size());
+      assert(batch[i][0].data.id == std::to_string(i * 100));
+      for (size_t j = 0; j < single.size(); ++j)
+        assert(std::abs(batch[i][j].score - single[j].score) < 1e-3f);
+      // A distance never goes below zero, however the expansion rounds
+      assert(type == nano_vectordb::metric::Cosine || (batch[i][0].score <= 0.0f && single[0].score <= 0.0f));
+    }
+  }
+
+  // An exact duplicate is at distance exactly 0 through both paths
+  NanoVectorDB l2(fake_dim, "l2", "nvdb_query_batch_test.json");
+  l2.initialize_metric(nano_vectordb::metric::L2);
+  Eigen::VectorXf exact(fake_dim);
+  for (int i = 0; i < fake_dim; ++i)
+    exact[i] = static_cast<float>(i % 7) - 3.0f;  // small integers: every product and sum is exact
+  l2.upsert({ { "dup", exact }, { "other", random_vector(fake_dim) } });
+  assert(l2.query(exact, 1)[0].score == 0.0f);
+  assert(l2.query_batch(exact.transpose(), 1)[0][0].score == 0.0f);
+  std::cerr << "[test_query_batch] END" << std::endl;
+}
+
+// Bounded top-k selection keeps the best candidates in order and applies the threshold while scanning.
+void test_topk_selection()
+{
+  std::cerr << "[test_topk_selection] START" << std::endl;
+  TopK selector(3, 0.2f);
+  const float scores[] = { 0.5f, 0.1f, 0.9f, 0.3f, 0.7f, 0.25f };
+  for (int i = 0; i < 6; ++i)
+    selector.push(i, scores[i]);
+  auto best = selector.take_sorted();
+  assert(best.size() == 3);
+  assert(best[0].first == 2 && best[1].first == 4 && best[2].first == 0);
+  TopK strict(10, 0.8f);
+  for (int i = 0; i < 6; ++i)
+    strict.push(i, scores[i]);
+  assert(strict.take_sorted().size() == 1);
+
+  NanoVectorDB a(32, "cosine", "nvdb_topk_test.json");
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < 200; ++i)
+    fakes_data.push_back({ std::to_string(i), random_vector(32) });
+  a.upsert(fakes_data);
+  auto results = a.query(fakes_data[7].vector, 200, 0.8f);
+  assert(results[0].data.id == "7");
+  for (size_t i = 1; i < results.size(); ++i)
+  {
+    assert(results[i - 1].score >= results[i].score);
+    assert(results[i].score >= 0.8f);
+  }
+  // top_k far above the row count returns every row without sizing anything by top_k
+  const int huge = std::numeric_limits<int>::max();
+  assert(a.query(fakes_data[7].vector, huge).size() == 200);
+  Eigen::MatrixXf batch(2, 32);
+  batch.row(0) = fakes_data[3].vector.transpose();
+  batch.row(1) = fakes_data[4].vector.transpose();
+  const auto batched = a.query_batch(batch, huge);
+  assert(batched[0].size() == 200 && batched[1].size() == 200 && batched[1][0].data.id == "4");
+  assert(a.query(fakes_data[7].vector, -1).empty());
+  std::cerr << "[test_topk_selection] END" << std::endl;
+}
+
+// Dispatched SIMD kernels and block distances must agree with the scalar per-pair metrics.
+void test_metric_kernels()
+{
+  std::cerr << "[test_metric_kernels] START" << std::endl;
+  for (int dim : { 1, 7, 16, 33, 100, 768 })
+  {
+    Eigen::VectorXf a = random_vector(dim);
+    Eigen::VectorXf b = random_vector(dim);
+    assert(std::abs(kernels::dot(a.data(), b.data(), dim) - a.dot(b)) < 1e-3f);
+    assert(std::abs(kernels::l2sq(a.data(), b.data(), dim) - (a - b).squaredNorm()) < 1e-3f);
+    std::vector<std::uint8_t> codes(dim);
+    float expect = 0.0f;
+    for (int i = 0; i < dim; ++i)
+    {
+      codes[i] = static_cast<std::uint8_t>((i * 37) % 256);
+      expect += a[i] * codes[i];
+    }
+    assert(std::abs(kernels::dot_u8(a.data(), codes.data(), dim) - expect) < 1e-2f * std::max(1.0f, expect));
+  }
+  // Block kernels match the per-row kernels bit for bit, with or without a fixed-dimension specialization
+#if !defined(NANOVDB_DISABLE_FIXED_KERNELS)
+  assert(kernels::has_fixed_kernels(768) == (kernels::active_isa() != kernels::isa::Scalar));
+  assert(!kernels::has_fixed_kernels(100));
+#endif
+  for (size_t width : { size_t(100), size_t(384), size_t(768), size_t(1024), size_t(1536) })
+  {
+    const size_t stride = width + 16;  // rows need not be packed
+    const size_t n = 5;                // odd, so the last row runs alone
+    RowMatrixXf block_rows(n, stride);
+    block_rows.setRandom();
+    const Eigen::VectorXf bq = random_vector(static_cast<int>(width));
+    std::vector<float> dots(n), l2s(n);
+    kernels::dot_rows(bq.data(), block_rows.data(), stride, n, width, dots.data());
+    kernels::l2sq_rows(bq.data(), block_rows.data(), stride, n, width, l2s.data());
+    for (size_t r = 0; r < n; ++r)
+    {
+      assert(dots[r] == kernels::dot(bq.data(), block_rows.row(r).data(), width));
+      assert(l2s[r] == kernels::l2sq(bq.data(), block_rows.row(r).data(), width));
+    }
+  }
+
+  int dim = 48;
+  RowMatrixXf rows(20, dim);
+  std::vector<float> sq_norms(rows.rows());
+  for (int i = 0; i < rows.rows(); ++i)
+  {
+    rows.row(i) = random_vector(dim).transpose();
+    sq_norms[i] = rows.row(i).squaredNorm();
+  }
+  Eigen::VectorXf q = random_vector(dim);
+  RowBlock block;
+  block.data = rows.data();
+  block.rows = rows.rows();
+  block.stride = dim;
+  block.dim = dim;
+  block.sq_norms = sq_norms.data();
+  for (auto type : { nano_vectordb::metric::Cosine, nano_vectordb::metric::L2 })
+  {
+    auto m = nano_vectordb::make(type);
+    std::vector<float> out(rows.rows());
+    m->distances(q, block, out.data());
+    for (int i = 0; i < rows.rows(); ++i)
+    {
+      Eigen::VectorXf r = rows.row(i).transpose();
+      assert(std::abs(out[i] - m->distance(q, r)) < 1e-3f);
+    }
+  }
+  std::cerr << "[test_metric_kernels] END" << std::endl;
+}
+
+// The HNSW index must approximate the exact scan and follow upserts, removals and compaction.
+void test_hnsw_index()
+{
+  std::cerr << "[test_hnsw_index] START" << std::endl;
+  const int dim = 32;
+  const int n = 3000;
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < n; ++i)
+    fakes_data.push_back({ std::to_string(i), random_vector(dim).array() - 0.5f });
+
+  for (auto type : { nano_vectordb::metric::Cosine, nano_vectordb::metric::L2 })
+  {
+    NanoVectorDB exact(dim, "cosine", "nvdb_hnsw_exact.json");
+    exact.initialize_metric(type);
+    exact.upsert(fakes_data);
+    NanoVectorDB a(dim, "cosine", "nvdb_hnsw_test.json");
+    a.initialize_metric(type);
+    a.upsert(std::vector<Data>(fakes_data.begin(), fakes_data.begin() + n / 2));
+    // Half is indexed in bulk, half incrementally through upsert
+    a.initialize_index(nano_vectordb::index::HNSW);
+    a.upsert(std::vector<Data>(fakes_data.begin() + n / 2, fakes_data.end()));
+    assert(a.index_strategy()->size() == static_cast<size_t>(n));
+
+    int hits = 0;
+    for (int qi = 0; qi < 50; ++qi)
+    {
+      const Eigen::VectorXf q = random_vector(dim).array() - 0.5f;
+      auto truth = exact.query(q, 10);
+      auto approx = a.query(q, 10);
+      assert(approx.size() == 10);
+      for (const auto& t : truth)
+        for (const auto& r : approx)
+          hits += (r.data.id == t.data.id);
+    }
+    assert(hits >= 450);  // recall@10 >= 0.9
+
+    a.remove({ "7" });
+    assert(a.query(fakes_data[7].vector, 5)[0].data.id != "7");
+    assert(a.query(fakes_data[8].vector, 1)[0].data.id == "8");
+    a.upsert({ { "moved", fakes_data[9].vector } });
+    assert(a.query(fakes_data[9].vector, 2)[1].score == a.query(fakes_data[9].vector, 2)[0].score);
+
+    auto even = [](const DataView& d) { return d.id.size() > 1 && (d.id.back() - '0') % 2 == 0; };
+    for (const auto& r : a.query(fakes_data[10].vector, 10, std::nullopt, even))
+      assert(even(r.data));
+    auto batch = a.query_batch(Eigen::MatrixXf(fakes_data[11].vector.transpose()), 1);
+    assert(batch[0][0].data.id == "11");
+
+    std::vector<std::string> drop;
+    for (int i = 0; i < n * 2 / 3; ++i)
+      drop.push_back(std::to_string(i));
+    a.remove(drop);  // falls below the live-fraction threshold and compacts
+    assert(a.tombstones() == 0 && a.size() == n - n * 2 / 3 + 1);
+    assert(a.index_strategy()->size() == static_cast<size_t>(a.size()));
+    assert(a.query(fakes_data[n - 1].vector, 1)[0].data.id == std::to_string(n - 1));
+  }
+
+  auto hnsw = std::make_shared<HNSWIndex>(HNSWParams{ 8, 64, 16 });
+  NanoVectorDB b(dim, "cosine", "nvdb_hnsw_test.json");
+  b.initialize_index(hnsw);
+  b.upsert(fakes_data);
+  hnsw->set_ef_search(128);
+  assert(b.query(fakes_data[42].vector, 1)[0].data.id == "42");
+  b.initialize_index(nano_vectordb::index::Flat);
+  assert(!b.index_strategy() && b.query(fakes_data[42].vector, 1)[0].data.id == "42");
+  std::cerr << "[test_hnsw_index] END" << std::endl;
+}
+
+// IVF scans only the nprobe nearest lists; probing every list must match the exact scan.
+void test_ivf_index()
+{
+  std::cerr << "[test_ivf_index] START" << std::endl;
+  const int dim = 16;
+  const int n = 4000;
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < n; ++i)
+    fakes_data.push_back({ std::to_string(i), random_vector(dim).array() - 0.5f });
+
+  for (auto type : { nano_vectordb::metric::Cosine, nano_vectordb::metric::L2 })
+  {
+    NanoVectorDB exact(dim, "cosine", "nvdb_ivf_exact.json");
+    exact.initialize_metric(type);
+    exact.upsert(fakes_data);
+
+    IVFParams params;
+    params.nlist = 32;
+    params.nprobe = 32;
+    params.min_train_rows = 500;
+    auto ivf = std::make_shared<IVFIndex>(params);
+    NanoVectorDB a(dim, "cosine", "nvdb_ivf_test.json");
+    a.initialize_metric(type);
+    a.initialize_index(ivf);
+    // Rows are scanned exhaustively until enough arrive to train the lists automatically
+    a.upsert(std::vector<Data>(fakes_data.begin(), fakes_data.begin() + 400));
+    assert(!ivf->trained() && ivf->size() == 400);
+    a.upsert(std::vector<Data>(fakes_data.begin() + 400, fakes_data.end()));
+    assert(ivf->trained() && ivf->nlist() == 32 && ivf->size() == static_cast<size_t>(n));
+
+    for (int qi = 0; qi < 10; ++qi)
+    {
+      const Eigen::VectorXf q = random_vector(dim).array() - 0.5f;
+      auto truth = exact.query(q, 10);
+      auto all_lists = a.query(q, 10);
+      assert(truth.size() == all_lists.size());
+      for (size_t i = 0; i < truth.size(); ++i)
+        assert(truth[i].data.id == all_lists[i].data.id);
+    }
+
+    ivf->set_nprobe(8);
+    int hits = 0;
+    for (int qi = 0; qi < 50; ++qi)
+    {
+      const Eigen::VectorXf q = random_vector(dim).array() - 0.5f;
+      for (const auto& t : exact.query(q, 10))
+        for (const auto& r : a.query(q, 10))
+          hits += (r.data.id == t.data.id);
+    }
+    assert(hits >= 350);  // recall@10 >= 0.7 while scanning a quarter of the lists
+
+    a.remove({ "3" });
+    assert(a.query(fakes_data[3].vector, 3)[0].data.id != "3");
+    assert(a.query(fakes_data[4].vector, 1)[0].data.id == "4");
+    a.rebuild_index();
+    assert(ivf->size() == static_cast<size_t>(n - 1));
+    std::vector<std::string> drop;
+    for (int i = 0; i < n * 3 / 4; ++i)
+      drop.push_back(std::to_string(i));
+    a.remove(drop);
+    assert(a.tombstones() == 0 && ivf->size() == static_cast<size_t>(a.size()));
+    assert(a.query(fakes_data[n - 1].vector, 1)[0].data.id == std::to_string(n - 1));
+  }
+  std::cerr << "[test_ivf_index] END" << std::endl;
+}
+
+// Quantized indexes scan compressed codes and re-rank exactly, so the top results match the exact scan.
+void test_quantized_index()
+{
+  std::cerr << "[test_quantized_index] START" << std::endl;
+  const int dim = 32;
+  const int n = 3000;
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < n; ++i)
+    fakes_data.push_back({ std::to_string(i), random_vector(dim).array() - 0.5f });
+
+  for (auto type : { nano_vectordb::metric::Cosine, nano_vectordb::metric::L2 })
+  {
+    NanoVectorDB exact(dim, "cosine", "nvdb_quant_exact.json");
+    exact.initialize_metric(type);
+    exact.upsert(fakes_data);
+    PQParams pq_params;
+    pq_params.m = 8;
+    pq_params.train_sample = 2000;
+    std::vector<std::shared_ptr<QuantizedIndex>> indexes{ std::make_shared<SQ8Index>(),
+                                                          std::make_shared<PQIndex>(pq_params) };
+    for (const auto& quantized : indexes)
+    {
+      NanoVectorDB a(dim, "cosine", "nvdb_quant_test.json");
+      a.initialize_metric(type);
+      a.upsert(std::vector<Data>(fakes_data.begin(), fakes_data.begin() + 500));
+      a.initialize_index(quantized);
+      assert(!quantized->trained());  // fewer rows than min_train_rows: scored exactly
+      a.upsert(std::vector<Data>(fakes_data.begin() + 500, fakes_data.end()));
+      assert(quantized->trained() && quantized->size() == static_cast<size_t>(n));
+
+      int hits = 0;
+      for (int qi = 0; qi < 30; ++qi)
+      {
+        const Eigen::VectorXf q = random_vector(dim).array() - 0.5f;
+        auto truth = exact.query(q, 10);
+        auto approx = a.query(q, 10);
+        for (const auto& t : truth)
+          for (const auto& r : approx)
+            hits += (r.data.id == t.data.id && std::abs(r.score - t.score) < 1e-4f);
+      }
+      assert(hits >= 270);  // recall@10 >= 0.9 with exact re-ranked scores
+
+      quantized->set_rerank(0);
+      auto raw = a.query(fakes_data[5].vector, 5);
+      assert(raw.size() == 5);
+      quantized->set_rerank(4);
+      a.remove({ "5" });
+      assert(a.query(fakes_data[5].vector, 3)[0].data.id != "5");
+      std::vector<std::string> drop;
+      for (int i = 0; i < n * 3 / 4; ++i)
+        drop.push_back(std::to_string(i));
+      a.remove(drop);
+      assert(quantized->size() == static_cast<size_t>(a.size()));
+      assert(a.query(fakes_data[n - 1].vector, 1)[0].data.id == std::to_string(n - 1));
+    }
+  }
+  std::cerr << "[test_quantized_index] END" << std::endl;
+}
+
+// F16 / BF16 storage halves the row store and must rank like fp32, through scans, batches and indexes,
+// and keep its precision across JSON and SQLite save/reload.
+void test_precision()
+{
+  std::cerr << "[test_precision] START" << std::endl;
+  assert(float_to_half(1.0f) == 0x3C00 && half_to_float(0x3C00) == 1.0f);
+  assert(half_to_float(float_to_half(65504.0f)) == 65504.0f && float_to_half(1e6f) == 0x7C00);
+  assert(half_to_float(0x0001) == std::ldexp(1.0f, -24) && float_to_half(std::ldexp(1.0f, -24)) == 0x0001);
+  assert(float_to_bf16(1.0f) == 0x3F80 && bf16_to_float(float_to_bf16(-2.5f)) == -2.5f);
+  assert(std::isnan(half_to_float(float_to_half(NAN))) && std::isnan(bf16_to_float(float_to_bf16(NAN))));
+  assert(precision_from_name(precision_name(precision::BF16)) == precision::BF16);
+  for (int dim : { 1, 7, 16, 33, 100, 768 })
+  {
+    Eigen::VectorXf q = random_vector(dim);
+    Eigen::VectorXf r = random_vector(dim).array() - 0.5f;
+    for (auto type : { precision::F16, precision::BF16 })
+    {
+      std::vector<std::uint16_t> narrow(dim);
+      Eigen::VectorXf wide(dim);
+      encode_values(type, r.data(), narrow.data(), dim);
+      decode_values(type, narrow.data(), wide.data(), dim);
+      assert((wide - r).cwiseAbs().maxCoeff() < 4e-3f);
+      assert(std::abs(kernels::dot(q.data(), narrow.data(), dim, type) - q.dot(wide)) < 1e-3f);
+      assert(std::abs(kernels::l2sq(q.data(), narrow.data(), dim, type) - (q - wide).squaredNorm()) < 1e-3f);
+    }
+  }
+  const int dim = 64;
+  assert(RowStore(dim, precision::F16).row_bytes() * 2 == RowStore(dim).row_bytes());
+
+  const int n = 2000;
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < n; ++i)
+    fakes_data.push_back({ std::to_string(i), random_vector(dim).array() - 0.5f });
+  for (bool l2 : { false, true })
+  {
+    NanoVectorDB exact(dim, "cosine", "nvdb_precision_exact.json");
+    if (l2)
+      exact.initialize_metric(nano_vectordb::metric::L2);
+    exact.upsert(fakes_data);
+    for (auto type : { precision::F16, precision::BF16 })
+    {
+      NanoVectorDB a(dim, "cosine", "nvdb_precision_test.json");
+      if (l2)
+        a.initialize_metric(nano_vectordb::metric::L2);
+      a.upsert(std::vector<Data>(fakes_data.begin(), fakes_data.begin() + n / 2));
+      a.set_precision(type);
+      a.upsert(std::vector<Data>(fakes_data.begin() + n / 2, fakes_data.end()));
+      assert(a.get_precision() == type && a.size() == n);
+
+      Eigen::MatrixXf queries(20, dim);
+      int hits = 0;
+      for (int qi = 0; qi < queries.rows(); ++qi)
+      {
+        queries.row(qi) = (random_vector(dim).array() - 0.5f).matrix().transpose();
+        auto truth = exact.query(queries.row(qi).transpose(), 10);
+        auto approx = a.query(queries.row(qi).transpose(), 10);
+        for (const auto& t : truth)
+          for (const auto& r : approx)
+            hits += r.data.id == t.data.id;
+      }
+      assert(hits >= 180);  // recall@10 >= 0.9
+      auto batch = a.query_batch(queries, 5);
+      for (int qi = 0; qi < queries.rows(); ++qi)
+      {
+        auto single = a.query(queries.row(qi).transpose(), 5);
+        for (int k = 0; k < 5; ++k)
+          assert(std::abs(batch[qi][k].score - single[k].score) < 1e-4f);
+      }
+
+      auto view = a.get_views({ "7" })[0];
+      bool threw = false;
+      try
+      {
+        view.vector();
+      }
+      catch (const std::runtime_error&)
+      {
+        threw = true;
+      }
+      assert(threw);
+      const Eigen::VectorXf expect = l2 ? fakes_data[7].vector : normalize(fakes_data[7].vector);
+      assert((a.get({ "7" })[0].vector - expect).cwiseAbs().maxCoeff() < 4e-3f);
+
+      a.initialize_index(nano_vectordb::index::HNSW);
+      assert(a.query(fakes_data[42].vector, 1)[0].data.id == "42");
+      a.remove({ "42" });
+      a.compact();
+      assert(a.get_precision() == type && a.query(fakes_data[42].vector, 1)[0].data.id != "42");
+    }
+  }
+
+  const std::string json_path = "nvdb_precision_save.json";
+  const std::string sqlite_path = "nvdb_precision_save.sqlite";
+  std::filesystem::remove(json_path);
+  remove_sqlite_files(sqlite_path);
+  auto sqlite = nano_vectordb::make(nano_vectordb::storage::SQLite);
+  {
+    NanoVectorDB json_db(dim, "cosine", json_path);
+    NanoVectorDB sqlite_db(dim, "cosine", sqlite_path, nullptr, sqlite);
+    json_db.set_precision(precision::BF16);
+    sqlite_db.set_precision(precision::F16);
+    json_db.upsert(fakes_data);
+    sqlite_db.upsert(fakes_data);
+    json_db.remove({ "3" });
+    json_db.save();
+    sqlite_db.save();
+  }
+  NanoVectorDB json_db(dim, "cosine", json_path);
+  NanoVectorDB sqlite_db(dim, "cosine", sqlite_path, nullptr, sqlite);
+  NanoVectorDB reference(dim, "cosine", "nvdb_precision_exact.json");
+  reference.upsert(fakes_data);
+  assert(json_db.get_precision() == precision::BF16 && json_db.size() == n - 1 && json_db.get({ "3" }).empty());
+  assert(sqlite_db.get_precision() == precision::F16 && sqlite_db.size() == n);
+  for (const char* id : { "0", "500", "1999" })
+  {
+    const Eigen::VectorXf v = reference.get({ id })[0].vector;
+    assert((json_db.get({ id })[0].vector - v).cwiseAbs().maxCoeff() < 4e-3f);
+    assert((sqlite_db.get({ id })[0].vector - v).cwiseAbs().maxCoeff() < 1e-3f);
+    assert(sqlite_db.query(v, 1)[0].data.id == id);
+  }
+  std::filesystem::remove(json_path);
+  remove_sqlite_files(sqlite_path);
+  std::cerr << "[test_precision] END" << std::endl;
+}
+
+// Metadata predicates are compiled to row bitmaps and must select exactly what an equivalent filter does.
+void test_metadata()
+{
+  std::cerr << "[test_metadata] START" << std::endl;
+  const int dim = 32;
+  const int n = 5000;
+  const std::vector<std::string> langs = { "en", "de", "fr" };
+  const std::string json_path = "nvdb_metadata_test.json";
+  const std::string sqlite_path = "nvdb_metadata_test.sqlite";
+  std::filesystem::remove(json_path);
+  remove_sqlite_files(sqlite_path);
+  auto sqlite = nano_vectordb::make(nano_vectordb::storage::SQLite);
+
+  NanoVectorDB db(dim, "cosine", json_path);
+  NanoVectorDB sqlite_db(dim, "cosine", sqlite_path, nullptr, sqlite);
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < n; ++i)
+    fakes_data.push_back({ std::to_string(i), random_vector(dim).array() - 0.5f });
+  for (NanoVectorDB* d : { &db, &sqlite_db })
+  {
+    d->upsert(fakes_data);
+    d->add_column("year", column_type::Int);
+    d->add_column("lang", column_type::Enum);
+    d->add_column("tags", column_type::Tags);
+    for (int i = 0; i < n; ++i)
+    {
+      const std::string id = std::to_string(i);
+      d->set_metadata(id, "year", std::int64_t(1980 + i % 50));
+      d->set_metadata(id, "lang", langs[i % 3]);
+      std::vector<std::string> tags = { "t" + std::to_string(i % 7) };
+      if (i % 2 == 0)
+        tags.push_back("even");
+      d->set_tags(id, "tags", tags);
+    }
+  }
+  const nlohmann::json row4 = { { "year", 1984 }, { "lang", "de" }, { "tags", { "even", "t4" } } };
+  assert(db.get_metadata("4") == row4);
+
+  // Each predicate is paired with the equivalent filter function over record ids
+  auto num = [](const DataView& v) { return std::stoi(std::string(v.id)); };
+  std::vector<std::pair<Predicate, std::function<bool(const DataView&)>>> cases = {
+    { where::eq("lang", "de"), [&](const DataView& v) { return num(v) % 3 == 1; } },
+    { where::range("year", 1990, 1999) && where::eq("tags", "even"),
+      [&](const DataView& v) { return num(v) % 50 >= 10 && num(v) % 50 <= 19 && num(v) % 2 == 0; } },
+    { where::in("lang", { "en", "fr" }) || where::range("year", 2020, 2029),
+      [&](const DataView& v) { return num(v) % 3 != 1 || num(v) % 50 >= 40; } },
+    { where::in("year", { 1980, 1981 }), [&](const DataView& v) { return num(v) % 50 <= 1; } },
+    { where::eq("tags", "t3") && where::eq("lang", "missing"), [](const DataView&) { return false; } },
+  };
+  auto same = [](const std::vector<QueryResult>& a, const std::vector<QueryResult>& b) {
+    assert(a.size() == b.size());
+    for (size_t k = 0; k < a.size(); ++k)
+      assert(std::abs(a[k].score - b[k].score) < 1e-5f);
+  };
+  Eigen::MatrixXf queries(8, dim);
+  for (int qi = 0; qi < queries.rows(); ++qi)
+    queries.row(qi) = (random_vector(dim).array() - 0.5f).matrix().transpose();
+  for (const auto& [where, filter] : cases)
+  {
+    auto batch = db.query_batch(queries, 10, std::nullopt, where);
+    for (int qi = 0; qi < queries.rows(); ++qi)
+    {
+      auto expected = db.query(queries.row(qi).transpose(), 10, std::nullopt, filter);
+      same(db.query(queries.row(qi).transpose(), 10, std::nullopt, where), expected);
+      same(batch[qi], expected);
+    }
+  }
+
+  // Indexes take the predicate as a pre-filter; selective predicates fall back to an exact scan
+  db.initialize_index(nano_vectordb::index::HNSW);
+  for (const auto& [where, filter] : cases)
+  {
+    for (int qi = 0; qi < queries.rows(); ++qi)
+    {
+      for (const auto& r : db.query(queries.row(qi).transpose(), 10, std::nullopt, where))
+        assert(filter(r.data));
+    }
+  }
+  assert(db.query(fakes_data[4].vector, 1, std::nullopt, where::eq("lang", "de"))[0].data.id == "4");
+
+  // Removed rows never match, and compaction keeps values with their records
+  std::vector<std::string> removed;
+  for (int i = 0; i < n; i += 2)
+    removed.push_back(std::to_string(i));
+  db.remove(removed);
+  assert(db.query(fakes_data[4].vector, 50, std::nullopt, where::eq("tags", "even")).empty());
+  db.compact();
+  const nlohmann::json row7 = { { "year", 1987 }, { "lang", "de" }, { "tags", { "t0" } } };
+  assert(db.get_metadata("7") == row7);
+  for (const auto& r : db.query(fakes_data[9].vector, 20, std::nullopt, where::eq("lang", "en")))
+    assert(num(r.data) % 3 == 0 && num(r.data) % 2 == 1);
+  db.upsert({ { "4", fakes_data[4].vector } });
+  assert(db.get_metadata("4").empty());
+
+  auto throws = [](const std::function<void()>& fn) {
+    try
+    {
+      fn();
+    }
+    catch (const std::runtime_error&)
+    {
+      return true;
+    }
+    return false;
+  };
+  assert(throws([&] { db.set_metadata("7", "lang", std::int64_t(1)); }));
+  assert(throws([&] { db.set_metadata("unknown", "year", std::int64_t(1)); }));
+  assert(throws([&] { db.query(fakes_data[0].vector, 1, std::nullopt, where::eq("year", "1980")); }));
+  assert(throws([&] { db.query(fakes_data[0].vector, 1, std::nullopt, where::eq("missing", 1)); }));
+
+  // Columns and values survive a save/load through JSON and SQLite
+  db.save();
+  sqlite_db.save();
+  NanoVectorDB json_loaded(dim, "cosine", json_path);
+  NanoVectorDB sqlite_loaded(dim, "cosine", sqlite_path, nullptr, sqlite);
+  assert(json_loaded.get_metadata("7") == db.get_metadata("7"));
+  assert(sqlite_loaded.get_metadata("4") == sqlite_db.get_metadata("4"));
+  const Predicate recent = where::range("year", 2025, 2029);
+  same(json_loaded.query(queries.row(0).transpose(), 10, std::nullopt, recent),
+       db.query(queries.row(0).transpose(), 10, std::nullopt, recent));
+  same(sqlite_loaded.query(queries.row(0).transpose(), 10, std::nullopt, recent),
+       sqlite_db.query(queries.row(0).transpose(), 10, std::nullopt, recent));
+  std::filesystem::remove(json_path);
+  remove_sqlite_files(sqlite_path);
+  std::cerr << "[test_metadata] END" << std::endl;
+}
+
+// Parallel scans split the rows into chunks and must return the same results as a serial scan.
+void test_parallel_query()
+{
+  std::cerr << "[test_parallel_query] START" << std::endl;
+  int data_len = 2000;
+  int fake_dim = 32;
+  std::vector<Data> fakes_data;
+  for (int i = 0; i < data_len; ++i)
+    fakes_data.push_back({ std::to_string(i), random_vector(fake_dim) });
+  for (auto type : { nano_vectordb::metric::Cosine, nano_vectordb::metric::L2 })
+  {
+    NanoVectorDB serial(fake_dim, "cosine", "nvdb_parallel_test.json");
+    NanoVectorDB parallel(fake_dim, "cosine", "nvdb_parallel_test.json");
+    serial.initialize_metric(type);
+    parallel.initialize_metric(type);
+    parallel.set_scan_options({ 4, 100 });
+    serial.upsert(fakes_data);
+    parallel.upsert(fakes_data);
+    auto filter = [](const Data& x) { return x.id.back() != '3'; };
+    auto expected = serial.query(fakes_data[42].vector, 20, std::nullopt, filter);
+    auto actual = parallel.query(fakes_data[42].vector, 20, std::nullopt, filter);
+    assert(expected.size() == actual.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+      assert(expected[i].data.id == actual[i].data.id);
+    Eigen::MatrixXf queries(2, fake_dim);
+    queries.row(0) = fakes_data[1].vector.transpose();
+    queries.row(1) = fakes_data[2].vector.transpose();
+    auto batch = parallel.query_batch(queries, 5);
+    assert(batch[0][0].data.id == "1" && batch[1][0].data.id == "2");
+  }
+  std::cerr << "[test_parallel_query] END" << std::endl;
+}
+
 // Additional user-provided JSON should persist through save/load operations.
 void test_additional_data()
 {
@@ -171,6 +1062,7 @@ void test_multi_tenant()
   tenant->store_additional_data(add_data);
   multi_tenant.save();
   MultiTenantNanoVDB multi_tenant2(1024);
+  multi_tenant2.set_default_storage(nano_vectordb::storage::File);
   assert(multi_tenant2.contain_tenant(tenant_id));
   auto tenant2 = multi_tenant2.get_tenant(tenant_id);
   assert(tenant2->get_additional_data() == add_data);
@@ -183,9 +1075,11 @@ void test_multi_tenant()
   {
   }
   MultiTenantNanoVDB multi_tenant3(1024, "cosine", 1);
+  multi_tenant3.set_default_storage(nano_vectordb::storage::File);
   multi_tenant3.create_tenant();
   multi_tenant3.get_tenant(tenant_id);
   multi_tenant3.delete_tenant(tenant_id);
+  multi_tenant3.wait_for_io();  // the evicted tenant is written in the background
   MultiTenantNanoVDB multi_tenant4(1024);
   assert(!multi_tenant4.contain_tenant(tenant_id));
   std::filesystem::remove_all("nano_multi_tenant_storage");
@@ -193,11 +1087,436 @@ void test_multi_tenant()
   multi_tenant5.create_tenant();
   assert(!std::filesystem::exists("nano_multi_tenant_storage"));
   multi_tenant5.create_tenant();
+  multi_tenant5.wait_for_io();
   assert(std::filesystem::exists("nano_multi_tenant_storage"));
   std::filesystem::remove_all("nano_multi_tenant_storage");
   std::cerr << "[test_multi_tenant] END" << std::endl;
 }
 
+// Tenant cache: LRU eviction with background saves of dirty tenants, prefetch, single-flight cold loads and
+// default strategies on reload.
+void test_tenant_cache()
+{
+  std::cerr << "[test_tenant_cache] START" << std::endl;
+  const std::string dir = "nano_tenant_cache_storage";
+  std::filesystem::remove_all(dir);
+  {
+    MultiTenantNanoVDB cache(32, "cosine", 2, dir);
+    cache.set_default_storage(nano_vectordb::storage::File);
+    const std::string a = cache.create_tenant();
+    const std::string b = cache.create_tenant();
+    cache.get_tenant(a);  // a is now more recent than b
+    const std::string c = cache.create_tenant();
+    cache.wait_for_io();
+    // b was evicted and written; a and c are still only in memory
+    assert(std::filesystem::exists(dir + "/" + MultiTenantNanoVDB::jsonfile_from_id(b)));
+    assert(!std::filesystem::exists(dir + "/" + MultiTenantNanoVDB::jsonfile_from_id(a)));
+    assert(!std::filesystem::exists(dir + "/" + MultiTenantNanoVDB::jsonfile_from_id(c)));
+    assert(cache.contain_tenant(a) && cache.contain_tenant(b) && cache.contain_tenant(c));
+
+    // Prefetch b back in (evicting a), then evict it again unchanged: a clean tenant is not rewritten
+    const std::string b_file = dir + "/" + MultiTenantNanoVDB::jsonfile_from_id(b);
+    const auto written = std::filesystem::last_write_time(b_file);
+    cache.prefetch_tenant(b);
+    cache.wait_for_io();
+    assert(std::filesystem::exists(dir + "/" + MultiTenantNanoVDB::jsonfile_from_id(a)));
+    auto b_db = cache.get_tenant_async(b).get();
+    assert(b_db && b_db == cache.get_tenant(b));
+    cache.get_tenant(a);
+    cache.get_tenant(c);
+    cache.wait_for_io();
+    assert(std::filesystem::last_write_time(b_file) == written);
+    try
+    {
+      cache.get_tenant_async("missing").get();
+      assert(false);
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+    cache.prefetch_tenant("missing");  // errors are left to get_tenant
+  }
+  std::filesystem::remove_all(dir);
+
+  // Reloaded tenants use the default storage (SQLite here), and concurrent cold loads share one instance
+  std::string tenant_id;
+  {
+    MultiTenantNanoVDB writer(32, "cosine", 8, dir);
+    tenant_id = writer.create_tenant();
+    writer.get_tenant(tenant_id)->upsert({ { "x", random_vector(32) }, { "y", random_vector(32) } });
+    writer.save();
+  }
+  {
+    MultiTenantNanoVDB reader(32, "cosine", 8, dir);
+    std::vector<std::shared_ptr<NanoVectorDB>> loaded(4);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < loaded.size(); ++t)
+      threads.emplace_back([&, t] { loaded[t] = reader.get_tenant(tenant_id); });
+    for (auto& thread : threads)
+      thread.join();
+    for (const auto& db : loaded)
+      assert(db && db == loaded[0]);
+    assert(loaded[0]->size() == 2);
+    reader.delete_tenant(tenant_id);
+    assert(!reader.contain_tenant(tenant_id));
+  }
+  std::filesystem::remove_all(dir);
+  std::cerr << "[test_tenant_cache] END" << std::endl;
+}
+
+// Memory accounting: per-database usage by component, and a tenant cache evicting against a byte budget.
+void test_tenant_memory_budget()
+{
+  std::cerr << "[test_tenant_memory_budget] START" << std::endl;
+  const int dim = 32;
+  auto make_records = [&](const std::string& prefix, int n) {
+    std::vector<Data> records;
+    for (int i = 0; i < n; ++i)
+      records.push_back({ prefix + std::to_string(i), random_vector(dim) });
+    return records;
+  };
+
+  NanoVectorDB db(dim, "cosine", "nvdb_memory_usage.json");
+  db.upsert(make_records("a-fairly-long-record-id-", 200));
+  MemoryUsage usage = db.memory_usage();
+  assert(usage.vectors >= 200 * dim * sizeof(float));
+  assert(usage.ids >= 200 * 25);  // ids are past the inline string buffer
+  assert(usage.index == 0 && usage.mapped == 0);
+  assert(db.memory_usage().total() == usage.total());
+  db.initialize_index(nano_vectordb::index::HNSW);
+  assert(db.memory_usage().index > 0);
+  db.upsert(make_records("b", 800));
+  assert(db.memory_usage().vectors > usage.vectors);
+
+  const std::string dir = "nano_tenant_budget_storage";
+  std::filesystem::remove_all(dir);
+  {
+    MultiTenantNanoVDB cache(dim, "cosine", 100, dir);
+    cache.set_default_storage(nano_vectordb::storage::File);
+    const std::string small1 = cache.create_tenant();
+    cache.get_tenant(small1)->upsert(make_records("s", 10));
+    const std::string big1 = cache.create_tenant();
+    cache.get_tenant(big1)->upsert(make_records("b", 2000));
+    const std::string small2 = cache.create_tenant();
+    cache.get_tenant(small2)->upsert(make_records("s", 10));
+    cache.get_tenant(small1);
+    cache.get_tenant(big1);
+    cache.get_tenant(small2);  // LRU order now small2, big1, small1
+
+    const std::size_t big_bytes = cache.get_tenant(big1)->memory_usage().total();
+    cache.get_tenant(small2);
+    TenantCacheStats stats = cache.cache_stats();
+    assert(stats.tenants == 3 && stats.evictions == 0 && stats.misses == 0);
+    assert(stats.bytes >= big_bytes);
+    cache.set_memory_budget(stats.bytes + big_bytes / 2);
+    assert(cache.cache_stats().evictions == 0);
+
+    // A second big tenant overflows the budget: big1 has the fewest hits per byte and goes, although
+    // small1 is less recently used
+    const std::string big2 = cache.create_tenant();
+    cache.get_tenant(big2)->upsert(make_records("b", 2000));
+    cache.get_tenant(big2);
+    cache.wait_for_io();
+    stats = cache.cache_stats();
+    assert(stats.evictions == 1 && stats.tenants == 3);
+    assert(stats.bytes <= stats.memory_budget);
+    assert(std::filesystem::exists(dir + "/" + MultiTenantNanoVDB::jsonfile_from_id(big1)));
+    assert(!std::filesystem::exists(dir + "/" + MultiTenantNanoVDB::jsonfile_from_id(small1)));
+
+    // Reloading big1 is a miss and pushes the cache over budget again
+    assert(cache.get_tenant(big1)->size() == 2000);
+    cache.wait_for_io();
+    stats = cache.cache_stats();
+    assert(stats.misses == 1 && stats.evictions >= 2 && stats.bytes <= stats.memory_budget);
+  }
+  std::filesystem::remove_all(dir);
+  std::cerr << "[test_tenant_memory_budget] END" << std::endl;
+}
+
+// Cross-tenant fan-out: query_many matches a serial loop over the tenants, with cold tenants loaded.
+void test_query_many()
+{
+  std::cerr << "[test_query_many] START" << std::endl;
+  const int dim = 16;
+  const std::string dir = "nano_tenant_fanout_storage";
+  std::filesystem::remove_all(dir);
+  {
+    MultiTenantNanoVDB cache(dim, "cosine", 4, dir, 2);
+    cache.set_default_storage(nano_vectordb::storage::File);
+    std::vector<std::string> tenants;
+    for (int t = 0; t < 12; ++t)
+    {
+      tenants.push_back(cache.create_tenant());
+      auto db = cache.get_tenant(tenants.back());
+      db->add_column("year", column_type::Int);
+      for (int i = 0; i < 50; ++i)
+      {
+        const std::string id = "t" + std::to_string(t) + "-" + std::to_string(i);
+        db->upsert({ { id, random_vector(dim) } });
+        db->set_metadata(id, "year", std::int64_t(2000 + i % 5));
+      }
+    }
+    cache.wait_for_io();
+    assert(cache.cache_stats().tenants == 4);  // the other 8 are on disk
+
+    const Eigen::VectorXf q = random_vector(dim);
+    auto serial = [&](std::optional<float> threshold, const Predicate* where) {
+      std::vector<TenantQueryResult> all;
+      for (const auto& tenant : tenants)
+      {
+        auto db = cache.get_tenant(tenant);
+        const auto results = where ? db->query(q, 7, threshold, *where) : db->query(q, 7, threshold);
+        for (const auto& r : results)
+          all.push_back({ tenant, std::string(r.data.id), r.score });
+      }
+      std::stable_sort(all.begin(), all.end(), [](const TenantQueryResult& a, const TenantQueryResult& b) {
+        return a.score > b.score;
+      });
+      all.resize(std::min<std::size_t>(all.size(), 7));
+      return all;
+    };
+    auto same = [](const std::vector<TenantQueryResult>& a, const std::vector<TenantQueryResult>& b) {
+      assert(a.size() == b.size());
+      for (std::size_t i = 0; i < a.size(); ++i)
+        assert(a[i].tenant_id == b[i].tenant_id && a[i].id == b[i].id && a[i].score == b[i].score);
+    };
+
+    // Calling thread only, then on a shared pool with tenants loading concurrently
+    same(cache.query_many(tenants, q, 7), serial(std::nullopt, nullptr));
+    cache.set_scan_options(ScanOptions{ 4, 16384 });
+    for (int round = 0; round < 3; ++round)
+      same(cache.query_many(tenants, q, 7), serial(std::nullopt, nullptr));
+    const auto year = where::eq("year", 2003);
+    same(cache.query_many(tenants, q, 7, std::nullopt, year), serial(std::nullopt, &year));
+    const auto filtered = cache.query_many(tenants, q, 7, 0.1f);
+    same(filtered, serial(0.1f, nullptr));
+    for (const auto& r : filtered)
+      assert(r.score >= 0.1f);
+
+    std::vector<std::string> twice = tenants;
+    twice.insert(twice.end(), tenants.begin(), tenants.begin() + 3);
+    same(cache.query_many(twice, q, 7), serial(std::nullopt, nullptr));
+    assert(cache.query_many(tenants, q, 0).empty() && cache.query_many({}, q, 7).empty());
+    assert(cache.stats()[operation::QueryMany].count == 9);
+
+    bool threw = false;
+    try
+    {
+      cache.query_many({ tenants[0], "no-such-tenant" }, q, 7);
+    }
+    catch (const std::runtime_error&)
+    {
+      threw = true;
+    }
+    assert(threw);
+  }
+  std::filesystem::remove_all(dir);
+  std::cerr << "[test_query_many] END" << std::endl;
+}
+
+// NUMA placement: tenants homed on balanced nodes, loaded and searched on their node's pinned pool.
+void test_numa_placement()
+{
+  std::cerr << "[test_numa_placement] START" << std::endl;
+  assert((numa::parse_cpu_list("0-2,5,7-8\n") == std::vector<int>{ 0, 1, 2, 5, 7, 8 }));
+  const auto detected = numa::detect_nodes();
+  assert(!detected.empty() && !detected.front().cpus.empty());
+
+  // The node survives replacing the store's contents
+  RowStore store(8);
+  store.set_node(0);
+  store = RowStore(8);
+  store.resize(100);
+  assert(store.node() == 0);
+
+  const int dim = 16;
+  const std::string dir = "nano_tenant_numa_storage";
+  std::filesystem::remove_all(dir);
+  {
+    MultiTenantNanoVDB cache(dim, "cosine", 4, dir, 1);
+    cache.set_default_storage(nano_vectordb::storage::File);
+    assert(cache.numa_stats().empty());
+    // Two nodes sharing CPU 0, so the test runs on any machine; binding to a missing node is a no-op
+    NumaOptions options;
+    options.nodes = { numa::Node{ 0, { 0 } }, numa::Node{ 1, { 0 } } };
+    options.threads_per_node = 1;
+    cache.set_numa_options(options);
+
+    std::vector<std::string> tenants;
+    for (int t = 0; t < 8; ++t)
+    {
+      tenants.push_back(cache.create_tenant());
+      auto db = cache.get_tenant(tenants.back());
+      for (int i = 0; i < 20 + 10 * t; ++i)
+        db->upsert({ { "t" + std::to_string(t) + "-" + std::to_string(i), random_vector(dim) } });
+      assert(cache.tenant_node(tenants.back()) == db->numa_node());
+      assert(db->scan_options().threads == 2);  // the node pool plus the caller
+    }
+    cache.wait_for_io();
+    auto stats = cache.numa_stats();
+    assert(stats.size() == 2 && stats[0].node == 0 && stats[1].node == 1);
+    assert(stats[0].tenants > 0 && stats[1].tenants > 0 && stats[0].tenants + stats[1].tenants == 8);
+    assert(stats[0].bytes + stats[1].bytes == cache.cache_stats().bytes);
+
+    bool threw = false;
+    try
+    {
+      cache.set_numa_options(options);
+    }
+    catch (const std::runtime_error&)
+    {
+      threw = true;
+    }
+    assert(threw);
+
+    // Routed searches match the tenant's own results; evicted tenants reload onto the same node
+    const Eigen::VectorXf q = random_vector(dim);
+    std::vector<TenantQueryResult> all;
+    for (const auto& tenant : tenants)
+    {
+      const int node = cache.tenant_node(tenant);
+      const auto routed = cache.query(tenant, q, 5);
+      auto db = cache.get_tenant(tenant);
+      assert(cache.tenant_node(tenant) == node && db->numa_node() == node);
+      const auto direct = db->query(q, 5);
+      assert(routed.size() == direct.size());
+      for (std::size_t i = 0; i < direct.size(); ++i)
+      {
+        assert(routed[i].tenant_id == tenant && routed[i].id == std::string(direct[i].data.id));
+        assert(routed[i].score == direct[i].score);
+        all.push_back(routed[i]);
+      }
+    }
+    std::stable_sort(all.begin(), all.end(),
+                     [](const TenantQueryResult& a, const TenantQueryResult& b) { return a.score > b.score; });
+    all.resize(5);
+    const auto merged = cache.query_many(tenants, q, 5);
+    assert(merged.size() == all.size());
+    for (std::size_t i = 0; i < all.size(); ++i)
+      assert(merged[i].tenant_id == all[i].tenant_id && merged[i].id == all[i].id);
+
+    threw = false;
+    try
+    {
+      cache.query("no-such-tenant", q, 5);
+    }
+    catch (const std::runtime_error&)
+    {
+      threw = true;
+    }
+    assert(threw && cache.tenant_node("no-such-tenant") == -1);
+
+    cache.delete_tenant(tenants[0]);
+    assert(cache.tenant_node(tenants[0]) == -1);
+    stats = cache.numa_stats();
+    assert(stats[0].tenants + stats[1].tenants == 7);
+  }
+  std::filesystem::remove_all(dir);
+  std::cerr << "[test_numa_placement] END" << std::endl;
+}
+
+// Runtime metrics: per-operation latency histograms and counters, merged across threads and tenants.
+void test_metrics()
+{
+  std::cerr << "[test_metrics] START" << std::endl;
+  for (std::uint64_t ns : { 0ull, 7ull, 8ull, 100ull, 12345ull, 999999999ull })
+  {
+    const std::size_t i = LatencyBuckets::index(ns);
+    assert(LatencyBuckets::upper_bound(i) >= ns);
+    assert(i == 0 || LatencyBuckets::upper_bound(i - 1) < ns);
+  }
+  assert(LatencyBuckets::index(std::uint64_t(1) << 50) == LatencyBuckets::kCount - 1);
+
+  const int dim = 16;
+  const std::string file = "nvdb_metrics.json";
+  std::filesystem::remove(file);
+  NanoVectorDB db(dim, "cosine", file);
+  assert(db.stats()[operation::Load].count == 1);
+  std::vector<Data> records;
+  for (int i = 0; i < 100; ++i)
+    records.push_back({ "m" + std::to_string(i), random_vector(dim) });
+  db.upsert(records);
+  const Eigen::VectorXf probe = random_vector(dim);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&]() {
+      for (int q = 0; q < 25; ++q)
+        db.query(probe, 5);
+    });
+  for (auto& t : threads)
+    t.join();
+  db.query_batch(Eigen::MatrixXf::Random(3, dim), 5);
+  db.remove({ "m0", "m1", "missing" });
+  db.save();
+
+  MetricsSnapshot stats = db.stats();
+  const LatencyStats& queries = stats[operation::Query];
+  assert(queries.count == 100);
+  assert(std::accumulate(queries.buckets.begin(), queries.buckets.end(), std::uint64_t(0)) == 100);
+  assert(queries.max_ns > 0 && queries.sum_ns >= queries.max_ns);
+  assert(queries.percentile_ns(0.5) <= queries.percentile_ns(0.99));
+  assert(queries.percentile_ns(1.0) == queries.max_ns);
+  assert(stats[operation::QueryBatch].count == 1);
+  assert(stats[operation::Upsert].count == 1 && stats[operation::Remove].count == 1);
+  assert(stats[operation::Save].count == 1);
+  assert(stats[counter::RowsUpserted] == 100 && stats[counter::RowsRemoved] == 2);
+
+  const std::string text = stats.to_prometheus();
+  assert(text.find("# TYPE nanovdb_operation_duration_seconds histogram") != std::string::npos);
+  assert(text.find("nanovdb_operation_duration_seconds_count{op=\"query\"} 100") != std::string::npos);
+  assert(text.find("nanovdb_operation_duration_seconds_bucket{op=\"query\",le=\"+Inf\"} 100") !=
+         std::string::npos);
+  assert(text.find("nanovdb_rows_removed_total 2") != std::string::npos);
+
+  db.set_metrics(nullptr);
+  db.query(random_vector(dim), 5);
+  assert(db.stats()[operation::Query].count == 0);
+  db.save();
+
+  // A collector passed in at construction records the load; nullptr records nothing
+  auto shared = std::make_shared<Metrics>();
+  {
+    NanoVectorDB first(dim, "cosine", file, nullptr, nullptr, shared);
+    NanoVectorDB second(dim, "cosine", file, nullptr, nullptr, shared);
+    NanoVectorDB quiet(dim, "cosine", file, nullptr, nullptr, nullptr);
+    assert(first.metrics() == shared && !quiet.metrics());
+    assert(shared->snapshot()[operation::Load].count == 2 && quiet.stats()[operation::Load].count == 0);
+  }
+  std::filesystem::remove(file);
+
+  // Blocks this thread cached for destroyed collectors are dropped without touching live ones
+  for (int i = 0; i < 1000; ++i)
+  {
+    Metrics churned;
+    churned.add(counter::RowsUpserted);
+    shared->add(counter::RowsUpserted);
+    assert(churned.snapshot()[counter::RowsUpserted] == 1);
+  }
+  assert(shared->snapshot()[counter::RowsUpserted] == 1000);
+
+  const std::string dir = "nano_tenant_metrics_storage";
+  std::filesystem::remove_all(dir);
+  {
+    MultiTenantNanoVDB cache(dim, "cosine", 1, dir, 0);
+    cache.set_default_storage(nano_vectordb::storage::File);
+    const std::string a = cache.create_tenant();
+    cache.get_tenant(a)->upsert(records);
+    const std::string b = cache.create_tenant();  // evicts a
+    cache.get_tenant(b)->upsert(records);
+    cache.get_tenant(a)->query(random_vector(dim), 5);  // miss, evicts b
+    stats = cache.stats();
+    assert(stats[counter::TenantHits] == 2 && stats[counter::TenantMisses] == 1);
+    assert(stats[counter::TenantEvictions] == 2);
+    assert(stats[operation::Load].count == 3);
+    assert(stats[operation::Upsert].count == 2 && stats[operation::Query].count == 1);
+    assert(stats[operation::Save].count == 2);
+    assert(cache.cache_stats().misses == 1);
+    assert(cache.prometheus_metrics("tenants").find("tenants_tenant_hits_total 2") != std::string::npos);
+  }
+  std::filesystem::remove_all(dir);
+  std::cerr << "[test_metrics] END" << std::endl;
+}
+
 // Comprehensive File storage test: save/load vectors and additional data, then query and delete.
 void test_storage_file_backend()
 {
@@ -272,25 +1591,970 @@ void test_storage_sqlite_backend()
   assert(db2.get({ "10", "19" }).empty());
 
   // Cleanup
-  std::filesystem::remove(path);
+  remove_sqlite_files(path);
   std::cerr << "[test_storage_sqlite_backend] END" << std::endl;
 }
 
+// Readers run concurrently with writers, saves and background compaction.
+void test_concurrency()
+{
+  std::cerr << "[test_concurrency] START" << std::endl;
+  const int dim = 32;
+  const std::string path = "nvdb_concurrency_test.json";
+  std::filesystem::remove(path);
+  std::filesystem::remove(WriteAheadLog::path_for(path));
+  NanoVectorDB db(dim, "cosine", path);
+  std::vector<Data> recs;
+  for (int i = 0; i < 2000; ++i)
+    recs.push_back({ "id-" + std::to_string(i), random_vector(dim) });
+  db.upsert(std::vector<Data>(recs.begin(), recs.begin() + 1000));
+  db.save();
+
+  // Writers throw instead of deadlocking when the thread holds a ReadGuard
+  {
+    NanoVectorDB::ReadGuard guard(db);
+    assert(db.size() == 1000 && db.query(recs[3].vector, 1)[0].data.id == "id-3");
+    bool threw = false;
+    try
+    {
+      db.upsert({ recs[1000] });
+    }
+    catch (const std::runtime_error&)
+    {
+      threw = true;
+    }
+    assert(threw);
+  }
+
+  std::atomic<bool> stop{ false };
+  std::atomic<int> queries{ 0 };
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; ++t)
+  {
+    readers.emplace_back([&, t] {
+      // Rows 0..499 are never touched by the writer, so their ids must always come back first
+      for (int i = t; !stop; i = (i + 7) % 500)
+      {
+        NanoVectorDB::ReadGuard guard(db);
+        auto res = db.query(recs[i].vector, 3);
+        assert(!res.empty() && res[0].data.id == recs[i].id);
+        assert(db.get({ recs[i].id }).size() == 1);
+        ++queries;
+      }
+    });
+  }
+  std::thread saver([&] {
+    while (!stop)
+      db.save();
+  });
+  for (int round = 0; round < 20; ++round)
+  {
+    const int begin = 1000 + round * 50;
+    db.upsert(std::vector<Data>(recs.begin() + begin, recs.begin() + begin + 50));
+    std::vector<std::string> gone;
+    for (int i = begin - 500; i < begin - 450; ++i)
+      gone.push_back(recs[i].id);
+    db.remove(gone);
+    if (round % 5 == 4)
+      db.compact_async().get();
+  }
+  stop = true;
+  for (auto& r : readers)
+    r.join();
+  saver.join();
+  assert(queries > 0);
+  assert(db.size() == 1000 && db.tombstones() < 1000);
+  db.save();
+
+  // Every change reached the storage file or its log
+  NanoVectorDB reloaded(dim, "cosine", path);
+  assert(reloaded.size() == 1000);
+  assert(reloaded.get({ "id-1999", "id-400" }).size() == 2 && reloaded.get({ "id-500", "id-1449" }).empty());
+  std::filesystem::remove(path);
+  std::filesystem::remove(WriteAheadLog::path_for(path));
+  std::cerr << "[test_concurrency] END" << std::endl;
+}
+
+// SQLite keeps one connection per path with cached statements, and batches inserts and deletes.
+void test_sqlite_connection_cache()
+{
+  std::cerr << "[test_sqlite_connection_cache] START" << std::endl;
+  const int dim = 32;
+  const std::string path = "nvdb_sqlite_cache.sqlite";
+  remove_sqlite_files(path);
+
+  bool rejected = false;
+  try
+  {
+    SQLiteOptions bad;
+    bad.synchronous = "sometimes";
+    SQLiteStorage storage(bad);
+  }
+  catch (const std::runtime_error&)
+  {
+    rejected = true;
+  }
+  assert(rejected);
+
+  SQLiteOptions options;
+  options.synchronous = "full";
+  options.batch_rows = 16;  // 150 rows: 9 multi-row statements and 6 single-row ones
+  options.max_connections = 2;
+  auto sqlite = std::make_shared<SQLiteStorage>(options);
+  assert(sqlite->options().synchronous == "FULL");
+
+  std::vector<Data> recs;
+  for (int i = 0; i < 150; ++i)
+    recs.push_back({ "id-" + std::to_string(i), random_vector(dim) });
+  {
+    NanoVectorDB db(dim, "cosine", path, nullptr, sqlite);
+    db.upsert(recs);
+    db.save();
+    std::vector<std::string> gone;
+    for (int i = 0; i < 40; ++i)
+      gone.push_back("id-" + std::to_string(i));
+    db.remove(gone);
+    db.save();
+  }
+  {
+    NanoVectorDB db(dim, "cosine", path, nullptr, sqlite);
+    assert(db.size() == 110 && db.get({ "id-39" }).empty());
+    auto g = db.get({ "id-40", "id-149" });
+    assert(g.size() == 2 && g[0].vector.isApprox(recs[40].vector.normalized()) &&
+           g[1].vector.isApprox(recs[149].vector.normalized()));
+    assert(db.query(recs[77].vector, 1)[0].data.id == "id-77");
+    db.set_precision(precision::BF16);
+    db.save();
+  }
+  // Both loads and all saves went through one connection, opened in WAL journal mode
+  assert(sqlite->open_connections() == 1);
+  sqlite3* raw = nullptr;
+  assert(sqlite3_open(path.c_str(), &raw) == SQLITE_OK);
+  sqlite3_stmt* mode = nullptr;
+  assert(sqlite3_prepare_v2(raw, "PRAGMA journal_mode", -1, &mode, nullptr) == SQLITE_OK);
+  assert(sqlite3_step(mode) == SQLITE_ROW);
+  assert(std::string(reinterpret_cast<const char*>(sqlite3_column_text(mode, 0))) == "wal");
+  sqlite3_finalize(mode);
+  sqlite3_close(raw);
+
+  // Narrow rows are read straight into the row store
+  {
+    NanoVectorDB db(dim, "cosine", path, nullptr, sqlite);
+    assert(db.size() == 110 && db.get_precision() == precision::BF16);
+    assert(db.query(recs[77].vector, 1)[0].data.id == "id-77");
+  }
+
+  // A file deleted behind the cached connection reads back as empty, and a new one can be written
+  remove_sqlite_files(path);
+  {
+    NanoVectorDB db(dim, "cosine", path, nullptr, sqlite);
+    assert(db.size() == 0);
+    db.upsert({ recs[0] });
+    db.save();
+  }
+  {
+    NanoVectorDB db(dim, "cosine", path, nullptr, sqlite);
+    assert(db.size() == 1 && db.get_precision() == precision::F32);
+  }
+
+  // Connections beyond max_connections are closed, least recently used first
+  const std::string other = "nvdb_sqlite_cache_other.sqlite";
+  const std::string third = "nvdb_sqlite_cache_third.sqlite";
+  for (const auto& p : { other, third })
+  {
+    remove_sqlite_files(p);
+    NanoVectorDB db(dim, "cosine", p, nullptr, sqlite);
+    db.upsert({ recs[1] });
+    db.save();
+  }
+  assert(sqlite->open_connections() == 2);
+  sqlite->close(third);
+  assert(sqlite->open_connections() == 1);
+  sqlite->close_all();
+  assert(sqlite->open_connections() == 0);
+  for (const auto& p : { path, other, third })
+  {
+    assert(!std::filesystem::exists(p + "-wal"));
+    remove_sqlite_files(p);
+  }
+  std::cerr << "[test_sqlite_connection_cache] END" << std::endl;
+}
+
+// MMap storage writes a binary columnar file and loads it by mapping the rows instead of copying them.
+void test_storage_mmap_backend()
+{
+  std::cerr << "[test_storage_mmap_backend] START" << std::endl;
+  int dim = 48;
+  std::string path = "nvdb_mmap_test.nvdb";
+  std::filesystem::remove(path);
+  auto storage_cols = nano_vectordb::make(nano_vectordb::storage::MMap);
+
+  std::vector<Data> recs;
+  for (int i = 0; i < 300; ++i)
+    recs.push_back({ "id-" + std::to_string(i), random_vector(dim) });
+  for (auto type : { precision::F32, precision::F16 })
+  {
+    for (bool l2 : { false, true })
+    {
+      std::shared_ptr<IMetric> metric = l2 ? nano_vectordb::make(nano_vectordb::metric::L2) : nullptr;
+      std::vector<std::vector<std::pair<std::string, float>>> expected;  // views die with their database
+      {
+        NanoVectorDB db(dim, "cosine", path, metric, storage_cols);
+        assert(db.size() == 0);
+        db.set_precision(type);
+        db.upsert(recs);
+        db.remove({ "id-3", "id-150" });
+        db.add_column("group", column_type::Int);
+        db.set_metadata("id-7", "group", std::int64_t(2));
+        db.store_additional_data({ { "owner", "mmap" } });
+        for (int i = 0; i < 5; ++i)
+        {
+          expected.emplace_back();
+          for (const auto& r : db.query(recs[i * 10].vector, 5))
+            expected.back().emplace_back(std::string(r.data.id), r.score);
+        }
+        db.save();
+      }
+      std::unique_ptr<NanoVectorDB> loaded(new NanoVectorDB(dim, "cosine", path, metric, storage_cols));
+      assert(loaded->size() == 298 && loaded->get_precision() == type && loaded->get({ "id-3" }).empty());
+      assert(loaded->get_additional_data() == nlohmann::json({ { "owner", "mmap" } }));
+      assert(loaded->get_metadata("id-7") == nlohmann::json({ { "group", 2 } }));
+      for (int i = 0; i < 5; ++i)
+      {
+        auto got = loaded->query(recs[i * 10].vector, 5);
+        assert(got.size() == expected[i].size());
+        for (size_t k = 0; k < got.size(); ++k)
+        {
+          assert(got[k].data.id == expected[i][k].first);
+          assert(std::abs(got[k].score - expected[i][k].second) < 1e-6f);
+        }
+      }
+
+      // Writes copy the mapped rows first; saving over the mapped file leaves the loaded copy intact
+      loaded->upsert({ { "id-3", recs[3].vector } });
+      loaded->checkpoint();
+      loaded->upsert({ { "extra", recs[4].vector } });
+      NanoVectorDB reloaded(dim, "cosine", path, metric, storage_cols);
+      assert(reloaded.size() == 299 && reloaded.query(recs[3].vector, 1)[0].data.id == "id-3");
+      assert(loaded->size() == 300 && loaded->query(recs[150].vector, 1, std::nullopt, [](const DataView& v) {
+        return v.id != "id-150";
+      }).size() == 1);
+      loaded.reset();
+      std::filesystem::remove(path);
+      std::filesystem::remove(WriteAheadLog::path_for(path));
+    }
+  }
+
+  // Files that are not in the columnar format are rejected
+  {
+    std::ofstream junk(path, std::ios::binary);
+    junk << std::string(256, 'x');
+  }
+  bool threw = false;
+  try
+  {
+    NanoVectorDB bad(dim, "cosine", path, nullptr, storage_cols);
+  }
+  catch (const std::runtime_error&)
+  {
+    threw = true;
+  }
+  assert(threw);
+  std::filesystem::remove(path);
+  std::cerr << "[test_storage_mmap_backend] END" << std::endl;
+}
+
+// With MMap storage and a PQ or SQ8 index only the codes live in memory: the index is saved next to the
+// file and loaded on open instead of re-encoding the mapped rows, until the rows no longer match it.
+void test_disk_resident()
+{
+  std::cerr << "[test_disk_resident] START" << std::endl;
+  const int dim = 32;
+  const int n = 3000;
+  const std::string path = "nvdb_disk_test.nvdb";
+  const std::string index_path = IPersistentIndex::path_for(path);
+  for (const std::string& file : { path, WriteAheadLog::path_for(path), index_path })
+    std::filesystem::remove(file);
+  auto storage = nano_vectordb::make(nano_vectordb::storage::MMap);
+  std::vector<Data> recs;
+  for (int i = 0; i < n; ++i)
+    recs.push_back({ "d-" + std::to_string(i), random_vector(dim).array() - 0.5f });
+  PQParams params;
+  params.m = 8;
+  params.train_sample = 2000;
+  params.rerank = 0;  // approximate scores come straight from the codebooks
+  std::vector<std::vector<std::pair<std::string, float>>> expected;
+  {
+    NanoVectorDB db(dim, "cosine", path, nullptr, storage);
+    db.upsert(recs);
+    db.remove({ "d-1" });
+    db.initialize_index(std::make_shared<PQIndex>(params));
+    db.checkpoint();
+    assert(std::filesystem::exists(index_path));
+    for (int i = 0; i < 10; ++i)
+    {
+      expected.emplace_back();
+      for (const auto& r : db.query(recs[i * 7].vector, 5))
+        expected.back().emplace_back(std::string(r.data.id), r.score);
+    }
+  }
+  // Another seed trains other codebooks, so equal approximate scores show the saved index was loaded
+  PQParams other = params;
+  other.seed = 7;
+  auto same_as_expected = [&](NanoVectorDB& db, const std::string& skip) {
+    for (int i = 0; i < 10; ++i)
+    {
+      std::vector<std::pair<std::string, float>> want;
+      for (const auto& e : expected[i])
+        if (e.first != skip)
+          want.push_back(e);
+      auto got = db.query(recs[i * 7].vector, 5);
+      for (size_t k = 0; k < want.size(); ++k)
+      {
+        if (got[k].data.id != want[k].first || got[k].score != want[k].second)
+          return false;
+      }
+    }
+    return true;
+  };
+  {
+    NanoVectorDB db(dim, "cosine", path, nullptr, storage);
+    auto pq = std::make_shared<PQIndex>(other);
+    db.initialize_index(pq);
+    assert(pq->trained() && pq->size() == static_cast<size_t>(n - 1));
+    assert(same_as_expected(db, ""));
+    const MemoryUsage usage = db.memory_usage();
+    assert(usage.mapped >= static_cast<size_t>(n - 1) * dim * sizeof(float));
+    assert(usage.index < static_cast<size_t>(n) * dim * sizeof(float) / 2);
+    // Re-ranked against the mapped rows, scores are exact
+    pq->set_rerank(8);
+    auto top = db.query(recs[10].vector, 1);
+    assert(top[0].data.id == "d-10" && std::abs(top[0].score - 1.0f) < 1e-5f);
+    pq->set_rerank(0);
+    // Logged removals leave the rows mapped, and the index is saved for them
+    WalOptions logged;
+    logged.enabled = true;
+    db.set_wal_options(logged);
+    db.remove({ "d-2" });
+    db.save();
+    assert(db.save_index());
+  }
+  {
+    NanoVectorDB db(dim, "cosine", path, nullptr, storage);
+    auto pq = std::make_shared<PQIndex>(other);
+    db.initialize_index(pq);
+    assert(pq->size() == static_cast<size_t>(n - 2) && db.get({ "d-2" }).empty());
+    assert(same_as_expected(db, "d-2"));
+    // A write copies the rows into memory; they no longer match the file, so the index is rebuilt
+    db.upsert({ { "d-3", recs[4].vector } });
+    assert(!db.save_index());
+    db.initialize_index(std::make_shared<PQIndex>(other));
+    assert(!same_as_expected(db, "d-2"));
+    // An index file of another codec is ignored
+    auto sq8 = std::make_shared<SQ8Index>();
+    db.initialize_index(sq8);
+    assert(sq8->trained() && sq8->size() == static_cast<size_t>(n - 2));
+  }
+  for (const std::string& file : { path, WriteAheadLog::path_for(path), index_path })
+    std::filesystem::remove(file);
+
+  // Sealed segments save their index when they are built and load it when the collection is reopened
+  const std::string dir = "nvdb_disk_segments";
+  std::filesystem::remove_all(dir);
+  SegmentOptions options;
+  options.seal_rows = 1200;
+  options.index_type = nano_vectordb::index::PQ;
+  options.background = false;
+  size_t sealed = 0;
+  {
+    SegmentedNanoVectorDB segmented(dim, nano_vectordb::metric::Cosine, dir, options);
+    for (int i = 0; i < n; i += 1000)
+      segmented.upsert(std::vector<Data>(recs.begin() + i, recs.begin() + i + 1000));
+    segmented.save();
+    for (const auto& segment : segmented.segments())
+      sealed += segment.sealed;
+  }
+  size_t index_files = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(dir))
+    index_files += entry.path().extension() == ".index";
+  assert(sealed > 0 && index_files == sealed);
+  {
+    SegmentedNanoVectorDB segmented(dim, nano_vectordb::metric::Cosine, dir, options);
+    assert(segmented.size() == n);
+    for (int i = 0; i < n; i += 500)
+      assert(segmented.query(recs[i].vector, 1)[0].id == recs[i].id);
+  }
+  std::filesystem::remove_all(dir);
+  std::cerr << "[test_disk_resident] END" << std::endl;
+}
+
+// With the write-ahead log enabled save() appends changes to it, and SQLite updates only the changed
+// rows, instead of rewriting every record; without the log the plain file is rewritten.
+void test_incremental_save()
+{
+  std::cerr << "[test_incremental_save] START" << std::endl;
+  int dim = 32;
+  const std::string path = "nvdb_wal_test.json";
+  const std::string wal = WriteAheadLog::path_for(path);
+  std::filesystem::remove(path);
+  std::filesystem::remove(wal);
+  std::vector<Data> recs;
+  for (int i = 0; i < 800; ++i)
+    recs.push_back({ "id-" + std::to_string(i), random_vector(dim) });
+  const Eigen::VectorXf moved = random_vector(dim);
+
+  // By default save() rewrites the plain JSON file, so readers that do not replay a log see every change
+  {
+    NanoVectorDB db(dim, "cosine", path);
+    assert(!db.wal_options().enabled);
+    db.upsert(std::vector<Data>(recs.begin(), recs.begin() + 10));
+    db.save();
+    db.upsert({ { "id-10", recs[10].vector } });
+    db.remove({ "id-0" });
+    db.save();
+    assert(!std::filesystem::exists(wal));
+    std::ifstream in(path);
+    const nlohmann::json plain = nlohmann::json::parse(in);
+    assert(plain["data"].size() == 10);
+    assert(std::none_of(plain["data"].begin(), plain["data"].end(),
+                        [](const nlohmann::json& d) { return d["id"] == "id-0"; }));
+  }
+  std::filesystem::remove(path);
+
+  WalOptions logged;
+  logged.enabled = true;
+  {
+    NanoVectorDB db(dim, "cosine", path);
+    db.set_wal_options(logged);
+    db.upsert(std::vector<Data>(recs.begin(), recs.begin() + 500));
+    db.add_column("n", column_type::Int);
+    db.set_metadata("id-1", "n", std::int64_t(1));
+    db.save();
+    assert(std::filesystem::exists(path) && !std::filesystem::exists(wal));
+    const auto base_bytes = std::filesystem::file_size(path);
+
+    db.upsert(std::vector<Data>(recs.begin() + 500, recs.begin() + 520));
+    db.upsert({ { "id-2", moved } });
+    db.remove({ "id-3" });
+    db.set_metadata("id-4", "n", std::int64_t(4));
+    db.store_additional_data({ { "v", 2 } });
+    db.save();
+    assert(std::filesystem::file_size(path) == base_bytes && std::filesystem::exists(wal));
+    // A re-inserted id starts without metadata
+    db.remove({ "id-1" });
+    db.upsert({ { "id-1", recs[1].vector } });
+    db.save();
+    db.save();  // nothing changed: nothing appended
+  }
+  const auto wal_bytes = std::filesystem::file_size(wal);
+  {
+    std::ofstream torn(wal, std::ios::binary | std::ios::app);
+    torn << "NVWB partial batch";
+  }
+  NanoVectorDB reopened(dim, "cosine", path);
+  reopened.set_wal_options(logged);
+  assert(std::filesystem::file_size(wal) == wal_bytes);
+  assert(reopened.size() == 519 && reopened.get({ "id-3" }).empty());
+  assert(reopened.get({ "id-2" })[0].vector.isApprox(normalize(moved), 1e-5f));
+  assert(reopened.get_metadata("id-4") == nlohmann::json({ { "n", 4 } }));
+  assert(reopened.get_metadata("id-1").empty());
+  assert(reopened.get_additional_data() == nlohmann::json({ { "v", 2 } }));
+  assert(reopened.query(recs[510].vector, 1)[0].data.id == "id-510");
+
+  // checkpoint() folds the log into the storage file; so does a save that changes many rows
+  reopened.checkpoint();
+  assert(!std::filesystem::exists(wal));
+  reopened.upsert({ { "id-0", recs[7].vector } });
+  reopened.save();
+  assert(std::filesystem::exists(wal));
+  reopened.upsert(std::vector<Data>(recs.begin() + 520, recs.end()));
+  reopened.save();
+  assert(!std::filesystem::exists(wal));
+  NanoVectorDB folded(dim, "cosine", path);
+  assert(folded.size() == 799 && folded.get_metadata("id-4") == nlohmann::json({ { "n", 4 } }));
+  assert(folded.query(recs[7].vector, 2)[1].score > 0.999f);
+  std::filesystem::remove(path);
+
+  // SQLite: only changed rows are written, so a row added behind the database's back survives
+  const std::string sqlite_path = "nvdb_wal_test.sqlite";
+  remove_sqlite_files(sqlite_path);
+  auto sqlite = nano_vectordb::make(nano_vectordb::storage::SQLite);
+  {
+    NanoVectorDB db(dim, "cosine", sqlite_path, nullptr, sqlite);
+    db.upsert(std::vector<Data>(recs.begin(), recs.begin() + 500));
+    db.save();
+    db.add_column("n", column_type::Int);
+
+    sqlite3* raw = nullptr;
+    assert(sqlite3_open(sqlite_path.c_str(), &raw) == SQLITE_OK);
+    sqlite3_stmt* ins = nullptr;
+    assert(sqlite3_prepare_v2(raw, "INSERT INTO vectors(id, dim, vec) VALUES ('outside', ?1, ?2)", -1, &ins,
+                              nullptr) == SQLITE_OK);
+    sqlite3_bind_int(ins, 1, dim);
+    sqlite3_bind_blob(ins, 2, recs[700].vector.data(), dim * sizeof(float), SQLITE_TRANSIENT);
+    assert(sqlite3_step(ins) == SQLITE_DONE);
+    sqlite3_finalize(ins);
+    sqlite3_close(raw);
+
+    db.upsert(std::vector<Data>(recs.begin() + 500, recs.begin() + 505));
+    db.remove({ "id-0" });
+    db.set_metadata("id-9", "n", std::int64_t(9));
+    db.save();
+  }
+  {
+    NanoVectorDB db(dim, "cosine", sqlite_path, nullptr, sqlite);
+    assert(db.size() == 505 && db.get({ "outside" }).size() == 1 && db.get({ "id-0" }).empty());
+    assert(db.get_metadata("id-9") == nlohmann::json({ { "n", 9 } }));
+    // A precision change rewrites every row
+    db.remove({ "outside" });
+    db.set_precision(precision::F16);
+    db.save();
+  }
+  NanoVectorDB narrow(dim, "cosine", sqlite_path, nullptr, sqlite);
+  assert(narrow.size() == 504 && narrow.get_precision() == precision::F16);
+  remove_sqlite_files(sqlite_path);
+
+  // A log that outlives its checkpoint (a crash before it was removed) is not replayed over the newer file
+  {
+    NanoVectorDB db(dim, "cosine", path);
+    db.set_wal_options(logged);
+    db.upsert(std::vector<Data>(recs.begin(), recs.begin() + 100));
+    db.save();
+    db.remove({ "id-3" });
+    db.save();
+    const std::string stale = wal + ".stale";
+    std::filesystem::copy_file(wal, stale, std::filesystem::copy_options::overwrite_existing);
+    db.upsert({ { "id-3", recs[3].vector } });
+    db.checkpoint();
+    std::filesystem::rename(stale, wal);
+  }
+  {
+    NanoVectorDB db(dim, "cosine", path);
+    db.set_wal_options(logged);
+    assert(db.size() == 100 && db.get({ "id-3" }).size() == 1);
+    db.remove({ "id-4" });
+    db.save();  // appended after the stale batches
+  }
+  {
+    NanoVectorDB db(dim, "cosine", path);
+    assert(db.size() == 99 && db.get({ "id-3" }).size() == 1 && db.get({ "id-4" }).empty());
+    // A checkpoint that cannot drop the log fails
+    std::filesystem::remove(wal);
+    std::filesystem::create_directories(wal + "/busy");
+    bool threw = false;
+    try
+    {
+      db.checkpoint();
+    }
+    catch (const std::runtime_error&)
+    {
+      threw = true;
+    }
+    assert(threw);
+    std::filesystem::remove_all(wal);
+  }
+  std::filesystem::remove(path);
+
+  // Saves clear the tracked changes while other threads ask dirty() and memory_usage()
+  {
+    NanoVectorDB db(dim, "cosine", path);
+    db.set_wal_options(logged);
+    db.upsert(std::vector<Data>(recs.begin(), recs.begin() + 500));
+    db.save();
+    std::atomic<bool> done{ false };
+    std::thread watcher([&] {
+      std::size_t polls = 0;
+      while (!done.load() || polls == 0)
+      {
+        db.dirty();
+        db.memory_usage();
+        ++polls;
+      }
+    });
+    for (int i = 0; i < 300; ++i)
+    {
+      db.upsert({ { "id-" + std::to_string(i), recs[i + 1].vector } });
+      db.remove({ "id-" + std::to_string(200 + i) });
+      db.save();
+    }
+    done = true;
+    watcher.join();
+    assert(!db.dirty());
+  }
+  std::filesystem::remove(path);
+  std::filesystem::remove(wal);
+  std::cerr << "[test_incremental_save] END" << std::endl;
+}
+
+// Reloading keeps stored unit rows and norms as they are, and still normalizes rows that need it.
+void test_query_cache()
+{
+  std::cerr << "[test_query_cache] START" << std::endl;
+  const int dim = 16;
+  const std::string file = "nvdb_query_cache.json";
+  std::filesystem::remove(file);
+  NanoVectorDB db(dim, "cosine", file);
+  std::vector<Data> records;
+  for (int i = 0; i < 200; ++i)
+    records.push_back({ "c" + std::to_string(i), random_vector(dim) });
+  db.upsert(records);
+  db.add_column("year", column_type::Int);
+  for (int i = 0; i < 200; ++i)
+    db.set_metadata("c" + std::to_string(i), "year", std::int64_t(2000 + i % 10));
+  assert(db.query_cache_stats().capacity == 0);
+
+  db.set_query_cache(2);
+  const Eigen::VectorXf a = random_vector(dim);
+  const Eigen::VectorXf b = random_vector(dim);
+  const auto first = db.query(a, 5);
+  const auto again = db.query(a, 5);
+  assert(again.size() == first.size());
+  for (size_t i = 0; i < first.size(); ++i)
+    assert(again[i].data.id == first[i].data.id && again[i].score == first[i].score);
+  QueryCacheStats stats = db.query_cache_stats();
+  assert(stats.hits == 1 && stats.misses == 1 && stats.entries == 1 && stats.bytes > 0);
+
+  // top_k, threshold and predicate are part of the key; lambda filters are never cached
+  db.query(a, 4);
+  db.query(a, 5, 0.0f);
+  db.query(a, 5, std::nullopt, [](const DataView&) { return true; });
+  stats = db.query_cache_stats();
+  assert(stats.hits == 1 && stats.misses == 3 && stats.entries == 2);
+  const auto year = where::eq("year", 2003);
+  const auto filtered = db.query(b, 5, std::nullopt, year);
+  assert(db.query(b, 5, std::nullopt, year).size() == filtered.size());
+  assert(db.query(b, 5, std::nullopt, where::eq("year", 2004)).size() == 5);
+  stats = db.query_cache_stats();
+  assert(stats.hits == 2 && stats.misses == 5 && stats.entries == 2);
+
+  // A write invalidates every entry, so the next query sees the new row
+  db.upsert({ { "exact", a } });
+  const auto fresh = db.query(a, 1);
+  assert(fresh[0].data.id == "exact");
+  stats = db.query_cache_stats();
+  assert(stats.misses == 6 && stats.entries == 1);
+  db.remove({ "exact" });
+  assert(db.query(a, 1)[0].data.id != "exact");
+
+  // Concurrent readers share the cache
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&]() {
+      for (int q = 0; q < 50; ++q)
+        assert(db.query(b, 3).size() == 3);
+    });
+  for (auto& t : threads)
+    t.join();
+  stats = db.query_cache_stats();
+  assert(stats.hits + stats.misses == 9 + 200 && stats.hits >= 198);
+  const MetricsSnapshot metrics = db.stats();
+  assert(metrics[counter::QueryCacheHits] == stats.hits && metrics[counter::QueryCacheMisses] == stats.misses);
+  assert(std::abs(stats.hit_rate() - double(stats.hits) / double(stats.hits + stats.misses)) < 1e-12);
+
+  db.set_query_cache(0);
+  db.query(a, 5);
+  assert(db.query_cache_stats().entries == 0 && db.query_cache_stats().hits == 0);
+  std::cerr << "[test_query_cache] END" << std::endl;
+}
+
+// Segmented collection: seals, merges and tombstones agree with one monolithic database
+void test_segmented()
+{
+  std::cerr << "[test_segmented] START" << std::endl;
+  const int dim = 16;
+  const std::string dir = "nano_segmented_test_storage";
+  std::filesystem::remove_all(dir);
+  std::filesystem::remove("nvdb_segmented_reference.json");
+  NanoVectorDB reference(dim, "cosine", "nvdb_segmented_reference.json");
+  reference.initialize_metric(nano_vectordb::metric::Cosine);
+  auto check = [&](const SegmentedNanoVectorDB& db) {
+    assert(db.size() == reference.size());
+    for (int q = 0; q < 5; ++q)
+    {
+      const Eigen::VectorXf probe = random_vector(dim);
+      const auto got = db.query(probe, 10);
+      const auto want = reference.query(probe, 10);
+      assert(got.size() == want.size());
+      for (size_t i = 0; i < got.size(); ++i)
+        assert(got[i].id == want[i].data.id && std::abs(got[i].score - want[i].score) < 1e-5f);
+    }
+  };
+
+  SegmentOptions options;
+  options.seal_rows = 100;
+  options.merge_factor = 3;
+  options.threads = 4;
+  options.background = false;
+  {
+    SegmentedNanoVectorDB db(dim, nano_vectordb::metric::Cosine, dir, options);
+    for (int b = 0; b < 20; ++b)
+    {
+      std::vector<Data> batch;
+      for (int i = 0; i < 50; ++i)
+        batch.push_back({ "s" + std::to_string(b * 50 + i), random_vector(dim) });
+      db.upsert(batch);
+      reference.upsert(batch);
+    }
+    // 1000 rows: nine sealed batches of 100 merged three at a time, one write segment of 100 frozen
+    auto segments = db.segments();
+    size_t sealed = 0;
+    size_t rows = 0;
+    for (const auto& s : segments)
+    {
+      sealed += s.sealed ? 1 : 0;
+      rows += s.rows;
+      assert(!s.busy);
+    }
+    assert(rows == 1000 && sealed >= 2 && segments.size() < 10);
+    assert(db.memory_usage().mapped > 0);
+    check(db);
+
+    // Overwrite and remove records held by sealed segments
+    std::vector<Data> updates;
+    for (int i = 0; i < 30; ++i)
+      updates.push_back({ "s" + std::to_string(i * 7), random_vector(dim) });
+    db.upsert(updates);
+    reference.upsert(updates);
+    const auto fetched = db.get({ "s7", "missing", "s0" });
+    assert(fetched.size() == 2 && fetched[0].id == "s7" && fetched[1].id == "s0");
+    assert((fetched[0].vector - updates[1].vector.normalized()).norm() < 1e-5f);
+    std::vector<std::string> gone;
+    for (int i = 100; i < 600; ++i)
+      gone.push_back("s" + std::to_string(i));
+    db.remove(gone);
+    reference.remove(gone);
+    check(db);
+    // The merged segment lost over half its rows, so it was rewritten without them
+    for (const auto& s : db.segments())
+      assert(!s.sealed || s.tombstones == 0);
+    assert(db.stats()[operation::Upsert].count == 21 && db.stats()[counter::RowsRemoved] == 500);
+    db.save();
+  }
+
+  // Reopen from the manifest; a stray file from an unfinished merge is deleted
+  std::ofstream(dir + "/seg-999.nvdb") << "partial";
+  {
+    SegmentedNanoVectorDB db(dim, nano_vectordb::metric::Cosine, dir, options);
+    assert(!std::filesystem::exists(dir + "/seg-999.nvdb"));
+    check(db);
+    assert(db.get({ "s7" }).size() == 1 && db.get({ "s300" }).empty());
+  }
+
+  // Background seals and merges while other threads query
+  options.background = true;
+  {
+    SegmentedNanoVectorDB db(dim, nano_vectordb::metric::Cosine, dir, options);
+    std::atomic<bool> done{ false };
+    const Eigen::VectorXf probe = random_vector(dim);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 2; ++t)
+      readers.emplace_back([&]() {
+        while (!done)
+          assert(db.query(probe, 5).size() == 5);
+      });
+    for (int b = 0; b < 10; ++b)
+    {
+      std::vector<Data> batch;
+      for (int i = 0; i < 40; ++i)
+        batch.push_back({ "bg" + std::to_string(b * 40 + i), random_vector(dim) });
+      db.upsert(batch);
+      reference.upsert(batch);
+      db.remove({ "s" + std::to_string(600 + b) });
+      reference.remove({ "s" + std::to_string(600 + b) });
+    }
+    done = true;
+    for (auto& t : readers)
+      t.join();
+    db.wait_for_background();
+    check(db);
+    db.save();
+  }
+  {
+    SegmentedNanoVectorDB db(dim, nano_vectordb::metric::Cosine, dir, options);
+    check(db);
+  }
+  std::filesystem::remove_all(dir);
+
+  // A rewrite that drops an overwritten row first saves the write segment holding its new copy
+  const std::string crash_dir = dir + "_crash";
+  std::filesystem::remove_all(crash_dir);
+  SegmentOptions rewrite = options;
+  rewrite.background = false;
+  rewrite.max_dead_fraction = 0.005f;
+  const Eigen::VectorXf moved = random_vector(dim);
+  {
+    SegmentedNanoVectorDB db(dim, nano_vectordb::metric::Cosine, crash_dir, rewrite);
+    std::vector<Data> batch;
+    for (int i = 0; i < 100; ++i)
+      batch.push_back({ "c" + std::to_string(i), random_vector(dim) });
+    db.upsert(batch);
+    db.save();
+    // Tombstones c5 in the sealed segment, which is then rewritten without it
+    db.upsert({ { "c5", moved } });
+  }  // closed without save(), as after a crash
+  {
+    SegmentedNanoVectorDB db(dim, nano_vectordb::metric::Cosine, crash_dir, rewrite);
+    const auto found = db.get({ "c5" });
+    assert(db.size() == 100 && found.size() == 1);
+    assert((found[0].vector - moved.normalized()).norm() < 1e-5f);
+  }
+  std::filesystem::remove_all(crash_dir);
+  std::cerr << "[test_segmented] END" << std::endl;
+}
+
+void test_load_path()
+{
+  std::cerr << "[test_load_path] START" << std::endl;
+  const int dim = 48;
+  std::vector<Data> recs;
+  for (int i = 0; i < 300; ++i)
+    recs.push_back({ "id-" + std::to_string(i), random_vector(dim) * 3.0f });
+  const Eigen::VectorXf probe = random_vector(dim);
+
+  struct Backend
+  {
+    std::string path;
+    std::shared_ptr<IStorage> storage;
+  };
+  const std::vector<Backend> backends = { { "nvdb_load_path.json", nullptr },
+                                          { "nvdb_load_path.file", nano_vectordb::make(storage::File) },
+                                          { "nvdb_load_path.sqlite", nano_vectordb::make(storage::SQLite) },
+                                          { "nvdb_load_path.mmap", nano_vectordb::make(storage::MMap) } };
+  for (const auto& backend : backends)
+  {
+    remove_sqlite_files(backend.path);
+    std::filesystem::remove(WriteAheadLog::path_for(backend.path));
+    std::vector<Data> saved;
+    std::vector<QueryResult> before;
+    {
+      NanoVectorDB db(dim, "cosine", backend.path, nullptr, backend.storage);
+      db.upsert(recs);
+      db.save();
+      saved = db.get({ "id-0", "id-150", "id-299" });
+      for (const auto& r : db.query(probe, 5))
+        before.push_back(r);
+      // Bitwise-identical reload: stored unit rows are neither re-normalized nor re-scored
+      NanoVectorDB reloaded(dim, "cosine", backend.path, nullptr, backend.storage);
+      const auto got = reloaded.get({ "id-0", "id-150", "id-299" });
+      assert(got.size() == 3);
+      for (size_t i = 0; i < got.size(); ++i)
+        assert(got[i].vector == saved[i].vector);
+      const auto after = reloaded.query(probe, 5);
+      assert(after.size() == before.size());
+      for (size_t i = 0; i < after.size(); ++i)
+        assert(after[i].data.id == before[i].data.id && after[i].score == before[i].score);
+    }
+    remove_sqlite_files(backend.path);
+  }
+
+  // Rows saved by an L2 database are not unit length, so a cosine database normalizes them on load
+  const std::string path = "nvdb_load_path.sqlite";
+  auto sqlite = nano_vectordb::make(storage::SQLite);
+  remove_sqlite_files(path);
+  {
+    NanoVectorDB l2(dim, "cosine", path, nullptr, sqlite);
+    l2.initialize_metric(metric::L2);
+    l2.upsert(recs);
+    l2.save();
+  }
+  {
+    NanoVectorDB cosine(dim, "cosine", path, nullptr, sqlite);
+    assert(std::abs(cosine.get({ "id-7" })[0].vector.norm() - 1.0f) < 1e-5f);
+    assert(cosine.query(recs[7].vector, 1)[0].score > 0.999f);
+  }
+  remove_sqlite_files(path);
+
+  // SQLite files written before row norms were stored gain the column and load as before
+  {
+    sqlite3* raw = nullptr;
+    assert(sqlite3_open(path.c_str(), &raw) == SQLITE_OK);
+    assert(sqlite3_exec(raw,
+                        "CREATE TABLE meta (key TEXT PRIMARY KEY, value TEXT NOT NULL);"
+                        "CREATE TABLE vectors (id TEXT PRIMARY KEY, dim INTEGER NOT NULL, vec BLOB NOT NULL);",
+                        nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_stmt* ins = nullptr;
+    assert(sqlite3_prepare_v2(raw, "INSERT INTO vectors(id, dim, vec) VALUES (?1, ?2, ?3)", -1, &ins,
+                              nullptr) == SQLITE_OK);
+    for (int i = 0; i < 10; ++i)
+    {
+      sqlite3_bind_text(ins, 1, recs[i].id.c_str(), -1, SQLITE_TRANSIENT);
+      sqlite3_bind_int(ins, 2, dim);
+      sqlite3_bind_blob(ins, 3, recs[i].vector.data(), dim * sizeof(float), SQLITE_TRANSIENT);
+      assert(sqlite3_step(ins) == SQLITE_DONE);
+      sqlite3_reset(ins);
+    }
+    sqlite3_finalize(ins);
+    sqlite3_close(raw);
+  }
+  {
+    auto fresh = nano_vectordb::make(storage::SQLite);
+    NanoVectorDB legacy(dim, "cosine", path, nullptr, fresh);
+    assert(legacy.size() == 10);
+    assert(std::abs(legacy.get({ "id-3" })[0].vector.norm() - 1.0f) < 1e-5f);
+    legacy.upsert({ recs[20] });
+    legacy.save();
+    NanoVectorDB again(dim, "cosine", path, nullptr, fresh);
+    assert(again.size() == 11 && again.query(recs[20].vector, 1)[0].data.id == "id-20");
+  }
+  remove_sqlite_files(path);
+
+  // Normalizing and re-scoring large row sets runs in parallel row ranges on the scan pool
+  NanoVectorDB wide(256, "cosine", "nvdb_load_path_unsaved.json");
+  wide.set_scan_options({ 4, 1024 });
+  wide.initialize_metric(metric::L2);
+  std::vector<Data> big;
+  for (int i = 0; i < 4096; ++i)
+    big.push_back({ std::to_string(i), random_vector(256) * 2.0f });
+  wide.upsert(big);
+  wide.initialize_metric(metric::Cosine);
+  for (const std::string id : { "0", "2047", "4095" })
+    assert(std::abs(wide.get({ id })[0].vector.norm() - 1.0f) < 1e-5f);
+  assert(wide.query(big[4095].vector, 1)[0].data.id == "4095");
+  std::cerr << "[test_load_path] END" << std::endl;
+}
+
 int main()
 {
   std::cerr << "[main] START" << std::endl;
   try
   {
     test_init();
+    test_row_store();
+    test_views();
     test_same_upsert();
+    test_bulk_ingest();
     test_get();
     test_delete();
+    test_tombstones();
+    test_id_index();
     test_cond_filter();
+    test_query_batch();
+    test_topk_selection();
+    test_metric_kernels();
+    test_parallel_query();
+    test_concurrency();
+    test_hnsw_index();
+    test_ivf_index();
+    test_quantized_index();
+    test_precision();
+    test_metadata();
     test_additional_data();
     test_multi_tenant();
-    // Full backend coverage: File and SQLite
+    test_tenant_cache();
+    test_tenant_memory_budget();
+    test_query_many();
+    test_numa_placement();
+    test_metrics();
+    test_query_cache();
+    // Full backend coverage: File, SQLite and MMap
     test_storage_file_backend();
     test_storage_sqlite_backend();
+    test_sqlite_connection_cache();
+    test_storage_mmap_backend();
+    test_disk_resident();
+    test_incremental_save();
+    test_load_path();
+    test_segmented();
     std::cout << "All tests passed!" << std::endl;
     std::cerr << "[main] END SUCCESS" << std::endl;
     return 0;